@@ -0,0 +1,873 @@
+#include "acoustics.h"
+#include "memory.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#ifndef M_PI
+#	define M_PI 3.14159265358979323846
+#endif
+
+// Layout of a geometry file (native byte order):
+// magic (4) | version (4) | node count (4) | triangle count (4) | nodes | triangles
+// The nodes are stored in depth-first order, so the left child of an inner node always directly follows it.
+#define GEOMETRY_MAGIC 0x56424d48 // "HMBV"
+#define GEOMETRY_VERSION 1
+#define GEOMETRY_HEADER_SIZE 16
+#define MAX_LEAF_TRIANGLES 4
+#define MAX_TRAVERSAL_DEPTH 64
+
+#define WORKER_INTERVAL_MS 10
+// Occlusion of this many speakers is updated per worker iteration. With 64 speakers every speaker is refreshed about
+// every 40ms while the ray casting effort per iteration stays bounded.
+#define SPEAKERS_PER_ITERATION 16
+#define OCCLUSION_RAYS 5
+#define OCCLUSION_SPREAD 0.5f
+// The listener's surroundings change slowly, so enclosure is only measured every few iterations
+#define ENCLOSURE_INTERVAL 10
+#define ENCLOSURE_RAYS 16
+#define ENCLOSURE_MAX_DISTANCE 50.0f
+
+#define OPEN_CUTOFF_HZ 20000.0f
+#define OCCLUDED_CUTOFF_HZ 800.0f
+#define OCCLUDED_GAIN 0.35f
+
+#define MAX_CHANNELS 8
+
+#define COMB_COUNT 4
+#define ALLPASS_COUNT 2
+#define MAX_SAMPLE_RATE 96000
+
+#define NO_USER UINT32_MAX
+
+struct Node {
+	float bounds[2][3];
+	// Inner node: index of the right child (the left one follows directly). Leaf: index of the first triangle.
+	uint32_t rightOrFirst;
+	// Zero for inner nodes
+	uint32_t triangleCount;
+};
+
+struct Bvh {
+	const struct Node *nodes;
+	uint32_t nodeCount;
+	const struct AcousticTriangle *triangles;
+	uint32_t triangleCount;
+	void *storage;
+	size_t storageLength;
+};
+
+struct SpeakerPosition {
+	bool inUse;
+	mumble_userid_t userID;
+	float position[3];
+};
+
+// Written by the worker, read by the audio thread. Floats are stored as their bit patterns.
+struct SpeakerParameters {
+	atomic_uint userID;
+	atomic_uint gain;
+	atomic_uint cutoff;
+	atomic_uint reverbSend;
+	atomic_uint distance;
+};
+
+// Only ever touched by the audio thread
+struct SourceState {
+	mumble_userid_t userID;
+	float gain;
+	float coefficient;
+	float reverbSend;
+	float lowpass[MAX_CHANNELS];
+};
+
+struct Reverb {
+	uint32_t sampleRate;
+	size_t combLength[COMB_COUNT];
+	size_t combPosition[COMB_COUNT];
+	float combFilter[COMB_COUNT];
+	float comb[COMB_COUNT][MAX_SAMPLE_RATE / 25];
+	size_t allpassLength[ALLPASS_COUNT];
+	size_t allpassPosition[ALLPASS_COUNT];
+	float allpass[ALLPASS_COUNT][MAX_SAMPLE_RATE / 75];
+};
+
+struct Acoustics {
+	struct Bvh bvh;
+
+	pthread_mutex_t lock;
+	bool hasListener;
+	float listener[3];
+	struct SpeakerPosition speakers[ACOUSTICS_MAX_SPEAKERS];
+
+	atomic_bool listenerValid;
+	atomic_uint reverbLevel;
+	atomic_uint reverbFeedback;
+	struct SpeakerParameters parameters[ACOUSTICS_MAX_SPEAKERS];
+
+	pthread_t worker;
+	atomic_bool running;
+	float enclosureDirections[ENCLOSURE_RAYS][3];
+
+	struct SourceState sources[ACOUSTICS_MAX_SPEAKERS];
+	// The sum of the current output buffer's sends, allocated from the audio thread's frame arena by its first source
+	float *sendBus;
+	uint32_t sendBusFrames;
+	struct Reverb reverb;
+};
+
+
+static unsigned floatBits(float value) {
+	unsigned bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	return bits;
+}
+
+static float bitsFloat(unsigned bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+
+	return value;
+}
+
+
+////////////////////////////////// BVH construction //////////////////////////////////
+
+struct BuildContext {
+	const struct AcousticTriangle *input;
+	uint32_t *order;
+	float (*centroids)[3];
+	struct Node *nodes;
+	uint32_t nodeCount;
+};
+
+static void computeBounds(const struct BuildContext *context, uint32_t begin, uint32_t end, float bounds[2][3]) {
+	for (int axis = 0; axis < 3; axis++) {
+		bounds[0][axis] = INFINITY;
+		bounds[1][axis] = -INFINITY;
+	}
+
+	for (uint32_t i = begin; i < end; i++) {
+		const struct AcousticTriangle *triangle = &context->input[context->order[i]];
+		for (int vertex = 0; vertex < 3; vertex++) {
+			for (int axis = 0; axis < 3; axis++) {
+				bounds[0][axis] = fminf(bounds[0][axis], triangle->vertices[vertex][axis]);
+				bounds[1][axis] = fmaxf(bounds[1][axis], triangle->vertices[vertex][axis]);
+			}
+		}
+	}
+}
+
+// Partially sorts order[begin, end) so that the element at nth is the one with the nth smallest centroid on the axis
+static void selectNth(struct BuildContext *context, uint32_t begin, uint32_t end, uint32_t nth, int axis) {
+	while (end - begin > 1) {
+		float pivot = context->centroids[context->order[begin + (end - begin) / 2]][axis];
+		uint32_t i = begin, j = end - 1;
+		while (i <= j) {
+			while (context->centroids[context->order[i]][axis] < pivot) {
+				i++;
+			}
+			while (context->centroids[context->order[j]][axis] > pivot) {
+				j--;
+			}
+			if (i <= j) {
+				uint32_t swap     = context->order[i];
+				context->order[i] = context->order[j];
+				context->order[j] = swap;
+				i++;
+				if (j == 0) {
+					break;
+				}
+				j--;
+			}
+		}
+
+		if (nth <= j) {
+			end = j + 1;
+		} else if (nth >= i) {
+			begin = i;
+		} else {
+			return;
+		}
+	}
+}
+
+static uint32_t buildNode(struct BuildContext *context, uint32_t begin, uint32_t end, int depth) {
+	uint32_t index    = context->nodeCount++;
+	struct Node *node = &context->nodes[index];
+	computeBounds(context, begin, end, node->bounds);
+
+	if (end - begin <= MAX_LEAF_TRIANGLES || depth >= MAX_TRAVERSAL_DEPTH - 1) {
+		node->rightOrFirst  = begin;
+		node->triangleCount = end - begin;
+		return index;
+	}
+
+	int axis     = 0;
+	float extent = -1.0f;
+	for (int i = 0; i < 3; i++) {
+		if (node->bounds[1][i] - node->bounds[0][i] > extent) {
+			extent = node->bounds[1][i] - node->bounds[0][i];
+			axis   = i;
+		}
+	}
+
+	uint32_t middle = begin + (end - begin) / 2;
+	selectNth(context, begin, end, middle, axis);
+
+	// The left child directly follows its parent
+	node->triangleCount = 0;
+	buildNode(context, begin, middle, depth + 1);
+	node->rightOrFirst = buildNode(context, middle, end, depth + 1);
+
+	return index;
+}
+
+bool acoustics_writeGeometry(const char *path, const struct AcousticTriangle *triangles, size_t triangleCount) {
+	if (triangleCount == 0 || triangleCount > UINT32_MAX / 2) {
+		return false;
+	}
+
+	struct BuildContext context;
+	context.input     = triangles;
+	context.order     = memory_alloc(MEMORY_ACOUSTICS, triangleCount * sizeof(uint32_t));
+	context.centroids = memory_alloc(MEMORY_ACOUSTICS, triangleCount * sizeof(*context.centroids));
+	context.nodes     = memory_alloc(MEMORY_ACOUSTICS, 2 * triangleCount * sizeof(struct Node));
+	context.nodeCount = 0;
+
+	bool success = false;
+	FILE *file   = NULL;
+	if (!context.order || !context.centroids || !context.nodes) {
+		goto cleanup;
+	}
+
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		context.order[i] = i;
+		for (int axis = 0; axis < 3; axis++) {
+			context.centroids[i][axis] = (triangles[i].vertices[0][axis] + triangles[i].vertices[1][axis]
+										  + triangles[i].vertices[2][axis])
+										 / 3.0f;
+		}
+	}
+
+	buildNode(&context, 0, (uint32_t) triangleCount, 0);
+
+	file = fopen(path, "wb");
+	if (!file) {
+		goto cleanup;
+	}
+
+	uint32_t header[4] = { GEOMETRY_MAGIC, GEOMETRY_VERSION, context.nodeCount, (uint32_t) triangleCount };
+	success            = fwrite(header, sizeof(header), 1, file) == 1
+			  && fwrite(context.nodes, sizeof(struct Node), context.nodeCount, file) == context.nodeCount;
+	for (size_t i = 0; success && i < triangleCount; i++) {
+		success = fwrite(&triangles[context.order[i]], sizeof(struct AcousticTriangle), 1, file) == 1;
+	}
+	success = fclose(file) == 0 && success;
+
+cleanup:
+	memory_free(context.order);
+	memory_free(context.centroids);
+	memory_free(context.nodes);
+
+	return success;
+}
+
+
+////////////////////////////////// BVH loading and traversal //////////////////////////////////
+
+static bool loadGeometry(struct Bvh *bvh, const char *path) {
+	size_t length;
+	void *storage;
+
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < GEOMETRY_HEADER_SIZE) {
+		close(fd);
+		return false;
+	}
+
+	length  = (size_t) info.st_size;
+	storage = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (storage == MAP_FAILED) {
+		return false;
+	}
+#else
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	length  = (size_t) ftell(file);
+	storage = length >= GEOMETRY_HEADER_SIZE ? memory_allocLarge(MEMORY_ACOUSTICS, length) : NULL;
+	fseek(file, 0, SEEK_SET);
+	if (storage && fread(storage, 1, length, file) != length) {
+		memory_freeLarge(storage);
+		storage = NULL;
+	}
+	fclose(file);
+	if (!storage) {
+		return false;
+	}
+#endif
+
+	const uint32_t *header = storage;
+	size_t expected        = GEOMETRY_HEADER_SIZE + (size_t) header[2] * sizeof(struct Node)
+					  + (size_t) header[3] * sizeof(struct AcousticTriangle);
+
+	bvh->storage       = storage;
+	bvh->storageLength = length;
+
+	if (header[0] != GEOMETRY_MAGIC || header[1] != GEOMETRY_VERSION || header[2] == 0 || length != expected) {
+		return false;
+	}
+
+	bvh->nodeCount     = header[2];
+	bvh->triangleCount = header[3];
+	bvh->nodes         = (const struct Node *) ((const uint8_t *) storage + GEOMETRY_HEADER_SIZE);
+	bvh->triangles     = (const struct AcousticTriangle *) (bvh->nodes + bvh->nodeCount);
+
+	// Validate the references once so that traversal doesn't have to
+	for (uint32_t i = 0; i < bvh->nodeCount; i++) {
+		const struct Node *node = &bvh->nodes[i];
+		if (node->triangleCount > 0 ? (uint64_t) node->rightOrFirst + node->triangleCount > bvh->triangleCount
+									: (node->rightOrFirst <= i + 1 || node->rightOrFirst >= bvh->nodeCount)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void unloadGeometry(struct Bvh *bvh) {
+	if (!bvh->storage) {
+		return;
+	}
+
+#ifndef _WIN32
+	munmap(bvh->storage, bvh->storageLength);
+#else
+	memory_freeLarge(bvh->storage);
+#endif
+	bvh->storage = NULL;
+}
+
+static bool intersectsBox(const float bounds[2][3], const float origin[3], const float inverseDirection[3],
+						  float maxDistance) {
+	float near = 0.0f;
+	float far  = maxDistance;
+	for (int axis = 0; axis < 3; axis++) {
+		float t0 = (bounds[0][axis] - origin[axis]) * inverseDirection[axis];
+		float t1 = (bounds[1][axis] - origin[axis]) * inverseDirection[axis];
+		near     = fmaxf(near, fminf(t0, t1));
+		far      = fminf(far, fmaxf(t0, t1));
+	}
+
+	return near <= far;
+}
+
+// Möller–Trumbore ray/triangle intersection
+static float intersectTriangle(const struct AcousticTriangle *triangle, const float origin[3],
+							   const float direction[3]) {
+	const float *v0 = triangle->vertices[0];
+	float edge1[3], edge2[3], p[3], t[3], q[3];
+	for (int i = 0; i < 3; i++) {
+		edge1[i] = triangle->vertices[1][i] - v0[i];
+		edge2[i] = triangle->vertices[2][i] - v0[i];
+		t[i]     = origin[i] - v0[i];
+	}
+
+	p[0]               = direction[1] * edge2[2] - direction[2] * edge2[1];
+	p[1]               = direction[2] * edge2[0] - direction[0] * edge2[2];
+	p[2]               = direction[0] * edge2[1] - direction[1] * edge2[0];
+	float determinant = edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2];
+	if (fabsf(determinant) < 1e-8f) {
+		return INFINITY;
+	}
+
+	float inverse = 1.0f / determinant;
+	float u       = (t[0] * p[0] + t[1] * p[1] + t[2] * p[2]) * inverse;
+	if (u < 0.0f || u > 1.0f) {
+		return INFINITY;
+	}
+
+	q[0]    = t[1] * edge1[2] - t[2] * edge1[1];
+	q[1]    = t[2] * edge1[0] - t[0] * edge1[2];
+	q[2]    = t[0] * edge1[1] - t[1] * edge1[0];
+	float v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse;
+	if (v < 0.0f || u + v > 1.0f) {
+		return INFINITY;
+	}
+
+	float distance = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) * inverse;
+
+	return distance > 1e-4f ? distance : INFINITY;
+}
+
+// Returns the distance to the closest hit along the (normalized) direction or INFINITY if there is none within
+// maxDistance. If anyHit is set, the first hit found is returned instead of the closest one.
+static float castRay(const struct Bvh *bvh, const float origin[3], const float direction[3], float maxDistance,
+					 bool anyHit) {
+	float inverseDirection[3];
+	for (int axis = 0; axis < 3; axis++) {
+		inverseDirection[axis] = 1.0f / direction[axis];
+	}
+
+	uint32_t stack[MAX_TRAVERSAL_DEPTH];
+	size_t stackSize = 0;
+	stack[stackSize++] = 0;
+
+	float closest = INFINITY;
+	while (stackSize > 0) {
+		const struct Node *node = &bvh->nodes[stack[--stackSize]];
+		if (!intersectsBox(node->bounds, origin, inverseDirection, fminf(closest, maxDistance))) {
+			continue;
+		}
+
+		if (node->triangleCount > 0) {
+			for (uint32_t i = 0; i < node->triangleCount; i++) {
+				float distance = intersectTriangle(&bvh->triangles[node->rightOrFirst + i], origin, direction);
+				if (distance < closest && distance <= maxDistance) {
+					closest = distance;
+					if (anyHit) {
+						return closest;
+					}
+				}
+			}
+		} else if (stackSize + 2 <= MAX_TRAVERSAL_DEPTH) {
+			stack[stackSize++] = node->rightOrFirst;
+			stack[stackSize++] = (uint32_t) (node - bvh->nodes) + 1;
+		}
+	}
+
+	return closest;
+}
+
+static bool isBlocked(const struct Bvh *bvh, const float from[3], const float to[3]) {
+	float direction[3];
+	float length = 0.0f;
+	for (int axis = 0; axis < 3; axis++) {
+		direction[axis] = to[axis] - from[axis];
+		length += direction[axis] * direction[axis];
+	}
+	length = sqrtf(length);
+	if (length < 1e-3f) {
+		return false;
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		direction[axis] /= length;
+	}
+
+	return castRay(bvh, from, direction, length, true) < length;
+}
+
+
+////////////////////////////////// Worker //////////////////////////////////
+
+static void updateOcclusion(struct Acoustics *acoustics, size_t slot, const float listener[3]) {
+	pthread_mutex_lock(&acoustics->lock);
+	struct SpeakerPosition speaker = acoustics->speakers[slot];
+	pthread_mutex_unlock(&acoustics->lock);
+
+	if (!speaker.inUse) {
+		return;
+	}
+
+	// Besides the direct path, test a few points around the speaker so that occlusion fades in and out smoothly
+	static const float offsets[OCCLUSION_RAYS][3] = {
+		{ 0.0f, 0.0f, 0.0f }, { OCCLUSION_SPREAD, 0.0f, 0.0f }, { -OCCLUSION_SPREAD, 0.0f, 0.0f },
+		{ 0.0f, OCCLUSION_SPREAD, 0.0f }, { 0.0f, 0.0f, OCCLUSION_SPREAD },
+	};
+
+	int blocked = 0;
+	for (int ray = 0; ray < OCCLUSION_RAYS; ray++) {
+		float target[3];
+		for (int axis = 0; axis < 3; axis++) {
+			target[axis] = speaker.position[axis] + offsets[ray][axis];
+		}
+		if (isBlocked(&acoustics->bvh, listener, target)) {
+			blocked++;
+		}
+	}
+
+	float occlusion = (float) blocked / OCCLUSION_RAYS;
+	float gain      = 1.0f - (1.0f - OCCLUDED_GAIN) * occlusion;
+	// Interpolate the cutoff logarithmically as that's how it is perceived
+	float cutoff = OPEN_CUTOFF_HZ * powf(OCCLUDED_CUTOFF_HZ / OPEN_CUTOFF_HZ, occlusion);
+	// Occluded speakers are mostly heard through reflections
+	float reverbSend = 0.2f + 0.6f * occlusion;
+
+	float distance = 0.0f;
+	for (int axis = 0; axis < 3; axis++) {
+		distance += (speaker.position[axis] - listener[axis]) * (speaker.position[axis] - listener[axis]);
+	}
+	distance = sqrtf(distance);
+
+	pthread_mutex_lock(&acoustics->lock);
+	if (acoustics->speakers[slot].inUse && acoustics->speakers[slot].userID == speaker.userID) {
+		struct SpeakerParameters *parameters = &acoustics->parameters[slot];
+		atomic_store_explicit(&parameters->gain, floatBits(gain), memory_order_relaxed);
+		atomic_store_explicit(&parameters->cutoff, floatBits(cutoff), memory_order_relaxed);
+		atomic_store_explicit(&parameters->reverbSend, floatBits(reverbSend), memory_order_relaxed);
+		atomic_store_explicit(&parameters->distance, floatBits(distance), memory_order_relaxed);
+		atomic_store_explicit(&parameters->userID, speaker.userID, memory_order_release);
+	}
+	pthread_mutex_unlock(&acoustics->lock);
+}
+
+static void updateEnclosure(struct Acoustics *acoustics, const float listener[3]) {
+	int hits            = 0;
+	float totalDistance = 0.0f;
+	for (int ray = 0; ray < ENCLOSURE_RAYS; ray++) {
+		float distance =
+			castRay(&acoustics->bvh, listener, acoustics->enclosureDirections[ray], ENCLOSURE_MAX_DISTANCE, false);
+		if (distance < ENCLOSURE_MAX_DISTANCE) {
+			hits++;
+			totalDistance += distance;
+		}
+	}
+
+	float enclosure = (float) hits / ENCLOSURE_RAYS;
+	float roomSize  = hits > 0 ? totalDistance / hits / ENCLOSURE_MAX_DISTANCE : 0.0f;
+
+	// Closed rooms get more reverb, big rooms a longer tail
+	atomic_store_explicit(&acoustics->reverbLevel, floatBits(0.4f * enclosure), memory_order_relaxed);
+	atomic_store_explicit(&acoustics->reverbFeedback, floatBits(0.7f + 0.18f * roomSize), memory_order_relaxed);
+}
+
+static void *runWorker(void *arg) {
+	struct Acoustics *acoustics = arg;
+
+	const struct timespec interval = { 0, WORKER_INTERVAL_MS * 1000000L };
+	size_t cursor                  = 0;
+	unsigned iteration             = 0;
+
+	while (atomic_load(&acoustics->running)) {
+		pthread_mutex_lock(&acoustics->lock);
+		bool hasListener = acoustics->hasListener;
+		float listener[3];
+		memcpy(listener, acoustics->listener, sizeof(listener));
+		pthread_mutex_unlock(&acoustics->lock);
+
+		if (hasListener) {
+			if (iteration++ % ENCLOSURE_INTERVAL == 0) {
+				updateEnclosure(acoustics, listener);
+			}
+
+			for (size_t i = 0; i < SPEAKERS_PER_ITERATION; i++) {
+				updateOcclusion(acoustics, cursor, listener);
+				cursor = (cursor + 1) % ACOUSTICS_MAX_SPEAKERS;
+			}
+
+			atomic_store_explicit(&acoustics->listenerValid, true, memory_order_release);
+		}
+
+		nanosleep(&interval, NULL);
+	}
+
+	return NULL;
+}
+
+
+////////////////////////////////// Audio processing //////////////////////////////////
+
+static void configureReverb(struct Reverb *reverb, uint32_t sampleRate) {
+	// Classic Schroeder reverb delay lengths (given for 44.1kHz)
+	static const size_t combLengths[COMB_COUNT]       = { 1557, 1617, 1491, 1422 };
+	static const size_t allpassLengths[ALLPASS_COUNT] = { 556, 225 };
+
+	memset(reverb, 0, sizeof(*reverb));
+	reverb->sampleRate = sampleRate;
+	for (int i = 0; i < COMB_COUNT; i++) {
+		reverb->combLength[i] = combLengths[i] * sampleRate / 44100;
+	}
+	for (int i = 0; i < ALLPASS_COUNT; i++) {
+		reverb->allpassLength[i] = allpassLengths[i] * sampleRate / 44100;
+	}
+}
+
+static struct SourceState *sourceState(struct Acoustics *acoustics, mumble_userid_t userID, float *gain,
+									   float *cutoff, float *reverbSend, float *distance) {
+	for (size_t slot = 0; slot < ACOUSTICS_MAX_SPEAKERS; slot++) {
+		struct SpeakerParameters *parameters = &acoustics->parameters[slot];
+		if (atomic_load_explicit(&parameters->userID, memory_order_acquire) != userID) {
+			continue;
+		}
+
+		*gain       = bitsFloat(atomic_load_explicit(&parameters->gain, memory_order_relaxed));
+		*cutoff     = bitsFloat(atomic_load_explicit(&parameters->cutoff, memory_order_relaxed));
+		*reverbSend = bitsFloat(atomic_load_explicit(&parameters->reverbSend, memory_order_relaxed));
+		*distance   = bitsFloat(atomic_load_explicit(&parameters->distance, memory_order_relaxed));
+
+		return &acoustics->sources[slot];
+	}
+
+	return NULL;
+}
+
+// The gain Mumble applies to a speaker at the given distance, leaving out the speaker's direction
+static float distanceGain(const struct AcousticsDistanceModel *model, float distance) {
+	if (model->minimumVolume > 0.99f) {
+		// Attenuation is disabled
+		return 1.0f;
+	}
+	if (distance < model->minimumDistance) {
+		// Close speakers "bloom", i.e. get louder the closer they are
+		return 1.0f + model->bloom * (1.0f - distance / model->minimumDistance);
+	}
+	if (distance >= model->maximumDistance) {
+		return model->minimumVolume;
+	}
+
+	// The volume falls off exponentially between the minimum and the maximum distance
+	float minimumVolume = fmaxf(model->minimumVolume, 0.005f);
+	float relative      = (distance - model->minimumDistance) / (model->maximumDistance - model->minimumDistance);
+
+	return powf(minimumVolume, relative);
+}
+
+bool acoustics_processSource(struct Acoustics *acoustics, float *pcm, uint32_t sampleCount, uint16_t channelCount,
+							 uint32_t sampleRate, mumble_userid_t userID,
+							 const struct AcousticsDistanceModel *distanceModel, struct MemoryArena *frameArena) {
+	if (!atomic_load_explicit(&acoustics->listenerValid, memory_order_acquire) || channelCount == 0
+		|| channelCount > MAX_CHANNELS || sampleRate == 0 || sampleRate > MAX_SAMPLE_RATE) {
+		return false;
+	}
+
+	float gain, cutoff, reverbSend, distance;
+	struct SourceState *state = sourceState(acoustics, userID, &gain, &cutoff, &reverbSend, &distance);
+	if (!state) {
+		return false;
+	}
+	reverbSend *= distanceGain(distanceModel, distance);
+
+	float coefficient = 1.0f - expf(-2.0f * (float) M_PI * fminf(cutoff, 0.45f * sampleRate) / sampleRate);
+	if (state->userID != userID) {
+		// The slot has been handed to a different user -> start from scratch without fading
+		memset(state, 0, sizeof(*state));
+		state->userID      = userID;
+		state->gain        = gain;
+		state->coefficient = coefficient;
+		state->reverbSend  = reverbSend;
+	}
+
+	float sendLevel = bitsFloat(atomic_load_explicit(&acoustics->reverbLevel, memory_order_relaxed));
+	if (!acoustics->sendBus) {
+		// Without room in the arena, the buffer's sources are played without reverb
+		acoustics->sendBus = memory_arenaAlloc(frameArena, sampleCount * sizeof(float));
+		if (acoustics->sendBus) {
+			memset(acoustics->sendBus, 0, sampleCount * sizeof(float));
+			acoustics->sendBusFrames = sampleCount;
+		}
+	}
+
+	// Parameters are ramped across the frame to avoid zipper noise
+	float step = 1.0f / sampleCount;
+	for (uint32_t frame = 0; frame < sampleCount; frame++) {
+		float t = (frame + 1) * step;
+		float g = state->gain + (gain - state->gain) * t;
+		float a = state->coefficient + (coefficient - state->coefficient) * t;
+		float s = state->reverbSend + (reverbSend - state->reverbSend) * t;
+
+		float mono = 0.0f;
+		for (uint16_t channel = 0; channel < channelCount; channel++) {
+			float *sample = &pcm[(size_t) frame * channelCount + channel];
+			state->lowpass[channel] += a * (*sample - state->lowpass[channel]);
+			*sample = state->lowpass[channel] * g;
+			mono += state->lowpass[channel];
+		}
+
+		if (frame < acoustics->sendBusFrames) {
+			acoustics->sendBus[frame] += mono / channelCount * s * sendLevel;
+		}
+	}
+
+	state->gain        = gain;
+	state->coefficient = coefficient;
+	state->reverbSend  = reverbSend;
+
+	return true;
+}
+
+bool acoustics_renderReverb(struct Acoustics *acoustics, float *pcm, uint32_t sampleCount, uint16_t channelCount,
+							uint32_t sampleRate) {
+	if (channelCount == 0 || sampleRate == 0 || sampleRate > MAX_SAMPLE_RATE) {
+		return false;
+	}
+
+	struct Reverb *reverb = &acoustics->reverb;
+	if (reverb->sampleRate != sampleRate) {
+		configureReverb(reverb, sampleRate);
+	}
+
+	float feedback = bitsFloat(atomic_load_explicit(&acoustics->reverbFeedback, memory_order_relaxed));
+	// Damping inside the comb filters makes the tail darker over time
+	const float damping = 0.3f;
+
+	for (uint32_t frame = 0; frame < sampleCount; frame++) {
+		float input  = frame < acoustics->sendBusFrames ? acoustics->sendBus[frame] : 0.0f;
+		float output = 0.0f;
+
+		for (int i = 0; i < COMB_COUNT; i++) {
+			float *delayed        = &reverb->comb[i][reverb->combPosition[i]];
+			float value           = *delayed;
+			reverb->combFilter[i] = value * (1.0f - damping) + reverb->combFilter[i] * damping;
+			*delayed              = input + reverb->combFilter[i] * feedback;
+			reverb->combPosition[i] = (reverb->combPosition[i] + 1) % reverb->combLength[i];
+			output += value;
+		}
+
+		for (int i = 0; i < ALLPASS_COUNT; i++) {
+			float *delayed             = &reverb->allpass[i][reverb->allpassPosition[i]];
+			float value                = *delayed;
+			*delayed                   = output + value * 0.5f;
+			output                     = value - output;
+			reverb->allpassPosition[i] = (reverb->allpassPosition[i] + 1) % reverb->allpassLength[i];
+		}
+
+		output *= 0.25f;
+		for (uint16_t channel = 0; channel < channelCount; channel++) {
+			pcm[(size_t) frame * channelCount + channel] += output;
+		}
+	}
+
+	acoustics_discardReverb(acoustics);
+
+	return true;
+}
+
+void acoustics_discardReverb(struct Acoustics *acoustics) {
+	acoustics->sendBus       = NULL;
+	acoustics->sendBusFrames = 0;
+}
+
+
+////////////////////////////////// Setup //////////////////////////////////
+
+struct Acoustics *acoustics_create(const char *geometryPath) {
+	// Mostly consists of the reverb's delay lines
+	struct Acoustics *acoustics = memory_allocLarge(MEMORY_ACOUSTICS, sizeof(struct Acoustics));
+	if (!acoustics) {
+		return NULL;
+	}
+
+	if (!loadGeometry(&acoustics->bvh, geometryPath)) {
+		unloadGeometry(&acoustics->bvh);
+		memory_freeLarge(acoustics);
+		return NULL;
+	}
+
+	pthread_mutex_init(&acoustics->lock, NULL);
+	for (size_t i = 0; i < ACOUSTICS_MAX_SPEAKERS; i++) {
+		atomic_init(&acoustics->parameters[i].userID, NO_USER);
+		acoustics->sources[i].userID = NO_USER;
+	}
+	atomic_init(&acoustics->reverbLevel, floatBits(0.0f));
+	atomic_init(&acoustics->reverbFeedback, floatBits(0.7f));
+
+	// Spread the enclosure rays evenly over the sphere (Fibonacci lattice)
+	for (int ray = 0; ray < ENCLOSURE_RAYS; ray++) {
+		float y      = 1.0f - 2.0f * (ray + 0.5f) / ENCLOSURE_RAYS;
+		float radius = sqrtf(1.0f - y * y);
+		float angle  = (float) M_PI * (3.0f - sqrtf(5.0f)) * ray;
+
+		acoustics->enclosureDirections[ray][0] = cosf(angle) * radius;
+		acoustics->enclosureDirections[ray][1] = y;
+		acoustics->enclosureDirections[ray][2] = sinf(angle) * radius;
+	}
+
+	atomic_init(&acoustics->running, true);
+	if (pthread_create(&acoustics->worker, NULL, &runWorker, acoustics) != 0) {
+		pthread_mutex_destroy(&acoustics->lock);
+		unloadGeometry(&acoustics->bvh);
+		memory_freeLarge(acoustics);
+		return NULL;
+	}
+
+	return acoustics;
+}
+
+void acoustics_destroy(struct Acoustics *acoustics) {
+	if (!acoustics) {
+		return;
+	}
+
+	atomic_store(&acoustics->running, false);
+	pthread_join(acoustics->worker, NULL);
+
+	pthread_mutex_destroy(&acoustics->lock);
+	unloadGeometry(&acoustics->bvh);
+	memory_freeLarge(acoustics);
+}
+
+void acoustics_setListener(struct Acoustics *acoustics, const float position[3]) {
+	pthread_mutex_lock(&acoustics->lock);
+	acoustics->hasListener = true;
+	memcpy(acoustics->listener, position, sizeof(acoustics->listener));
+	pthread_mutex_unlock(&acoustics->lock);
+}
+
+void acoustics_clearListener(struct Acoustics *acoustics) {
+	pthread_mutex_lock(&acoustics->lock);
+	acoustics->hasListener = false;
+	atomic_store_explicit(&acoustics->listenerValid, false, memory_order_release);
+	pthread_mutex_unlock(&acoustics->lock);
+}
+
+void acoustics_setSpeaker(struct Acoustics *acoustics, mumble_userid_t userID, const float position[3]) {
+	pthread_mutex_lock(&acoustics->lock);
+
+	struct SpeakerPosition *freeSlot = NULL;
+	for (size_t i = 0; i < ACOUSTICS_MAX_SPEAKERS; i++) {
+		struct SpeakerPosition *speaker = &acoustics->speakers[i];
+		if (speaker->inUse && speaker->userID == userID) {
+			memcpy(speaker->position, position, sizeof(speaker->position));
+			pthread_mutex_unlock(&acoustics->lock);
+			return;
+		}
+		if (!speaker->inUse && !freeSlot) {
+			freeSlot = speaker;
+		}
+	}
+
+	if (freeSlot) {
+		freeSlot->inUse  = true;
+		freeSlot->userID = userID;
+		memcpy(freeSlot->position, position, sizeof(freeSlot->position));
+	}
+
+	pthread_mutex_unlock(&acoustics->lock);
+}
+
+void acoustics_removeSpeaker(struct Acoustics *acoustics, mumble_userid_t userID) {
+	pthread_mutex_lock(&acoustics->lock);
+
+	for (size_t i = 0; i < ACOUSTICS_MAX_SPEAKERS; i++) {
+		if (acoustics->speakers[i].inUse && acoustics->speakers[i].userID == userID) {
+			acoustics->speakers[i].inUse = false;
+			atomic_store_explicit(&acoustics->parameters[i].userID, NO_USER, memory_order_release);
+		}
+	}
+
+	pthread_mutex_unlock(&acoustics->lock);
+}
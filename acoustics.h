@@ -0,0 +1,88 @@
+/// This header file declares the acoustic environment engine that makes walls audible.
+///
+/// Level geometry is stored as a bounding volume hierarchy (BVH) in a file that is memory-mapped when loading, so even
+/// large levels load instantly. A worker thread casts rays from the listener to every speaker and around the listener
+/// itself and caches the results per user: how much of a speaker is occluded (applied as attenuation and low-pass
+/// filtering) and how enclosed the listener is (applied as reverb). Ray casts are spread across worker iterations so
+/// that their cost doesn't depend on the amount of speakers per audio frame.
+///
+/// The audio side (acoustics_processSource and acoustics_renderReverb) only reads cached parameters and never blocks.
+/// It has to be called from a single audio thread. All other functions may be called from any thread.
+
+#ifndef MUMBLE_PLUGIN_ACOUSTICS_H_
+#define MUMBLE_PLUGIN_ACOUSTICS_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The maximum amount of speakers whose acoustics are tracked at the same time
+#define ACOUSTICS_MAX_SPEAKERS 64
+
+struct AcousticTriangle {
+	float vertices[3][3];
+};
+
+/// Mumble's positional audio distance settings (see mumblesettings.h)
+struct AcousticsDistanceModel {
+	float minimumDistance;
+	float maximumDistance;
+	float bloom;
+	/// The volume at (and beyond) the maximum distance
+	float minimumVolume;
+};
+
+struct Acoustics;
+struct MemoryArena;
+
+/// Builds a BVH over the given triangles and writes it to the given geometry file
+///
+/// @returns Whether writing the file succeeded
+bool acoustics_writeGeometry(const char *path, const struct AcousticTriangle *triangles, size_t triangleCount);
+
+/// Creates the engine and starts its worker thread
+///
+/// @param geometryPath A geometry file created by acoustics_writeGeometry. It is memory-mapped for the lifetime of the
+/// engine.
+/// @returns The new engine or NULL if the file couldn't be loaded or the worker couldn't be started
+struct Acoustics *acoustics_create(const char *geometryPath);
+
+/// Stops the worker thread and releases all resources
+void acoustics_destroy(struct Acoustics *acoustics);
+
+/// Sets the listener's position (usually the camera position obtained in mumble_fetchPositionalData)
+void acoustics_setListener(struct Acoustics *acoustics, const float position[3]);
+
+/// Tells that there's no listener position available (anymore). This disables all processing.
+void acoustics_clearListener(struct Acoustics *acoustics);
+
+/// Sets the position of the given speaker
+void acoustics_setSpeaker(struct Acoustics *acoustics, mumble_userid_t userID, const float position[3]);
+
+void acoustics_removeSpeaker(struct Acoustics *acoustics, mumble_userid_t userID);
+
+/// Applies occlusion to a speaker's audio and feeds its reverb send (see mumble_onAudioSourceFetched)
+///
+/// Mumble only applies its distance attenuation after this, so it doesn't affect the reverb send. The send is
+/// attenuated according to the given distance model instead.
+///
+/// @param frameArena The arena the sends are summed in. It must not be reset before the output buffer's reverb has
+/// been rendered or discarded.
+/// @returns Whether the audio has been modified
+bool acoustics_processSource(struct Acoustics *acoustics, float *pcm, uint32_t sampleCount, uint16_t channelCount,
+							 uint32_t sampleRate, mumble_userid_t userID,
+							 const struct AcousticsDistanceModel *distanceModel, struct MemoryArena *frameArena);
+
+/// Adds the reverb generated from all sources' sends to the final mix (see mumble_onAudioOutputAboutToPlay)
+///
+/// @returns Whether the audio has been modified
+bool acoustics_renderReverb(struct Acoustics *acoustics, float *pcm, uint32_t sampleCount, uint16_t channelCount,
+							uint32_t sampleRate);
+
+/// Drops the reverb sends of the current frame instead of rendering them (for when reverb is disabled). Either this or
+/// acoustics_renderReverb has to be called before the frame arena is reset.
+void acoustics_discardReverb(struct Acoustics *acoustics);
+
+#endif // MUMBLE_PLUGIN_ACOUSTICS_H_
@@ -0,0 +1,240 @@
+#include "commands.h"
+#include "memory.h"
+
+#include <stdlib.h>
+
+#if (COMMANDS_QUEUE_SIZE & (COMMANDS_QUEUE_SIZE - 1)) != 0
+#	error "COMMANDS_QUEUE_SIZE has to be a power of two"
+#endif
+
+// A slot's sequence number tells who owns it: Equal to the position a producer is about to claim means the slot is
+// free, one more means the command in it has been written completely and may be taken out by the dispatcher.
+struct Slot {
+	atomic_size_t sequence;
+	struct Command command;
+};
+
+// A command taken out of the queue by the dispatcher
+struct Entry {
+	struct Command command;
+	// The entry this one has been merged into (its own index if it hasn't been merged)
+	size_t winner;
+	// Whether the command turned out to be redundant (e.g. two toggles in a row) and completes without executing
+	bool cancelled;
+	// A toggle following a mute request is executed as the inverted mute request (with the mute state in muted)
+	bool inverted;
+	bool muted;
+	mumble_error_t result;
+};
+
+struct CommandQueue {
+	CommandExecuteFunction execute;
+	void *userData;
+
+	struct Slot slots[COMMANDS_QUEUE_SIZE];
+	// The next position producers claim
+	atomic_size_t tail;
+	// The next position the dispatcher takes out (only accessed by the dispatcher)
+	size_t head;
+
+	struct Entry batch[COMMANDS_QUEUE_SIZE];
+};
+
+
+static bool dequeue(struct CommandQueue *queue, struct Command *command) {
+	struct Slot *slot = &queue->slots[queue->head & (COMMANDS_QUEUE_SIZE - 1)];
+	if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != queue->head + 1) {
+		// Either empty or the producer that claimed the slot hasn't finished writing it yet
+		return false;
+	}
+
+	*command = slot->command;
+	atomic_store_explicit(&slot->sequence, queue->head + COMMANDS_QUEUE_SIZE, memory_order_release);
+	queue->head++;
+
+	return true;
+}
+
+static void complete(const struct Command *command, mumble_error_t result) {
+	if (command->completion) {
+		command->completion(command->userData, command, result);
+	}
+	if (command->future) {
+		command->future->result = result;
+		atomic_store_explicit(&command->future->state, COMMAND_DONE, memory_order_release);
+	}
+}
+
+// Commands in the same group modify the same state
+static int mergeGroup(enum CommandType type) {
+	switch (type) {
+		case COMMAND_TOGGLE_SELF_MUTE:
+			return COMMAND_SELF_MUTE;
+		case COMMAND_PLAY_SAMPLE:
+			return -1;
+		default:
+			return (int) type;
+	}
+}
+
+static bool sameTarget(const struct Command *a, const struct Command *b) {
+	int group = mergeGroup(a->type);
+	if (group < 0 || group != mergeGroup(b->type)) {
+		return false;
+	}
+
+	switch (a->type) {
+		case COMMAND_MOVE_USER:
+		case COMMAND_LOCAL_MUTE:
+			return a->connection == b->connection && a->userID == b->userID;
+		case COMMAND_SET_COMMENT:
+			return a->connection == b->connection;
+		default:
+			// The local user's state isn't tied to a connection
+			return true;
+	}
+}
+
+// Merges the given entry with the latest preceding one that targets the same state
+static void merge(struct Entry *batch, size_t index) {
+	struct Entry *entry = &batch[index];
+
+	for (size_t i = index; i-- > 0;) {
+		struct Entry *previous = &batch[i];
+		if (previous->winner != i || !sameTarget(&previous->command, &entry->command)) {
+			continue;
+		}
+
+		previous->winner = index;
+		if (entry->command.type != COMMAND_TOGGLE_SELF_MUTE || previous->cancelled) {
+			return;
+		}
+
+		if (previous->command.type == COMMAND_SELF_MUTE) {
+			entry->inverted = true;
+			entry->muted    = !previous->command.enabled;
+		} else if (previous->inverted) {
+			entry->inverted = true;
+			entry->muted    = !previous->muted;
+		} else {
+			entry->cancelled = true;
+		}
+
+		return;
+	}
+}
+
+struct CommandQueue *commands_create(CommandExecuteFunction execute, void *userData) {
+	struct CommandQueue *queue = memory_calloc(MEMORY_COMMANDS, 1, sizeof(struct CommandQueue));
+	if (!queue) {
+		return NULL;
+	}
+
+	queue->execute  = execute;
+	queue->userData = userData;
+	for (size_t i = 0; i < COMMANDS_QUEUE_SIZE; i++) {
+		atomic_init(&queue->slots[i].sequence, i);
+	}
+	atomic_init(&queue->tail, 0);
+
+	return queue;
+}
+
+void commands_destroy(struct CommandQueue *queue) {
+	if (!queue) {
+		return;
+	}
+
+	struct Command command;
+	while (dequeue(queue, &command)) {
+		complete(&command, MUMBLE_EC_GENERIC_ERROR);
+	}
+
+	memory_free(queue);
+}
+
+bool commands_enqueue(struct CommandQueue *queue, const struct Command *command) {
+	size_t position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	struct Slot *slot;
+
+	while (true) {
+		slot            = &queue->slots[position & (COMMANDS_QUEUE_SIZE - 1)];
+		size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+		if (sequence == position) {
+			if (atomic_compare_exchange_weak_explicit(&queue->tail, &position, position + 1, memory_order_relaxed,
+													  memory_order_relaxed)) {
+				break;
+			}
+			// position has been updated to the current tail
+		} else if ((intptr_t) (sequence - position) < 0) {
+			// The slot still holds a command from the previous round -> the queue is full
+			return false;
+		} else {
+			position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+		}
+	}
+
+	slot->command = *command;
+	atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+
+	return true;
+}
+
+size_t commands_dispatch(struct CommandQueue *queue) {
+	size_t count = 0;
+	while (count < COMMANDS_QUEUE_SIZE && dequeue(queue, &queue->batch[count].command)) {
+		struct Entry *entry = &queue->batch[count];
+		entry->winner       = count;
+		entry->cancelled    = false;
+		entry->inverted     = false;
+		entry->muted        = false;
+		entry->result       = MUMBLE_STATUS_OK;
+
+		merge(queue->batch, count);
+		count++;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		struct Entry *entry = &queue->batch[i];
+		if (entry->winner != i || entry->cancelled) {
+			continue;
+		}
+
+		if (entry->inverted) {
+			struct Command command = entry->command;
+			command.type           = COMMAND_SELF_MUTE;
+			command.enabled        = entry->muted;
+			entry->result          = queue->execute(queue->userData, &command);
+		} else {
+			entry->result = queue->execute(queue->userData, &entry->command);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		// Merged commands share the result of the command they have been merged into
+		size_t winner = i;
+		while (queue->batch[winner].winner != winner) {
+			winner = queue->batch[winner].winner;
+		}
+
+		complete(&queue->batch[i].command, queue->batch[winner].result);
+	}
+
+	return count;
+}
+
+void commands_resetFuture(struct CommandFuture *future) {
+	future->result = MUMBLE_STATUS_OK;
+	atomic_store_explicit(&future->state, COMMAND_PENDING, memory_order_relaxed);
+}
+
+bool commands_pollFuture(struct CommandFuture *future, mumble_error_t *result) {
+	if (atomic_load_explicit(&future->state, memory_order_acquire) != COMMAND_DONE) {
+		return false;
+	}
+
+	*result = future->result;
+
+	return true;
+}
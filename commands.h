@@ -0,0 +1,117 @@
+/// This header file declares the queue through which code that must not block can make requests to Mumble.
+///
+/// API functions like requestUserMove or findChannelByName must not be called from audio callbacks (and block until
+/// Mumble's main thread gets to them when called from any other thread). Instead, typed commands are put into a
+/// bounded lock-free queue that any amount of threads may write to without ever blocking or allocating. A single
+/// dispatcher takes out everything that has been queued in one go, merges commands that make each other redundant and
+/// executes the remaining ones through the execute callback. Every command is completed exactly once, either through a
+/// callback (invoked on the dispatching thread) or through a future that the submitter polls.
+///
+/// Commands are merged if they target the same state: Only the last of several mute requests for the same user is
+/// executed, two toggles of the local user's mute state cancel each other out and a toggle following a mute request
+/// simply inverts it. Commands that have been merged into another one complete with that command's result.
+
+#ifndef MUMBLE_PLUGIN_COMMANDS_H_
+#define MUMBLE_PLUGIN_COMMANDS_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The maximum amount of commands waiting to be dispatched (a power of two)
+#define COMMANDS_QUEUE_SIZE 256
+/// The maximum length of a command's text (including the terminator)
+#define COMMANDS_MAX_TEXT 256
+
+enum CommandType {
+	/// Moves userID on connection into channelID, or into the channel named text if that isn't empty
+	COMMAND_MOVE_USER,
+	/// Locally mutes (enabled) or unmutes userID on connection
+	COMMAND_LOCAL_MUTE,
+	/// Mutes (enabled) or unmutes the local user
+	COMMAND_SELF_MUTE,
+	/// Inverts the local user's mute state
+	COMMAND_TOGGLE_SELF_MUTE,
+	/// Deafens (enabled) or undeafens the local user
+	COMMAND_SELF_DEAF,
+	/// Switches the local user's transmission mode to transmissionMode
+	COMMAND_TRANSMISSION_MODE,
+	/// Sets the local user's comment on connection to text
+	COMMAND_SET_COMMENT,
+	/// Plays the sample at the path text (never merged)
+	COMMAND_PLAY_SAMPLE,
+};
+
+enum CommandFutureState { COMMAND_PENDING, COMMAND_DONE };
+
+/// The result of a command that can be polled from any thread
+struct CommandFuture {
+	/// An enum CommandFutureState value
+	atomic_int state;
+	/// Only valid once state is COMMAND_DONE
+	mumble_error_t result;
+};
+
+struct Command;
+
+/// Receives the result of a command. This is called on the dispatching thread.
+typedef void (*CommandCompletionFunction)(void *userData, const struct Command *command, mumble_error_t result);
+
+struct Command {
+	enum CommandType type;
+	mumble_connection_t connection;
+	mumble_userid_t userID;
+	mumble_channelid_t channelID;
+	bool enabled;
+	mumble_transmission_mode_t transmissionMode;
+	char text[COMMANDS_MAX_TEXT];
+
+	/// Called once the command has completed (may be NULL)
+	CommandCompletionFunction completion;
+	void *userData;
+	/// Resolved once the command has completed (may be NULL). It has to stay valid until then.
+	struct CommandFuture *future;
+};
+
+/// Executes a single command. Usually this calls the respective MumbleAPI function.
+typedef mumble_error_t (*CommandExecuteFunction)(void *userData, const struct Command *command);
+
+struct CommandQueue;
+
+/// Creates a new queue. All memory it needs is allocated here.
+///
+/// @param execute The function used to execute commands
+/// @param userData An arbitrary pointer that is passed to the execute callback
+/// @returns The new queue or NULL if allocating it failed
+struct CommandQueue *commands_create(CommandExecuteFunction execute, void *userData);
+
+/// Destroys the queue. Commands that haven't been dispatched yet complete with MUMBLE_EC_GENERIC_ERROR. No thread may
+/// enqueue commands anymore.
+void commands_destroy(struct CommandQueue *queue);
+
+/// Queues the given command (it is copied). This never blocks and may be called from any thread (including audio
+/// threads).
+///
+/// @returns Whether the command has been queued. If the queue is full, it is dropped without being completed.
+bool commands_enqueue(struct CommandQueue *queue, const struct Command *command);
+
+/// Merges and executes all commands that have been queued so far
+///
+/// NOTE: Only one thread at a time may dispatch. It has to be a thread that is allowed to call into Mumble.
+///
+/// @returns The amount of commands that have been completed
+size_t commands_dispatch(struct CommandQueue *queue);
+
+/// Prepares a future to be passed along with a command
+void commands_resetFuture(struct CommandFuture *future);
+
+/// Checks whether the command the given future belongs to has completed
+///
+/// @param[out] result The command's result (only written if it has completed)
+/// @returns Whether it has completed
+bool commands_pollFuture(struct CommandFuture *future, mumble_error_t *result);
+
+#endif // MUMBLE_PLUGIN_COMMANDS_H_
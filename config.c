@@ -0,0 +1,506 @@
+#include "config.h"
+#include "memory.h"
+#include "transcription.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#	include <poll.h>
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#endif
+
+#define MAX_LINE_LENGTH 1024
+// Replaced snapshots waiting to be freed. Readers only hold snapshots for the duration of a callback, so this only
+// fills up if the file changes extremely often.
+#define MAX_RETIRED 64
+// Snapshots come from a pool: the current one, the retired ones and a few that are being parsed concurrently
+#define SNAPSHOT_POOL_SIZE (MAX_RETIRED + 4)
+// The watcher wakes up at least this often, also to free retired snapshots
+#define WATCH_INTERVAL_MS 500
+
+struct Retired {
+	struct PluginSettings *snapshot;
+	// The epoch in which the snapshot has been replaced
+	uint64_t epoch;
+};
+
+struct Config {
+	char path[4096];
+
+	struct MemoryPool *snapshots;
+	_Atomic(struct PluginSettings *) current;
+	_Atomic uint64_t globalEpoch;
+	// The epoch each reader entered in or 0 for unused slots
+	_Atomic uint64_t readerEpochs[CONFIG_MAX_READERS];
+
+	// Serializes publishing and reclamation. It is never taken by readers.
+	pthread_mutex_t writerLock;
+	struct Retired retired[MAX_RETIRED];
+	size_t retiredCount;
+	uint64_t generation;
+
+	bool watching;
+	pthread_t watcher;
+	atomic_bool running;
+	int inotifyFD;
+};
+
+static const struct PluginSettings defaultSettings = {
+	.generation       = 0,
+	.soundboardVolume = 1.0f,
+	.acoustics        = true,
+	.reverb           = true,
+	.cpuBudget        = 0.25f,
+	.spectrumRate     = 20,
+	.logFile          = false,
+
+	.transcription                = false,
+	.transcriptionWorkers         = 2,
+	.transcriptionLatencyBudgetMs = 2000,
+	.textIndex                    = false,
+};
+
+// The slot the calling thread currently occupies (SIZE_MAX if none) and where it starts looking for a free one
+static _Thread_local size_t readerSlot = SIZE_MAX;
+static _Thread_local size_t readerHint;
+
+
+////////////////////////////////// Parsing //////////////////////////////////
+
+static char *trim(char *text) {
+	while (isspace((unsigned char) *text)) {
+		text++;
+	}
+
+	size_t length = strlen(text);
+	while (length > 0 && isspace((unsigned char) text[length - 1])) {
+		text[--length] = '\0';
+	}
+
+	return text;
+}
+
+static bool parseBool(const char *value, bool *result) {
+	if (strcmp(value, "true") == 0 || strcmp(value, "yes") == 0 || strcmp(value, "on") == 0
+		|| strcmp(value, "1") == 0) {
+		*result = true;
+	} else if (strcmp(value, "false") == 0 || strcmp(value, "no") == 0 || strcmp(value, "off") == 0
+			   || strcmp(value, "0") == 0) {
+		*result = false;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool parseTransmissionMode(const char *value, mumble_transmission_mode_t *mode) {
+	if (strcmp(value, "continuous") == 0) {
+		*mode = MUMBLE_TM_CONTINOUS;
+	} else if (strcmp(value, "voice-activation") == 0) {
+		*mode = MUMBLE_TM_VOICE_ACTIVATION;
+	} else if (strcmp(value, "push-to-talk") == 0) {
+		*mode = MUMBLE_TM_PUSH_TO_TALK;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool parseAction(char *value, struct KeyAction *action) {
+	memset(action, 0, sizeof(*action));
+
+	char *argument = value + strcspn(value, " \t");
+	if (*argument != '\0') {
+		*argument++ = '\0';
+		argument    = trim(argument);
+	}
+	if (strlen(argument) >= sizeof(action->argument)) {
+		return false;
+	}
+
+	bool needsArgument = true;
+	if (strcmp(value, "soundboard") == 0) {
+		action->type = KEY_ACTION_SOUNDBOARD;
+	} else if (strcmp(value, "sample") == 0) {
+		action->type = KEY_ACTION_PLAY_SAMPLE;
+	} else if (strcmp(value, "channel") == 0) {
+		action->type = KEY_ACTION_MOVE_TO_CHANNEL;
+	} else if (strcmp(value, "mute") == 0) {
+		action->type  = KEY_ACTION_SELF_MUTE;
+		needsArgument = false;
+	} else if (strcmp(value, "transmission") == 0 || strcmp(value, "hold-transmission") == 0) {
+		action->type      = KEY_ACTION_TRANSMISSION_MODE;
+		action->momentary = value[0] == 'h';
+		if (!parseTransmissionMode(argument, &action->transmissionMode)) {
+			return false;
+		}
+	} else if (strcmp(value, "custom") == 0) {
+		char *end;
+		action->type     = KEY_ACTION_CUSTOM;
+		action->customID = (int) strtol(argument, &end, 10);
+		if (*end != '\0') {
+			return false;
+		}
+	} else {
+		return false;
+	}
+
+	if (needsArgument != (argument[0] != '\0')) {
+		return false;
+	}
+	strcpy(action->argument, argument);
+
+	return true;
+}
+
+// Parses the given file. A missing file yields the defaults.
+static struct PluginSettings *parseFile(struct MemoryPool *snapshots, const char *path) {
+	struct PluginSettings *settings = memory_poolAlloc(snapshots);
+	if (!settings) {
+		return NULL;
+	}
+	*settings = defaultSettings;
+
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		return settings;
+	}
+
+	char section[64] = "";
+	char buffer[MAX_LINE_LENGTH];
+	bool valid = true;
+	while (valid && fgets(buffer, sizeof(buffer), file)) {
+		char *line = trim(buffer);
+		if (line[0] == '\0' || line[0] == '#') {
+			continue;
+		}
+
+		size_t length = strlen(line);
+		if (line[0] == '[' && line[length - 1] == ']' && length - 2 < sizeof(section)) {
+			line[length - 1] = '\0';
+			strcpy(section, trim(line + 1));
+			continue;
+		}
+
+		char *separator = strchr(line, '=');
+		if (!separator || separator == line) {
+			valid = false;
+			break;
+		}
+		*separator  = '\0';
+		char *key   = trim(line);
+		char *value = trim(separator + 1);
+
+		if (strcmp(section, "audio") == 0) {
+			if (strcmp(key, "soundboard_volume") == 0) {
+				char *end;
+				settings->soundboardVolume = strtof(value, &end);
+				valid = *end == '\0' && settings->soundboardVolume >= 0.0f && settings->soundboardVolume <= 4.0f;
+			} else if (strcmp(key, "acoustics") == 0) {
+				valid = parseBool(value, &settings->acoustics);
+			} else if (strcmp(key, "reverb") == 0) {
+				valid = parseBool(value, &settings->reverb);
+			} else if (strcmp(key, "cpu_budget") == 0) {
+				char *end;
+				settings->cpuBudget = strtof(value, &end);
+				valid               = *end == '\0' && settings->cpuBudget >= 0.0f && settings->cpuBudget <= 1.0f;
+			}
+		} else if (strcmp(section, "meters") == 0) {
+			if (strcmp(key, "spectrum_rate") == 0) {
+				char *end;
+				unsigned long rate     = strtoul(value, &end, 10);
+				valid                  = *end == '\0' && rate <= 100;
+				settings->spectrumRate = (unsigned int) rate;
+			}
+		} else if (strcmp(section, "log") == 0) {
+			if (strcmp(key, "file") == 0) {
+				valid = parseBool(value, &settings->logFile);
+			}
+		} else if (strcmp(section, "update") == 0) {
+			if (strcmp(key, "manifest") == 0) {
+				valid = strlen(value) < sizeof(settings->updateManifest);
+				if (valid) {
+					strcpy(settings->updateManifest, value);
+				}
+			}
+		} else if (strcmp(section, "transcription") == 0) {
+			if (strcmp(key, "enabled") == 0) {
+				valid = parseBool(value, &settings->transcription);
+			} else if (strcmp(key, "model") == 0) {
+				valid = strlen(value) < sizeof(settings->transcriptionModel);
+				if (valid) {
+					strcpy(settings->transcriptionModel, value);
+				}
+			} else if (strcmp(key, "workers") == 0) {
+				char *end;
+				unsigned long workers          = strtoul(value, &end, 10);
+				valid                          = *end == '\0' && workers >= 1 && workers <= TRANSCRIPTION_MAX_WORKERS;
+				settings->transcriptionWorkers = (unsigned int) workers;
+			} else if (strcmp(key, "latency_budget_ms") == 0) {
+				char *end;
+				unsigned long budget                   = strtoul(value, &end, 10);
+				valid                                  = *end == '\0' && budget >= 100 && budget <= 60000;
+				settings->transcriptionLatencyBudgetMs = (unsigned int) budget;
+			}
+		} else if (strcmp(section, "index") == 0) {
+			if (strcmp(key, "enabled") == 0) {
+				valid = parseBool(value, &settings->textIndex);
+			}
+		} else if (strcmp(section, "bindings") == 0) {
+			struct ConfigBinding *binding = &settings->bindings[settings->bindingCount];
+			valid = settings->bindingCount < CONFIG_MAX_BINDINGS && strlen(key) < sizeof(binding->spec)
+					&& parseAction(value, &binding->action);
+			if (valid) {
+				strcpy(binding->spec, key);
+				settings->bindingCount++;
+			}
+		}
+		// Unknown sections and keys are ignored so that newer files still work with older versions
+	}
+
+	valid = valid && !ferror(file);
+	fclose(file);
+
+	if (!valid) {
+		memory_poolFree(snapshots, settings);
+		return NULL;
+	}
+
+	return settings;
+}
+
+
+////////////////////////////////// Publishing and reclamation //////////////////////////////////
+
+// Frees all retired snapshots that no reader can be using anymore. Has to be called with the writer lock held.
+static void reclaim(struct Config *config) {
+	uint64_t oldestReader = UINT64_MAX;
+	for (size_t i = 0; i < CONFIG_MAX_READERS; i++) {
+		uint64_t epoch = atomic_load(&config->readerEpochs[i]);
+		if (epoch != 0 && epoch < oldestReader) {
+			oldestReader = epoch;
+		}
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < config->retiredCount; i++) {
+		// Readers that entered in the epoch a snapshot was replaced in may still have loaded it
+		if (config->retired[i].epoch < oldestReader) {
+			memory_poolFree(config->snapshots, config->retired[i].snapshot);
+		} else {
+			config->retired[kept++] = config->retired[i];
+		}
+	}
+	config->retiredCount = kept;
+}
+
+static void publish(struct Config *config, struct PluginSettings *snapshot) {
+	pthread_mutex_lock(&config->writerLock);
+
+	while (config->retiredCount == MAX_RETIRED) {
+		// Readers only hold snapshots briefly, so space frees up quickly
+		const struct timespec delay = { 0, 1000000L };
+		nanosleep(&delay, NULL);
+		reclaim(config);
+	}
+
+	snapshot->generation            = ++config->generation;
+	struct PluginSettings *previous = atomic_exchange(&config->current, snapshot);
+	uint64_t epoch                  = atomic_fetch_add(&config->globalEpoch, 1);
+
+	config->retired[config->retiredCount].snapshot = previous;
+	config->retired[config->retiredCount].epoch    = epoch;
+	config->retiredCount++;
+	reclaim(config);
+
+	pthread_mutex_unlock(&config->writerLock);
+}
+
+bool config_reload(struct Config *config) {
+	struct PluginSettings *snapshot = parseFile(config->snapshots, config->path);
+	if (!snapshot) {
+		return false;
+	}
+
+	publish(config, snapshot);
+
+	return true;
+}
+
+const struct PluginSettings *config_acquire(struct Config *config) {
+	uint64_t epoch = atomic_load(&config->globalEpoch);
+
+	for (size_t i = 0; i < CONFIG_MAX_READERS; i++) {
+		size_t slot       = (readerHint + i) % CONFIG_MAX_READERS;
+		uint64_t expected = 0;
+		if (atomic_compare_exchange_strong(&config->readerEpochs[slot], &expected, epoch)) {
+			readerSlot = slot;
+			readerHint = slot;
+
+			// Sequentially consistent, so that the writer either sees this reader's epoch or the reader sees the new
+			// snapshot
+			return atomic_load(&config->current);
+		}
+	}
+
+	// All slots are taken -> the defaults are the only thing that is guaranteed not to be freed
+	readerSlot = SIZE_MAX;
+
+	return &defaultSettings;
+}
+
+void config_release(struct Config *config) {
+	if (readerSlot != SIZE_MAX) {
+		atomic_store_explicit(&config->readerEpochs[readerSlot], 0, memory_order_release);
+		readerSlot = SIZE_MAX;
+	}
+}
+
+
+////////////////////////////////// Watching //////////////////////////////////
+
+#ifdef __linux__
+static void *runWatcher(void *arg) {
+	struct Config *config = arg;
+
+	const char *fileName = strrchr(config->path, '/');
+	fileName             = fileName ? fileName + 1 : config->path;
+
+	struct pollfd descriptor = { config->inotifyFD, POLLIN, 0 };
+	while (atomic_load(&config->running)) {
+		bool changed = false;
+		if (poll(&descriptor, 1, WATCH_INTERVAL_MS) > 0) {
+			// Editors often replace files instead of writing them in place, so the directory is watched and events are
+			// filtered by name
+			char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+			ssize_t length;
+			while ((length = read(config->inotifyFD, events, sizeof(events))) > 0) {
+				for (char *position = events; position < events + length;) {
+					const struct inotify_event *event = (const struct inotify_event *) position;
+					changed = changed || (event->len > 0 && strcmp(event->name, fileName) == 0);
+					position += sizeof(struct inotify_event) + event->len;
+				}
+			}
+		}
+
+		if (changed) {
+			config_reload(config);
+		} else {
+			pthread_mutex_lock(&config->writerLock);
+			reclaim(config);
+			pthread_mutex_unlock(&config->writerLock);
+		}
+	}
+
+	return NULL;
+}
+
+static bool startWatching(struct Config *config) {
+	char directory[sizeof(config->path)];
+	strcpy(directory, config->path);
+	char *separator = strrchr(directory, '/');
+	if (!separator) {
+		strcpy(directory, ".");
+	} else {
+		*separator = '\0';
+	}
+
+	config->inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (config->inotifyFD < 0) {
+		return false;
+	}
+
+	atomic_init(&config->running, true);
+	if (inotify_add_watch(config->inotifyFD, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0
+		|| pthread_create(&config->watcher, NULL, &runWatcher, config) != 0) {
+		close(config->inotifyFD);
+		return false;
+	}
+
+	return true;
+}
+
+static void stopWatching(struct Config *config) {
+	atomic_store(&config->running, false);
+	pthread_join(config->watcher, NULL);
+	close(config->inotifyFD);
+}
+#else
+static bool startWatching(struct Config *config) {
+	(void) config;
+
+	return false;
+}
+
+static void stopWatching(struct Config *config) {
+	(void) config;
+}
+#endif
+
+
+////////////////////////////////// Setup //////////////////////////////////
+
+struct Config *config_create(const char *path) {
+	if (strlen(path) >= sizeof(((struct Config *) 0)->path)) {
+		return NULL;
+	}
+
+	struct Config *config = memory_calloc(MEMORY_CONFIG, 1, sizeof(struct Config));
+	if (!config) {
+		return NULL;
+	}
+	strcpy(config->path, path);
+
+	config->snapshots = memory_createPool(MEMORY_CONFIG, sizeof(struct PluginSettings), SNAPSHOT_POOL_SIZE);
+	if (!config->snapshots) {
+		memory_free(config);
+		return NULL;
+	}
+
+	struct PluginSettings *snapshot = parseFile(config->snapshots, path);
+	if (!snapshot) {
+		// A broken file shouldn't keep the plugin from loading
+		snapshot  = memory_poolAlloc(config->snapshots);
+		*snapshot = defaultSettings;
+	}
+
+	snapshot->generation = config->generation = 1;
+	atomic_init(&config->current, snapshot);
+	atomic_init(&config->globalEpoch, 1);
+	for (size_t i = 0; i < CONFIG_MAX_READERS; i++) {
+		atomic_init(&config->readerEpochs[i], 0);
+	}
+	pthread_mutex_init(&config->writerLock, NULL);
+
+	// Without a watcher, changes only take effect on config_reload
+	config->watching = startWatching(config);
+
+	return config;
+}
+
+void config_destroy(struct Config *config) {
+	if (!config) {
+		return;
+	}
+
+	if (config->watching) {
+		stopWatching(config);
+	}
+
+	for (size_t i = 0; i < config->retiredCount; i++) {
+		memory_poolFree(config->snapshots, config->retired[i].snapshot);
+	}
+	memory_poolFree(config->snapshots, atomic_load(&config->current));
+	memory_destroyPool(config->snapshots);
+	pthread_mutex_destroy(&config->writerLock);
+	memory_free(config);
+}
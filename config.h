@@ -0,0 +1,134 @@
+/// This header file declares the plugin's configuration layer.
+///
+/// The configuration file is parsed into an immutable snapshot which is published by swapping an atomic pointer. On
+/// Linux a background thread watches the file with inotify and publishes a new snapshot whenever it changes. Snapshots
+/// that have been replaced are freed once no reader can still be using them (epoch-based reclamation), so readers
+/// never take a lock: config_acquire and config_release are a handful of atomic loads and stores, which makes them safe
+/// to use from audio callbacks.
+///
+/// The file consists of "key = value" lines, grouped into sections. Lines starting with '#' are comments.
+///
+///     [audio]
+///     soundboard_volume = 0.8
+///     acoustics = true
+///     reverb = false
+///     cpu_budget = 0.25
+///
+///     [meters]
+///     spectrum_rate = 20
+///
+///     [log]
+///     file = true
+///
+///     [update]
+///     manifest = https://example.com/hello_mumble/update.txt
+///
+///     [transcription]
+///     enabled = false
+///     model = /usr/share/hello_mumble/asr.bin
+///     workers = 2
+///     latency_budget_ms = 2000
+///
+///     [index]
+///     enabled = true
+///
+///     [bindings]
+///     CTRL+F1 = soundboard airhorn
+///     F5 = channel Lobby
+///     G G = mute
+///     ALT+T = hold-transmission continuous
+///
+/// Binding keys are key-binding specs (see keybindings.h). The available actions are "soundboard <clip>", "sample
+/// <path>", "channel <name>", "mute", "transmission <mode>", "hold-transmission <mode>" (switches back on release) and
+/// "custom <id>", with the modes "continuous", "voice-activation" and "push-to-talk".
+///
+/// The update manifest (see update.h), the transcription settings (see transcription.h) and whether the index is kept
+/// (see textindex.h) are only read when the plugin is loaded.
+
+#ifndef MUMBLE_PLUGIN_CONFIG_H_
+#define MUMBLE_PLUGIN_CONFIG_H_
+
+#include "keybindings.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONFIG_FILE_NAME "hello_mumble.conf"
+/// The maximum amount of bindings in the configuration file
+#define CONFIG_MAX_BINDINGS 32
+#define CONFIG_MAX_BINDING_SPEC 64
+/// The maximum length of a URL (including the terminating null byte)
+#define CONFIG_MAX_URL 256
+#define CONFIG_MAX_PATH 512
+/// The maximum amount of threads that can read the configuration. Further threads only ever see the defaults.
+#define CONFIG_MAX_READERS 32
+
+struct ConfigBinding {
+	char spec[CONFIG_MAX_BINDING_SPEC];
+	struct KeyAction action;
+};
+
+/// A snapshot of the configuration. It is never modified after it has been published.
+struct PluginSettings {
+	/// Incremented with every published snapshot, so that users can tell when to re-apply settings
+	uint64_t generation;
+
+	/// The gain soundboard clips are mixed with
+	float soundboardVolume;
+	/// Whether occlusion is applied to speakers
+	bool acoustics;
+	/// Whether reverb is added to the output
+	bool reverb;
+	/// The fraction of the audio's duration the audio callbacks may spend processing it before stages are degraded
+	/// (0 never degrades them, see governor.h)
+	float cpuBudget;
+	/// How often the speakers' spectra are analyzed (per second, 0 disables them)
+	unsigned int spectrumRate;
+	/// Whether messages are written to the log file ($XDG_STATE_HOME/hello_mumble/hello_mumble.log) as well
+	bool logFile;
+	/// Where to look for updates (empty if updates aren't checked for)
+	char updateManifest[CONFIG_MAX_URL];
+	/// Whether the speakers are transcribed (off by default). No speech recognizer is built in yet, so transcription
+	/// stays off regardless.
+	bool transcription;
+	/// The speech recognizer's model (empty if there is none)
+	char transcriptionModel[CONFIG_MAX_PATH];
+	/// The amount of threads speech is recognized on
+	unsigned int transcriptionWorkers;
+	/// How long speech may wait to be recognized before it is dropped
+	unsigned int transcriptionLatencyBudgetMs;
+	/// Whether captions and channel events are indexed ($XDG_DATA_HOME/hello_mumble/index)
+	bool textIndex;
+
+	struct ConfigBinding bindings[CONFIG_MAX_BINDINGS];
+	size_t bindingCount;
+};
+
+struct Config;
+
+/// Loads the configuration (falling back to the defaults for anything that isn't set) and starts watching the file
+///
+/// @param path The configuration file. It doesn't have to exist.
+/// @returns The configuration or NULL if creating it failed
+struct Config *config_create(const char *path);
+
+/// Stops watching the file and frees all snapshots. No reader may be active anymore.
+void config_destroy(struct Config *config);
+
+/// Makes the current snapshot available to the calling thread until config_release is called
+///
+/// NOTE: Every thread may only hold one snapshot at a time (acquire and release must not be nested)
+///
+/// @returns The current snapshot. It is never NULL.
+const struct PluginSettings *config_acquire(struct Config *config);
+
+/// Releases the snapshot obtained by the last config_acquire call of the calling thread
+void config_release(struct Config *config);
+
+/// Re-reads the file and publishes its contents (this happens automatically if the file is watched)
+///
+/// @returns Whether the file could be parsed. If not, the previous snapshot stays in place.
+bool config_reload(struct Config *config);
+
+#endif // MUMBLE_PLUGIN_CONFIG_H_
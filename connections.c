@@ -0,0 +1,177 @@
+#include "connections.h"
+#include "memory.h"
+#include "replica.h"
+#include "spatial.h"
+
+#include <string.h>
+
+// The lookup table maps connections to shard indices (a power of two, at least twice CONNECTIONS_MAX_SHARDS)
+#define LOOKUP_SIZE 16
+#define NONE (-1)
+
+struct Shard {
+	struct ConnectionShard public;
+	bool attached;
+};
+
+struct ConnectionTable {
+	float cellSize;
+	struct Shard shards[CONNECTIONS_MAX_SHARDS];
+	// Open addressing (NONE = empty slot). Deletion uses backward shifting so no tombstones are needed.
+	int lookup[LOOKUP_SIZE];
+};
+
+
+static uint32_t hashConnection(mumble_connection_t connection) {
+	return (uint32_t) connection & (LOOKUP_SIZE - 1);
+}
+
+static int findShard(const struct ConnectionTable *table, mumble_connection_t connection) {
+	for (uint32_t slot = hashConnection(connection);; slot = (slot + 1) & (LOOKUP_SIZE - 1)) {
+		int shard = table->lookup[slot];
+		if (shard == NONE || table->shards[shard].public.connection == connection) {
+			return shard;
+		}
+	}
+}
+
+static void insertIntoLookup(struct ConnectionTable *table, int shard) {
+	uint32_t slot = hashConnection(table->shards[shard].public.connection);
+	while (table->lookup[slot] != NONE) {
+		slot = (slot + 1) & (LOOKUP_SIZE - 1);
+	}
+	table->lookup[slot] = shard;
+}
+
+static void removeFromLookup(struct ConnectionTable *table, int shard) {
+	uint32_t slot = hashConnection(table->shards[shard].public.connection);
+	while (table->lookup[slot] != shard) {
+		slot = (slot + 1) & (LOOKUP_SIZE - 1);
+	}
+
+	// Shift following entries of the same probe sequence back into the hole
+	uint32_t hole = slot;
+	for (uint32_t next = (hole + 1) & (LOOKUP_SIZE - 1); table->lookup[next] != NONE;
+		 next          = (next + 1) & (LOOKUP_SIZE - 1)) {
+		uint32_t home = hashConnection(table->shards[table->lookup[next]].public.connection);
+		// Move the element if its home slot doesn't lie cyclically within (hole, next]
+		bool movable = hole <= next ? (home <= hole || home > next) : (home <= hole && home > next);
+		if (movable) {
+			table->lookup[hole] = table->lookup[next];
+			hole                = next;
+		}
+	}
+	table->lookup[hole] = NONE;
+}
+
+// Picks the shard to attach to a connection, preferring one whose arena exists already
+static int pickShard(const struct ConnectionTable *table) {
+	int unallocated = NONE;
+	for (int i = 0; i < CONNECTIONS_MAX_SHARDS; i++) {
+		const struct Shard *shard = &table->shards[i];
+		if (shard->attached) {
+			continue;
+		}
+		if (shard->public.arena) {
+			return i;
+		}
+		if (unallocated == NONE) {
+			unallocated = i;
+		}
+	}
+
+	return unallocated;
+}
+
+
+struct ConnectionTable *connections_create(float cellSize) {
+	struct ConnectionTable *table = memory_calloc(MEMORY_CONNECTIONS, 1, sizeof(struct ConnectionTable));
+	if (!table) {
+		return NULL;
+	}
+
+	table->cellSize = cellSize;
+	for (size_t i = 0; i < LOOKUP_SIZE; i++) {
+		table->lookup[i] = NONE;
+	}
+
+	return table;
+}
+
+void connections_destroy(struct ConnectionTable *table) {
+	if (!table) {
+		return;
+	}
+
+	for (size_t i = 0; i < CONNECTIONS_MAX_SHARDS; i++) {
+		memory_destroyArena(table->shards[i].public.arena);
+	}
+	memory_free(table);
+}
+
+struct ConnectionShard *connections_attach(struct ConnectionTable *table, mumble_connection_t connection) {
+	int index = findShard(table, connection);
+	if (index != NONE) {
+		return &table->shards[index].public;
+	}
+
+	index = pickShard(table);
+	if (index == NONE) {
+		return NULL;
+	}
+
+	struct Shard *shard = &table->shards[index];
+	if (!shard->public.arena) {
+		shard->public.arena = memory_createArena(MEMORY_CONNECTIONS, CONNECTIONS_ARENA_SIZE);
+		if (!shard->public.arena) {
+			return NULL;
+		}
+	}
+
+	// Whatever the shard held during its previous session has been released when it was detached
+	shard->public.spatial  = spatial_createInArena(shard->public.arena, table->cellSize);
+	shard->public.replicas = replica_createInArena(shard->public.arena);
+	if (!shard->public.spatial || !shard->public.replicas) {
+		memory_arenaReset(shard->public.arena);
+		return NULL;
+	}
+
+	shard->attached          = true;
+	shard->public.connection = connection;
+	shard->public.session++;
+	insertIntoLookup(table, index);
+
+	return &shard->public;
+}
+
+void connections_detach(struct ConnectionTable *table, mumble_connection_t connection) {
+	int index = findShard(table, connection);
+	if (index == NONE) {
+		return;
+	}
+
+	removeFromLookup(table, index);
+
+	struct Shard *shard = &table->shards[index];
+	memory_arenaReset(shard->public.arena);
+	shard->public.spatial  = NULL;
+	shard->public.replicas = NULL;
+	shard->attached        = false;
+}
+
+struct ConnectionShard *connections_find(const struct ConnectionTable *table, mumble_connection_t connection) {
+	int index = findShard(table, connection);
+
+	return index != NONE ? (struct ConnectionShard *) &table->shards[index].public : NULL;
+}
+
+size_t connections_list(const struct ConnectionTable *table, mumble_connection_t *connections) {
+	size_t count = 0;
+	for (size_t i = 0; i < CONNECTIONS_MAX_SHARDS; i++) {
+		if (table->shards[i].attached) {
+			connections[count++] = table->shards[i].public.connection;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,74 @@
+/// This header file declares the partitioning of the plugin's state by server connection.
+///
+/// User and channel IDs are only unique within a connection, so everything keyed by them lives in a shard of its own
+/// per connection. A shard's state is allocated from an arena, which is attached to a connection once it has been
+/// established and reset as a whole once it is gone, so that tearing a connection down doesn't depend on how much
+/// state it has accumulated. Shards are looked up by connection through a small hash table (connection IDs are handed
+/// out sequentially by Mumble, so lookups hardly ever probe).
+///
+/// The state itself isn't kept across reconnects: user IDs are handed out anew by the server for every session, so
+/// positions and replicated state of an earlier session would be attributed to the wrong users. Only the arenas of
+/// detached shards are kept, so attaching a shard only allocates while more connections exist at the same time than
+/// ever before.
+///
+/// NOTE: The functions in this file are not thread-safe.
+
+#ifndef MUMBLE_PLUGIN_CONNECTIONS_H_
+#define MUMBLE_PLUGIN_CONNECTIONS_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The maximum amount of connections with a shard at the same time
+#define CONNECTIONS_MAX_SHARDS 8
+/// The size of every shard's arena
+#define CONNECTIONS_ARENA_SIZE (256 * 1024)
+
+struct MemoryArena;
+struct ReplicaStore;
+struct SpatialIndex;
+
+/// The state of a single connection
+struct ConnectionShard {
+	mumble_connection_t connection;
+	/// Incremented whenever the shard is attached, so that state kept elsewhere can tell sessions apart
+	uint64_t session;
+	/// Holds the shard's state (and may be used for further state that lives as long as the connection does)
+	struct MemoryArena *arena;
+	/// The positions published by the connection's users
+	struct SpatialIndex *spatial;
+	/// The state shared with the connection's other users
+	struct ReplicaStore *replicas;
+};
+
+struct ConnectionTable;
+
+/// @param cellSize The cell size of the shards' spatial indices (see spatial_create)
+/// @returns A new table without any shards or NULL if allocating it failed
+struct ConnectionTable *connections_create(float cellSize);
+
+void connections_destroy(struct ConnectionTable *table);
+
+/// Attaches an empty shard to the given connection. Shards whose arena has been allocated already are preferred.
+///
+/// @returns The connection's shard (which may have been attached already) or NULL if all shards are attached or
+/// allocating it failed
+struct ConnectionShard *connections_attach(struct ConnectionTable *table, mumble_connection_t connection);
+
+/// Detaches the connection's shard, releasing all of its state at once (the arena itself is kept for the next
+/// connection)
+void connections_detach(struct ConnectionTable *table, mumble_connection_t connection);
+
+/// @returns The connection's shard or NULL if none is attached to it
+struct ConnectionShard *connections_find(const struct ConnectionTable *table, mumble_connection_t connection);
+
+/// Lists the connections shards are attached to
+///
+/// @param[out] connections The array the connections are written to. It has to hold CONNECTIONS_MAX_SHARDS elements.
+/// @returns The amount of connections
+size_t connections_list(const struct ConnectionTable *table, mumble_connection_t *connections);
+
+#endif // MUMBLE_PLUGIN_CONNECTIONS_H_
@@ -0,0 +1,891 @@
+#include "control.h"
+#include "memory.h"
+#include "server.h"
+#include "textindex.h"
+
+#include <string.h>
+
+#ifdef __linux__
+
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <pthread.h>
+#	include <stdio.h>
+#	include <sys/mman.h>
+#	include <sys/socket.h>
+#	include <time.h>
+#	include <unistd.h>
+
+// The type and the sequence number following a frame's length
+#	define FRAME_HEADER_SIZE 5
+#	define ALL_TOPICS (CONTROL_TOPIC_TALKING | CONTROL_TOPIC_CHANNEL | CONTROL_TOPIC_POSITION)
+// Users are only added as long as the table is at most this full (in percent)
+#	define MAX_LOAD 75
+// The size of the largest CONTROL_EVENT_USER (including the length)
+#	define MAX_USER_EVENT (4 + FRAME_HEADER_SIZE + 9 + 4 + 4 + 12)
+
+struct User {
+	bool used;
+	bool removed;
+	// Whether the user is in the list of users with changes
+	bool queued;
+	// The CONTROL_TOPIC_* flags whose values have been set at all and those that changed since the last delta
+	uint8_t known;
+	uint8_t changed;
+	// The changes (including CONTROL_USER_REMOVED) that haven't been sent to each of the clients yet. They pile up (and
+	// coalesce) while a client doesn't read its events.
+	uint8_t pending[CONTROL_MAX_CLIENTS];
+	mumble_connection_t connection;
+	mumble_userid_t userID;
+	int32_t talking;
+	int32_t channel;
+	float position[3];
+};
+
+// Indexed by the client's slot in the server's sockets
+struct Client {
+	uint32_t topics;
+	// Set if the client sent something invalid or didn't keep up. It is closed once the current events are handled.
+	bool failed;
+	// The epoll events the client's socket is watched for
+	uint32_t events;
+	// Whether users have changes pending for the client and where to continue looking for them
+	bool backlog;
+	size_t cursor;
+
+	uint8_t input[4 + CONTROL_MAX_FRAME];
+	size_t received;
+
+	// The events waiting to be sent (CONTROL_CLIENT_BUFFER_SIZE bytes)
+	uint8_t *output;
+	size_t outputStart;
+	size_t outputEnd;
+};
+
+struct ControlServer {
+	struct TextIndex *index;
+	ControlRequestFunction request;
+	void *userData;
+
+	// Woken up whenever the state changed and when the server shall stop
+	struct SocketServer sockets;
+	atomic_bool stopping;
+	pthread_t thread;
+
+	char ringName[64];
+	struct ControlLevelRing *ring;
+
+	// Guards the users, the list of users with changes and whether the server has been woken up already
+	pthread_mutex_t lock;
+	struct User users[CONTROL_MAX_USERS];
+	size_t userCount;
+	uint32_t changedUsers[CONTROL_MAX_USERS];
+	size_t changedCount;
+	bool removals;
+	bool woken;
+
+	struct Client clients[CONTROL_MAX_CLIENTS];
+	uint8_t *outputBuffers;
+	// Only used by the server's thread
+	struct ControlRequest scratch;
+	struct TextIndexHit hits[CONTROL_MAX_HITS];
+};
+
+static size_t slotOf(const struct ControlServer *server, const struct Client *client) {
+	return (size_t) (client - server->clients);
+}
+
+static int clientFD(const struct ControlServer *server, const struct Client *client) {
+	return server->sockets.clientFDs[slotOf(server, client)];
+}
+
+
+static void putU32(uint8_t *data, uint32_t value) {
+	data[0] = (uint8_t) value;
+	data[1] = (uint8_t) (value >> 8);
+	data[2] = (uint8_t) (value >> 16);
+	data[3] = (uint8_t) (value >> 24);
+}
+
+static uint32_t getU32(const uint8_t *data) {
+	return (uint32_t) data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24;
+}
+
+static void putU64(uint8_t *data, uint64_t value) {
+	putU32(data, (uint32_t) value);
+	putU32(data + 4, (uint32_t) (value >> 32));
+}
+
+static uint64_t getU64(const uint8_t *data) {
+	return (uint64_t) getU32(data) | (uint64_t) getU32(data + 4) << 32;
+}
+
+static void putFloat(uint8_t *data, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	putU32(data, bits);
+}
+
+static uint64_t timeNs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+
+////////////////////////////////// Users //////////////////////////////////
+
+static size_t hashUser(mumble_connection_t connection, mumble_userid_t userID) {
+	uint64_t key = (uint64_t) (uint32_t) connection << 32 | userID;
+	key *= 0x9E3779B97F4A7C15ull;
+
+	return (size_t) (key >> 32) & (CONTROL_MAX_USERS - 1);
+}
+
+// Finds a user, adding it if it isn't known yet (the lock has to be held)
+//
+// @returns The user's index or -1 if the table is full
+static int findUser(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID) {
+	size_t index = hashUser(connection, userID);
+	while (server->users[index].used) {
+		if (server->users[index].connection == connection && server->users[index].userID == userID) {
+			return (int) index;
+		}
+		index = (index + 1) & (CONTROL_MAX_USERS - 1);
+	}
+
+	if (server->userCount * 100 >= CONTROL_MAX_USERS * MAX_LOAD) {
+		return -1;
+	}
+
+	struct User *user = &server->users[index];
+	memset(user, 0, sizeof(*user));
+	user->used       = true;
+	user->connection = connection;
+	user->userID     = userID;
+	server->userCount++;
+
+	return (int) index;
+}
+
+// Removes the user at the given index from the table, moving users that were displaced by it back (the lock has to be
+// held)
+static void deleteUser(struct ControlServer *server, size_t index) {
+	size_t hole = index;
+	size_t next = (hole + 1) & (CONTROL_MAX_USERS - 1);
+
+	while (server->users[next].used) {
+		size_t home = hashUser(server->users[next].connection, server->users[next].userID);
+		// The user may only move back if the hole lies between its home and its current position
+		if (((next - home) & (CONTROL_MAX_USERS - 1)) >= ((next - hole) & (CONTROL_MAX_USERS - 1))) {
+			server->users[hole] = server->users[next];
+			hole                = next;
+		}
+		next = (next + 1) & (CONTROL_MAX_USERS - 1);
+	}
+
+	server->users[hole].used = false;
+	server->userCount--;
+}
+
+// Queues the user's changes for the next delta and wakes the server up if necessary (the lock has to be held)
+static void markChanged(struct ControlServer *server, int index, uint8_t changes) {
+	struct User *user = &server->users[index];
+	user->changed |= changes;
+
+	if (!user->queued) {
+		user->queued                                 = true;
+		server->changedUsers[server->changedCount++] = (uint32_t) index;
+	}
+
+	if (!server->woken) {
+		// The counter can't overflow as the server resets it every time it wakes up
+		server->woken = server_wake(&server->sockets);
+	}
+}
+
+void control_setTalking(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID,
+						mumble_talking_state_t state) {
+	if (!server) {
+		return;
+	}
+
+	pthread_mutex_lock(&server->lock);
+	int index = findUser(server, connection, userID);
+	if (index >= 0) {
+		struct User *user = &server->users[index];
+		user->removed     = false;
+		user->talking     = state;
+		user->known |= CONTROL_TOPIC_TALKING;
+		markChanged(server, index, CONTROL_TOPIC_TALKING);
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+void control_setChannel(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID,
+						mumble_channelid_t channelID) {
+	if (!server) {
+		return;
+	}
+
+	pthread_mutex_lock(&server->lock);
+	int index = findUser(server, connection, userID);
+	if (index >= 0) {
+		struct User *user = &server->users[index];
+		user->removed     = false;
+		user->channel     = channelID;
+		user->known |= CONTROL_TOPIC_CHANNEL;
+		markChanged(server, index, CONTROL_TOPIC_CHANNEL);
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+void control_setPosition(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID,
+						 const float position[3]) {
+	if (!server) {
+		return;
+	}
+
+	pthread_mutex_lock(&server->lock);
+	int index = findUser(server, connection, userID);
+	if (index >= 0) {
+		struct User *user = &server->users[index];
+		user->removed     = false;
+		memcpy(user->position, position, sizeof(user->position));
+		user->known |= CONTROL_TOPIC_POSITION;
+		markChanged(server, index, CONTROL_TOPIC_POSITION);
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+static void removeUser(struct ControlServer *server, int index) {
+	server->users[index].removed = true;
+	server->users[index].known   = 0;
+	server->removals             = true;
+	markChanged(server, index, 0);
+}
+
+void control_removeUser(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID) {
+	if (!server) {
+		return;
+	}
+
+	pthread_mutex_lock(&server->lock);
+	size_t index = hashUser(connection, userID);
+	while (server->users[index].used) {
+		if (server->users[index].connection == connection && server->users[index].userID == userID) {
+			removeUser(server, (int) index);
+			break;
+		}
+		index = (index + 1) & (CONTROL_MAX_USERS - 1);
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+void control_removeConnection(struct ControlServer *server, mumble_connection_t connection) {
+	if (!server) {
+		return;
+	}
+
+	pthread_mutex_lock(&server->lock);
+	for (size_t i = 0; i < CONTROL_MAX_USERS; i++) {
+		if (server->users[i].used && !server->users[i].removed && server->users[i].connection == connection) {
+			removeUser(server, (int) i);
+		}
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+
+////////////////////////////////// Levels //////////////////////////////////
+
+static bool createRing(struct ControlServer *server) {
+	snprintf(server->ringName, sizeof(server->ringName), "/hello_mumble-%d-levels", (int) getpid());
+
+	int fd = shm_open(server->ringName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0 && errno == EEXIST) {
+		// Left behind by a process that crashed and had the same PID
+		shm_unlink(server->ringName);
+		fd = shm_open(server->ringName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	}
+	if (fd < 0) {
+		server->ringName[0] = '\0';
+		return false;
+	}
+
+	void *mapping = MAP_FAILED;
+	if (ftruncate(fd, sizeof(struct ControlLevelRing)) == 0) {
+		mapping = mmap(NULL, sizeof(struct ControlLevelRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+
+	// The object is zeroed already
+	server->ring          = mapping;
+	server->ring->version = CONTROL_PROTOCOL_VERSION;
+	server->ring->size    = CONTROL_LEVEL_RING_SIZE;
+	atomic_thread_fence(memory_order_release);
+	server->ring->magic = CONTROL_LEVEL_RING_MAGIC;
+
+	return true;
+}
+
+void control_publishLevel(struct ControlServer *server, mumble_userid_t userID, float peak, float rms) {
+	if (!server) {
+		return;
+	}
+
+	struct ControlLevelRing *ring = server->ring;
+	uint64_t position             = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+	struct ControlLevel *level    = &ring->levels[position % CONTROL_LEVEL_RING_SIZE];
+
+	atomic_store_explicit(&level->sequence, 2 * position + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	level->timeNs = timeNs();
+	level->userID = userID;
+	level->peak   = peak;
+	level->rms    = rms;
+	atomic_store_explicit(&level->sequence, 2 * position + 2, memory_order_release);
+}
+
+
+////////////////////////////////// Clients //////////////////////////////////
+
+// Queues an event for the client. A client whose buffer is full is marked as failed.
+static void queueEvent(struct Client *client, enum ControlEventType type, uint32_t sequence, const uint8_t *payload,
+					   size_t payloadSize) {
+	size_t size = 4 + FRAME_HEADER_SIZE + payloadSize;
+	if (client->failed) {
+		return;
+	}
+
+	if (CONTROL_CLIENT_BUFFER_SIZE - client->outputEnd < size && client->outputStart > 0) {
+		memmove(client->output, client->output + client->outputStart, client->outputEnd - client->outputStart);
+		client->outputEnd -= client->outputStart;
+		client->outputStart = 0;
+	}
+	if (CONTROL_CLIENT_BUFFER_SIZE - client->outputEnd < size) {
+		client->failed = true;
+		return;
+	}
+
+	uint8_t *frame = client->output + client->outputEnd;
+	putU32(frame, (uint32_t) (FRAME_HEADER_SIZE + payloadSize));
+	frame[4] = (uint8_t) type;
+	putU32(frame + 5, sequence);
+	if (payloadSize > 0) {
+		memcpy(frame + 4 + FRAME_HEADER_SIZE, payload, payloadSize);
+	}
+	client->outputEnd += size;
+}
+
+static void queueReply(struct Client *client, uint32_t sequence, mumble_error_t status) {
+	uint8_t payload[4];
+	putU32(payload, (uint32_t) status);
+	queueEvent(client, CONTROL_EVENT_REPLY, sequence, payload, sizeof(payload));
+}
+
+// Queues the given changes of a user
+static void queueUser(struct Client *client, const struct User *user, uint8_t changes) {
+	changes = user->removed ? CONTROL_USER_REMOVED : changes & ALL_TOPICS;
+	if (!changes) {
+		return;
+	}
+
+	uint8_t payload[9 + 4 + 4 + 12];
+	putU32(payload, (uint32_t) user->connection);
+	putU32(payload + 4, user->userID);
+	payload[8]  = changes;
+	size_t size = 9;
+
+	if (changes & CONTROL_TOPIC_TALKING) {
+		putU32(payload + size, (uint32_t) user->talking);
+		size += 4;
+	}
+	if (changes & CONTROL_TOPIC_CHANNEL) {
+		putU32(payload + size, (uint32_t) user->channel);
+		size += 4;
+	}
+	if (changes & CONTROL_TOPIC_POSITION) {
+		for (int i = 0; i < 3; i++) {
+			putFloat(payload + size, user->position[i]);
+			size += 4;
+		}
+	}
+
+	queueEvent(client, CONTROL_EVENT_USER, 0, payload, size);
+}
+
+// Runs a search and queues its hits. The index is searched right on the server's thread: searches only touch the
+// segments' posting lists of the phrase's terms and never wait for documents being added.
+//
+// @returns The status of the search
+static mumble_error_t queueHits(struct ControlServer *server, struct Client *client, uint32_t sequence,
+								const struct ControlRequest *request, uint64_t fromMs, uint64_t toMs, size_t maxHits) {
+	if (!server->index) {
+		return MUMBLE_EC_GENERIC_ERROR;
+	}
+
+	size_t count = textindex_search(server->index, request->text, fromMs, toMs, server->hits,
+									maxHits < CONTROL_MAX_HITS ? maxHits : CONTROL_MAX_HITS);
+	for (size_t i = 0; i < count; i++) {
+		const struct TextIndexHit *hit = &server->hits[i];
+		uint8_t payload[25 + TEXTINDEX_MAX_TEXT];
+		putU64(payload, hit->document);
+		putU64(payload + 8, hit->timestampMs);
+		payload[16] = (uint8_t) hit->kind;
+		putU32(payload + 17, hit->userID);
+		putU32(payload + 21, (uint32_t) hit->channelID);
+
+		size_t length = strlen(hit->text);
+		memcpy(payload + 25, hit->text, length);
+		queueEvent(client, CONTROL_EVENT_HIT, sequence, payload, 25 + length);
+	}
+
+	return MUMBLE_STATUS_OK;
+}
+
+// Requests are only handled as long as the events they result in (at most a snapshot of all users or the hits of a
+// search) surely fit into the client's buffer. Until then, the client's requests wait in the socket.
+static bool hasRoom(const struct Client *client) {
+	return client->outputEnd - client->outputStart <= CONTROL_CLIENT_BUFFER_SIZE / 2;
+}
+
+static void updateEvents(struct ControlServer *server, struct Client *client) {
+	uint32_t events = (hasRoom(client) ? EPOLLIN : 0) | (client->outputStart < client->outputEnd ? EPOLLOUT : 0);
+	if (client->events == events) {
+		return;
+	}
+
+	if (server_watchClient(&server->sockets, slotOf(server, client), events)) {
+		client->events = events;
+	} else {
+		client->failed = true;
+	}
+}
+
+// Sends as much of the queued events as the socket takes
+static void flushClient(struct ControlServer *server, struct Client *client) {
+	int fd = clientFD(server, client);
+
+	while (client->outputStart < client->outputEnd) {
+		ssize_t count = send(fd, client->output + client->outputStart, client->outputEnd - client->outputStart,
+							 MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (count < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				client->failed = true;
+			}
+			break;
+		}
+		client->outputStart += (size_t) count;
+	}
+
+	if (client->outputStart == client->outputEnd) {
+		client->outputStart = 0;
+		client->outputEnd   = 0;
+	}
+}
+
+static void closeClient(struct ControlServer *server, struct Client *client) {
+	size_t index = slotOf(server, client);
+	server_closeClient(&server->sockets, index);
+
+	pthread_mutex_lock(&server->lock);
+	for (size_t i = 0; i < CONTROL_MAX_USERS; i++) {
+		server->users[i].pending[index] = 0;
+	}
+	server->removals = true;
+	pthread_mutex_unlock(&server->lock);
+}
+
+static void acceptClients(struct ControlServer *server) {
+	int slot;
+	while ((slot = server_accept(&server->sockets)) >= 0) {
+		struct Client *client = &server->clients[slot];
+		client->topics        = 0;
+		client->failed        = false;
+		client->events        = EPOLLIN;
+		client->backlog       = false;
+		client->cursor        = 0;
+		client->received      = 0;
+		client->outputStart   = 0;
+		client->outputEnd     = 0;
+
+		uint8_t hello[4 + sizeof(server->ringName)];
+		size_t nameLength = strlen(server->ringName);
+		putU32(hello, CONTROL_PROTOCOL_VERSION);
+		memcpy(hello + 4, server->ringName, nameLength);
+		queueEvent(client, CONTROL_EVENT_HELLO, 0, hello, 4 + nameLength);
+	}
+}
+
+// Copies the string spanning the rest of a frame into the request
+static void copyText(struct ControlRequest *request, const uint8_t *data, size_t size) {
+	memcpy(request->text, data, size);
+	request->text[size] = '\0';
+}
+
+static void handleFrame(struct ControlServer *server, struct Client *client, uint8_t type, uint32_t sequence,
+						const uint8_t *payload, size_t size) {
+	struct ControlRequest *request = &server->scratch;
+	memset(request, 0, offsetof(struct ControlRequest, text));
+	request->type    = (enum ControlRequestType) type;
+	request->text[0] = '\0';
+
+	switch (type) {
+		case CONTROL_REQUEST_PING:
+			queueEvent(client, CONTROL_EVENT_PONG, sequence, payload, size);
+			return;
+		case CONTROL_REQUEST_SUBSCRIBE:
+			if (size < 4) {
+				break;
+			}
+			client->topics = getU32(payload) & ALL_TOPICS;
+			queueReply(client, sequence, MUMBLE_STATUS_OK);
+
+			// The snapshot replaces everything still pending for the client (except for removals)
+			pthread_mutex_lock(&server->lock);
+			for (size_t i = 0; i < CONTROL_MAX_USERS; i++) {
+				struct User *user = &server->users[i];
+				if (user->used && !user->removed) {
+					user->pending[client - server->clients] = 0;
+					queueUser(client, user, user->known & (uint8_t) client->topics);
+				}
+			}
+			pthread_mutex_unlock(&server->lock);
+			return;
+		case CONTROL_REQUEST_MOVE_USER:
+			if (size < 12) {
+				break;
+			}
+			request->connection = (mumble_connection_t) getU32(payload);
+			request->userID     = getU32(payload + 4);
+			request->channelID  = (mumble_channelid_t) getU32(payload + 8);
+			copyText(request, payload + 12, size - 12);
+			queueReply(client, sequence, server->request(server->userData, request));
+			return;
+		case CONTROL_REQUEST_SOUNDBOARD:
+			copyText(request, payload, size);
+			queueReply(client, sequence, server->request(server->userData, request));
+			return;
+		case CONTROL_REQUEST_SELF_MUTE:
+			if (size < 1) {
+				break;
+			}
+			request->enabled = payload[0] != 0;
+			queueReply(client, sequence, server->request(server->userData, request));
+			return;
+		case CONTROL_REQUEST_TRANSMISSION_MODE:
+			if (size < 1) {
+				break;
+			}
+			request->transmissionMode = payload[0];
+			queueReply(client, sequence, server->request(server->userData, request));
+			return;
+		case CONTROL_REQUEST_SEARCH:
+			if (size < 17) {
+				break;
+			}
+			copyText(request, payload + 17, size - 17);
+			queueReply(client, sequence,
+					   queueHits(server, client, sequence, request, getU64(payload), getU64(payload + 8), payload[16]));
+			return;
+	}
+
+	// Unknown or malformed
+	queueReply(client, sequence, MUMBLE_EC_GENERIC_ERROR);
+}
+
+// Handles the complete frames the client has sent (as long as there's room for the resulting events)
+static void handleFrames(struct ControlServer *server, struct Client *client) {
+	size_t consumed = 0;
+	while (client->received - consumed >= 4 && hasRoom(client) && !client->failed) {
+		const uint8_t *frame = client->input + consumed;
+		uint32_t length      = getU32(frame);
+		if (length < FRAME_HEADER_SIZE || length > CONTROL_MAX_FRAME) {
+			client->failed = true;
+			return;
+		}
+		if (client->received - consumed < 4 + (size_t) length) {
+			break;
+		}
+
+		handleFrame(server, client, frame[4], getU32(frame + 5), frame + 4 + FRAME_HEADER_SIZE,
+					length - FRAME_HEADER_SIZE);
+		consumed += 4 + (size_t) length;
+	}
+
+	memmove(client->input, client->input + consumed, client->received - consumed);
+	client->received -= consumed;
+}
+
+static void readFrames(struct ControlServer *server, struct Client *client) {
+	int fd = clientFD(server, client);
+
+	while (hasRoom(client) && !client->failed) {
+		ssize_t count = read(fd, client->input + client->received, sizeof(client->input) - client->received);
+		if (count <= 0) {
+			if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+				client->failed = true;
+			}
+			return;
+		}
+		client->received += (size_t) count;
+
+		handleFrames(server, client);
+	}
+}
+
+// Queues the changes pending for the client as far as there is room for them (the lock has to be held)
+static void queuePending(struct ControlServer *server, struct Client *client) {
+	size_t index    = slotOf(server, client);
+	client->backlog = false;
+
+	for (size_t i = 0; i < CONTROL_MAX_USERS; i++) {
+		struct User *user = &server->users[(client->cursor + i) & (CONTROL_MAX_USERS - 1)];
+		if (!user->used || !user->pending[index]) {
+			continue;
+		}
+		if (CONTROL_CLIENT_BUFFER_SIZE - (client->outputEnd - client->outputStart) < MAX_USER_EVENT) {
+			client->backlog = true;
+			client->cursor  = (client->cursor + i) & (CONTROL_MAX_USERS - 1);
+			return;
+		}
+
+		queueUser(client, user, user->pending[index]);
+		user->pending[index] = 0;
+	}
+}
+
+// Deletes the removed users whose removal has been sent to all clients (the lock has to be held)
+static void deleteRemovedUsers(struct ControlServer *server) {
+	static const uint8_t nothingPending[CONTROL_MAX_CLIENTS];
+
+	server->removals = false;
+	for (size_t i = 0; i < CONTROL_MAX_USERS; i++) {
+		while (server->users[i].used && server->users[i].removed) {
+			if (memcmp(server->users[i].pending, nothingPending, sizeof(nothingPending)) != 0) {
+				server->removals = true;
+				break;
+			}
+			// Deleting moves the following users, so the user now at this index has to be checked as well
+			deleteUser(server, i);
+		}
+	}
+}
+
+// Hands the changes since the last delta to all subscribed clients
+static void broadcastChanges(struct ControlServer *server) {
+	server_clearWake(&server->sockets);
+
+	pthread_mutex_lock(&server->lock);
+	for (size_t i = 0; i < server->changedCount; i++) {
+		struct User *user = &server->users[server->changedUsers[i]];
+		for (size_t j = 0; j < CONTROL_MAX_CLIENTS; j++) {
+			struct Client *client = &server->clients[j];
+			uint8_t changes = user->removed ? CONTROL_USER_REMOVED : user->changed & (uint8_t) client->topics;
+			if (server->sockets.clientFDs[j] >= 0 && client->topics && changes) {
+				user->pending[j] |= changes;
+				client->backlog = true;
+			}
+		}
+		user->changed = 0;
+		user->queued  = false;
+	}
+	server->changedCount = 0;
+	server->woken        = false;
+
+	for (size_t i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (server->sockets.clientFDs[i] >= 0 && server->clients[i].backlog) {
+			queuePending(server, &server->clients[i]);
+		}
+	}
+	if (server->removals) {
+		deleteRemovedUsers(server);
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+static void *serve(void *arg) {
+	struct ControlServer *server = arg;
+
+	while (!atomic_load(&server->stopping)) {
+		struct epoll_event events[CONTROL_MAX_CLIENTS + 2];
+		int count = server_wait(&server->sockets, events, CONTROL_MAX_CLIENTS + 2);
+		if (count < 0) {
+			return NULL;
+		}
+
+		for (int i = 0; i < count; i++) {
+			uint64_t tag = events[i].data.u64;
+			if (tag == SERVER_TAG_WAKE) {
+				broadcastChanges(server);
+			} else if (tag == SERVER_TAG_LISTENER) {
+				acceptClients(server);
+			} else if (server->sockets.clientFDs[tag] >= 0 && events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+				readFrames(server, &server->clients[tag]);
+			}
+		}
+
+		for (size_t i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+			struct Client *client = &server->clients[i];
+			if (server->sockets.clientFDs[i] < 0) {
+				continue;
+			}
+
+			flushClient(server, client);
+			// Changes and requests that have been held back because the client didn't read its events
+			if (client->backlog) {
+				pthread_mutex_lock(&server->lock);
+				queuePending(server, client);
+				if (server->removals) {
+					deleteRemovedUsers(server);
+				}
+				pthread_mutex_unlock(&server->lock);
+				flushClient(server, client);
+			}
+			if (hasRoom(client) && client->received > 0) {
+				handleFrames(server, client);
+				flushClient(server, client);
+			}
+			updateEvents(server, client);
+
+			if (client->failed) {
+				closeClient(server, client);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+
+////////////////////////////////// Server //////////////////////////////////
+
+static void destroyServer(struct ControlServer *server) {
+	for (size_t i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (server->sockets.clientFDs[i] >= 0) {
+			closeClient(server, &server->clients[i]);
+		}
+	}
+	server_close(&server->sockets);
+	if (server->ring) {
+		munmap(server->ring, sizeof(struct ControlLevelRing));
+	}
+	if (server->ringName[0] != '\0') {
+		shm_unlink(server->ringName);
+	}
+
+	pthread_mutex_destroy(&server->lock);
+	memory_freeLarge(server->outputBuffers);
+	memory_free(server);
+}
+
+struct ControlServer *control_create(const char *path, struct TextIndex *index, ControlRequestFunction request,
+									 void *userData) {
+	struct ControlServer *server = memory_calloc(MEMORY_CONTROL, 1, sizeof(struct ControlServer));
+	if (!server) {
+		return NULL;
+	}
+
+	server->index    = index;
+	server->request  = request;
+	server->userData = userData;
+	atomic_init(&server->stopping, false);
+	pthread_mutex_init(&server->lock, NULL);
+
+	// Opened first, so that destroying the server always finds it initialized. Connections wait in the backlog until
+	// the thread runs.
+	bool listening        = server_open(&server->sockets, path, CONTROL_MAX_CLIENTS);
+	server->outputBuffers = memory_allocLarge(MEMORY_CONTROL, CONTROL_MAX_CLIENTS * CONTROL_CLIENT_BUFFER_SIZE);
+	if (!listening || !server->outputBuffers || !createRing(server)) {
+		destroyServer(server);
+		return NULL;
+	}
+	for (size_t i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		server->clients[i].output = server->outputBuffers + i * CONTROL_CLIENT_BUFFER_SIZE;
+	}
+
+	if (pthread_create(&server->thread, NULL, &serve, server) != 0) {
+		destroyServer(server);
+		return NULL;
+	}
+
+	return server;
+}
+
+void control_destroy(struct ControlServer *server) {
+	if (!server) {
+		return;
+	}
+
+	atomic_store(&server->stopping, true);
+	if (server_wake(&server->sockets)) {
+		pthread_join(server->thread, NULL);
+	}
+
+	destroyServer(server);
+}
+
+#else
+
+struct ControlServer *control_create(const char *path, struct TextIndex *index, ControlRequestFunction request,
+									 void *userData) {
+	(void) path;
+	(void) index;
+	(void) request;
+	(void) userData;
+
+	return NULL;
+}
+
+void control_destroy(struct ControlServer *server) {
+	(void) server;
+}
+
+void control_setTalking(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID,
+						mumble_talking_state_t state) {
+	(void) server;
+	(void) connection;
+	(void) userID;
+	(void) state;
+}
+
+void control_setChannel(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID,
+						mumble_channelid_t channelID) {
+	(void) server;
+	(void) connection;
+	(void) userID;
+	(void) channelID;
+}
+
+void control_setPosition(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID,
+						 const float position[3]) {
+	(void) server;
+	(void) connection;
+	(void) userID;
+	(void) position;
+}
+
+void control_removeUser(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID) {
+	(void) server;
+	(void) connection;
+	(void) userID;
+}
+
+void control_removeConnection(struct ControlServer *server, mumble_connection_t connection) {
+	(void) server;
+	(void) connection;
+}
+
+void control_publishLevel(struct ControlServer *server, mumble_userid_t userID, float peak, float rms) {
+	(void) server;
+	(void) userID;
+	(void) peak;
+	(void) rms;
+}
+
+#endif
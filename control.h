@@ -0,0 +1,181 @@
+/// This header file declares the control channel through which external tools (e.g. a companion app) drive the plugin.
+///
+/// Tools connect to a Unix domain socket and exchange length-prefixed binary frames with a server running an epoll loop
+/// on a thread of its own. Every frame starts with its length (a little endian uint32_t counting all bytes following
+/// it), followed by its type (uint8_t) and a sequence number (little endian uint32_t) chosen by the tool and echoed in
+/// the reply. All integers are little endian, floats are IEEE 754 singles and strings aren't terminated (they span the
+/// rest of the frame).
+///
+/// Requests (tool to plugin):
+/// - CONTROL_REQUEST_PING: Any payload, which is echoed in a CONTROL_EVENT_PONG
+/// - CONTROL_REQUEST_SUBSCRIBE: uint32_t topics (CONTROL_TOPIC_* flags, replacing the previous subscription). The reply
+///   is followed by a snapshot of the subscribed state and then by deltas whenever it changes.
+/// - CONTROL_REQUEST_MOVE_USER: int32_t connection, uint32_t userID, int32_t channelID, channel name (used instead of
+///   the ID if it isn't empty, at most COMMANDS_MAX_TEXT - 1 bytes; longer names are rejected with
+///   MUMBLE_EC_DATA_TOO_BIG)
+/// - CONTROL_REQUEST_SOUNDBOARD: clip name
+/// - CONTROL_REQUEST_SELF_MUTE: uint8_t muted
+/// - CONTROL_REQUEST_TRANSMISSION_MODE: uint8_t mode (a Mumble_TransmissionMode)
+/// - CONTROL_REQUEST_SEARCH: uint64_t fromMs, uint64_t toMs (the time range, inclusive, milliseconds since the epoch),
+///   uint8_t maxHits (at most CONTROL_MAX_HITS), phrase (see textindex_search). The hits are sent newest first, before
+///   the reply. Searches fail with MUMBLE_EC_GENERIC_ERROR if the plugin doesn't keep an index.
+///
+/// Events (plugin to tool):
+/// - CONTROL_EVENT_HELLO: uint32_t CONTROL_PROTOCOL_VERSION, name of the level ring's shared memory object. Sent once
+///   right after connecting (with sequence number 0).
+/// - CONTROL_EVENT_REPLY: int32_t status (a mumble_error_t). Requests executed by Mumble are replied to once they have
+///   been queued, not once Mumble has executed them.
+/// - CONTROL_EVENT_PONG: the ping's payload
+/// - CONTROL_EVENT_USER: int32_t connection, uint32_t userID, uint8_t changes (CONTROL_TOPIC_* flags and
+///   CONTROL_USER_REMOVED) followed by the changed values in the order of the flags: int32_t talking state, int32_t
+///   channel ID, 3 floats position. Sent with sequence number 0.
+/// - CONTROL_EVENT_HIT: uint64_t document, uint64_t timestampMs, uint8_t kind (a TextIndexKind), uint32_t userID,
+///   int32_t channelID, text. Sent with the sequence number of the search it has been found by.
+///
+/// State changes are coalesced: A tool that subscribed to positions gets the latest position of every user that moved
+/// since the last delta, not every single update. While a tool doesn't read its events, changes keep being coalesced
+/// and its requests stay in the socket, so slow tools get fewer deltas instead of an ever growing backlog.
+///
+/// Audio levels change far too often for the socket. They are written into a ring in shared memory instead (see
+/// struct ControlLevelRing), which tools map read-only and tail at their own pace.
+///
+/// NOTE: The control channel is only available on Linux. Everywhere else control_create returns NULL.
+
+#ifndef MUMBLE_PLUGIN_CONTROL_H_
+#define MUMBLE_PLUGIN_CONTROL_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONTROL_PROTOCOL_VERSION 2
+/// The maximum size of a frame (excluding the length)
+#define CONTROL_MAX_FRAME 1024
+/// The maximum amount of tools connected at the same time
+#define CONTROL_MAX_CLIENTS 8
+/// The amount of events that may be waiting to be sent to a single tool (in bytes)
+#define CONTROL_CLIENT_BUFFER_SIZE (64 * 1024)
+/// The maximum amount of users whose state is tracked (a power of two)
+#define CONTROL_MAX_USERS 1024
+/// The maximum amount of hits a search returns
+#define CONTROL_MAX_HITS 16
+/// The amount of entries in the level ring (a power of two)
+#define CONTROL_LEVEL_RING_SIZE 4096
+#define CONTROL_LEVEL_RING_MAGIC 0x4C564C48
+
+enum ControlRequestType {
+	CONTROL_REQUEST_PING = 1,
+	CONTROL_REQUEST_SUBSCRIBE,
+	CONTROL_REQUEST_MOVE_USER,
+	CONTROL_REQUEST_SOUNDBOARD,
+	CONTROL_REQUEST_SELF_MUTE,
+	CONTROL_REQUEST_TRANSMISSION_MODE,
+	CONTROL_REQUEST_SEARCH,
+};
+
+enum ControlEventType {
+	CONTROL_EVENT_HELLO = 128,
+	CONTROL_EVENT_REPLY,
+	CONTROL_EVENT_PONG,
+	CONTROL_EVENT_USER,
+	CONTROL_EVENT_HIT,
+};
+
+enum ControlTopic {
+	CONTROL_TOPIC_TALKING  = 1,
+	CONTROL_TOPIC_CHANNEL  = 2,
+	CONTROL_TOPIC_POSITION = 4,
+};
+
+/// Marks a CONTROL_EVENT_USER for a user that is gone
+#define CONTROL_USER_REMOVED 128
+
+/// A request that has to be executed by the plugin (pings, subscriptions and searches are handled by the server
+/// itself)
+struct ControlRequest {
+	enum ControlRequestType type;
+	mumble_connection_t connection;
+	mumble_userid_t userID;
+	mumble_channelid_t channelID;
+	bool enabled;
+	mumble_transmission_mode_t transmissionMode;
+	/// The request's string (terminated)
+	char text[CONTROL_MAX_FRAME];
+};
+
+/// Executes a request. This is called on the server's thread, so it must not call into Mumble (which would block
+/// until Mumble's main thread gets to it) but queue commands instead.
+///
+/// @returns The status that is sent back to the tool
+typedef mumble_error_t (*ControlRequestFunction)(void *userData, const struct ControlRequest *request);
+
+/// An entry of the level ring
+struct ControlLevel {
+	/// 2 * position + 2 once the entry for the given position has been written and an odd value while it is written
+	atomic_uint_least64_t sequence;
+	/// CLOCK_MONOTONIC
+	uint64_t timeNs;
+	mumble_userid_t userID;
+	float peak;
+	float rms;
+	uint32_t reserved;
+};
+
+/// The layout of the shared memory object the levels are written into. Writers claim the next position by
+/// incrementing head and write the entry at position % CONTROL_LEVEL_RING_SIZE. A reader that wants to read the entry
+/// at a given position loads its sequence number (acquire), copies the entry and loads the sequence number again: Only
+/// if both are 2 * position + 2 the copy is complete and hasn't been overwritten in the meantime. Readers that fall
+/// behind by more than CONTROL_LEVEL_RING_SIZE entries skip ahead to head.
+struct ControlLevelRing {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t reserved;
+	atomic_uint_least64_t head;
+	struct ControlLevel levels[CONTROL_LEVEL_RING_SIZE];
+};
+
+struct ControlServer;
+struct TextIndex;
+
+/// Starts a server listening at the given path and creates the level ring. A socket left at the path is replaced,
+/// anything else there makes starting fail.
+///
+/// @param index The index searches are answered from (NULL if there is none). It has to outlive the server.
+/// @param request The function requests are executed with
+/// @param userData An arbitrary pointer that is passed to the request function
+/// @returns The new server or NULL if starting it failed
+struct ControlServer *control_create(const char *path, struct TextIndex *index, ControlRequestFunction request,
+									 void *userData);
+
+/// Stops the server and removes the socket and the level ring
+void control_destroy(struct ControlServer *server);
+
+/// Updates a user's talking state
+///
+/// NOTE: This and the other functions updating the state may be called from any thread except audio threads (they
+/// take a lock shared with the server's thread). server may be NULL, in which case nothing happens.
+void control_setTalking(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID,
+						mumble_talking_state_t state);
+
+/// Updates the channel a user is in (-1 if the user isn't in any channel)
+void control_setChannel(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID,
+						mumble_channelid_t channelID);
+
+void control_setPosition(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID,
+						 const float position[3]);
+
+void control_removeUser(struct ControlServer *server, mumble_connection_t connection, mumble_userid_t userID);
+
+/// Removes all users of the given connection
+void control_removeConnection(struct ControlServer *server, mumble_connection_t connection);
+
+/// Writes a user's audio level into the level ring. Never blocks, so this may be called from audio threads.
+///
+/// NOTE: server may be NULL, in which case nothing happens
+void control_publishLevel(struct ControlServer *server, mumble_userid_t userID, float peak, float rms);
+
+#endif // MUMBLE_PLUGIN_CONTROL_H_
@@ -0,0 +1,424 @@
+#include "games.h"
+#include "memory.h"
+#include "scanner.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EMPTY_SLOT -1
+
+// Layout of the offset cache file (native byte order): magic (4) | version (4) | entry count (4) | entries
+#define CACHE_FILE_NAME "offsets.cache"
+#define CACHE_MAGIC 0x4f434d48 // "HMCO"
+#define CACHE_VERSION 1
+// If no collision-free seed is found within this many attempts, the table is grown
+#define MAX_SEED_ATTEMPTS 4096
+
+static const struct GameProfile profiles[] = {
+	// An example of how a supported game is described. The signature matches the instruction loading the global
+	// pointer to the local player (mov rax, [rip + player]; test rax, rax; jz ...; movss xmm0, [rax + ...]).
+	{
+		"Example Game",
+		{ "example_game", "example_game.exe" },
+		{ { "48 8B 05 ?? ?? ?? ?? 48 85 C0 74 ?? F3 0F 10 40", 3, 7 } },
+		1,
+		8,
+		{
+			{ 0, true, 0x10 },
+			{ 0, true, 0x1C },
+			{ 0, true, 0x28 },
+			{ 0, true, 0x40 },
+			{ 0, true, 0x4C },
+			{ 0, true, 0x58 },
+		},
+		POSITIONAL_UNITS_CENTIMETERS,
+		POSITIONAL_AXES_Z_UP_RIGHT_HANDED,
+	},
+};
+
+#define PROFILE_COUNT (sizeof(profiles) / sizeof(profiles[0]))
+
+struct Slot {
+	int16_t profile;
+	int16_t executable;
+};
+
+// Stored in the cache file as is
+struct CacheEntry {
+	// Changes whenever a profile's signatures change, so that stale offsets aren't used after updating the plugin
+	uint64_t profileKey;
+	uint8_t buildID[SCANNER_MAX_BUILD_ID];
+	uint32_t buildIDLength;
+	uint32_t reserved;
+	// Relative to the module's base, so that they survive address space layout randomization
+	uint64_t offsets[GAMES_MAX_SIGNATURES];
+};
+
+struct GameRegistry {
+	uint32_t seed;
+	uint32_t mask;
+	struct Slot *slots;
+
+	struct CacheEntry cache[GAMES_CACHE_SIZE];
+	size_t cacheCount;
+	// The entry to be replaced next once the cache is full
+	size_t cacheVictim;
+	// Empty if the cache isn't persisted
+	char cachePath[4096];
+};
+
+struct Game {
+	const struct GameProfile *profile;
+	uint64_t pid;
+	uint64_t addresses[GAMES_MAX_SIGNATURES];
+};
+
+// FNV-1a over the lowercase name, mixed with the seed
+static uint32_t hashName(const char *name, uint32_t seed) {
+	uint32_t hash = 2166136261u ^ seed;
+	for (; *name != '\0'; name++) {
+		hash ^= (uint8_t) tolower((unsigned char) *name);
+		hash *= 16777619u;
+	}
+
+	// Final avalanche so that the low bits used for indexing depend on all input bits
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+
+	return hash;
+}
+
+static bool equalsIgnoringCase(const char *a, const char *b) {
+	for (; *a != '\0' && *b != '\0'; a++, b++) {
+		if (tolower((unsigned char) *a) != tolower((unsigned char) *b)) {
+			return false;
+		}
+	}
+
+	return *a == *b;
+}
+
+// Tries to place all executable names without any collision
+static bool fillTable(struct GameRegistry *registry) {
+	for (uint32_t i = 0; i <= registry->mask; i++) {
+		registry->slots[i].profile = EMPTY_SLOT;
+	}
+
+	for (size_t profile = 0; profile < PROFILE_COUNT; profile++) {
+		for (size_t executable = 0; executable < GAMES_MAX_EXECUTABLES; executable++) {
+			const char *name = profiles[profile].executables[executable];
+			if (!name) {
+				continue;
+			}
+
+			struct Slot *slot = &registry->slots[hashName(name, registry->seed) & registry->mask];
+			if (slot->profile != EMPTY_SLOT) {
+				return false;
+			}
+			slot->profile    = (int16_t) profile;
+			slot->executable = (int16_t) executable;
+		}
+	}
+
+	return true;
+}
+
+static uint64_t profileKey(const struct GameProfile *profile) {
+	uint64_t hash = 14695981039346656037u;
+	for (const char *c = profile->name; *c != '\0'; c++) {
+		hash = (hash ^ (uint8_t) *c) * 1099511628211u;
+	}
+	for (size_t i = 0; i < profile->signatureCount; i++) {
+		for (const char *c = profile->signatures[i].pattern; *c != '\0'; c++) {
+			hash = (hash ^ (uint8_t) *c) * 1099511628211u;
+		}
+		hash = (hash ^ (uint32_t) profile->signatures[i].displacementOffset) * 1099511628211u;
+		hash = (hash ^ (uint32_t) profile->signatures[i].instructionEnd) * 1099511628211u;
+	}
+
+	return hash;
+}
+
+static void loadCache(struct GameRegistry *registry) {
+	FILE *file = fopen(registry->cachePath, "rb");
+	if (!file) {
+		return;
+	}
+
+	uint32_t header[3];
+	if (fread(header, sizeof(header), 1, file) == 1 && header[0] == CACHE_MAGIC && header[1] == CACHE_VERSION
+		&& header[2] <= GAMES_CACHE_SIZE) {
+		registry->cacheCount = fread(registry->cache, sizeof(struct CacheEntry), header[2], file);
+	}
+
+	fclose(file);
+}
+
+// The file is replaced atomically, so that a crash never leaves a truncated cache behind
+static void saveCache(const struct GameRegistry *registry) {
+	char temporaryPath[sizeof(registry->cachePath) + 8];
+	snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", registry->cachePath);
+
+	FILE *file = fopen(temporaryPath, "wb");
+	if (!file) {
+		return;
+	}
+
+	uint32_t header[3] = { CACHE_MAGIC, CACHE_VERSION, (uint32_t) registry->cacheCount };
+	bool written       = fwrite(header, sizeof(header), 1, file) == 1
+				   && fwrite(registry->cache, sizeof(struct CacheEntry), registry->cacheCount, file)
+						  == registry->cacheCount;
+	written = fclose(file) == 0 && written;
+
+	if (!written || rename(temporaryPath, registry->cachePath) != 0) {
+		remove(temporaryPath);
+	}
+}
+
+struct GameRegistry *games_create(const char *cacheDirectory) {
+	struct GameRegistry *registry = memory_calloc(MEMORY_GAMES, 1, sizeof(struct GameRegistry));
+	if (!registry) {
+		return NULL;
+	}
+
+	if (cacheDirectory) {
+		int length = snprintf(registry->cachePath, sizeof(registry->cachePath), "%s/" CACHE_FILE_NAME, cacheDirectory);
+		if (length > 0 && (size_t) length < sizeof(registry->cachePath)) {
+			loadCache(registry);
+		} else {
+			registry->cachePath[0] = '\0';
+		}
+	}
+
+	size_t nameCount = 0;
+	for (size_t i = 0; i < PROFILE_COUNT; i++) {
+		for (size_t j = 0; j < GAMES_MAX_EXECUTABLES; j++) {
+			nameCount += profiles[i].executables[j] != NULL;
+		}
+	}
+
+	// Search for a seed that makes the hash perfect for this set of names, growing the table if that takes too long
+	size_t tableSize = 16;
+	while (tableSize < 2 * nameCount) {
+		tableSize *= 2;
+	}
+
+	while (true) {
+		struct Slot *slots = memory_realloc(MEMORY_GAMES, registry->slots, tableSize * sizeof(struct Slot));
+		if (!slots) {
+			games_destroy(registry);
+			return NULL;
+		}
+		registry->slots = slots;
+		registry->mask  = (uint32_t) tableSize - 1;
+
+		for (registry->seed = 0; registry->seed < MAX_SEED_ATTEMPTS; registry->seed++) {
+			if (fillTable(registry)) {
+				return registry;
+			}
+		}
+
+		tableSize *= 2;
+	}
+}
+
+void games_destroy(struct GameRegistry *registry) {
+	if (!registry) {
+		return;
+	}
+
+	memory_free(registry->slots);
+	memory_free(registry);
+}
+
+const struct GameProfile *games_lookup(const struct GameRegistry *registry, const char *executable) {
+	const struct Slot *slot = &registry->slots[hashName(executable, registry->seed) & registry->mask];
+	if (slot->profile == EMPTY_SLOT) {
+		return NULL;
+	}
+
+	const struct GameProfile *profile = &profiles[slot->profile];
+
+	// Names that aren't part of the set may still hash to an occupied slot
+	return equalsIgnoringCase(profile->executables[slot->executable], executable) ? profile : NULL;
+}
+
+static struct CacheEntry *findCacheEntry(struct GameRegistry *registry, uint64_t key,
+										 const struct ModuleInfo *module) {
+	for (size_t i = 0; i < registry->cacheCount; i++) {
+		struct CacheEntry *entry = &registry->cache[i];
+		if (entry->profileKey == key && entry->buildIDLength == module->buildIDLength
+			&& memcmp(entry->buildID, module->buildID, module->buildIDLength) == 0) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void storeCacheEntry(struct GameRegistry *registry, uint64_t key, const struct ModuleInfo *module,
+							const uint64_t *offsets) {
+	struct CacheEntry *entry;
+	if (registry->cacheCount < GAMES_CACHE_SIZE) {
+		entry = &registry->cache[registry->cacheCount++];
+	} else {
+		entry                 = &registry->cache[registry->cacheVictim];
+		registry->cacheVictim = (registry->cacheVictim + 1) % GAMES_CACHE_SIZE;
+	}
+
+	memset(entry, 0, sizeof(*entry));
+	entry->profileKey    = key;
+	entry->buildIDLength = (uint32_t) module->buildIDLength;
+	memcpy(entry->buildID, module->buildID, module->buildIDLength);
+	memcpy(entry->offsets, offsets, sizeof(entry->offsets));
+
+	if (registry->cachePath[0] != '\0') {
+		saveCache(registry);
+	}
+}
+
+// Determines the module-relative offsets all of the profile's signatures refer to with a single scan of the module
+static bool resolveSignatures(uint64_t pid, const struct ModuleInfo *module, const struct GameProfile *profile,
+							  uint64_t *offsets) {
+	struct SignaturePattern patterns[GAMES_MAX_SIGNATURES];
+	uint64_t matches[GAMES_MAX_SIGNATURES];
+	for (size_t i = 0; i < profile->signatureCount; i++) {
+		if (!scanner_parsePattern(profile->signatures[i].pattern, &patterns[i])) {
+			return false;
+		}
+	}
+
+	if (!scanner_scanModule(pid, module, patterns, profile->signatureCount, matches)) {
+		return false;
+	}
+
+	for (size_t i = 0; i < profile->signatureCount; i++) {
+		const struct GameSignature *signature = &profile->signatures[i];
+		uint64_t address                      = matches[i];
+
+		if (signature->displacementOffset >= 0) {
+			int32_t displacement;
+			if (!scanner_read(pid, matches[i] + (uint64_t) signature->displacementOffset, &displacement,
+							  sizeof(displacement))) {
+				return false;
+			}
+			address = matches[i] + (uint64_t) signature->instructionEnd + (uint64_t) (int64_t) displacement;
+		}
+
+		offsets[i] = address - module->base;
+	}
+
+	return true;
+}
+
+static struct Game *attachTo(struct GameRegistry *registry, const struct GameProfile *profile, const char *executable,
+							 uint64_t pid) {
+	struct ModuleInfo *module = memory_alloc(MEMORY_GAMES, sizeof(struct ModuleInfo));
+	if (!module) {
+		return NULL;
+	}
+
+	struct Game *game = NULL;
+	if (!scanner_findModule(pid, executable, module)) {
+		goto cleanup;
+	}
+
+	uint64_t key                           = profileKey(profile);
+	uint64_t offsets[GAMES_MAX_SIGNATURES] = { 0 };
+
+	struct CacheEntry *entry = module->buildIDLength > 0 ? findCacheEntry(registry, key, module) : NULL;
+	if (entry) {
+		memcpy(offsets, entry->offsets, sizeof(offsets));
+	} else {
+		if (!resolveSignatures(pid, module, profile, offsets)) {
+			goto cleanup;
+		}
+
+		// Without a build ID there's no way to tell whether it's still the same binary next time
+		if (module->buildIDLength > 0) {
+			storeCacheEntry(registry, key, module, offsets);
+		}
+	}
+
+	game = memory_alloc(MEMORY_GAMES, sizeof(struct Game));
+	if (game) {
+		game->profile = profile;
+		game->pid     = pid;
+		for (size_t i = 0; i < profile->signatureCount; i++) {
+			game->addresses[i] = module->base + offsets[i];
+		}
+	}
+
+cleanup:
+	memory_free(module);
+
+	return game;
+}
+
+struct Game *games_attach(struct GameRegistry *registry, const char *const *programNames, const uint64_t *programPIDs,
+						  size_t programCount) {
+	for (size_t i = 0; i < programCount; i++) {
+		const struct GameProfile *profile = games_lookup(registry, programNames[i]);
+		if (!profile) {
+			continue;
+		}
+
+		struct Game *game = attachTo(registry, profile, programNames[i], programPIDs[i]);
+		if (game) {
+			return game;
+		}
+	}
+
+	return NULL;
+}
+
+void games_detach(struct Game *game) {
+	memory_free(game);
+}
+
+bool games_read(struct Game *game, struct PositionalData *data) {
+	const struct GameProfile *profile = game->profile;
+
+	// Pointers are only read once even if several vectors are located relative to them
+	uint64_t pointers[GAMES_MAX_SIGNATURES];
+	bool pointerRead[GAMES_MAX_SIGNATURES] = { false };
+
+	float vectors[POSITIONAL_VECTOR_COUNT][3];
+	for (size_t i = 0; i < POSITIONAL_VECTOR_COUNT; i++) {
+		const struct GameVector *vector = &profile->vectors[i];
+		uint64_t base                   = game->addresses[vector->signature];
+
+		if (vector->dereference) {
+			if (!pointerRead[vector->signature]) {
+				pointers[vector->signature] = 0;
+				if (!scanner_read(game->pid, base, &pointers[vector->signature], profile->pointerSize)) {
+					// The game's own image is no longer readable -> it has exited
+					return false;
+				}
+				pointerRead[vector->signature] = true;
+			}
+
+			base = pointers[vector->signature];
+			if (base == 0) {
+				// The game hasn't set up the player (yet), e.g. because it's in the main menu
+				memset(data, 0, sizeof(*data));
+				return true;
+			}
+		}
+
+		if (!scanner_read(game->pid, base + vector->offset, vectors[i], sizeof(vectors[i]))) {
+			// A dangling pointer is just a transient state, but the game's own image has to stay readable
+			memset(data, 0, sizeof(*data));
+			return vector->dereference;
+		}
+	}
+
+	if (positional_convert(profile->units, profile->axes, vectors, data)) {
+		data->active = true;
+	}
+
+	return true;
+}
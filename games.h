@@ -0,0 +1,87 @@
+/// This header file declares the registry of games whose positional data is read directly from their memory.
+///
+/// The executable names of all profiles are compiled into a perfect hash table when the registry is created, so
+/// checking the whole process list Mumble hands to mumble_initPositionalData costs a single hash lookup per process.
+/// Only once a process matches are the signatures of that one profile scanned for in the game's image (all of them in a
+/// single pass). The resolved offsets are cached on disk by the module's build ID, so re-attaching to the same game
+/// binary skips the scan entirely, even after restarting Mumble.
+///
+/// NOTE: The functions in this file are not thread-safe.
+
+#ifndef MUMBLE_PLUGIN_GAMES_H_
+#define MUMBLE_PLUGIN_GAMES_H_
+
+#include "positional.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GAMES_MAX_EXECUTABLES 4
+#define GAMES_MAX_SIGNATURES 4
+/// The amount of game binaries whose resolved offsets are remembered
+#define GAMES_CACHE_SIZE 16
+
+struct GameSignature {
+	/// See scanner_parsePattern
+	const char *pattern;
+	/// The offset of a 32 bit displacement within the match that is relative to the end of the instruction
+	/// (RIP-relative addressing). If this is negative, the address of the match itself is the result.
+	int displacementOffset;
+	/// The offset of the end of the instruction within the match
+	int instructionEnd;
+};
+
+struct GameVector {
+	/// The index of the signature whose resolved address the vector is read relative to
+	size_t signature;
+	/// Whether the resolved address holds a pointer to the structure containing the vector
+	bool dereference;
+	/// The offset of the vector (three floats) from the (dereferenced) address
+	uint32_t offset;
+};
+
+struct GameProfile {
+	const char *name;
+	/// The executable names the game is detected by (unused entries are NULL)
+	const char *executables[GAMES_MAX_EXECUTABLES];
+	struct GameSignature signatures[GAMES_MAX_SIGNATURES];
+	size_t signatureCount;
+	/// The size of pointers in the game's process (4 or 8)
+	size_t pointerSize;
+	/// Where to find the vectors (indexed by enum PositionalVector)
+	struct GameVector vectors[POSITIONAL_VECTOR_COUNT];
+	/// An enum PositionalUnits value
+	uint32_t units;
+	/// An enum PositionalAxes value
+	uint32_t axes;
+};
+
+struct GameRegistry;
+struct Game;
+
+/// @param cacheDirectory The directory the resolved offsets are cached in. If this is NULL, they are only cached in
+/// memory.
+/// @returns A registry of all supported games or NULL if creating it failed
+struct GameRegistry *games_create(const char *cacheDirectory);
+
+void games_destroy(struct GameRegistry *registry);
+
+/// @returns The profile of the game with the given executable name (ignoring case) or NULL if it's not supported
+const struct GameProfile *games_lookup(const struct GameRegistry *registry, const char *executable);
+
+/// Looks for a supported game in the given process list (see mumble_initPositionalData) and locates its data
+///
+/// @returns The attached game or NULL if no supported game is running or its data couldn't be located
+struct Game *games_attach(struct GameRegistry *registry, const char *const *programNames, const uint64_t *programPIDs,
+						  size_t programCount);
+
+void games_detach(struct Game *game);
+
+/// Reads the game's current positional data
+///
+/// @param[out] data The converted data. It is cleared while the game doesn't provide any (e.g. in menus).
+/// @returns Whether the game is still running. If this returns false, the game should be detached.
+bool games_read(struct Game *game, struct PositionalData *data);
+
+#endif // MUMBLE_PLUGIN_GAMES_H_
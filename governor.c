@@ -0,0 +1,191 @@
+#include "governor.h"
+#include "memory.h"
+
+// Budgets and loads are stored in parts per million, as atomic doubles aren't lock-free everywhere
+#define PPM 1000000.0
+
+struct Stage {
+	enum GovernorClock clock;
+	unsigned int tierCount;
+	atomic_uint tier;
+};
+
+// Only ever touched by the thread recording the clock (except for load)
+struct Clock {
+	uint64_t busyNs;
+	uint64_t audioNs;
+	atomic_uint load;
+
+	unsigned int budget;
+	// The amount of windows the load has been low in a row
+	unsigned int calmWindows;
+	unsigned int restoreWindows;
+	// The amount of windows since the last step up (UINT32_MAX if there hasn't been one since the last step down)
+	unsigned int windowsSinceStepUp;
+};
+
+struct Governor {
+	GovernorStepFunction step;
+	void *userData;
+	atomic_uint budget;
+
+	struct Stage stages[GOVERNOR_MAX_STAGES];
+	size_t stageCount;
+
+	struct Clock clocks[GOVERNOR_CLOCK_COUNT];
+};
+
+struct Governor *governor_create(GovernorStepFunction step, void *userData) {
+	struct Governor *governor = memory_calloc(MEMORY_GOVERNOR, 1, sizeof(struct Governor));
+	if (!governor) {
+		return NULL;
+	}
+
+	governor->step     = step;
+	governor->userData = userData;
+
+	for (size_t i = 0; i < GOVERNOR_CLOCK_COUNT; ++i) {
+		governor->clocks[i].restoreWindows     = GOVERNOR_RESTORE_WINDOWS;
+		governor->clocks[i].windowsSinceStepUp = UINT32_MAX;
+	}
+
+	return governor;
+}
+
+void governor_destroy(struct Governor *governor) {
+	memory_free(governor);
+}
+
+int governor_addStage(struct Governor *governor, enum GovernorClock clock, unsigned int tierCount) {
+	if (governor->stageCount == GOVERNOR_MAX_STAGES || tierCount == 0) {
+		return -1;
+	}
+
+	struct Stage *stage = &governor->stages[governor->stageCount];
+	stage->clock        = clock;
+	stage->tierCount    = tierCount;
+	atomic_init(&stage->tier, 0);
+
+	return (int) governor->stageCount++;
+}
+
+void governor_setBudget(struct Governor *governor, double budget) {
+	if (budget < 0) {
+		budget = 0;
+	}
+
+	atomic_store_explicit(&governor->budget, (unsigned int) (budget * PPM), memory_order_relaxed);
+}
+
+static void setTier(struct Governor *governor, size_t index, unsigned int tier, bool down, double load) {
+	atomic_store_explicit(&governor->stages[index].tier, tier, memory_order_relaxed);
+
+	if (governor->step) {
+		governor->step(governor->userData, index, tier, down, load);
+	}
+}
+
+// Steps the first stage of the clock that has a lower tier left down
+static bool stepDown(struct Governor *governor, enum GovernorClock clock, double load) {
+	for (size_t i = 0; i < governor->stageCount; ++i) {
+		struct Stage *stage = &governor->stages[i];
+		unsigned int tier   = atomic_load_explicit(&stage->tier, memory_order_relaxed);
+
+		if (stage->clock == clock && tier + 1 < stage->tierCount) {
+			setTier(governor, i, tier + 1, true, load);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Steps the last stage of the clock that isn't at tier 0 up
+static bool stepUp(struct Governor *governor, enum GovernorClock clock, double load) {
+	for (size_t i = governor->stageCount; i-- > 0;) {
+		struct Stage *stage = &governor->stages[i];
+		unsigned int tier   = atomic_load_explicit(&stage->tier, memory_order_relaxed);
+
+		if (stage->clock == clock && tier > 0) {
+			setTier(governor, i, tier - 1, false, load);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void evaluate(struct Governor *governor, enum GovernorClock clock, struct Clock *state) {
+	double load = (double) state->busyNs / (double) state->audioNs;
+	atomic_store_explicit(&state->load, (unsigned int) (load < 1000 ? load * PPM : 1000 * PPM), memory_order_relaxed);
+
+	unsigned int budget = atomic_load_explicit(&governor->budget, memory_order_relaxed);
+	if (budget != state->budget) {
+		state->budget         = budget;
+		state->calmWindows    = 0;
+		state->restoreWindows = GOVERNOR_RESTORE_WINDOWS;
+	}
+
+	if (budget == 0) {
+		while (stepUp(governor, clock, load)) {
+		}
+		return;
+	}
+
+	if (state->windowsSinceStepUp != UINT32_MAX) {
+		++state->windowsSinceStepUp;
+	}
+
+	if (load * PPM > budget) {
+		state->calmWindows = 0;
+
+		if (stepDown(governor, clock, load)) {
+			// The last step up has apparently been too much, so the next one has to wait longer
+			if (state->windowsSinceStepUp <= state->restoreWindows) {
+				state->restoreWindows *= 2;
+				if (state->restoreWindows > GOVERNOR_MAX_RESTORE_WINDOWS) {
+					state->restoreWindows = GOVERNOR_MAX_RESTORE_WINDOWS;
+				}
+			}
+			state->windowsSinceStepUp = UINT32_MAX;
+		}
+	} else if (load * PPM < budget * GOVERNOR_RESTORE_FRACTION) {
+		if (++state->calmWindows >= state->restoreWindows && stepUp(governor, clock, load)) {
+			state->calmWindows        = 0;
+			state->windowsSinceStepUp = 0;
+		}
+	} else {
+		state->calmWindows = 0;
+	}
+}
+
+void governor_record(struct Governor *governor, enum GovernorClock clock, uint64_t busyNs, uint64_t audioNs) {
+	if (!governor) {
+		return;
+	}
+
+	struct Clock *state = &governor->clocks[clock];
+	state->busyNs += busyNs;
+	state->audioNs += audioNs;
+
+	if (state->audioNs < GOVERNOR_WINDOW_MS * 1000000ULL) {
+		return;
+	}
+
+	evaluate(governor, clock, state);
+
+	state->busyNs  = 0;
+	state->audioNs = 0;
+}
+
+unsigned int governor_getTier(const struct Governor *governor, int stage) {
+	if (!governor || stage < 0) {
+		return 0;
+	}
+
+	return atomic_load_explicit(&governor->stages[stage].tier, memory_order_relaxed);
+}
+
+double governor_getLoad(const struct Governor *governor, enum GovernorClock clock) {
+	return atomic_load_explicit(&governor->clocks[clock].load, memory_order_relaxed) / PPM;
+}
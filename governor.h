@@ -0,0 +1,83 @@
+/// This header file declares the governor that keeps the audio callbacks within a CPU budget.
+///
+/// Every audio callback reports how long it took and how much audio it processed. The governor sums both up per clock
+/// (audio thread) and, every GOVERNOR_WINDOW_MS of audio, compares the load (the fraction of the audio's duration that
+/// has been spent in the callbacks) against the budget. If the load exceeds the budget, one of the clock's stages is
+/// stepped down to the next lower quality tier. Only once the load has been well below the budget for a while (see
+/// GOVERNOR_RESTORE_FRACTION and GOVERNOR_RESTORE_WINDOWS) a stage is stepped back up. Steps up that had to be undone
+/// right away make the governor wait twice as long before the next one.
+///
+/// Stages are stepped down in the order they have been added (the first stage gives up all its tiers before the
+/// second one gives up any) and stepped up in reverse order. What a tier means is up to the stage: Tier 0 is its full
+/// quality and the last tier might just as well bypass it altogether.
+///
+/// Recording and deciding never blocks, never allocates and may be done from audio threads. Each clock has to be
+/// recorded from a single thread at a time, while tiers may be read from any thread.
+
+#ifndef MUMBLE_PLUGIN_GOVERNOR_H_
+#define MUMBLE_PLUGIN_GOVERNOR_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GOVERNOR_MAX_STAGES 8
+/// The amount of audio after which the load is evaluated
+#define GOVERNOR_WINDOW_MS 250
+/// A stage is only stepped back up if the load stayed below this fraction of the budget
+#define GOVERNOR_RESTORE_FRACTION 0.5
+/// The amount of windows the load has to stay low before a stage is stepped back up
+#define GOVERNOR_RESTORE_WINDOWS 8
+/// The longest the governor waits before stepping up after steps up had to be undone
+#define GOVERNOR_MAX_RESTORE_WINDOWS 128
+
+/// The threads audio is processed on. Each has its own load.
+enum GovernorClock { GOVERNOR_INPUT, GOVERNOR_OUTPUT, GOVERNOR_CLOCK_COUNT };
+
+/// Called (on the audio thread) whenever a stage has been stepped to another tier
+///
+/// @param down Whether the stage has been stepped down (to a higher tier) or up
+/// @param load The load that caused the step
+typedef void (*GovernorStepFunction)(void *userData, size_t stage, unsigned int tier, bool down, double load);
+
+struct Governor;
+
+/// @param step The function that is told about steps (may be NULL)
+/// @param userData An arbitrary pointer that is passed to the step function
+/// @returns A new governor without any stages or NULL if allocating it failed
+struct Governor *governor_create(GovernorStepFunction step, void *userData);
+
+void governor_destroy(struct Governor *governor);
+
+/// Adds a stage
+///
+/// NOTE: Stages have to be added before the governor is being used from several threads
+///
+/// @param clock The clock whose load the stage contributes to
+/// @param tierCount The amount of tiers (including tier 0)
+/// @returns The stage's index or -1 if there are too many stages
+int governor_addStage(struct Governor *governor, enum GovernorClock clock, unsigned int tierCount);
+
+/// Sets the budget as a fraction of the audio's duration (e.g. 0.25 allows 2.5ms per 10ms frame). A budget of 0
+/// disables the governor, which then steps all stages back up to tier 0 at the end of the next window.
+///
+/// NOTE: May be called from any thread
+void governor_setBudget(struct Governor *governor, double budget);
+
+/// Records a callback
+///
+/// NOTE: governor may be NULL, in which case nothing happens
+///
+/// @param busyNs The time spent in the callback
+/// @param audioNs The duration of the audio the callback has advanced the clock by. Callbacks that process only part
+/// of a frame (e.g. a single speaker's audio, with the frame being completed by another callback) pass 0.
+void governor_record(struct Governor *governor, enum GovernorClock clock, uint64_t busyNs, uint64_t audioNs);
+
+/// @returns The stage's current tier (0 if governor is NULL)
+unsigned int governor_getTier(const struct Governor *governor, int stage);
+
+/// @returns The load of the clock during the last window
+double governor_getLoad(const struct Governor *governor, enum GovernorClock clock);
+
+#endif // MUMBLE_PLUGIN_GOVERNOR_H_
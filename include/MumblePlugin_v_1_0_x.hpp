@@ -0,0 +1,608 @@
+/// This header file provides C++ bindings for the Mumble plugin interface (C++17 or later).
+///
+/// mumble::API wraps the MumbleAPI struct: Results are returned instead of written through out-parameters, and memory
+/// Mumble allocates is owned by move-only handles (mumble::String and mumble::Array) that hand it back through
+/// freeMemory when they go out of scope. Their contents are accessed through std::string_view and span views without
+/// being copied.
+///
+/// Plugins derive from mumble::Plugin (CRTP) and export the callbacks they implement with the MUMBLE_EXPORT macro.
+/// Every exported function forwards to the plugin's member function directly (no virtual calls), and callbacks that
+/// aren't listed aren't exported at all, so Mumble doesn't even call them:
+///
+///     struct HelloPlugin : mumble::Plugin<HelloPlugin> {
+///         static constexpr std::string_view name = "HelloMumble";
+///
+///         HelloPlugin() { api().log("Hello Mumble"); }
+///         ~HelloPlugin() { api().log("Goodbye Mumble"); }
+///
+///         void onUserAdded(mumble_connection_t connection, mumble_userid_t userID) {
+///             if (auto userName = api().getUserName(connection, userID)) {
+///                 // Use userName->view()
+///             }
+///         }
+///     };
+///
+///     MUMBLE_PLUGIN(HelloPlugin)
+///     MUMBLE_EXPORT(HelloPlugin, onUserAdded)
+///
+/// The plugin object is constructed in mumble_init and destroyed in mumble_shutdown. If the constructor throws, loading
+/// the plugin fails. Callbacks that Mumble may call without the plugin being loaded (getVersion, getAuthor,
+/// getDescription, hasUpdate and getUpdateDownloadURL) have to be static members.
+///
+/// NOTE: All of this is inline and adds no indirection over calling the C API directly. The bindings are not used by
+/// the C plugin in this repository.
+
+#ifndef MUMBLE_PLUGIN_CPP_H_
+#define MUMBLE_PLUGIN_CPP_H_
+
+#include "MumblePlugin_v_1_0_x.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#	include <span>
+#endif
+
+namespace mumble {
+
+#ifdef __cpp_lib_span
+template< typename T > using Span = std::span< T >;
+#else
+/// A minimal stand-in for std::span (which is only available as of C++20)
+template< typename T > class Span {
+public:
+	constexpr Span() noexcept = default;
+	constexpr Span(T *data, std::size_t size) noexcept : m_data(data), m_size(size) {}
+
+	constexpr T *data() const noexcept { return m_data; }
+	constexpr std::size_t size() const noexcept { return m_size; }
+	constexpr bool empty() const noexcept { return m_size == 0; }
+	constexpr T *begin() const noexcept { return m_data; }
+	constexpr T *end() const noexcept { return m_data + m_size; }
+	constexpr T &operator[](std::size_t index) const noexcept { return m_data[index]; }
+
+private:
+	T *m_data           = nullptr;
+	std::size_t m_size = 0;
+};
+#endif
+
+/// Either a value or the error code of the call that failed to produce it
+template< typename T > class Result {
+public:
+	Result(mumble_error_t error) noexcept : m_error(error) {}
+	Result(T value) noexcept(std::is_nothrow_move_constructible_v< T >)
+		: m_error(MUMBLE_STATUS_OK), m_value(std::move(value)) {}
+
+	bool ok() const noexcept { return m_error == MUMBLE_STATUS_OK; }
+	explicit operator bool() const noexcept { return ok(); }
+	mumble_error_t error() const noexcept { return m_error; }
+
+	/// Only valid if ok() returns true
+	T &value() & noexcept { return m_value; }
+	const T &value() const & noexcept { return m_value; }
+	T &&value() && noexcept { return std::move(m_value); }
+	T *operator->() noexcept { return &m_value; }
+	const T *operator->() const noexcept { return &m_value; }
+	T &operator*() & noexcept { return m_value; }
+
+	/// @returns The value or the given fallback if the call failed
+	T valueOr(T fallback) && { return ok() ? std::move(m_value) : std::move(fallback); }
+
+private:
+	mumble_error_t m_error;
+	T m_value{};
+};
+
+/// Hands memory back to Mumble (used as the deleter of the owning handles)
+struct FreeMemory {
+	const MumbleAPI_v_1_0_x *api = nullptr;
+	mumble_plugin_id_t pluginID  = 0;
+
+	void operator()(const void *pointer) const noexcept { api->freeMemory(pluginID, pointer); }
+};
+
+/// A string allocated by Mumble
+class String {
+public:
+	String() noexcept = default;
+	String(const char *data, FreeMemory deleter) noexcept : m_data(data, deleter), m_size(std::strlen(data)) {}
+
+	std::string_view view() const noexcept { return std::string_view(m_data.get(), m_size); }
+	operator std::string_view() const noexcept { return view(); }
+	/// The string including its terminator
+	const char *c_str() const noexcept { return m_data.get(); }
+
+private:
+	std::unique_ptr< const char[], FreeMemory > m_data;
+	std::size_t m_size = 0;
+};
+
+/// An array allocated by Mumble
+template< typename T > class Array {
+public:
+	Array() noexcept = default;
+	Array(T *data, std::size_t size, FreeMemory deleter) noexcept : m_data(data, deleter), m_size(size) {}
+
+	Span< const T > span() const noexcept { return Span< const T >(m_data.get(), m_size); }
+	operator Span< const T >() const noexcept { return span(); }
+
+	const T *begin() const noexcept { return m_data.get(); }
+	const T *end() const noexcept { return m_data.get() + m_size; }
+	std::size_t size() const noexcept { return m_size; }
+	bool empty() const noexcept { return m_size == 0; }
+	const T &operator[](std::size_t index) const noexcept { return m_data[index]; }
+
+private:
+	std::unique_ptr< T[], FreeMemory > m_data;
+	std::size_t m_size = 0;
+};
+
+/// The functions Mumble provides to plugins (see MumbleAPI_v_1_0_x.h for their documentation)
+class API {
+public:
+	API(const MumbleAPI_v_1_0_x &api, mumble_plugin_id_t pluginID) noexcept : m_api(&api), m_pluginID(pluginID) {}
+
+	const MumbleAPI_v_1_0_x &raw() const noexcept { return *m_api; }
+	mumble_plugin_id_t pluginID() const noexcept { return m_pluginID; }
+
+	// -------- Getter functions --------
+
+	Result< mumble_connection_t > getActiveServerConnection() const noexcept {
+		return get< mumble_connection_t >(m_api->getActiveServerConnection);
+	}
+
+	Result< bool > isConnectionSynchronized(mumble_connection_t connection) const noexcept {
+		return get< bool >(m_api->isConnectionSynchronized, connection);
+	}
+
+	Result< mumble_userid_t > getLocalUserID(mumble_connection_t connection) const noexcept {
+		return get< mumble_userid_t >(m_api->getLocalUserID, connection);
+	}
+
+	Result< String > getUserName(mumble_connection_t connection, mumble_userid_t userID) const noexcept {
+		return getString(m_api->getUserName, connection, userID);
+	}
+
+	Result< String > getChannelName(mumble_connection_t connection, mumble_channelid_t channelID) const noexcept {
+		return getString(m_api->getChannelName, connection, channelID);
+	}
+
+	Result< Array< mumble_userid_t > > getAllUsers(mumble_connection_t connection) const noexcept {
+		return getArray< mumble_userid_t >(m_api->getAllUsers, connection);
+	}
+
+	Result< Array< mumble_channelid_t > > getAllChannels(mumble_connection_t connection) const noexcept {
+		return getArray< mumble_channelid_t >(m_api->getAllChannels, connection);
+	}
+
+	Result< mumble_channelid_t > getChannelOfUser(mumble_connection_t connection, mumble_userid_t userID) const
+		noexcept {
+		return get< mumble_channelid_t >(m_api->getChannelOfUser, connection, userID);
+	}
+
+	Result< Array< mumble_userid_t > > getUsersInChannel(mumble_connection_t connection,
+														 mumble_channelid_t channelID) const noexcept {
+		return getArray< mumble_userid_t >(m_api->getUsersInChannel, connection, channelID);
+	}
+
+	Result< mumble_transmission_mode_t > getLocalUserTransmissionMode() const noexcept {
+		return get< mumble_transmission_mode_t >(m_api->getLocalUserTransmissionMode);
+	}
+
+	Result< bool > isUserLocallyMuted(mumble_connection_t connection, mumble_userid_t userID) const noexcept {
+		return get< bool >(m_api->isUserLocallyMuted, connection, userID);
+	}
+
+	Result< bool > isLocalUserMuted() const noexcept { return get< bool >(m_api->isLocalUserMuted); }
+
+	Result< bool > isLocalUserDeafened() const noexcept { return get< bool >(m_api->isLocalUserDeafened); }
+
+	Result< String > getUserHash(mumble_connection_t connection, mumble_userid_t userID) const noexcept {
+		return getString(m_api->getUserHash, connection, userID);
+	}
+
+	Result< String > getServerHash(mumble_connection_t connection) const noexcept {
+		return getString(m_api->getServerHash, connection);
+	}
+
+	Result< String > getUserComment(mumble_connection_t connection, mumble_userid_t userID) const noexcept {
+		return getString(m_api->getUserComment, connection, userID);
+	}
+
+	Result< String > getChannelDescription(mumble_connection_t connection, mumble_channelid_t channelID) const
+		noexcept {
+		return getString(m_api->getChannelDescription, connection, channelID);
+	}
+
+	// -------- Request functions --------
+
+	mumble_error_t requestLocalUserTransmissionMode(mumble_transmission_mode_t transmissionMode) const noexcept {
+		return m_api->requestLocalUserTransmissionMode(m_pluginID, transmissionMode);
+	}
+
+	mumble_error_t requestUserMove(mumble_connection_t connection, mumble_userid_t userID,
+								   mumble_channelid_t channelID, const char *password = nullptr) const noexcept {
+		return m_api->requestUserMove(m_pluginID, connection, userID, channelID, password);
+	}
+
+	mumble_error_t requestMicrophoneActivationOverwrite(bool activate) const noexcept {
+		return m_api->requestMicrophoneActivationOvewrite(m_pluginID, activate);
+	}
+
+	mumble_error_t requestLocalMute(mumble_connection_t connection, mumble_userid_t userID, bool muted) const
+		noexcept {
+		return m_api->requestLocalMute(m_pluginID, connection, userID, muted);
+	}
+
+	mumble_error_t requestLocalUserMute(bool muted) const noexcept {
+		return m_api->requestLocalUserMute(m_pluginID, muted);
+	}
+
+	mumble_error_t requestLocalUserDeaf(bool deafened) const noexcept {
+		return m_api->requestLocalUserDeaf(m_pluginID, deafened);
+	}
+
+	mumble_error_t requestSetLocalUserComment(mumble_connection_t connection, const char *comment) const noexcept {
+		return m_api->requestSetLocalUserComment(m_pluginID, connection, comment);
+	}
+
+	// -------- Find functions --------
+
+	Result< mumble_userid_t > findUserByName(mumble_connection_t connection, const char *userName) const noexcept {
+		return get< mumble_userid_t >(m_api->findUserByName, connection, userName);
+	}
+
+	Result< mumble_channelid_t > findChannelByName(mumble_connection_t connection, const char *channelName) const
+		noexcept {
+		return get< mumble_channelid_t >(m_api->findChannelByName, connection, channelName);
+	}
+
+	// -------- Settings --------
+
+	Result< bool > getMumbleSettingBool(mumble_settings_key_t key) const noexcept {
+		return get< bool >(m_api->getMumbleSetting_bool, key);
+	}
+
+	Result< int64_t > getMumbleSettingInt(mumble_settings_key_t key) const noexcept {
+		return get< int64_t >(m_api->getMumbleSetting_int, key);
+	}
+
+	Result< double > getMumbleSettingDouble(mumble_settings_key_t key) const noexcept {
+		return get< double >(m_api->getMumbleSetting_double, key);
+	}
+
+	Result< String > getMumbleSettingString(mumble_settings_key_t key) const noexcept {
+		return getString(m_api->getMumbleSetting_string, key);
+	}
+
+	mumble_error_t setMumbleSetting(mumble_settings_key_t key, bool value) const noexcept {
+		return m_api->setMumbleSetting_bool(m_pluginID, key, value);
+	}
+
+	mumble_error_t setMumbleSetting(mumble_settings_key_t key, int64_t value) const noexcept {
+		return m_api->setMumbleSetting_int(m_pluginID, key, value);
+	}
+
+	mumble_error_t setMumbleSetting(mumble_settings_key_t key, double value) const noexcept {
+		return m_api->setMumbleSetting_double(m_pluginID, key, value);
+	}
+
+	mumble_error_t setMumbleSetting(mumble_settings_key_t key, const char *value) const noexcept {
+		return m_api->setMumbleSetting_string(m_pluginID, key, value);
+	}
+
+	// -------- Miscellaneous --------
+
+	mumble_error_t sendData(mumble_connection_t connection, Span< const mumble_userid_t > users,
+							Span< const uint8_t > data, const char *dataID) const noexcept {
+		return m_api->sendData(m_pluginID, connection, users.data(), users.size(), data.data(), data.size(), dataID);
+	}
+
+	mumble_error_t log(const char *message) const noexcept { return m_api->log(m_pluginID, message); }
+
+	mumble_error_t playSample(const char *samplePath) const noexcept {
+		return m_api->playSample(m_pluginID, samplePath);
+	}
+
+private:
+	const MumbleAPI_v_1_0_x *m_api;
+	mumble_plugin_id_t m_pluginID;
+
+	FreeMemory deleter() const noexcept { return FreeMemory{ m_api, m_pluginID }; }
+
+	template< typename T, typename Function, typename... Arguments >
+	Result< T > get(Function function, Arguments... arguments) const noexcept {
+		T value{};
+		mumble_error_t error = function(m_pluginID, arguments..., &value);
+		if (error != MUMBLE_STATUS_OK) {
+			return error;
+		}
+
+		return value;
+	}
+
+	template< typename Function, typename... Arguments >
+	Result< String > getString(Function function, Arguments... arguments) const noexcept {
+		const char *value    = nullptr;
+		mumble_error_t error = function(m_pluginID, arguments..., &value);
+		if (error != MUMBLE_STATUS_OK) {
+			return error;
+		}
+
+		return String(value, deleter());
+	}
+
+	template< typename T, typename Function, typename... Arguments >
+	Result< Array< T > > getArray(Function function, Arguments... arguments) const noexcept {
+		T *values            = nullptr;
+		std::size_t count    = 0;
+		mumble_error_t error = function(m_pluginID, arguments..., &values, &count);
+		if (error != MUMBLE_STATUS_OK) {
+			return error;
+		}
+
+		return Array< T >(values, count, deleter());
+	}
+};
+
+/// The base of a plugin implemented in C++ (see the top of this file)
+template< typename Derived > class Plugin {
+public:
+	/// The plugin object. Only valid between mumble_init and mumble_shutdown.
+	static Derived &instance() noexcept { return *s_instance; }
+
+	/// The API of the Mumble instance that loaded the plugin
+	static API api() noexcept { return API(s_api, s_pluginID); }
+
+	// The remaining members are used by the export macros
+
+	static void registerAPI(void *apiStruct) noexcept { s_api = MUMBLE_API_CAST(apiStruct); }
+
+	static mumble_error_t create(mumble_plugin_id_t pluginID) noexcept {
+		s_pluginID = pluginID;
+		try {
+			s_instance = new Derived();
+		} catch (...) {
+			return MUMBLE_EC_GENERIC_ERROR;
+		}
+
+		return MUMBLE_STATUS_OK;
+	}
+
+	static void destroy() noexcept {
+		delete s_instance;
+		s_instance = nullptr;
+	}
+
+	static MumbleStringWrapper wrap(std::string_view string) noexcept {
+		MumbleStringWrapper wrapper;
+		wrapper.data           = string.data();
+		wrapper.size           = string.size();
+		wrapper.needsReleasing = false;
+
+		return wrapper;
+	}
+
+private:
+	static inline MumbleAPI_v_1_0_x s_api{};
+	static inline mumble_plugin_id_t s_pluginID = 0;
+	static inline Derived *s_instance           = nullptr;
+};
+
+} // namespace mumble
+
+/// Exports the mandatory functions for the given plugin type, which needs a static std::string_view member called
+/// name. If the plugin returns strings with needsReleasing set, it also needs a static releaseResource function.
+#define MUMBLE_PLUGIN(Type)                                                                                       \
+	extern "C" {                                                                                                  \
+	PLUGIN_EXPORT mumble_error_t PLUGIN_CALLING_CONVENTION mumble_init(mumble_plugin_id_t id) {                   \
+		return ::mumble::Plugin< Type >::create(id);                                                              \
+	}                                                                                                             \
+	PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_shutdown() { ::mumble::Plugin< Type >::destroy(); }       \
+	PLUGIN_EXPORT struct MumbleStringWrapper PLUGIN_CALLING_CONVENTION mumble_getName() {                         \
+		return ::mumble::Plugin< Type >::wrap(Type::name);                                                        \
+	}                                                                                                             \
+	PLUGIN_EXPORT mumble_version_t PLUGIN_CALLING_CONVENTION mumble_getAPIVersion() {                             \
+		return MUMBLE_PLUGIN_API_VERSION;                                                                         \
+	}                                                                                                             \
+	PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_registerAPIFunctions(void *apiStruct) {                   \
+		::mumble::Plugin< Type >::registerAPI(apiStruct);                                                         \
+	}                                                                                                             \
+	PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_releaseResource(const void *pointer) {                    \
+		::mumble::detail::releaseResource< Type >(pointer);                                                       \
+	}                                                                                                             \
+	}
+
+/// Exports the given optional callback (e.g. onUserAdded) of the given plugin type
+#define MUMBLE_EXPORT(Type, callback) MUMBLE_EXPORT_##callback(Type)
+
+namespace mumble {
+namespace detail {
+	template< typename T, typename = void > struct HasReleaseResource : std::false_type {};
+	template< typename T >
+	struct HasReleaseResource< T, std::void_t< decltype(T::releaseResource(static_cast< const void * >(nullptr))) > >
+		: std::true_type {};
+
+	template< typename T > void releaseResource(const void *pointer) noexcept {
+		if constexpr (HasReleaseResource< T >::value) {
+			T::releaseResource(pointer);
+		} else {
+			// Only strings with needsReleasing set are handed back, which plugins without releaseResource never return
+			(void) pointer;
+		}
+	}
+} // namespace detail
+} // namespace mumble
+
+#define MUMBLE_INSTANCE(Type) ::mumble::Plugin< Type >::instance()
+
+#define MUMBLE_EXPORT_setMumbleInfo(Type)                                                                         \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_setMumbleInfo(                                 \
+		mumble_version_t mumbleVersion, mumble_version_t mumbleAPIVersion, mumble_version_t minimumAPIVersion) {  \
+		Type::setMumbleInfo(mumbleVersion, mumbleAPIVersion, minimumAPIVersion);                                  \
+	}
+
+#define MUMBLE_EXPORT_getVersion(Type) \
+	extern "C" PLUGIN_EXPORT mumble_version_t PLUGIN_CALLING_CONVENTION mumble_getVersion() { return Type::version; }
+
+#define MUMBLE_EXPORT_getAuthor(Type)                                                                             \
+	extern "C" PLUGIN_EXPORT struct MumbleStringWrapper PLUGIN_CALLING_CONVENTION mumble_getAuthor() {            \
+		return ::mumble::Plugin< Type >::wrap(Type::author);                                                      \
+	}
+
+#define MUMBLE_EXPORT_getDescription(Type)                                                                        \
+	extern "C" PLUGIN_EXPORT struct MumbleStringWrapper PLUGIN_CALLING_CONVENTION mumble_getDescription() {       \
+		return ::mumble::Plugin< Type >::wrap(Type::description);                                                 \
+	}
+
+#define MUMBLE_EXPORT_getFeatures(Type) \
+	extern "C" PLUGIN_EXPORT uint32_t PLUGIN_CALLING_CONVENTION mumble_getFeatures() { return Type::features; }
+
+#define MUMBLE_EXPORT_deactivateFeatures(Type)                                                                    \
+	extern "C" PLUGIN_EXPORT uint32_t PLUGIN_CALLING_CONVENTION mumble_deactivateFeatures(uint32_t features) {    \
+		return MUMBLE_INSTANCE(Type).deactivateFeatures(features);                                                \
+	}
+
+#define MUMBLE_EXPORT_initPositionalData(Type)                                                                    \
+	extern "C" PLUGIN_EXPORT uint8_t PLUGIN_CALLING_CONVENTION mumble_initPositionalData(                         \
+		const char *const *programNames, const uint64_t *programPIDs, size_t programCount) {                      \
+		return MUMBLE_INSTANCE(Type).initPositionalData(                                                          \
+			::mumble::Span< const char *const >(programNames, programCount),                                      \
+			::mumble::Span< const uint64_t >(programPIDs, programCount));                                         \
+	}
+
+#define MUMBLE_EXPORT_fetchPositionalData(Type)                                                                   \
+	extern "C" PLUGIN_EXPORT bool PLUGIN_CALLING_CONVENTION mumble_fetchPositionalData(                           \
+		float *avatarPos, float *avatarDir, float *avatarAxis, float *cameraPos, float *cameraDir,                \
+		float *cameraAxis, const char **context, const char **identity) {                                         \
+		return MUMBLE_INSTANCE(Type).fetchPositionalData(avatarPos, avatarDir, avatarAxis, cameraPos, cameraDir,  \
+														 cameraAxis, context, identity);                          \
+	}
+
+#define MUMBLE_EXPORT_shutdownPositionalData(Type)                                                                \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_shutdownPositionalData() {                     \
+		MUMBLE_INSTANCE(Type).shutdownPositionalData();                                                           \
+	}
+
+#define MUMBLE_EXPORT_onServerConnected(Type)                                                                     \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onServerConnected(                             \
+		mumble_connection_t connection) {                                                                         \
+		MUMBLE_INSTANCE(Type).onServerConnected(connection);                                                      \
+	}
+
+#define MUMBLE_EXPORT_onServerDisconnected(Type)                                                                  \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onServerDisconnected(                          \
+		mumble_connection_t connection) {                                                                         \
+		MUMBLE_INSTANCE(Type).onServerDisconnected(connection);                                                   \
+	}
+
+#define MUMBLE_EXPORT_onServerSynchronized(Type)                                                                  \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onServerSynchronized(                          \
+		mumble_connection_t connection) {                                                                         \
+		MUMBLE_INSTANCE(Type).onServerSynchronized(connection);                                                   \
+	}
+
+#define MUMBLE_EXPORT_onChannelEntered(Type)                                                                      \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onChannelEntered(                              \
+		mumble_connection_t connection, mumble_userid_t userID, mumble_channelid_t previousChannelID,             \
+		mumble_channelid_t newChannelID) {                                                                        \
+		MUMBLE_INSTANCE(Type).onChannelEntered(connection, userID, previousChannelID, newChannelID);              \
+	}
+
+#define MUMBLE_EXPORT_onChannelExited(Type)                                                                       \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onChannelExited(                               \
+		mumble_connection_t connection, mumble_userid_t userID, mumble_channelid_t channelID) {                   \
+		MUMBLE_INSTANCE(Type).onChannelExited(connection, userID, channelID);                                     \
+	}
+
+#define MUMBLE_EXPORT_onUserTalkingStateChanged(Type)                                                             \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onUserTalkingStateChanged(                     \
+		mumble_connection_t connection, mumble_userid_t userID, mumble_talking_state_t talkingState) {            \
+		MUMBLE_INSTANCE(Type).onUserTalkingStateChanged(connection, userID, talkingState);                        \
+	}
+
+// The audio callbacks receive the interleaved samples of all channels as a single span
+#define MUMBLE_EXPORT_onAudioInput(Type)                                                                          \
+	extern "C" PLUGIN_EXPORT bool PLUGIN_CALLING_CONVENTION mumble_onAudioInput(                                  \
+		short *inputPCM, uint32_t sampleCount, uint16_t channelCount, uint32_t sampleRate, bool isSpeech) {       \
+		return MUMBLE_INSTANCE(Type).onAudioInput(                                                                \
+			::mumble::Span< short >(inputPCM, (size_t) sampleCount * channelCount), channelCount, sampleRate,     \
+			isSpeech);                                                                                            \
+	}
+
+#define MUMBLE_EXPORT_onAudioSourceFetched(Type)                                                                  \
+	extern "C" PLUGIN_EXPORT bool PLUGIN_CALLING_CONVENTION mumble_onAudioSourceFetched(                          \
+		float *outputPCM, uint32_t sampleCount, uint16_t channelCount, uint32_t sampleRate, bool isSpeech,        \
+		mumble_userid_t userID) {                                                                                 \
+		return MUMBLE_INSTANCE(Type).onAudioSourceFetched(                                                        \
+			::mumble::Span< float >(outputPCM, (size_t) sampleCount * channelCount), channelCount, sampleRate,    \
+			isSpeech, userID);                                                                                    \
+	}
+
+#define MUMBLE_EXPORT_onAudioOutputAboutToPlay(Type)                                                              \
+	extern "C" PLUGIN_EXPORT bool PLUGIN_CALLING_CONVENTION mumble_onAudioOutputAboutToPlay(                      \
+		float *outputPCM, uint32_t sampleCount, uint16_t channelCount, uint32_t sampleRate) {                     \
+		return MUMBLE_INSTANCE(Type).onAudioOutputAboutToPlay(                                                    \
+			::mumble::Span< float >(outputPCM, (size_t) sampleCount * channelCount), channelCount, sampleRate);   \
+	}
+
+#define MUMBLE_EXPORT_onReceiveData(Type)                                                                         \
+	extern "C" PLUGIN_EXPORT bool PLUGIN_CALLING_CONVENTION mumble_onReceiveData(                                 \
+		mumble_connection_t connection, mumble_userid_t sender, const uint8_t *data, size_t dataLength,           \
+		const char *dataID) {                                                                                     \
+		return MUMBLE_INSTANCE(Type).onReceiveData(connection, sender,                                            \
+												   ::mumble::Span< const uint8_t >(data, dataLength),             \
+												   std::string_view(dataID));                                     \
+	}
+
+#define MUMBLE_EXPORT_onUserAdded(Type)                                                                           \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onUserAdded(mumble_connection_t connection,    \
+																			   mumble_userid_t userID) {          \
+		MUMBLE_INSTANCE(Type).onUserAdded(connection, userID);                                                    \
+	}
+
+#define MUMBLE_EXPORT_onUserRemoved(Type)                                                                         \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onUserRemoved(mumble_connection_t connection,  \
+																				 mumble_userid_t userID) {        \
+		MUMBLE_INSTANCE(Type).onUserRemoved(connection, userID);                                                  \
+	}
+
+#define MUMBLE_EXPORT_onChannelAdded(Type)                                                                        \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onChannelAdded(                                \
+		mumble_connection_t connection, mumble_channelid_t channelID) {                                           \
+		MUMBLE_INSTANCE(Type).onChannelAdded(connection, channelID);                                              \
+	}
+
+#define MUMBLE_EXPORT_onChannelRemoved(Type)                                                                      \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onChannelRemoved(                              \
+		mumble_connection_t connection, mumble_channelid_t channelID) {                                           \
+		MUMBLE_INSTANCE(Type).onChannelRemoved(connection, channelID);                                            \
+	}
+
+#define MUMBLE_EXPORT_onChannelRenamed(Type)                                                                      \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onChannelRenamed(                              \
+		mumble_connection_t connection, mumble_channelid_t channelID) {                                           \
+		MUMBLE_INSTANCE(Type).onChannelRenamed(connection, channelID);                                            \
+	}
+
+#define MUMBLE_EXPORT_onKeyEvent(Type)                                                                            \
+	extern "C" PLUGIN_EXPORT void PLUGIN_CALLING_CONVENTION mumble_onKeyEvent(uint32_t keyCode, bool wasPress) {  \
+		MUMBLE_INSTANCE(Type).onKeyEvent(keyCode, wasPress);                                                      \
+	}
+
+#define MUMBLE_EXPORT_hasUpdate(Type) \
+	extern "C" PLUGIN_EXPORT bool PLUGIN_CALLING_CONVENTION mumble_hasUpdate() { return Type::hasUpdate(); }
+
+#define MUMBLE_EXPORT_getUpdateDownloadURL(Type)                                                                  \
+	extern "C" PLUGIN_EXPORT struct MumbleStringWrapper PLUGIN_CALLING_CONVENTION mumble_getUpdateDownloadURL() { \
+		return Type::getUpdateDownloadURL();                                                                      \
+	}
+
+#endif // MUMBLE_PLUGIN_CPP_H_
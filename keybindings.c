@@ -0,0 +1,377 @@
+#include "keybindings.h"
+#include "memory.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KEY_COUNT (MUMBLE_KC_F19 + 1)
+#define MODIFIER_COMBINATIONS 64
+#define MAX_SEQUENCE_STATES 64
+#define MAX_STEPS 8
+
+#define MODIFIER_SHIFT (1 << 0)
+#define MODIFIER_CONTROL (1 << 1)
+#define MODIFIER_ALT (1 << 2)
+#define MODIFIER_ALT_GR (1 << 3)
+#define MODIFIER_META (1 << 4)
+#define MODIFIER_SUPER (1 << 5)
+
+// Table entries: 0 = nothing bound, > 0 = index of the action + 1, < 0 = -(index of the sequence state + 1)
+typedef int16_t entry_t;
+
+struct Transition {
+	uint8_t modifiers;
+	entry_t target;
+};
+
+// A state reached after the first step(s) of a sequence. Only one modifier combination per key is supported here,
+// which keeps the table small while lookups stay O(1).
+struct SequenceState {
+	struct Transition transitions[KEY_COUNT];
+};
+
+struct Step {
+	uint8_t modifiers;
+	uint16_t key;
+};
+
+struct KeyBindings {
+	entry_t root[MODIFIER_COMBINATIONS][KEY_COUNT];
+	struct SequenceState states[MAX_SEQUENCE_STATES];
+	size_t stateCount;
+	// The first keptActionCount actions are momentary actions whose key was still held when the bindings were cleared.
+	// They are only kept so that releasing the key undoes them.
+	struct KeyAction actions[2 * KEYBINDINGS_MAX_BINDINGS];
+	size_t actionCount;
+	size_t keptActionCount;
+
+	uint8_t heldModifiers;
+	int currentState;
+	uint64_t lastStepAt;
+	// The action triggered by pressing the respective key (needed for undoing momentary actions)
+	entry_t triggeredBy[KEY_COUNT];
+};
+
+static const struct {
+	const char *name;
+	uint16_t key;
+} namedKeys[] = {
+	{ "END", MUMBLE_KC_END },
+	{ "LEFT", MUMBLE_KC_LEFT },
+	{ "RIGHT", MUMBLE_KC_RIGHT },
+	{ "UP", MUMBLE_KC_UP },
+	{ "DOWN", MUMBLE_KC_DOWN },
+	{ "DELETE", MUMBLE_KC_DELETE },
+	{ "BACKSPACE", MUMBLE_KC_BACKSPACE },
+	{ "TAB", MUMBLE_KC_TAB },
+	{ "ENTER", MUMBLE_KC_ENTER },
+	{ "ESCAPE", MUMBLE_KC_ESCAPE },
+	{ "PAGE_UP", MUMBLE_KC_PAGE_UP },
+	{ "PAGE_DOWN", MUMBLE_KC_PAGE_DOWN },
+	{ "CAPSLOCK", MUMBLE_KC_CAPSLOCK },
+	{ "NUMLOCK", MUMBLE_KC_NUMLOCK },
+	{ "HOME", MUMBLE_KC_HOME },
+	{ "PRINT", MUMBLE_KC_PRINT },
+	{ "SCROLLLOCK", MUMBLE_KC_SCROLLLOCK },
+	{ "SPACE", MUMBLE_KC_SPACE },
+	{ "PLUS", MUMBLE_KC_PLUS },
+	{ "DEGREE_SIGN", MUMBLE_KC_DEGREE_SIGN },
+};
+
+static const struct {
+	const char *name;
+	uint8_t modifier;
+	uint16_t key;
+} modifiers[] = {
+	{ "SHIFT", MODIFIER_SHIFT, MUMBLE_KC_SHIFT },   { "CTRL", MODIFIER_CONTROL, MUMBLE_KC_CONTROL },
+	{ "CONTROL", MODIFIER_CONTROL, MUMBLE_KC_CONTROL }, { "ALT", MODIFIER_ALT, MUMBLE_KC_ALT },
+	{ "ALT_GR", MODIFIER_ALT_GR, MUMBLE_KC_ALT_GR },  { "META", MODIFIER_META, MUMBLE_KC_META },
+	{ "SUPER", MODIFIER_SUPER, MUMBLE_KC_SUPER },
+};
+
+
+static uint8_t modifierOfKey(uint32_t keyCode) {
+	for (size_t i = 0; i < sizeof(modifiers) / sizeof(modifiers[0]); i++) {
+		if (modifiers[i].key == keyCode) {
+			return modifiers[i].modifier;
+		}
+	}
+
+	return 0;
+}
+
+static bool parseKey(const char *token, size_t length, uint16_t *key) {
+	if (length == 1 && isprint((unsigned char) token[0])) {
+		*key = (uint16_t) toupper((unsigned char) token[0]);
+		return true;
+	}
+
+	if ((token[0] == 'F' || token[0] == 'f') && length <= 3 && isdigit((unsigned char) token[1])) {
+		char *end;
+		long number = strtol(token + 1, &end, 10);
+		// Reject tokens like "F1X"
+		if (end == token + length && number >= 1 && number <= MUMBLE_KC_F19 - MUMBLE_KC_F1 + 1) {
+			*key = (uint16_t)(MUMBLE_KC_F1 + number - 1);
+			return true;
+		}
+	}
+
+	for (size_t i = 0; i < sizeof(namedKeys) / sizeof(namedKeys[0]); i++) {
+		if (strlen(namedKeys[i].name) == length && strncmp(namedKeys[i].name, token, length) == 0) {
+			*key = namedKeys[i].key;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool parseModifier(const char *token, size_t length, uint8_t *modifier) {
+	for (size_t i = 0; i < sizeof(modifiers) / sizeof(modifiers[0]); i++) {
+		if (strlen(modifiers[i].name) == length && strncmp(modifiers[i].name, token, length) == 0) {
+			*modifier = modifiers[i].modifier;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Parses a single step such as "CTRL+SHIFT+F1"
+static bool parseStep(const char *begin, const char *end, struct Step *step) {
+	step->modifiers = 0;
+
+	for (;;) {
+		const char *separator = memchr(begin, '+', (size_t)(end - begin));
+		// A lone "+" (or a trailing one as in "CTRL++") refers to the plus key
+		if (!separator || separator == begin || separator + 1 == end) {
+			return parseKey(begin, (size_t)(end - begin), &step->key);
+		}
+
+		uint8_t modifier;
+		if (!parseModifier(begin, (size_t)(separator - begin), &modifier)) {
+			return false;
+		}
+		step->modifiers |= modifier;
+
+		begin = separator + 1;
+	}
+}
+
+static int parseSpec(const char *spec, struct Step *steps) {
+	int count = 0;
+
+	while (*spec) {
+		while (*spec == ' ') {
+			spec++;
+		}
+		if (!*spec) {
+			break;
+		}
+
+		const char *end = spec;
+		while (*end && *end != ' ') {
+			end++;
+		}
+
+		if (count == MAX_STEPS || !parseStep(spec, end, &steps[count])) {
+			return -1;
+		}
+		count++;
+
+		spec = end;
+	}
+
+	return count;
+}
+
+static void resetSequence(struct KeyBindings *bindings) {
+	bindings->currentState = -1;
+}
+
+
+struct KeyBindings *keybindings_create() {
+	struct KeyBindings *bindings = memory_calloc(MEMORY_KEYBINDINGS, 1, sizeof(struct KeyBindings));
+	if (bindings) {
+		resetSequence(bindings);
+	}
+
+	return bindings;
+}
+
+void keybindings_destroy(struct KeyBindings *bindings) {
+	memory_free(bindings);
+}
+
+bool keybindings_add(struct KeyBindings *bindings, const char *spec, const struct KeyAction *action) {
+	struct Step steps[MAX_STEPS];
+	int stepCount = parseSpec(spec, steps);
+	if (stepCount <= 0 || bindings->actionCount - bindings->keptActionCount == KEYBINDINGS_MAX_BINDINGS) {
+		return false;
+	}
+
+	// Verify first so that a conflicting binding doesn't leave half-compiled states behind
+	entry_t current = 0;
+	int step        = 0;
+	for (; step < stepCount; step++) {
+		entry_t next;
+		if (step == 0) {
+			next = bindings->root[steps[0].modifiers][steps[0].key];
+		} else {
+			const struct Transition *transition = &bindings->states[-current - 1].transitions[steps[step].key];
+			if (transition->target != 0 && transition->modifiers != steps[step].modifiers) {
+				return false;
+			}
+			next = transition->target;
+		}
+
+		if (next > 0 || (next < 0 && step == stepCount - 1)) {
+			// An existing binding is equal to or a prefix of this one or vice versa
+			return false;
+		}
+		if (next == 0) {
+			break;
+		}
+		current = next;
+	}
+
+	if ((size_t)(stepCount - 1 - step) > MAX_SEQUENCE_STATES - bindings->stateCount) {
+		return false;
+	}
+
+	bindings->actions[bindings->actionCount] = *action;
+	entry_t actionEntry                      = (entry_t)(bindings->actionCount + 1);
+	bindings->actionCount++;
+
+	for (; step < stepCount; step++) {
+		entry_t next;
+		if (step == stepCount - 1) {
+			next = actionEntry;
+		} else {
+			memset(&bindings->states[bindings->stateCount], 0, sizeof(struct SequenceState));
+			next = (entry_t) -(int) (bindings->stateCount + 1);
+			bindings->stateCount++;
+		}
+
+		if (step == 0) {
+			bindings->root[steps[0].modifiers][steps[0].key] = next;
+		} else {
+			struct Transition *transition = &bindings->states[-current - 1].transitions[steps[step].key];
+			transition->modifiers         = steps[step].modifiers;
+			transition->target            = next;
+		}
+
+		current = next;
+	}
+
+	return true;
+}
+
+void keybindings_clear(struct KeyBindings *bindings) {
+	memset(bindings->root, 0, sizeof(bindings->root));
+	bindings->stateCount = 0;
+
+	// Keys that are held down stay held down (as do modifiers), so the momentary actions they triggered are kept
+	// until they are released. Kept actions move towards the front in order, so none is overwritten before it's moved.
+	entry_t moved[2 * KEYBINDINGS_MAX_BINDINGS] = { 0 };
+	for (size_t key = 0; key < KEY_COUNT; key++) {
+		entry_t triggered = bindings->triggeredBy[key];
+		if (triggered > 0 && bindings->actions[triggered - 1].momentary) {
+			moved[triggered - 1] = 1;
+		}
+	}
+
+	size_t keptCount = 0;
+	for (size_t i = 0; i < bindings->actionCount; i++) {
+		if (moved[i] && keptCount < KEYBINDINGS_MAX_BINDINGS) {
+			bindings->actions[keptCount] = bindings->actions[i];
+			moved[i]                     = (entry_t)(++keptCount);
+		} else {
+			moved[i] = 0;
+		}
+	}
+
+	for (size_t key = 0; key < KEY_COUNT; key++) {
+		entry_t triggered          = bindings->triggeredBy[key];
+		bindings->triggeredBy[key] = triggered > 0 ? moved[triggered - 1] : 0;
+	}
+
+	bindings->actionCount     = keptCount;
+	bindings->keptActionCount = keptCount;
+	resetSequence(bindings);
+}
+
+const struct KeyAction *keybindings_onKeyEvent(struct KeyBindings *bindings, uint32_t keyCode, bool wasPress,
+											   uint64_t nowMs, bool *activate) {
+	if (keyCode >= KEY_COUNT) {
+		return NULL;
+	}
+
+	uint8_t modifier = modifierOfKey(keyCode);
+	if (modifier) {
+		if (wasPress) {
+			bindings->heldModifiers |= modifier;
+		} else {
+			bindings->heldModifiers &= (uint8_t) ~modifier;
+		}
+
+		return NULL;
+	}
+
+	if (!wasPress) {
+		entry_t triggered              = bindings->triggeredBy[keyCode];
+		bindings->triggeredBy[keyCode] = 0;
+
+		if (triggered > 0 && bindings->actions[triggered - 1].momentary) {
+			*activate = false;
+			return &bindings->actions[triggered - 1];
+		}
+
+		return NULL;
+	}
+
+	// Key repeat doesn't trigger a momentary action again while its key is held down
+	entry_t held = bindings->triggeredBy[keyCode];
+	if (held > 0 && bindings->actions[held - 1].momentary) {
+		return NULL;
+	}
+
+	if (bindings->currentState >= 0 && nowMs - bindings->lastStepAt > KEYBINDINGS_SEQUENCE_TIMEOUT_MS) {
+		resetSequence(bindings);
+	}
+
+	entry_t entry = 0;
+	if (bindings->currentState >= 0) {
+		const struct Transition *transition = &bindings->states[bindings->currentState].transitions[keyCode];
+		if (transition->modifiers == bindings->heldModifiers) {
+			entry = transition->target;
+		}
+
+		if (entry == 0) {
+			// The sequence has been broken -> this key might start another binding
+			resetSequence(bindings);
+		}
+	}
+
+	if (bindings->currentState < 0 && entry == 0) {
+		entry = bindings->root[bindings->heldModifiers][keyCode];
+	}
+
+	if (entry < 0) {
+		bindings->currentState = -entry - 1;
+		bindings->lastStepAt   = nowMs;
+		return NULL;
+	}
+
+	resetSequence(bindings);
+
+	if (entry == 0) {
+		return NULL;
+	}
+
+	bindings->triggeredBy[keyCode] = entry;
+	*activate                      = true;
+
+	return &bindings->actions[entry - 1];
+}
@@ -0,0 +1,84 @@
+/// This header file declares the key-binding engine that maps key events to plugin actions.
+///
+/// Bindings are given as strings and compiled into lookup tables right away, so that handling a key event is a
+/// single table lookup regardless of how many bindings exist. A binding consists of one or more steps separated by
+/// spaces. Each step is a key optionally preceded by modifiers, e.g. "CTRL+SHIFT+F1" (a chord) or "G G" (a
+/// sequence: G pressed twice within KEYBINDINGS_SEQUENCE_TIMEOUT_MS).
+///
+/// Keys are named like their Mumble_KeyCode without the MUMBLE_KC_ prefix (e.g. "SPACE", "F5", "PAGE_UP") or given as
+/// a single printable character (e.g. "G", "5", "#"). The modifiers SHIFT, CTRL, ALT, ALT_GR, META and SUPER can't be
+/// triggers on their own.
+///
+/// NOTE: The engine doesn't execute any actions itself. keybindings_onKeyEvent returns the action that has been
+/// triggered and it is up to the caller to perform it.
+
+#ifndef MUMBLE_PLUGIN_KEYBINDINGS_H_
+#define MUMBLE_PLUGIN_KEYBINDINGS_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/// The time after which a started sequence is abandoned
+#define KEYBINDINGS_SEQUENCE_TIMEOUT_MS 1000
+/// The maximum amount of bindings
+#define KEYBINDINGS_MAX_BINDINGS 128
+/// The maximum length of an action's string argument (including the terminating null byte)
+#define KEYBINDINGS_MAX_ARGUMENT 256
+
+enum KeyActionType {
+	/// Switch the local user's transmission mode (to transmissionMode)
+	KEY_ACTION_TRANSMISSION_MODE,
+	/// Move the local user into the channel whose name is given as argument
+	KEY_ACTION_MOVE_TO_CHANNEL,
+	/// Play the sample whose path is given as argument (locally only)
+	KEY_ACTION_PLAY_SAMPLE,
+	/// Mix the soundboard clip whose name is given as argument into the outgoing audio
+	KEY_ACTION_SOUNDBOARD,
+	/// Toggle the local user's self-mute
+	KEY_ACTION_SELF_MUTE,
+	/// An action that is implemented by the plugin itself (identified by customID)
+	KEY_ACTION_CUSTOM,
+};
+
+struct KeyAction {
+	enum KeyActionType type;
+	/// Whether the action is undone once the (last) key of the binding is released again. A momentary
+	/// KEY_ACTION_TRANSMISSION_MODE for instance restores the previous mode on release.
+	bool momentary;
+	mumble_transmission_mode_t transmissionMode;
+	int customID;
+	char argument[KEYBINDINGS_MAX_ARGUMENT];
+};
+
+struct KeyBindings;
+
+/// @returns A new engine without any bindings or NULL if allocating it failed
+struct KeyBindings *keybindings_create();
+
+void keybindings_destroy(struct KeyBindings *bindings);
+
+/// Compiles the given binding into the engine's lookup tables
+///
+/// @param spec The binding (see above)
+/// @param action The action to trigger. It is copied.
+/// @returns Whether the binding has been added. This fails if the spec can't be parsed, if it conflicts with an
+/// existing binding (same keys or one being the prefix of the other) or if there's no space for it.
+bool keybindings_add(struct KeyBindings *bindings, const char *spec, const struct KeyAction *action);
+
+/// Removes all bindings. Keys and modifiers that are held down stay so, i.e. releasing a key still undoes the momentary
+/// action it triggered before the bindings were cleared.
+void keybindings_clear(struct KeyBindings *bindings);
+
+/// Processes a key event (see mumble_onKeyEvent). Repeated presses of a key that is held down (key repeat) don't
+/// trigger its momentary action again.
+///
+/// @param nowMs The current time in milliseconds (monotonic)
+/// @param[out] activate Whether the returned action shall be performed (true) or undone (false, only for momentary
+/// actions)
+/// @returns The triggered action or NULL if the event didn't trigger anything
+const struct KeyAction *keybindings_onKeyEvent(struct KeyBindings *bindings, uint32_t keyCode, bool wasPress,
+											   uint64_t nowMs, bool *activate);
+
+#endif // MUMBLE_PLUGIN_KEYBINDINGS_H_
@@ -0,0 +1,750 @@
+#include "logger.h"
+#include "memory.h"
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if (LOGGER_RING_SIZE & (LOGGER_RING_SIZE - 1)) != 0
+#	error "LOGGER_RING_SIZE has to be a power of two"
+#endif
+
+// The amount of sites that can hold back repetitions at the same time
+#define MAX_PENDING 32
+// The longest flags, width and precision part of a conversion specification that is supported
+#define MAX_SPEC_PREFIX 16
+#define NO_ARGUMENT 0xff
+
+enum SiteState { SITE_UNPARSED, SITE_PARSING, SITE_PARSED, SITE_INVALID };
+
+// An argument type is an ArgumentKind in the upper and an ArgumentLength (the length modifier) in the lower half
+enum ArgumentKind {
+	ARGUMENT_SIGNED,
+	ARGUMENT_UNSIGNED,
+	ARGUMENT_DOUBLE,
+	ARGUMENT_CHAR,
+	ARGUMENT_STRING,
+	ARGUMENT_POINTER,
+};
+enum ArgumentLength { LENGTH_NONE, LENGTH_HH, LENGTH_H, LENGTH_L, LENGTH_LL, LENGTH_Z, LENGTH_J, LENGTH_T };
+
+enum RingState { RING_FREE, RING_OWNED, RING_ABANDONED };
+
+union LogArgument {
+	int64_t i;
+	uint64_t u;
+	double d;
+	const void *p;
+	// The position of a string in the record's strings
+	size_t offset;
+};
+
+struct LogRecord {
+	struct LogSite *site;
+	uint64_t timeMs;
+	// The amount of messages from the same site that have been dropped by the rate limit before this one
+	uint32_t suppressed;
+	union LogArgument arguments[LOGGER_MAX_ARGUMENTS];
+	char strings[LOGGER_MAX_STRINGS];
+};
+
+// A single-producer single-consumer ring, written by the thread that owns it and read by the drainer
+struct LogRing {
+	atomic_int state;
+	alignas(64) atomic_size_t tail;
+	alignas(64) atomic_size_t head;
+	struct LogRecord records[LOGGER_RING_SIZE];
+};
+
+// A message whose repetitions are being counted instead of being output
+struct PendingRepeat {
+	struct LogSite *site;
+	uint32_t repeats;
+	char message[LOGGER_MAX_MESSAGE];
+};
+
+struct Logger {
+	LoggerSinkFunction sink;
+	void *userData;
+	// Tells the thread-local ring pointers (and the sites' deduplication state) of different loggers apart
+	uint64_t generation;
+	pthread_key_t threadKey;
+	// Messages that have been lost because a ring was full or no ring was left
+	atomic_uint_least64_t dropped;
+
+	// Only accessed by the drainer
+	struct PendingRepeat pending[MAX_PENDING];
+	FILE *file;
+	char *filePath;
+	size_t fileSize;
+	size_t maxFileSize;
+	unsigned int maxFiles;
+
+	struct LogRing rings[LOGGER_MAX_THREADS];
+};
+
+static atomic_uint_least64_t nextGeneration = 1;
+
+static _Thread_local struct LogRing *threadRing;
+static _Thread_local uint64_t threadGeneration;
+
+static const char *levelNames[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+
+
+static uint64_t currentTimeMs() {
+	struct timespec now;
+#ifdef CLOCK_REALTIME_COARSE
+	// Milliseconds are all that's needed and the coarse clock is considerably cheaper to read
+	clock_gettime(CLOCK_REALTIME_COARSE, &now);
+#else
+	timespec_get(&now, TIME_UTC);
+#endif
+
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+
+////////////////////////////////// Formats //////////////////////////////////
+
+static bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+// Parses the conversion specification starting at the given '%'
+//
+// @param[out] type The type of the argument it consumes (NO_ARGUMENT for "%%")
+// @param[out] prefixLength The length of the '%', flags, width and precision
+// @returns The character following the specification or NULL if it isn't supported
+static const char *parseConversion(const char *spec, uint8_t *type, size_t *prefixLength) {
+	const char *c = spec + 1;
+	if (*c == '%') {
+		*type         = NO_ARGUMENT;
+		*prefixLength = 1;
+		return c + 1;
+	}
+
+	while (*c == '-' || *c == '+' || *c == ' ' || *c == '#' || *c == '0') {
+		c++;
+	}
+	while (isDigit(*c)) {
+		c++;
+	}
+	if (*c == '.') {
+		c++;
+		while (isDigit(*c)) {
+			c++;
+		}
+	}
+
+	*prefixLength = (size_t) (c - spec);
+	if (*prefixLength > MAX_SPEC_PREFIX) {
+		return NULL;
+	}
+
+	enum ArgumentLength length = LENGTH_NONE;
+	if (c[0] == 'h' && c[1] == 'h') {
+		length = LENGTH_HH;
+		c += 2;
+	} else if (c[0] == 'l' && c[1] == 'l') {
+		length = LENGTH_LL;
+		c += 2;
+	} else if (*c == 'h' || *c == 'l' || *c == 'z' || *c == 'j' || *c == 't') {
+		length = *c == 'h' ? LENGTH_H : *c == 'l' ? LENGTH_L : *c == 'z' ? LENGTH_Z : *c == 'j' ? LENGTH_J : LENGTH_T;
+		c++;
+	}
+
+	enum ArgumentKind kind;
+	switch (*c) {
+		case 'd':
+		case 'i':
+			kind = ARGUMENT_SIGNED;
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			kind = ARGUMENT_UNSIGNED;
+			break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			// %lf is a double as well
+			if (length != LENGTH_NONE && length != LENGTH_L) {
+				return NULL;
+			}
+			kind = ARGUMENT_DOUBLE;
+			break;
+		case 'c':
+		case 's':
+		case 'p':
+			if (length != LENGTH_NONE) {
+				return NULL;
+			}
+			kind = *c == 'c' ? ARGUMENT_CHAR : *c == 's' ? ARGUMENT_STRING : ARGUMENT_POINTER;
+			break;
+		default:
+			// Including '*' widths, %n and the end of the format
+			return NULL;
+	}
+
+	*type = (uint8_t) (kind << 4 | length);
+
+	return c + 1;
+}
+
+static bool parseFormat(const char *format, uint8_t *types, uint8_t *count) {
+	*count = 0;
+
+	for (const char *c = format; *c != '\0';) {
+		if (*c != '%') {
+			c++;
+			continue;
+		}
+
+		uint8_t type;
+		size_t prefixLength;
+		c = parseConversion(c, &type, &prefixLength);
+		if (!c) {
+			return false;
+		}
+		if (type != NO_ARGUMENT) {
+			if (*count == LOGGER_MAX_ARGUMENTS) {
+				return false;
+			}
+			types[(*count)++] = type;
+		}
+	}
+
+	return true;
+}
+
+// Returns the argument types of the given site (NULL if its format isn't supported), parsing its format on first use
+static const uint8_t *siteArguments(struct LogSite *site, uint8_t *scratch, uint8_t *count) {
+	int state = atomic_load_explicit(&site->state, memory_order_acquire);
+
+	if (state == SITE_UNPARSED
+		&& atomic_compare_exchange_strong_explicit(&site->state, &state, SITE_PARSING, memory_order_acquire,
+												   memory_order_acquire)) {
+		state = parseFormat(site->format, site->argumentTypes, &site->argumentCount) ? SITE_PARSED : SITE_INVALID;
+		atomic_store_explicit(&site->state, state, memory_order_release);
+	}
+
+	switch (state) {
+		case SITE_PARSED:
+			*count = site->argumentCount;
+			return site->argumentTypes;
+		case SITE_INVALID:
+			return NULL;
+		default:
+			// Another thread is parsing it right now
+			return parseFormat(site->format, scratch, count) ? scratch : NULL;
+	}
+}
+
+
+////////////////////////////////// Writing //////////////////////////////////
+
+static void abandonRing(void *ring) {
+	atomic_store_explicit(&((struct LogRing *) ring)->state, RING_ABANDONED, memory_order_release);
+}
+
+static struct LogRing *claimRing(struct Logger *logger) {
+	if (threadRing && threadGeneration == logger->generation) {
+		return threadRing;
+	}
+
+	for (size_t i = 0; i < LOGGER_MAX_THREADS; i++) {
+		struct LogRing *ring = &logger->rings[i];
+		int expected         = RING_FREE;
+		if (atomic_compare_exchange_strong_explicit(&ring->state, &expected, RING_OWNED, memory_order_acquire,
+													memory_order_relaxed)) {
+			threadRing       = ring;
+			threadGeneration = logger->generation;
+			// Hands the ring back once the thread exits
+			pthread_setspecific(logger->threadKey, ring);
+
+			return ring;
+		}
+	}
+
+	return NULL;
+}
+
+// Rate limits the given site
+//
+// @param[out] suppressed The amount of messages that have been suppressed since the last one that was let through
+// @returns Whether the message may be logged
+static bool admit(struct LogSite *site, uint64_t nowMs, uint32_t *suppressed) {
+	uint64_t windowStart = atomic_load_explicit(&site->windowStart, memory_order_relaxed);
+	if (nowMs - windowStart >= LOGGER_RATE_WINDOW_MS
+		&& atomic_compare_exchange_strong_explicit(&site->windowStart, &windowStart, nowMs, memory_order_relaxed,
+												   memory_order_relaxed)) {
+		atomic_store_explicit(&site->windowCount, 0, memory_order_relaxed);
+	}
+
+	if (atomic_fetch_add_explicit(&site->windowCount, 1, memory_order_relaxed) >= LOGGER_RATE_LIMIT) {
+		atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+		return false;
+	}
+
+	*suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+
+	return true;
+}
+
+static void copyString(struct LogRecord *record, size_t *used, const char *string, union LogArgument *argument) {
+	if (!string) {
+		string = "(null)";
+	}
+
+	if (*used == LOGGER_MAX_STRINGS) {
+		// Out of space -> point to the previous string's terminator
+		argument->offset = LOGGER_MAX_STRINGS - 1;
+		return;
+	}
+
+	argument->offset = *used;
+	while (*string != '\0' && *used < LOGGER_MAX_STRINGS - 1) {
+		record->strings[(*used)++] = *string++;
+	}
+	record->strings[(*used)++] = '\0';
+}
+
+void logger_write(struct Logger *logger, struct LogSite *site, const char *format, ...) {
+	(void) format;
+
+	if (!logger) {
+		return;
+	}
+
+	uint64_t nowMs = currentTimeMs();
+	uint32_t suppressed;
+	if (!admit(site, nowMs, &suppressed)) {
+		return;
+	}
+
+	struct LogRing *ring = claimRing(logger);
+	size_t tail          = ring ? atomic_load_explicit(&ring->tail, memory_order_relaxed) : 0;
+	if (!ring || tail - atomic_load_explicit(&ring->head, memory_order_acquire) == LOGGER_RING_SIZE) {
+		atomic_fetch_add_explicit(&logger->dropped, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&site->suppressed, suppressed, memory_order_relaxed);
+		return;
+	}
+
+	struct LogRecord *record = &ring->records[tail & (LOGGER_RING_SIZE - 1)];
+	record->site             = site;
+	record->timeMs           = nowMs;
+	record->suppressed       = suppressed;
+
+	uint8_t scratch[LOGGER_MAX_ARGUMENTS];
+	uint8_t count        = 0;
+	const uint8_t *types = siteArguments(site, scratch, &count);
+	size_t stringsUsed   = 0;
+
+	va_list arguments;
+	va_start(arguments, format);
+	for (uint8_t i = 0; types && i < count; i++) {
+		union LogArgument *argument = &record->arguments[i];
+
+		switch (types[i]) {
+			case ARGUMENT_SIGNED << 4 | LENGTH_NONE:
+				argument->i = va_arg(arguments, int);
+				break;
+			case ARGUMENT_SIGNED << 4 | LENGTH_HH:
+				argument->i = (signed char) va_arg(arguments, int);
+				break;
+			case ARGUMENT_SIGNED << 4 | LENGTH_H:
+				argument->i = (short) va_arg(arguments, int);
+				break;
+			case ARGUMENT_SIGNED << 4 | LENGTH_L:
+				argument->i = va_arg(arguments, long);
+				break;
+			case ARGUMENT_SIGNED << 4 | LENGTH_LL:
+				argument->i = va_arg(arguments, long long);
+				break;
+			case ARGUMENT_SIGNED << 4 | LENGTH_Z:
+				argument->i = (ptrdiff_t) va_arg(arguments, size_t);
+				break;
+			case ARGUMENT_SIGNED << 4 | LENGTH_J:
+				argument->i = va_arg(arguments, intmax_t);
+				break;
+			case ARGUMENT_SIGNED << 4 | LENGTH_T:
+				argument->i = va_arg(arguments, ptrdiff_t);
+				break;
+			case ARGUMENT_UNSIGNED << 4 | LENGTH_NONE:
+				argument->u = va_arg(arguments, unsigned int);
+				break;
+			case ARGUMENT_UNSIGNED << 4 | LENGTH_HH:
+				argument->u = (unsigned char) va_arg(arguments, unsigned int);
+				break;
+			case ARGUMENT_UNSIGNED << 4 | LENGTH_H:
+				argument->u = (unsigned short) va_arg(arguments, unsigned int);
+				break;
+			case ARGUMENT_UNSIGNED << 4 | LENGTH_L:
+				argument->u = va_arg(arguments, unsigned long);
+				break;
+			case ARGUMENT_UNSIGNED << 4 | LENGTH_LL:
+				argument->u = va_arg(arguments, unsigned long long);
+				break;
+			case ARGUMENT_UNSIGNED << 4 | LENGTH_Z:
+				argument->u = va_arg(arguments, size_t);
+				break;
+			case ARGUMENT_UNSIGNED << 4 | LENGTH_J:
+				argument->u = va_arg(arguments, uintmax_t);
+				break;
+			case ARGUMENT_UNSIGNED << 4 | LENGTH_T:
+				argument->u = (size_t) va_arg(arguments, ptrdiff_t);
+				break;
+			case ARGUMENT_DOUBLE << 4 | LENGTH_NONE:
+			case ARGUMENT_DOUBLE << 4 | LENGTH_L:
+				argument->d = va_arg(arguments, double);
+				break;
+			case ARGUMENT_CHAR << 4:
+				argument->i = va_arg(arguments, int);
+				break;
+			case ARGUMENT_STRING << 4:
+				copyString(record, &stringsUsed, va_arg(arguments, const char *), argument);
+				break;
+			case ARGUMENT_POINTER << 4:
+				argument->p = va_arg(arguments, void *);
+				break;
+		}
+	}
+	va_end(arguments);
+
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+
+////////////////////////////////// Draining //////////////////////////////////
+
+static void formatRecord(const struct LogRecord *record, char *message) {
+	uint8_t scratch[LOGGER_MAX_ARGUMENTS];
+	uint8_t count        = 0;
+	const uint8_t *types = siteArguments(record->site, scratch, &count);
+	if (!types) {
+		snprintf(message, LOGGER_MAX_MESSAGE, "%s (unsupported format)", record->site->format);
+		return;
+	}
+
+	size_t used     = 0;
+	size_t argument = 0;
+	for (const char *c = record->site->format; *c != '\0' && used < LOGGER_MAX_MESSAGE - 1;) {
+		if (*c != '%') {
+			message[used++] = *c++;
+			continue;
+		}
+
+		uint8_t type;
+		size_t prefixLength;
+		const char *next = parseConversion(c, &type, &prefixLength);
+		if (type == NO_ARGUMENT) {
+			message[used++] = '%';
+			c               = next;
+			continue;
+		}
+
+		// The specification is rebuilt with the length modifier matching the type the argument has been stored as
+		char spec[MAX_SPEC_PREFIX + 4];
+		memcpy(spec, c, prefixLength);
+		size_t length = prefixLength;
+		if ((type >> 4) == ARGUMENT_SIGNED || (type >> 4) == ARGUMENT_UNSIGNED) {
+			spec[length++] = 'l';
+			spec[length++] = 'l';
+		}
+		spec[length++] = next[-1];
+		spec[length]   = '\0';
+
+		const union LogArgument *value = &record->arguments[argument++];
+		char *output                   = message + used;
+		size_t available               = LOGGER_MAX_MESSAGE - used;
+		int written                    = 0;
+		switch (type >> 4) {
+			case ARGUMENT_SIGNED:
+				written = snprintf(output, available, spec, (long long) value->i);
+				break;
+			case ARGUMENT_UNSIGNED:
+				written = snprintf(output, available, spec, (unsigned long long) value->u);
+				break;
+			case ARGUMENT_DOUBLE:
+				written = snprintf(output, available, spec, value->d);
+				break;
+			case ARGUMENT_CHAR:
+				written = snprintf(output, available, spec, (int) value->i);
+				break;
+			case ARGUMENT_STRING:
+				written = snprintf(output, available, spec, record->strings + value->offset);
+				break;
+			case ARGUMENT_POINTER:
+				written = snprintf(output, available, spec, value->p);
+				break;
+		}
+
+		if (written > 0) {
+			used += (size_t) written < available ? (size_t) written : available - 1;
+		}
+		c = next;
+	}
+	message[used] = '\0';
+
+	if (record->suppressed > 0) {
+		snprintf(message + used, LOGGER_MAX_MESSAGE - used, " (%u similar messages suppressed)", record->suppressed);
+	}
+}
+
+static uint64_t hashMessage(const char *message) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325u;
+	for (; *message != '\0'; message++) {
+		hash = (hash ^ (unsigned char) *message) * 0x100000001b3u;
+	}
+
+	return hash;
+}
+
+static void rotateFile(struct Logger *logger) {
+	fclose(logger->file);
+
+	char from[4096];
+	char to[4096];
+	for (unsigned int i = logger->maxFiles; i > 0; i--) {
+		if (i == 1) {
+			snprintf(from, sizeof(from), "%s", logger->filePath);
+		} else {
+			snprintf(from, sizeof(from), "%s.%u", logger->filePath, i - 1);
+		}
+		snprintf(to, sizeof(to), "%s.%u", logger->filePath, i);
+
+		// rename doesn't replace existing files on Windows
+		remove(to);
+		rename(from, to);
+	}
+
+	logger->file     = fopen(logger->filePath, "w");
+	logger->fileSize = 0;
+}
+
+static void writeFile(struct Logger *logger, enum LogLevel level, const char *message, uint64_t timeMs) {
+	time_t seconds = (time_t) (timeMs / 1000);
+	struct tm local;
+#ifndef _WIN32
+	localtime_r(&seconds, &local);
+#else
+	localtime_s(&local, &seconds);
+#endif
+	char timestamp[32];
+	strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &local);
+
+	char line[LOGGER_MAX_MESSAGE + 64];
+	int length = snprintf(line, sizeof(line), "%s.%03u %-7s %s\n", timestamp, (unsigned int) (timeMs % 1000),
+						  levelNames[level], message);
+	if (length <= 0) {
+		return;
+	}
+	if ((size_t) length >= sizeof(line)) {
+		length = sizeof(line) - 1;
+	}
+
+	if (logger->fileSize > 0 && logger->fileSize + (size_t) length > logger->maxFileSize) {
+		rotateFile(logger);
+		if (!logger->file) {
+			return;
+		}
+	}
+
+	fwrite(line, 1, (size_t) length, logger->file);
+	logger->fileSize += (size_t) length;
+}
+
+static void output(struct Logger *logger, enum LogLevel level, const char *message, uint64_t timeMs) {
+	logger->sink(logger->userData, level, message);
+
+	if (logger->file) {
+		writeFile(logger, level, message, timeMs);
+	}
+}
+
+static void flushRepeats(struct Logger *logger, struct LogSite *site, uint64_t nowMs) {
+	if (site->pending == 0) {
+		return;
+	}
+
+	struct PendingRepeat *pending = &logger->pending[site->pending - 1];
+	char message[LOGGER_MAX_MESSAGE + 48];
+	snprintf(message, sizeof(message), "%s (repeated %u more times)", pending->message, pending->repeats);
+	output(logger, site->level, message, nowMs);
+
+	pending->site = NULL;
+	site->pending = 0;
+}
+
+static void drainRecord(struct Logger *logger, const struct LogRecord *record) {
+	struct LogSite *site = record->site;
+	if (site->generation != logger->generation) {
+		// First message from this site since the logger has been created
+		site->generation = logger->generation;
+		site->lastHash   = 0;
+		site->lastTimeMs = 0;
+		site->pending    = 0;
+	}
+
+	char message[LOGGER_MAX_MESSAGE];
+	formatRecord(record, message);
+	uint64_t hash = hashMessage(message);
+
+	if (hash == site->lastHash && record->timeMs - site->lastTimeMs < LOGGER_REPEAT_WINDOW_MS) {
+		if (site->pending != 0) {
+			logger->pending[site->pending - 1].repeats++;
+			return;
+		}
+
+		for (size_t i = 0; i < MAX_PENDING; i++) {
+			if (!logger->pending[i].site) {
+				logger->pending[i].site    = site;
+				logger->pending[i].repeats = 1;
+				memcpy(logger->pending[i].message, message, sizeof(message));
+				site->pending = (uint8_t) (i + 1);
+				return;
+			}
+		}
+		// Too many repeating sites -> simply output it
+	}
+
+	flushRepeats(logger, site, record->timeMs);
+	site->lastHash   = hash;
+	site->lastTimeMs = record->timeMs;
+
+	output(logger, site->level, message, record->timeMs);
+}
+
+size_t logger_drain(struct Logger *logger, uint64_t nowMs) {
+	size_t count = 0;
+
+	for (size_t i = 0; i < LOGGER_MAX_THREADS; i++) {
+		struct LogRing *ring = &logger->rings[i];
+		int state            = atomic_load_explicit(&ring->state, memory_order_acquire);
+		if (state == RING_FREE) {
+			continue;
+		}
+
+		size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+		size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		for (; head != tail; head++, count++) {
+			drainRecord(logger, &ring->records[head & (LOGGER_RING_SIZE - 1)]);
+			atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+		}
+
+		if (state == RING_ABANDONED) {
+			// The thread that owned it has exited, so nothing can have been added in the meantime
+			atomic_store_explicit(&ring->state, RING_FREE, memory_order_release);
+		}
+	}
+
+	uint64_t dropped = atomic_exchange_explicit(&logger->dropped, 0, memory_order_relaxed);
+	if (dropped > 0) {
+		char message[64];
+		snprintf(message, sizeof(message), "Dropped %llu log messages", (unsigned long long) dropped);
+		output(logger, LOG_LEVEL_WARNING, message, nowMs);
+	}
+
+	for (size_t i = 0; i < MAX_PENDING; i++) {
+		struct LogSite *site = logger->pending[i].site;
+		if (site && nowMs - site->lastTimeMs >= LOGGER_REPEAT_WINDOW_MS) {
+			flushRepeats(logger, site, nowMs);
+		}
+	}
+
+	if (logger->file) {
+		fflush(logger->file);
+	}
+
+	return count;
+}
+
+
+struct Logger *logger_create(LoggerSinkFunction sink, void *userData) {
+	struct Logger *logger = memory_allocLarge(MEMORY_LOGGER, sizeof(struct Logger));
+	if (!logger) {
+		return NULL;
+	}
+
+	if (pthread_key_create(&logger->threadKey, &abandonRing) != 0) {
+		memory_freeLarge(logger);
+		return NULL;
+	}
+
+	logger->sink       = sink;
+	logger->userData   = userData;
+	logger->generation = atomic_fetch_add(&nextGeneration, 1);
+	atomic_init(&logger->dropped, 0);
+	for (size_t i = 0; i < LOGGER_MAX_THREADS; i++) {
+		atomic_init(&logger->rings[i].state, RING_FREE);
+		atomic_init(&logger->rings[i].tail, 0);
+		atomic_init(&logger->rings[i].head, 0);
+	}
+
+	return logger;
+}
+
+void logger_destroy(struct Logger *logger) {
+	if (!logger) {
+		return;
+	}
+
+	uint64_t now = currentTimeMs();
+	logger_drain(logger, now);
+	for (size_t i = 0; i < MAX_PENDING; i++) {
+		if (logger->pending[i].site) {
+			flushRepeats(logger, logger->pending[i].site, now);
+		}
+	}
+
+	logger_setFile(logger, NULL, 0, 0);
+	// Threads that exit from now on don't call back into the (possibly unloaded) logger anymore
+	pthread_key_delete(logger->threadKey);
+
+	memory_freeLarge(logger);
+}
+
+bool logger_setFile(struct Logger *logger, const char *path, size_t maxSize, unsigned int maxFiles) {
+	if (logger->file) {
+		fclose(logger->file);
+		logger->file = NULL;
+	}
+	memory_free(logger->filePath);
+	logger->filePath = NULL;
+
+	if (!path) {
+		return true;
+	}
+
+	logger->filePath = memory_alloc(MEMORY_LOGGER, strlen(path) + 1);
+	if (!logger->filePath) {
+		return false;
+	}
+	strcpy(logger->filePath, path);
+
+	logger->file = fopen(path, "a");
+	if (!logger->file) {
+		memory_free(logger->filePath);
+		logger->filePath = NULL;
+
+		return false;
+	}
+
+	fseek(logger->file, 0, SEEK_END);
+	long size           = ftell(logger->file);
+	logger->fileSize    = size > 0 ? (size_t) size : 0;
+	logger->maxFileSize = maxSize;
+	logger->maxFiles    = maxFiles;
+
+	return true;
+}
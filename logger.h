@@ -0,0 +1,121 @@
+/// This header file declares the plugin's logger.
+///
+/// mumbleAPI.log blocks until Mumble's main thread gets to it, so it must not be called from audio callbacks, and
+/// anything that logs per packet or per frame would flood Mumble's console. Instead, the LOG_* macros put a record
+/// into a lock-free ring owned by the calling thread. The record only holds the call site and the raw arguments:
+/// Formatting happens later on, when a single drainer (logger_drain) takes the records out of all rings and hands the
+/// messages to the sink (usually mumbleAPI.log) and, optionally, to a rotating log file.
+///
+/// Every call site is rate limited on its own: Beyond LOGGER_RATE_LIMIT messages per LOGGER_RATE_WINDOW_MS, messages
+/// are only counted and the next message that makes it through reports how many have been suppressed. Repetitions of
+/// the same message from the same site are collapsed into a single "repeated" line as well.
+///
+///     LOG_WARNING(logger, "Dropped packet from user %u (%zu bytes)", userID, length);
+///
+/// The supported conversions are those of printf except for '*' widths and precisions, %n and long doubles. At most
+/// LOGGER_MAX_ARGUMENTS arguments can be passed and strings passed for %s are copied (up to LOGGER_MAX_STRINGS bytes
+/// for all of them). Writing never blocks, never allocates and may be done from any thread, including audio threads.
+
+#ifndef MUMBLE_PLUGIN_LOGGER_H_
+#define MUMBLE_PLUGIN_LOGGER_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The maximum amount of threads that may have logged something at the same time
+#define LOGGER_MAX_THREADS 32
+/// The amount of records every thread can have waiting to be drained (a power of two)
+#define LOGGER_RING_SIZE 256
+#define LOGGER_MAX_ARGUMENTS 8
+/// The space for copies of %s arguments in every record (including their terminators)
+#define LOGGER_MAX_STRINGS 64
+/// The maximum length of a formatted message (including the terminator)
+#define LOGGER_MAX_MESSAGE 512
+#define LOGGER_RATE_LIMIT 10
+#define LOGGER_RATE_WINDOW_MS 1000
+/// How long a repeated message may be held back before the amount of repetitions is reported
+#define LOGGER_REPEAT_WINDOW_MS 10000
+
+enum LogLevel { LOG_LEVEL_DEBUG, LOG_LEVEL_INFO, LOG_LEVEL_WARNING, LOG_LEVEL_ERROR };
+
+/// A call site of one of the LOG_* macros. Only used by the macros and the logger itself.
+struct LogSite {
+	enum LogLevel level;
+	const char *format;
+
+	// The argument types, parsed from the format on first use
+	atomic_int state;
+	uint8_t argumentCount;
+	uint8_t argumentTypes[LOGGER_MAX_ARGUMENTS];
+
+	// Rate limiting
+	atomic_uint_least64_t windowStart;
+	atomic_uint windowCount;
+	atomic_uint suppressed;
+
+	// Deduplication (only accessed by the drainer)
+	uint64_t generation;
+	uint64_t lastHash;
+	uint64_t lastTimeMs;
+	// The position (plus one) of the repetitions of the last message that are being counted (0 if there are none)
+	uint8_t pending;
+};
+
+#define LOG(logger, siteLevel, siteFormat, ...)                                           \
+	do {                                                                                  \
+		static struct LogSite logSite = { .level = (siteLevel), .format = (siteFormat) }; \
+		logger_write((logger), &logSite, (siteFormat), ##__VA_ARGS__);                    \
+	} while (0)
+
+#define LOG_DEBUG(logger, format, ...) LOG(logger, LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define LOG_INFO(logger, format, ...) LOG(logger, LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define LOG_WARNING(logger, format, ...) LOG(logger, LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#define LOG_ERROR(logger, format, ...) LOG(logger, LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+
+#if defined(__GNUC__) || defined(__clang__)
+// Lets the compiler check the arguments against the format
+#	define LOGGER_FORMAT(formatIndex, firstArgument) __attribute__((format(printf, formatIndex, firstArgument)))
+#else
+#	define LOGGER_FORMAT(formatIndex, firstArgument)
+#endif
+
+/// Receives every formatted message. This is called on the draining thread.
+typedef void (*LoggerSinkFunction)(void *userData, enum LogLevel level, const char *message);
+
+struct Logger;
+
+/// Creates a new logger. All memory it needs (including the rings of all threads) is allocated here.
+///
+/// @param sink The function messages are handed to
+/// @param userData An arbitrary pointer that is passed to the sink
+/// @returns The new logger or NULL if allocating it failed
+struct Logger *logger_create(LoggerSinkFunction sink, void *userData);
+
+/// Drains everything that has been logged so far and destroys the logger. No thread may log anymore.
+void logger_destroy(struct Logger *logger);
+
+/// Queues a message. Use the LOG_* macros instead of calling this directly.
+///
+/// NOTE: logger may be NULL, in which case nothing happens
+void logger_write(struct Logger *logger, struct LogSite *site, const char *format, ...) LOGGER_FORMAT(3, 4);
+
+/// Formats everything that has been logged so far and hands it to the sink (and the log file)
+///
+/// NOTE: Only one thread at a time may drain
+///
+/// @param nowMs The current time in milliseconds
+/// @returns The amount of records that have been drained
+size_t logger_drain(struct Logger *logger, uint64_t nowMs);
+
+/// Starts writing all messages (including debug messages) to the given file as well. Once it grows beyond maxSize
+/// bytes, it is renamed to path.1 (path.1 to path.2 and so on, keeping at most maxFiles old files) and a new file is
+/// started. Passing NULL closes the current file.
+///
+/// NOTE: May only be called by the draining thread
+///
+/// @returns Whether the file could be opened
+bool logger_setFile(struct Logger *logger, const char *path, size_t maxSize, unsigned int maxFiles);
+
+#endif // MUMBLE_PLUGIN_LOGGER_H_
@@ -0,0 +1,386 @@
+#include "memory.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#	include <sys/mman.h>
+#	include <unistd.h>
+#else
+#	include <malloc.h>
+#endif
+
+#define HEAP_MAGIC 0x484d4d48u // "HMMH"
+#define LARGE_MAGIC 0x484d4d4cu // "HMML"
+#define ARENA_ALIGNMENT 16
+#define NO_OBJECT UINT32_MAX
+
+// Stored in front of every heap allocation (and at the start of the first page of every large block). Its size keeps
+// the memory behind it aligned for any type.
+struct BlockHeader {
+	uint32_t magic;
+	uint32_t subsystem;
+	size_t size;
+	alignas(max_align_t) unsigned char data[];
+};
+
+struct Account {
+	atomic_size_t bytes;
+	atomic_size_t peakBytes;
+	atomic_size_t blocks;
+	atomic_uint_least64_t allocations;
+};
+
+struct MemoryPool {
+	enum MemorySubsystem subsystem;
+	size_t objectSize;
+	size_t capacity;
+	unsigned char *objects;
+	// The index of the next free object of every object
+	atomic_uint *next;
+	// The index of the first free object in the lower half, a counter in the upper half that prevents a stale head from
+	// being installed again (ABA)
+	atomic_uint_least64_t head;
+};
+
+struct MemoryArena {
+	enum MemorySubsystem subsystem;
+	unsigned char *data;
+	size_t capacity;
+	size_t used;
+};
+
+static const char *subsystemNames[MEMORY_SUBSYSTEM_COUNT] = {
+	"acoustics", "commands", "config", "connections", "control", "games", "governor", "keybindings", "logger",
+	"meters", "metrics", "positional", "recipients", "scanner", "settings", "soundboard", "spatial",
+	"textindex", "transcription", "transport", "update",
+};
+
+static struct Account accounts[MEMORY_SUBSYSTEM_COUNT];
+
+static _Thread_local bool isAudioThread;
+
+
+static void checkThread(const char *function) {
+#ifdef MEMORY_DEBUG
+	if (isAudioThread) {
+		fprintf(stderr, "hello_mumble: %s called from an audio thread\n", function);
+		abort();
+	}
+#else
+	(void) function;
+#endif
+}
+
+static void account(enum MemorySubsystem subsystem, size_t size) {
+	struct Account *account = &accounts[subsystem];
+
+	size_t bytes = atomic_fetch_add_explicit(&account->bytes, size, memory_order_relaxed) + size;
+	size_t peak  = atomic_load_explicit(&account->peakBytes, memory_order_relaxed);
+	while (bytes > peak
+		   && !atomic_compare_exchange_weak_explicit(&account->peakBytes, &peak, bytes, memory_order_relaxed,
+													 memory_order_relaxed)) {
+	}
+
+	atomic_fetch_add_explicit(&account->blocks, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&account->allocations, 1, memory_order_relaxed);
+}
+
+static void unaccount(enum MemorySubsystem subsystem, size_t size) {
+	atomic_fetch_sub_explicit(&accounts[subsystem].bytes, size, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&accounts[subsystem].blocks, 1, memory_order_relaxed);
+}
+
+
+////////////////////////////////// Heap //////////////////////////////////
+
+void *memory_alloc(enum MemorySubsystem subsystem, size_t size) {
+	checkThread(__func__);
+
+	if (size > SIZE_MAX - sizeof(struct BlockHeader)) {
+		return NULL;
+	}
+
+	struct BlockHeader *header = malloc(sizeof(struct BlockHeader) + size);
+	if (!header) {
+		return NULL;
+	}
+
+	header->magic     = HEAP_MAGIC;
+	header->subsystem = subsystem;
+	header->size      = size;
+	account(subsystem, size);
+
+	return header->data;
+}
+
+void *memory_calloc(enum MemorySubsystem subsystem, size_t count, size_t size) {
+	if (size != 0 && count > SIZE_MAX / size) {
+		return NULL;
+	}
+
+	void *pointer = memory_alloc(subsystem, count * size);
+	if (pointer) {
+		memset(pointer, 0, count * size);
+	}
+
+	return pointer;
+}
+
+void *memory_realloc(enum MemorySubsystem subsystem, void *pointer, size_t size) {
+	// Existing blocks stay accounted to the subsystem they have been allocated for
+	if (!pointer) {
+		return memory_alloc(subsystem, size);
+	}
+
+	checkThread(__func__);
+
+	if (size > SIZE_MAX - sizeof(struct BlockHeader)) {
+		return NULL;
+	}
+
+	struct BlockHeader *header = (struct BlockHeader *) ((unsigned char *) pointer - sizeof(struct BlockHeader));
+	size_t previousSize        = header->size;
+
+	header = realloc(header, sizeof(struct BlockHeader) + size);
+	if (!header) {
+		return NULL;
+	}
+
+	header->size = size;
+	unaccount((enum MemorySubsystem) header->subsystem, previousSize);
+	account((enum MemorySubsystem) header->subsystem, size);
+
+	return header->data;
+}
+
+void memory_free(void *pointer) {
+	if (!pointer) {
+		return;
+	}
+
+	checkThread(__func__);
+
+	struct BlockHeader *header = (struct BlockHeader *) ((unsigned char *) pointer - sizeof(struct BlockHeader));
+	if (header->magic != HEAP_MAGIC) {
+		fprintf(stderr, "hello_mumble: memory_free called with a pointer that wasn't allocated by memory_alloc\n");
+		abort();
+	}
+
+	unaccount((enum MemorySubsystem) header->subsystem, header->size);
+	header->magic = 0;
+	free(header);
+}
+
+
+////////////////////////////////// Large blocks //////////////////////////////////
+
+static size_t pageSize() {
+#ifndef _WIN32
+	long size = sysconf(_SC_PAGESIZE);
+	return size > 0 ? (size_t) size : 4096;
+#else
+	return 4096;
+#endif
+}
+
+void *memory_allocLarge(enum MemorySubsystem subsystem, size_t size) {
+	checkThread(__func__);
+
+	// The header takes up a page of its own, so that the block itself is page-aligned
+	size_t page = pageSize();
+	if (size > SIZE_MAX - 2 * page) {
+		return NULL;
+	}
+	size_t length = page + (size + page - 1) / page * page;
+
+#ifndef _WIN32
+	void *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED) {
+		return NULL;
+	}
+#else
+	void *mapping = _aligned_malloc(length, page);
+	if (!mapping) {
+		return NULL;
+	}
+	memset(mapping, 0, length);
+#endif
+
+	struct BlockHeader *header = mapping;
+	header->magic              = LARGE_MAGIC;
+	header->subsystem          = subsystem;
+	header->size               = length;
+	account(subsystem, length);
+
+	return (unsigned char *) mapping + page;
+}
+
+void memory_freeLarge(void *pointer) {
+	if (!pointer) {
+		return;
+	}
+
+	checkThread(__func__);
+
+	struct BlockHeader *header = (struct BlockHeader *) ((unsigned char *) pointer - pageSize());
+	if (header->magic != LARGE_MAGIC) {
+		fprintf(stderr, "hello_mumble: memory_freeLarge called with a pointer that wasn't allocated by "
+						"memory_allocLarge\n");
+		abort();
+	}
+
+	unaccount((enum MemorySubsystem) header->subsystem, header->size);
+
+#ifndef _WIN32
+	munmap(header, header->size);
+#else
+	_aligned_free(header);
+#endif
+}
+
+
+////////////////////////////////// Pools //////////////////////////////////
+
+struct MemoryPool *memory_createPool(enum MemorySubsystem subsystem, size_t objectSize, size_t capacity) {
+	if (capacity == 0 || capacity >= NO_OBJECT) {
+		return NULL;
+	}
+
+	struct MemoryPool *pool = memory_calloc(subsystem, 1, sizeof(struct MemoryPool));
+	if (!pool) {
+		return NULL;
+	}
+
+	pool->subsystem = subsystem;
+	// Every object is aligned like the slab itself
+	pool->objectSize = (objectSize + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+	pool->capacity   = capacity;
+	pool->objects    = memory_allocLarge(subsystem, pool->objectSize * capacity);
+	pool->next       = memory_alloc(subsystem, capacity * sizeof(atomic_uint));
+	if (!pool->objects || !pool->next) {
+		memory_freeLarge(pool->objects);
+		memory_free(pool->next);
+		memory_free(pool);
+
+		return NULL;
+	}
+
+	for (size_t i = 0; i < capacity; i++) {
+		atomic_init(&pool->next[i], i + 1 < capacity ? (unsigned) (i + 1) : NO_OBJECT);
+	}
+	atomic_init(&pool->head, 0);
+
+	return pool;
+}
+
+void memory_destroyPool(struct MemoryPool *pool) {
+	if (!pool) {
+		return;
+	}
+
+	memory_freeLarge(pool->objects);
+	memory_free(pool->next);
+	memory_free(pool);
+}
+
+void *memory_poolAlloc(struct MemoryPool *pool) {
+	uint_least64_t head = atomic_load_explicit(&pool->head, memory_order_acquire);
+
+	while (true) {
+		uint32_t index = (uint32_t) head;
+		if (index == NO_OBJECT) {
+			return NULL;
+		}
+
+		// If the object is taken by another thread in the meantime, the counter makes the exchange fail
+		uint32_t next           = atomic_load_explicit(&pool->next[index], memory_order_relaxed);
+		uint_least64_t replaced = ((head >> 32) + 1) << 32 | next;
+		if (atomic_compare_exchange_weak_explicit(&pool->head, &head, replaced, memory_order_acquire,
+												  memory_order_acquire)) {
+			// Pool objects count as blocks (so that they show up as leaks) but not as bytes, as the slab already does
+			atomic_fetch_add_explicit(&accounts[pool->subsystem].blocks, 1, memory_order_relaxed);
+			atomic_fetch_add_explicit(&accounts[pool->subsystem].allocations, 1, memory_order_relaxed);
+
+			return pool->objects + (size_t) index * pool->objectSize;
+		}
+	}
+}
+
+void memory_poolFree(struct MemoryPool *pool, void *object) {
+	if (!object) {
+		return;
+	}
+
+	uint32_t index      = (uint32_t) (((unsigned char *) object - pool->objects) / pool->objectSize);
+	uint_least64_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+
+	do {
+		atomic_store_explicit(&pool->next[index], (uint32_t) head, memory_order_relaxed);
+	} while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, ((head >> 32) + 1) << 32 | index,
+													memory_order_release, memory_order_relaxed));
+
+	atomic_fetch_sub_explicit(&accounts[pool->subsystem].blocks, 1, memory_order_relaxed);
+}
+
+
+////////////////////////////////// Arenas //////////////////////////////////
+
+struct MemoryArena *memory_createArena(enum MemorySubsystem subsystem, size_t capacity) {
+	struct MemoryArena *arena = memory_calloc(subsystem, 1, sizeof(struct MemoryArena));
+	if (!arena) {
+		return NULL;
+	}
+
+	arena->subsystem = subsystem;
+	arena->capacity  = capacity;
+	arena->data      = memory_allocLarge(subsystem, capacity);
+	if (!arena->data) {
+		memory_free(arena);
+		return NULL;
+	}
+
+	return arena;
+}
+
+void memory_destroyArena(struct MemoryArena *arena) {
+	if (!arena) {
+		return;
+	}
+
+	memory_freeLarge(arena->data);
+	memory_free(arena);
+}
+
+void *memory_arenaAlloc(struct MemoryArena *arena, size_t size) {
+	size_t offset = (arena->used + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+	if (offset > arena->capacity || size > arena->capacity - offset) {
+		return NULL;
+	}
+
+	arena->used = offset + size;
+
+	return arena->data + offset;
+}
+
+void memory_arenaReset(struct MemoryArena *arena) {
+	arena->used = 0;
+}
+
+
+void memory_setAudioThread(bool audioThread) {
+	isAudioThread = audioThread;
+}
+
+void memory_getUsage(struct MemoryUsage *usage) {
+	for (size_t i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+		usage[i].name        = subsystemNames[i];
+		usage[i].bytes       = atomic_load_explicit(&accounts[i].bytes, memory_order_relaxed);
+		usage[i].peakBytes   = atomic_load_explicit(&accounts[i].peakBytes, memory_order_relaxed);
+		usage[i].blocks      = atomic_load_explicit(&accounts[i].blocks, memory_order_relaxed);
+		usage[i].allocations = atomic_load_explicit(&accounts[i].allocations, memory_order_relaxed);
+	}
+}
@@ -0,0 +1,127 @@
+/// This header file declares the plugin's memory subsystem.
+///
+/// All memory the plugin's subsystems allocate is accounted for per subsystem, so that usage can be inspected at any
+/// time and anything still allocated when the plugin shuts down can be reported as a leak. Besides a general-purpose
+/// heap (memory_alloc and friends) there are three allocators for the patterns that malloc handles badly:
+///
+/// - Pools hand out fixed-size objects from a slab that is allocated up front. Allocating and freeing is lock-free, so
+///   pools may be used from any thread, including audio threads.
+/// - Arenas hand out memory by bumping a pointer and are reset as a whole, e.g. once per audio callback for scratch
+///   buffers that only live for the duration of a frame. An arena may only be used by one thread.
+/// - Large blocks (e.g. lookup tables) are mapped directly from the operating system instead of fragmenting the heap.
+///   They are page-aligned and zero-initialized.
+///
+/// Mumble's audio threads must never call into the heap, as that may block on the allocator's locks. Threads can mark
+/// themselves as audio threads, and if the plugin is built with MEMORY_DEBUG (the PLUGIN_MEMORY_DEBUG CMake option),
+/// any heap, large block, pool creation or arena creation call made from such a thread aborts.
+
+#ifndef MUMBLE_PLUGIN_MEMORY_H_
+#define MUMBLE_PLUGIN_MEMORY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum MemorySubsystem {
+	MEMORY_ACOUSTICS,
+	MEMORY_COMMANDS,
+	MEMORY_CONFIG,
+	MEMORY_CONNECTIONS,
+	MEMORY_CONTROL,
+	MEMORY_GAMES,
+	MEMORY_GOVERNOR,
+	MEMORY_KEYBINDINGS,
+	MEMORY_LOGGER,
+	MEMORY_METERS,
+	MEMORY_METRICS,
+	MEMORY_POSITIONAL,
+	MEMORY_RECIPIENTS,
+	MEMORY_SCANNER,
+	MEMORY_SETTINGS,
+	MEMORY_SOUNDBOARD,
+	MEMORY_SPATIAL,
+	MEMORY_TEXTINDEX,
+	MEMORY_TRANSCRIPTION,
+	MEMORY_TRANSPORT,
+	MEMORY_UPDATE,
+	MEMORY_SUBSYSTEM_COUNT
+};
+
+/// The memory currently held by a subsystem
+struct MemoryUsage {
+	const char *name;
+	/// The bytes allocated from the heap or as large blocks (including the backing memory of pools and arenas)
+	size_t bytes;
+	size_t peakBytes;
+	/// The amount of heap allocations, large blocks and pool objects that haven't been freed yet
+	size_t blocks;
+	/// The amount of allocations that have been made in total
+	uint64_t allocations;
+};
+
+/// Works like malloc, accounting the memory to the given subsystem
+void *memory_alloc(enum MemorySubsystem subsystem, size_t size);
+
+/// Works like calloc, accounting the memory to the given subsystem
+void *memory_calloc(enum MemorySubsystem subsystem, size_t count, size_t size);
+
+/// Works like realloc. The memory has to have been allocated for the same subsystem.
+void *memory_realloc(enum MemorySubsystem subsystem, void *pointer, size_t size);
+
+/// Frees memory returned by memory_alloc, memory_calloc or memory_realloc (NULL is ignored)
+void memory_free(void *pointer);
+
+/// Allocates a large, page-aligned and zero-initialized block
+///
+/// @returns The block or NULL if allocating it failed
+void *memory_allocLarge(enum MemorySubsystem subsystem, size_t size);
+
+/// Frees a block returned by memory_allocLarge (NULL is ignored)
+void memory_freeLarge(void *pointer);
+
+struct MemoryPool;
+
+/// Creates a pool and allocates memory for all of its objects
+///
+/// @param objectSize The size of every object
+/// @param capacity The maximum amount of objects that can be allocated at the same time
+/// @returns The new pool or NULL if allocating it failed
+struct MemoryPool *memory_createPool(enum MemorySubsystem subsystem, size_t objectSize, size_t capacity);
+
+/// Destroys the pool. Objects that haven't been freed are reported as leaked.
+void memory_destroyPool(struct MemoryPool *pool);
+
+/// Takes an object out of the pool. This is lock-free and never allocates.
+///
+/// @returns The object (its contents are undefined) or NULL if all objects are in use
+void *memory_poolAlloc(struct MemoryPool *pool);
+
+/// Returns an object to the pool it has been taken from (NULL is ignored)
+void memory_poolFree(struct MemoryPool *pool, void *object);
+
+struct MemoryArena;
+
+/// Creates an arena that can hand out up to capacity bytes between resets
+///
+/// @returns The new arena or NULL if allocating it failed
+struct MemoryArena *memory_createArena(enum MemorySubsystem subsystem, size_t capacity);
+
+void memory_destroyArena(struct MemoryArena *arena);
+
+/// Allocates memory (aligned to 16 bytes) from the arena. This never allocates from the heap.
+///
+/// @returns The memory or NULL if the arena is exhausted
+void *memory_arenaAlloc(struct MemoryArena *arena, size_t size);
+
+/// Releases everything that has been allocated from the arena at once
+void memory_arenaReset(struct MemoryArena *arena);
+
+/// Marks the calling thread as an audio thread (or not). See MEMORY_DEBUG.
+void memory_setAudioThread(bool audioThread);
+
+/// Fills in the current usage of every subsystem
+///
+/// @param[out] usage An array of MEMORY_SUBSYSTEM_COUNT entries, indexed by enum MemorySubsystem
+void memory_getUsage(struct MemoryUsage *usage);
+
+#endif // MUMBLE_PLUGIN_MEMORY_H_
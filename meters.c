@@ -0,0 +1,483 @@
+#include "meters.h"
+#include "memory.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <stdio.h>
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#	define M_PI 3.14159265358979323846
+#endif
+
+// The FFT is done as a complex FFT of half the size on the even and odd samples
+#define HALF_SIZE (METERS_FFT_SIZE / 2)
+
+struct Analyzer {
+	// The last METERS_FFT_SIZE samples of the decimated mono downmix (a ring)
+	float history[METERS_FFT_SIZE];
+	size_t position;
+	size_t sampleCount;
+	size_t samplesSinceSpectrum;
+
+	// The samples of the decimation group that is being collected
+	float accumulator;
+	unsigned int accumulated;
+
+	// The bins every band covers for the (decimated) sample rate they have been computed for
+	uint32_t mappedRate;
+	uint16_t firstBin[METERS_BANDS];
+	uint16_t lastBin[METERS_BANDS];
+	float frequencies[METERS_BANDS];
+};
+
+struct Meters {
+	struct MeterTable *table;
+	char name[64];
+
+	// METERS_MAX_SPEAKERS analyzers, one per entry of the table
+	struct Analyzer *analyzers;
+
+	float window[METERS_FFT_SIZE];
+	uint16_t bitReverse[HALF_SIZE];
+	// The twiddle factors of the complex FFT and those combining its result into the real FFT
+	float twiddleCos[HALF_SIZE / 2];
+	float twiddleSin[HALF_SIZE / 2];
+	float splitCos[HALF_SIZE];
+	float splitSin[HALF_SIZE];
+};
+
+// Speech hardly has any energy above 8kHz, so the spectrum is computed from a signal decimated to about this rate. This
+// improves the resolution of the lower bands and makes the history cover a longer time.
+#define ANALYSIS_RATE 16000
+
+
+static uint64_t timeNs() {
+	struct timespec now;
+#ifndef _WIN32
+	clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+	timespec_get(&now, TIME_UTC);
+#endif
+
+	return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+static void computeTables(struct Meters *meters) {
+	for (size_t i = 0; i < METERS_FFT_SIZE; i++) {
+		meters->window[i] = 0.5f - 0.5f * cosf(2.0f * (float) M_PI * (float) i / METERS_FFT_SIZE);
+	}
+
+	unsigned int bits = 0;
+	while ((1u << bits) < HALF_SIZE) {
+		bits++;
+	}
+	for (unsigned int i = 0; i < HALF_SIZE; i++) {
+		unsigned int reversed = 0;
+		for (unsigned int bit = 0; bit < bits; bit++) {
+			reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+		}
+		meters->bitReverse[i] = (uint16_t) reversed;
+	}
+
+	for (size_t k = 0; k < HALF_SIZE / 2; k++) {
+		meters->twiddleCos[k] = cosf(2.0f * (float) M_PI * (float) k / HALF_SIZE);
+		meters->twiddleSin[k] = -sinf(2.0f * (float) M_PI * (float) k / HALF_SIZE);
+	}
+	for (size_t k = 0; k < HALF_SIZE; k++) {
+		meters->splitCos[k] = cosf(2.0f * (float) M_PI * (float) k / METERS_FFT_SIZE);
+		meters->splitSin[k] = -sinf(2.0f * (float) M_PI * (float) k / METERS_FFT_SIZE);
+	}
+}
+
+
+////////////////////////////////// Table //////////////////////////////////
+
+#ifndef _WIN32
+
+static bool createTable(struct Meters *meters) {
+	snprintf(meters->name, sizeof(meters->name), "/hello_mumble-%d-meters", (int) getpid());
+
+	int fd = shm_open(meters->name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0 && errno == EEXIST) {
+		// Left behind by a process that crashed and had the same PID
+		shm_unlink(meters->name);
+		fd = shm_open(meters->name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	}
+	if (fd < 0) {
+		meters->name[0] = '\0';
+		return false;
+	}
+
+	void *mapping = MAP_FAILED;
+	if (ftruncate(fd, sizeof(struct MeterTable)) == 0) {
+		mapping = mmap(NULL, sizeof(struct MeterTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+
+	// The object is zeroed already
+	meters->table               = mapping;
+	meters->table->version      = METERS_TABLE_VERSION;
+	meters->table->speakerCount = METERS_MAX_SPEAKERS;
+	meters->table->bandCount    = METERS_BANDS;
+	meters->table->fftSize      = METERS_FFT_SIZE;
+	atomic_thread_fence(memory_order_release);
+	meters->table->magic = METERS_TABLE_MAGIC;
+
+	return true;
+}
+
+static void destroyTable(struct Meters *meters) {
+	if (meters->table) {
+		munmap(meters->table, sizeof(struct MeterTable));
+	}
+	if (meters->name[0] != '\0') {
+		shm_unlink(meters->name);
+	}
+}
+
+#else
+
+static bool createTable(struct Meters *meters) {
+	(void) meters;
+
+	return false;
+}
+
+static void destroyTable(struct Meters *meters) {
+	(void) meters;
+}
+
+#endif
+
+struct Meters *meters_create() {
+	struct Meters *meters = memory_calloc(MEMORY_METERS, 1, sizeof(struct Meters));
+	if (!meters) {
+		return NULL;
+	}
+
+	meters->analyzers = memory_allocLarge(MEMORY_METERS, METERS_MAX_SPEAKERS * sizeof(struct Analyzer));
+	if (!meters->analyzers || !createTable(meters)) {
+		meters_destroy(meters);
+		return NULL;
+	}
+
+	computeTables(meters);
+
+	return meters;
+}
+
+void meters_destroy(struct Meters *meters) {
+	if (!meters) {
+		return;
+	}
+
+	destroyTable(meters);
+	memory_freeLarge(meters->analyzers);
+	memory_free(meters);
+}
+
+// @returns The index of the speaker's entry or -1 if the speaker doesn't have one (and none could be claimed)
+static int findEntry(struct Meters *meters, mumble_userid_t userID, bool claim) {
+	if (userID == UINT32_MAX) {
+		return -1;
+	}
+
+	unsigned int owner = userID + 1;
+	for (size_t i = 0; i < METERS_PROBE_LENGTH; i++) {
+		size_t index = (userID + i) & (METERS_MAX_SPEAKERS - 1);
+		if (atomic_load_explicit(&meters->table->entries[index].owner, memory_order_relaxed) == owner) {
+			return (int) index;
+		}
+	}
+
+	if (!claim) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < METERS_PROBE_LENGTH; i++) {
+		size_t index         = (userID + i) & (METERS_MAX_SPEAKERS - 1);
+		unsigned int unowned = 0;
+		if (atomic_compare_exchange_strong(&meters->table->entries[index].owner, &unowned, owner)) {
+			struct Analyzer *analyzer = &meters->analyzers[index];
+			memset(analyzer, 0, sizeof(*analyzer));
+			return (int) index;
+		}
+	}
+
+	return -1;
+}
+
+void meters_removeSpeaker(struct Meters *meters, mumble_userid_t userID) {
+	int index = findEntry(meters, userID, false);
+	if (index >= 0) {
+		atomic_store_explicit(&meters->table->entries[index].owner, 0, memory_order_release);
+	}
+}
+
+
+////////////////////////////////// Analysis //////////////////////////////////
+
+static void measureLevels(const float *samples, size_t count, struct MeterLevels *levels) {
+	size_t i   = 0;
+	float peak = 0.0f;
+	float sum  = 0.0f;
+
+#if defined(__SSE2__)
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 peaks          = _mm_setzero_ps();
+	__m128 sums           = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4) {
+		__m128 value = _mm_loadu_ps(samples + i);
+		peaks        = _mm_max_ps(peaks, _mm_andnot_ps(signMask, value));
+		sums         = _mm_add_ps(sums, _mm_mul_ps(value, value));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, peaks);
+	peak = fmaxf(fmaxf(lanes[0], lanes[1]), fmaxf(lanes[2], lanes[3]));
+	_mm_storeu_ps(lanes, sums);
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__ARM_NEON)
+	float32x4_t peaks = vdupq_n_f32(0.0f);
+	float32x4_t sums  = vdupq_n_f32(0.0f);
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t value = vld1q_f32(samples + i);
+		peaks             = vmaxq_f32(peaks, vabsq_f32(value));
+		sums              = vmlaq_f32(sums, value, value);
+	}
+	float lanes[4];
+	vst1q_f32(lanes, peaks);
+	peak = fmaxf(fmaxf(lanes[0], lanes[1]), fmaxf(lanes[2], lanes[3]));
+	vst1q_f32(lanes, sums);
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+	for (; i < count; i++) {
+		peak = fmaxf(peak, fabsf(samples[i]));
+		sum += samples[i] * samples[i];
+	}
+
+	levels->peak = peak;
+	levels->rms  = count > 0 ? sqrtf(sum / (float) count) : 0.0f;
+}
+
+// Downmixes and decimates the samples into the analyzer's history
+//
+// @returns The amount of samples added to the history
+static size_t collectSamples(struct Analyzer *analyzer, const float *pcm, uint32_t sampleCount, uint16_t channelCount,
+							 unsigned int factor) {
+	size_t added = 0;
+	float scale  = 1.0f / (float) (factor * channelCount);
+
+	for (uint32_t frame = 0; frame < sampleCount; frame++) {
+		for (uint16_t channel = 0; channel < channelCount; channel++) {
+			analyzer->accumulator += pcm[(size_t) frame * channelCount + channel];
+		}
+
+		if (++analyzer->accumulated == factor) {
+			analyzer->history[analyzer->position] = analyzer->accumulator * scale;
+			analyzer->position                    = (analyzer->position + 1) & (METERS_FFT_SIZE - 1);
+			analyzer->accumulator                 = 0.0f;
+			analyzer->accumulated                 = 0;
+			added++;
+		}
+	}
+
+	analyzer->sampleCount += added;
+	return added;
+}
+
+// Assigns the bins to the bands, which are spaced logarithmically between METERS_LOWEST_FREQUENCY and the Nyquist
+// frequency. Bands too narrow to contain a bin of their own use the bin closest to their center.
+static void mapBands(struct Analyzer *analyzer, uint32_t rate) {
+	float nyquist  = (float) rate / 2.0f;
+	float binWidth = (float) rate / METERS_FFT_SIZE;
+	float ratio    = nyquist / METERS_LOWEST_FREQUENCY;
+
+	for (size_t band = 0; band < METERS_BANDS; band++) {
+		float lower  = METERS_LOWEST_FREQUENCY * powf(ratio, (float) band / METERS_BANDS);
+		float upper  = METERS_LOWEST_FREQUENCY * powf(ratio, (float) (band + 1) / METERS_BANDS);
+		float center = sqrtf(lower * upper);
+
+		long first = (long) ceilf(lower / binWidth);
+		long last  = (long) floorf(upper / binWidth);
+		if (band < METERS_BANDS - 1 && (float) last * binWidth >= upper) {
+			// The bin on the edge belongs to the next band
+			last--;
+		}
+		if (last < first) {
+			first = last = lroundf(center / binWidth);
+		}
+		if (last > HALF_SIZE) {
+			last = HALF_SIZE;
+		}
+		if (first > last) {
+			first = last;
+		}
+
+		analyzer->firstBin[band]    = (uint16_t) first;
+		analyzer->lastBin[band]     = (uint16_t) last;
+		analyzer->frequencies[band] = center;
+	}
+
+	analyzer->mappedRate = rate;
+}
+
+static void fft(const struct Meters *meters, float *real, float *imaginary) {
+	for (size_t i = 0; i < HALF_SIZE; i++) {
+		size_t j = meters->bitReverse[i];
+		if (i < j) {
+			float swap   = real[i];
+			real[i]      = real[j];
+			real[j]      = swap;
+			swap         = imaginary[i];
+			imaginary[i] = imaginary[j];
+			imaginary[j] = swap;
+		}
+	}
+
+	for (size_t size = 2; size <= HALF_SIZE; size *= 2) {
+		size_t half = size / 2;
+		size_t step = HALF_SIZE / size;
+
+		for (size_t start = 0; start < HALF_SIZE; start += size) {
+			for (size_t k = 0; k < half; k++) {
+				float wr = meters->twiddleCos[k * step];
+				float wi = meters->twiddleSin[k * step];
+				size_t a = start + k;
+				size_t b = a + half;
+
+				float tr     = real[b] * wr - imaginary[b] * wi;
+				float ti     = real[b] * wi + imaginary[b] * wr;
+				real[b]      = real[a] - tr;
+				imaginary[b] = imaginary[a] - ti;
+				real[a] += tr;
+				imaginary[a] += ti;
+			}
+		}
+	}
+}
+
+// Computes the spectrum of the analyzer's history
+//
+// @param[out] spectrum The level of every band in dBFS
+static void computeSpectrum(const struct Meters *meters, const struct Analyzer *analyzer, float *spectrum) {
+	// The windowed history, with even samples as real and odd samples as imaginary parts
+	float real[HALF_SIZE];
+	float imaginary[HALF_SIZE];
+	for (size_t i = 0; i < HALF_SIZE; i++) {
+		size_t even  = (analyzer->position + 2 * i) & (METERS_FFT_SIZE - 1);
+		size_t odd   = (even + 1) & (METERS_FFT_SIZE - 1);
+		real[i]      = analyzer->history[even] * meters->window[2 * i];
+		imaginary[i] = analyzer->history[odd] * meters->window[2 * i + 1];
+	}
+
+	fft(meters, real, imaginary);
+
+	// The power of every bin of the real FFT (0 to HALF_SIZE), scaled so that a full scale sine has a power of 1
+	float power[HALF_SIZE + 1];
+	const float scale = 4.0f / METERS_FFT_SIZE;
+
+	power[0]         = (real[0] + imaginary[0]) * (real[0] + imaginary[0]) * scale * scale / 4.0f;
+	power[HALF_SIZE] = (real[0] - imaginary[0]) * (real[0] - imaginary[0]) * scale * scale / 4.0f;
+	for (size_t k = 1; k < HALF_SIZE; k++) {
+		float zr = real[k];
+		float zi = imaginary[k];
+		float cr = real[HALF_SIZE - k];
+		float ci = -imaginary[HALF_SIZE - k];
+
+		// The transforms of the even and the odd samples
+		float evenReal      = (zr + cr) / 2.0f;
+		float evenImaginary = (zi + ci) / 2.0f;
+		float oddReal       = (zi - ci) / 2.0f;
+		float oddImaginary  = -(zr - cr) / 2.0f;
+
+		float wr = meters->splitCos[k];
+		float wi = meters->splitSin[k];
+		float xr = evenReal + wr * oddReal - wi * oddImaginary;
+		float xi = evenImaginary + wr * oddImaginary + wi * oddReal;
+
+		power[k] = (xr * xr + xi * xi) * scale * scale;
+	}
+
+	for (size_t band = 0; band < METERS_BANDS; band++) {
+		float highest = 0.0f;
+		for (size_t bin = analyzer->firstBin[band]; bin <= analyzer->lastBin[band]; bin++) {
+			highest = fmaxf(highest, power[bin]);
+		}
+
+		float level    = highest > 0.0f ? 10.0f * log10f(highest) : METERS_FLOOR_DB;
+		spectrum[band] = fmaxf(level, METERS_FLOOR_DB);
+	}
+}
+
+bool meters_process(struct Meters *meters, mumble_userid_t userID, const float *pcm, uint32_t sampleCount,
+					uint16_t channelCount, uint32_t sampleRate, unsigned int spectrumRate, struct MeterLevels *levels) {
+	struct MeterLevels measured;
+	measureLevels(pcm, (size_t) sampleCount * channelCount, &measured);
+	if (levels) {
+		*levels = measured;
+	}
+
+	int index = findEntry(meters, userID, true);
+	if (index < 0) {
+		return false;
+	}
+
+	struct Analyzer *analyzer = &meters->analyzers[index];
+	struct MeterEntry *entry  = &meters->table->entries[index];
+
+	bool spectrumDue = false;
+	float spectrum[METERS_BANDS];
+	if (spectrumRate > 0 && sampleRate > 0 && channelCount > 0) {
+		unsigned int factor = sampleRate > ANALYSIS_RATE ? sampleRate / ANALYSIS_RATE : 1;
+		uint32_t rate       = sampleRate / factor;
+		if (analyzer->mappedRate != rate) {
+			mapBands(analyzer, rate);
+		}
+
+		analyzer->samplesSinceSpectrum += collectSamples(analyzer, pcm, sampleCount, channelCount, factor);
+		spectrumDue = analyzer->sampleCount >= METERS_FFT_SIZE && analyzer->samplesSinceSpectrum >= rate / spectrumRate;
+		if (spectrumDue) {
+			computeSpectrum(meters, analyzer, spectrum);
+			analyzer->samplesSinceSpectrum = 0;
+		}
+	}
+
+	uint64_t now          = timeNs();
+	unsigned int sequence = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+	atomic_store_explicit(&entry->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	entry->timeNs = now;
+	entry->peak   = measured.peak;
+	entry->rms    = measured.rms;
+	if (spectrumDue) {
+		entry->spectrumTimeNs = now;
+		memcpy(entry->spectrum, spectrum, sizeof(spectrum));
+		memcpy(entry->frequencies, analyzer->frequencies, sizeof(entry->frequencies));
+	} else if (analyzer->sampleCount < METERS_FFT_SIZE) {
+		// The entry may still hold the spectrum of its previous owner
+		entry->spectrumTimeNs = 0;
+	}
+
+	atomic_store_explicit(&entry->sequence, sequence + 2, memory_order_release);
+
+	return true;
+}
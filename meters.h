@@ -0,0 +1,103 @@
+/// This header file declares the level meters and spectrum analyzers of the speakers.
+///
+/// meters_process is meant to be called from mumble_onAudioSourceFetched. It measures the peak and RMS level of every
+/// buffer (vectorized with SSE2 or NEON) and, at the configured rate, the spectrum of the last METERS_FFT_SIZE samples
+/// (Hann window, real FFT with precomputed tables) folded into METERS_BANDS logarithmically spaced bands. Spectra are
+/// only computed every few buffers, so most calls cost about as much as the level measurement.
+///
+/// The results are written into a table in shared memory named "/hello_mumble-<pid>-meters" (with Mumble's PID) that
+/// other processes map read-only (see struct MeterTable). Readers never make a syscall and never block the plugin.
+///
+/// NOTE: The meters are only available where POSIX shared memory is. Everywhere else meters_create returns NULL.
+
+#ifndef MUMBLE_PLUGIN_METERS_H_
+#define MUMBLE_PLUGIN_METERS_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The amount of entries in the table (a power of two)
+#define METERS_MAX_SPEAKERS 256
+/// The amount of entries a speaker's entry may be away from userID % METERS_MAX_SPEAKERS
+#define METERS_PROBE_LENGTH 8
+/// The amount of samples (of the mono downmix) a spectrum is computed from (a power of two)
+#define METERS_FFT_SIZE 512
+#define METERS_BANDS 32
+/// The lower edge of the lowest band in Hz. The upper edge of the highest band is the Nyquist frequency of the signal
+/// the spectrum is computed from, which is decimated to about 16kHz (as speech hardly has any energy above 8kHz).
+#define METERS_LOWEST_FREQUENCY 50.0f
+/// The level reported for silence in dBFS
+#define METERS_FLOOR_DB -120.0f
+#define METERS_TABLE_MAGIC 0x4D545248
+#define METERS_TABLE_VERSION 1
+
+/// A speaker's entry in the table
+struct MeterEntry {
+	/// Odd while the entry is being written. Readers load it (acquire), copy the entry and load it again (after an
+	/// acquire fence). The copy is consistent if both loads returned the same even value.
+	atomic_uint sequence;
+	/// The user ID plus one (0 if the entry is unused)
+	atomic_uint owner;
+	/// CLOCK_MONOTONIC of the last update
+	uint64_t timeNs;
+	/// The levels of the last buffer (linear, 1 is full scale)
+	float peak;
+	float rms;
+	/// CLOCK_MONOTONIC of the last spectrum (0 if there is none yet)
+	uint64_t spectrumTimeNs;
+	/// The highest level of every band in dBFS (a full scale sine reads 0)
+	float spectrum[METERS_BANDS];
+	/// The center frequency of every band in Hz
+	float frequencies[METERS_BANDS];
+};
+
+/// The layout of the shared memory object. A reader looks for a user by checking the entries starting at
+/// userID % METERS_MAX_SPEAKERS (wrapping around) for up to METERS_PROBE_LENGTH entries whose owner is the user ID
+/// plus one.
+struct MeterTable {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t speakerCount;
+	uint32_t bandCount;
+	uint32_t fftSize;
+	uint32_t reserved;
+	struct MeterEntry entries[METERS_MAX_SPEAKERS];
+};
+
+/// The levels measured by meters_process
+struct MeterLevels {
+	float peak;
+	float rms;
+};
+
+struct Meters;
+
+/// Creates the shared memory table and all analysis state, so that processing never allocates
+///
+/// @returns The new meters or NULL if creating them failed
+struct Meters *meters_create();
+
+/// Destroys the meters and removes the shared memory table
+void meters_destroy(struct Meters *meters);
+
+/// Measures a buffer of a speaker's audio and publishes the results
+///
+/// NOTE: Different speakers may be processed on different threads at the same time, a single speaker may not.
+///
+/// @param pcm Interleaved samples
+/// @param spectrumRate How often the speaker's spectrum is computed (per second, 0 never computes it)
+/// @param[out] levels The measured levels (may be NULL)
+/// @returns Whether the speaker has an entry in the table. Speakers are measured either way.
+bool meters_process(struct Meters *meters, mumble_userid_t userID, const float *pcm, uint32_t sampleCount,
+					uint16_t channelCount, uint32_t sampleRate, unsigned int spectrumRate, struct MeterLevels *levels);
+
+/// Frees the speaker's entry
+///
+/// NOTE: Must not be called while the speaker is being processed
+void meters_removeSpeaker(struct Meters *meters, mumble_userid_t userID);
+
+#endif // MUMBLE_PLUGIN_METERS_H_
@@ -0,0 +1,573 @@
+#include "metrics.h"
+#include "memory.h"
+#include "server.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#	include <errno.h>
+#	include <pthread.h>
+#	include <sys/socket.h>
+#	include <unistd.h>
+#endif
+
+#define MAX_REQUEST_SIZE 1024
+
+enum MetricType { METRIC_COUNTER, METRIC_GAUGE, METRIC_COUNTER_VECTOR, METRIC_HISTOGRAM };
+
+struct Metric {
+	struct MetricsRegistry *registry;
+	enum MetricType type;
+	const char *name;
+	const char *labels;
+	const char *help;
+
+	// The position of the metric's first cell. Counters have one, vectors one per label and histograms one per bucket,
+	// followed by one for the values that are too large for any bucket and one for the sum of all values.
+	size_t cell;
+	size_t cellCount;
+
+	// Counter vectors
+	const char *labelName;
+	int firstLabel;
+
+	// Gauges aren't sharded. The bits of their value (a double) are stored here.
+	atomic_uint_least64_t gauge;
+};
+
+struct MetricsServer;
+
+struct MetricsRegistry {
+	struct Metric metrics[METRICS_MAX_METRICS];
+	size_t metricCount;
+	size_t cellCount;
+	// METRICS_SHARDS rows of METRICS_MAX_CELLS cells
+	atomic_uint_least64_t *cells;
+
+	struct MetricsServer *server;
+};
+
+// The shard of the calling thread (-1 until it has been assigned)
+static _Thread_local int threadShard = -1;
+static atomic_uint nextShard;
+
+
+static atomic_uint_least64_t *shardCell(const struct Metric *metric, size_t offset) {
+	if (threadShard < 0) {
+		threadShard = (int) (atomic_fetch_add_explicit(&nextShard, 1, memory_order_relaxed) % METRICS_SHARDS);
+	}
+
+	return &metric->registry->cells[(size_t) threadShard * METRICS_MAX_CELLS + metric->cell + offset];
+}
+
+// Sums up the given cell of all shards
+static uint64_t sumCell(const struct Metric *metric, size_t offset) {
+	uint64_t sum = 0;
+	for (size_t shard = 0; shard < METRICS_SHARDS; shard++) {
+		sum += atomic_load_explicit(&metric->registry->cells[shard * METRICS_MAX_CELLS + metric->cell + offset],
+									memory_order_relaxed);
+	}
+
+	return sum;
+}
+
+static unsigned int highestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+	return 63 - (unsigned int) __builtin_clzll(value);
+#else
+	unsigned int bit = 0;
+	while (value >>= 1) {
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+// Values 0 and 1 have buckets of their own, every larger power of two is split into a lower and an upper half
+static size_t bucketIndex(uint64_t value) {
+	if (value < 2) {
+		return (size_t) value;
+	}
+
+	unsigned int exponent = highestBit(value);
+	return 2 * exponent + ((value >> (exponent - 1)) & 1);
+}
+
+// The largest value that ends up in the given bucket
+static uint64_t bucketBound(size_t index) {
+	if (index < 2) {
+		return index;
+	}
+
+	unsigned int exponent = (unsigned int) (index / 2);
+	uint64_t lower        = (uint64_t) (2 + index % 2) << (exponent - 1);
+	return lower + ((uint64_t) 1 << (exponent - 1)) - 1;
+}
+
+
+////////////////////////////////// Registry //////////////////////////////////
+
+struct MetricsRegistry *metrics_create() {
+	struct MetricsRegistry *registry = memory_calloc(MEMORY_METRICS, 1, sizeof(struct MetricsRegistry));
+	if (!registry) {
+		return NULL;
+	}
+
+	// Every shard's cells start on a page of their own
+	registry->cells =
+		memory_allocLarge(MEMORY_METRICS, METRICS_SHARDS * METRICS_MAX_CELLS * sizeof(atomic_uint_least64_t));
+	if (!registry->cells) {
+		memory_free(registry);
+		return NULL;
+	}
+
+	return registry;
+}
+
+static void stopServer(struct MetricsRegistry *registry);
+
+void metrics_destroy(struct MetricsRegistry *registry) {
+	if (!registry) {
+		return;
+	}
+
+	stopServer(registry);
+
+	memory_freeLarge(registry->cells);
+	memory_free(registry);
+}
+
+static struct Metric *addMetric(struct MetricsRegistry *registry, enum MetricType type, const char *name,
+								const char *labels, const char *help, size_t cellCount) {
+	if (!registry || registry->metricCount == METRICS_MAX_METRICS
+		|| cellCount > METRICS_MAX_CELLS - registry->cellCount) {
+		return NULL;
+	}
+
+	struct Metric *metric = &registry->metrics[registry->metricCount++];
+	metric->registry      = registry;
+	metric->type          = type;
+	metric->name          = name;
+	metric->labels        = labels;
+	metric->help          = help;
+	metric->cell          = registry->cellCount;
+	metric->cellCount     = cellCount;
+	atomic_init(&metric->gauge, 0);
+
+	registry->cellCount += cellCount;
+
+	return metric;
+}
+
+struct Metric *metrics_addCounter(struct MetricsRegistry *registry, const char *name, const char *labels,
+								  const char *help) {
+	return addMetric(registry, METRIC_COUNTER, name, labels, help, 1);
+}
+
+struct Metric *metrics_addGauge(struct MetricsRegistry *registry, const char *name, const char *labels,
+								const char *help) {
+	return addMetric(registry, METRIC_GAUGE, name, labels, help, 0);
+}
+
+struct Metric *metrics_addCounterVector(struct MetricsRegistry *registry, const char *name, const char *labelName,
+										int firstLabel, size_t count, const char *help) {
+	struct Metric *metric = addMetric(registry, METRIC_COUNTER_VECTOR, name, NULL, help, count);
+	if (metric) {
+		metric->labelName  = labelName;
+		metric->firstLabel = firstLabel;
+	}
+
+	return metric;
+}
+
+struct Metric *metrics_addHistogram(struct MetricsRegistry *registry, const char *name, const char *labels,
+									uint64_t maxValue, const char *help) {
+	return addMetric(registry, METRIC_HISTOGRAM, name, labels, help, bucketIndex(maxValue) + 3);
+}
+
+
+////////////////////////////////// Updating //////////////////////////////////
+
+void metrics_increment(struct Metric *counter, uint64_t amount) {
+	if (counter) {
+		atomic_fetch_add_explicit(shardCell(counter, 0), amount, memory_order_relaxed);
+	}
+}
+
+void metrics_incrementAt(struct Metric *vector, int label, uint64_t amount) {
+	if (!vector || label < vector->firstLabel || (size_t) (label - vector->firstLabel) >= vector->cellCount) {
+		return;
+	}
+
+	atomic_fetch_add_explicit(shardCell(vector, (size_t) (label - vector->firstLabel)), amount, memory_order_relaxed);
+}
+
+void metrics_set(struct Metric *gauge, double value) {
+	if (!gauge) {
+		return;
+	}
+
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	atomic_store_explicit(&gauge->gauge, bits, memory_order_relaxed);
+}
+
+void metrics_record(struct Metric *histogram, uint64_t value) {
+	if (!histogram) {
+		return;
+	}
+
+	size_t bucketCount = histogram->cellCount - 2;
+	size_t bucket      = bucketIndex(value);
+
+	atomic_fetch_add_explicit(shardCell(histogram, bucket < bucketCount ? bucket : bucketCount), 1,
+							  memory_order_relaxed);
+	atomic_fetch_add_explicit(shardCell(histogram, bucketCount + 1), value, memory_order_relaxed);
+}
+
+uint64_t metrics_timeNs() {
+	struct timespec now;
+#ifndef _WIN32
+	clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+	timespec_get(&now, TIME_UTC);
+#endif
+
+	return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+
+////////////////////////////////// Exposition //////////////////////////////////
+
+struct Output {
+	char **buffer;
+	size_t *capacity;
+	size_t length;
+	bool failed;
+};
+
+static void append(struct Output *output, const char *format, ...) {
+	if (output->failed) {
+		return;
+	}
+
+	while (true) {
+		size_t available = *output->capacity - output->length;
+
+		va_list arguments;
+		va_start(arguments, format);
+		int length = *output->buffer ? vsnprintf(*output->buffer + output->length, available, format, arguments) : -1;
+		va_end(arguments);
+
+		if (length >= 0 && (size_t) length < available) {
+			output->length += (size_t) length;
+			return;
+		}
+
+		size_t capacity = *output->capacity ? 2 * *output->capacity : 4096;
+		char *buffer    = memory_realloc(MEMORY_METRICS, *output->buffer, capacity);
+		if (!buffer) {
+			output->failed = true;
+			return;
+		}
+		*output->buffer   = buffer;
+		*output->capacity = capacity;
+	}
+}
+
+static void appendHistogram(struct Output *output, const struct Metric *metric) {
+	const char *labels    = metric->labels ? metric->labels : "";
+	const char *separator = metric->labels ? "," : "";
+	size_t bucketCount    = metric->cellCount - 2;
+
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < bucketCount; i++) {
+		cumulative += sumCell(metric, i);
+		append(output, "%s_bucket{%s%sle=\"%llu\"} %llu\n", metric->name, labels, separator,
+			   (unsigned long long) bucketBound(i), (unsigned long long) cumulative);
+	}
+	cumulative += sumCell(metric, bucketCount);
+
+	append(output, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", metric->name, labels, separator,
+		   (unsigned long long) cumulative);
+	if (metric->labels) {
+		append(output, "%s_sum{%s} %llu\n", metric->name, labels,
+			   (unsigned long long) sumCell(metric, bucketCount + 1));
+		append(output, "%s_count{%s} %llu\n", metric->name, labels, (unsigned long long) cumulative);
+	} else {
+		append(output, "%s_sum %llu\n", metric->name, (unsigned long long) sumCell(metric, bucketCount + 1));
+		append(output, "%s_count %llu\n", metric->name, (unsigned long long) cumulative);
+	}
+}
+
+size_t metrics_format(struct MetricsRegistry *registry, char **buffer, size_t *capacity) {
+	static const char *typeNames[] = { "counter", "gauge", "counter", "histogram" };
+
+	struct Output output = { buffer, capacity, 0, false };
+	// Guarantees a terminated buffer even if there are no metrics
+	append(&output, "");
+
+	for (size_t i = 0; i < registry->metricCount; i++) {
+		const struct Metric *metric = &registry->metrics[i];
+
+		// Metrics sharing a name (with different labels) are described once
+		if (i == 0 || strcmp(registry->metrics[i - 1].name, metric->name) != 0) {
+			append(&output, "# HELP %s %s\n# TYPE %s %s\n", metric->name, metric->help, metric->name,
+				   typeNames[metric->type]);
+		}
+
+		switch (metric->type) {
+			case METRIC_COUNTER:
+			case METRIC_GAUGE: {
+				char value[32];
+				if (metric->type == METRIC_COUNTER) {
+					snprintf(value, sizeof(value), "%llu", (unsigned long long) sumCell(metric, 0));
+				} else {
+					uint64_t bits = atomic_load_explicit(&metric->gauge, memory_order_relaxed);
+					double gauge;
+					memcpy(&gauge, &bits, sizeof(gauge));
+					snprintf(value, sizeof(value), "%.17g", gauge);
+				}
+
+				if (metric->labels) {
+					append(&output, "%s{%s} %s\n", metric->name, metric->labels, value);
+				} else {
+					append(&output, "%s %s\n", metric->name, value);
+				}
+				break;
+			}
+			case METRIC_COUNTER_VECTOR:
+				for (size_t j = 0; j < metric->cellCount; j++) {
+					append(&output, "%s{%s=\"%d\"} %llu\n", metric->name, metric->labelName,
+						   metric->firstLabel + (int) j, (unsigned long long) sumCell(metric, j));
+				}
+				break;
+			case METRIC_HISTOGRAM:
+				appendHistogram(&output, metric);
+				break;
+		}
+	}
+
+	return output.failed ? 0 : output.length;
+}
+
+
+////////////////////////////////// Server //////////////////////////////////
+
+#ifdef __linux__
+
+struct MetricsClient {
+	char request[MAX_REQUEST_SIZE];
+	size_t received;
+	// The response (including the HTTP header, if the client sent a request) once the request is complete
+	char *response;
+	size_t responseLength;
+	size_t sent;
+};
+
+struct MetricsServer {
+	struct MetricsRegistry *registry;
+	struct SocketServer sockets;
+	pthread_t thread;
+
+	// Indexed by the clients' slots in sockets
+	struct MetricsClient clients[METRICS_MAX_CLIENTS];
+	// Only used by the server's thread
+	char *buffer;
+	size_t capacity;
+};
+
+static size_t slotOf(const struct MetricsServer *server, const struct MetricsClient *client) {
+	return (size_t) (client - server->clients);
+}
+
+static int clientFD(const struct MetricsServer *server, const struct MetricsClient *client) {
+	return server->sockets.clientFDs[slotOf(server, client)];
+}
+
+static void closeClient(struct MetricsServer *server, struct MetricsClient *client) {
+	server_closeClient(&server->sockets, slotOf(server, client));
+	memory_free(client->response);
+
+	client->response = NULL;
+}
+
+static void acceptClients(struct MetricsServer *server) {
+	int slot;
+	while ((slot = server_accept(&server->sockets)) >= 0) {
+		struct MetricsClient *client = &server->clients[slot];
+		client->received             = 0;
+		client->responseLength       = 0;
+		client->sent                 = 0;
+	}
+}
+
+// Renders the metrics into the client's response
+static bool prepareResponse(struct MetricsServer *server, struct MetricsClient *client) {
+	size_t length = metrics_format(server->registry, &server->buffer, &server->capacity);
+	if (length == 0) {
+		return false;
+	}
+
+	// Plain HTTP clients (e.g. Prometheus through a proxy or curl --unix-socket) get a proper response, anything else
+	// (e.g. socat) just the metrics
+	char header[160] = "";
+	if (client->received >= 4 && memcmp(client->request, "GET ", 4) == 0) {
+		snprintf(header, sizeof(header),
+				 "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", length);
+	}
+
+	size_t headerLength = strlen(header);
+	client->response    = memory_alloc(MEMORY_METRICS, headerLength + length);
+	if (!client->response) {
+		return false;
+	}
+	memcpy(client->response, header, headerLength);
+	memcpy(client->response + headerLength, server->buffer, length);
+	client->responseLength = headerLength + length;
+
+	return server_watchClient(&server->sockets, slotOf(server, client), EPOLLOUT);
+}
+
+static void readRequest(struct MetricsServer *server, struct MetricsClient *client) {
+	int fd        = clientFD(server, client);
+	bool complete = false;
+
+	while (!complete) {
+		ssize_t count = read(fd, client->request + client->received, MAX_REQUEST_SIZE - 1 - client->received);
+		if (count < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return;
+			}
+			closeClient(server, client);
+			return;
+		}
+
+		client->received += (size_t) count;
+		client->request[client->received] = '\0';
+
+		// The request is complete once the client stops sending, sends an empty line or sends too much
+		complete = count == 0 || strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n")
+				   || client->received == MAX_REQUEST_SIZE - 1;
+	}
+
+	if (!prepareResponse(server, client)) {
+		closeClient(server, client);
+	}
+}
+
+static void writeResponse(struct MetricsServer *server, struct MetricsClient *client) {
+	int fd = clientFD(server, client);
+
+	while (client->sent < client->responseLength) {
+		ssize_t count =
+			send(fd, client->response + client->sent, client->responseLength - client->sent, MSG_NOSIGNAL);
+		if (count < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return;
+			}
+			break;
+		}
+		client->sent += (size_t) count;
+	}
+
+	closeClient(server, client);
+}
+
+static void *serve(void *arg) {
+	struct MetricsServer *server = arg;
+
+	while (true) {
+		struct epoll_event events[METRICS_MAX_CLIENTS + 2];
+		int count = server_wait(&server->sockets, events, METRICS_MAX_CLIENTS + 2);
+		if (count < 0) {
+			return NULL;
+		}
+
+		for (int i = 0; i < count; i++) {
+			uint64_t tag = events[i].data.u64;
+			if (tag == SERVER_TAG_WAKE) {
+				// Only used to stop the server
+				return NULL;
+			}
+			if (tag == SERVER_TAG_LISTENER) {
+				acceptClients(server);
+				continue;
+			}
+
+			struct MetricsClient *client = &server->clients[tag];
+			if (server->sockets.clientFDs[tag] < 0) {
+				continue;
+			}
+			if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & (EPOLLIN | EPOLLOUT))) {
+				closeClient(server, client);
+			} else if (client->response) {
+				writeResponse(server, client);
+			} else {
+				readRequest(server, client);
+			}
+		}
+	}
+}
+
+static void destroyServer(struct MetricsServer *server) {
+	for (size_t i = 0; i < METRICS_MAX_CLIENTS; i++) {
+		memory_free(server->clients[i].response);
+	}
+	server_close(&server->sockets);
+
+	memory_free(server->buffer);
+	memory_free(server);
+}
+
+bool metrics_startServer(struct MetricsRegistry *registry, const char *path) {
+	struct MetricsServer *server = memory_calloc(MEMORY_METRICS, 1, sizeof(struct MetricsServer));
+	if (!server) {
+		return false;
+	}
+
+	server->registry = registry;
+
+	if (!server_open(&server->sockets, path, METRICS_MAX_CLIENTS)
+		|| pthread_create(&server->thread, NULL, &serve, server) != 0) {
+		destroyServer(server);
+		return false;
+	}
+
+	registry->server = server;
+
+	return true;
+}
+
+static void stopServer(struct MetricsRegistry *registry) {
+	struct MetricsServer *server = registry->server;
+	if (!server) {
+		return;
+	}
+
+	if (server_wake(&server->sockets)) {
+		pthread_join(server->thread, NULL);
+	}
+
+	destroyServer(server);
+	registry->server = NULL;
+}
+
+#else
+
+bool metrics_startServer(struct MetricsRegistry *registry, const char *path) {
+	(void) registry;
+	(void) path;
+
+	return false;
+}
+
+static void stopServer(struct MetricsRegistry *registry) {
+	(void) registry;
+}
+
+#endif
@@ -0,0 +1,101 @@
+/// This header file declares the plugin's metrics registry.
+///
+/// Counters, gauges and histograms are registered once (while the plugin is initialized) and updated from anywhere,
+/// including audio threads: Every thread is assigned one of METRICS_SHARDS shards and only ever adds to its own shard's
+/// cells with relaxed atomic operations, so updates neither lock nor contend on the same cache line as other threads.
+/// The shards are only summed up when the metrics are scraped.
+///
+/// Histograms are log-linear like HDR histograms: Every power of two is split into two buckets, which keeps the
+/// relative error below 50% with a fixed amount of buckets no matter how large the values get.
+///
+/// On Linux the metrics can be served in Prometheus' text format on a Unix domain socket. A small epoll loop on a
+/// thread of its own answers every connection (plain HTTP requests, e.g. from curl --unix-socket, or simply closing
+/// the sending direction of the socket) with the current values.
+///
+/// Metric names and labels are not copied, so they have to be string literals (or otherwise outlive the registry).
+/// Updating a NULL metric does nothing, so metrics that failed to register can simply be used anyway.
+
+#ifndef MUMBLE_PLUGIN_METRICS_H_
+#define MUMBLE_PLUGIN_METRICS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The amount of shards every cell is split into
+#define METRICS_SHARDS 16
+#define METRICS_MAX_METRICS 64
+/// The amount of values that can be stored per shard (counters use one, vectors one per label and histograms two more
+/// than their buckets)
+#define METRICS_MAX_CELLS 1024
+/// The maximum amount of clients being served at the same time
+#define METRICS_MAX_CLIENTS 8
+
+struct MetricsRegistry;
+struct Metric;
+
+/// Creates an empty registry. All memory the cells need is allocated here.
+///
+/// @returns The new registry or NULL if allocating it failed
+struct MetricsRegistry *metrics_create();
+
+/// Stops the server (if it is running) and destroys the registry. No thread may update any of its metrics anymore.
+void metrics_destroy(struct MetricsRegistry *registry);
+
+/// Registers a counter
+///
+/// NOTE: Registering isn't thread-safe and should happen before any metric is updated or scraped
+///
+/// @param name The metric's name. Several metrics may share a name if they have different labels.
+/// @param labels The labels in Prometheus' syntax (e.g. stage="input") or NULL
+/// @param help The description of the metric
+/// @returns The counter or NULL if the registry is full
+struct Metric *metrics_addCounter(struct MetricsRegistry *registry, const char *name, const char *labels,
+								  const char *help);
+
+/// Registers a gauge (see metrics_addCounter)
+struct Metric *metrics_addGauge(struct MetricsRegistry *registry, const char *name, const char *labels,
+								const char *help);
+
+/// Registers a set of counters that are told apart by an integer label ranging from firstLabel to
+/// firstLabel + count - 1 (see metrics_addCounter)
+struct Metric *metrics_addCounterVector(struct MetricsRegistry *registry, const char *name, const char *labelName,
+										int firstLabel, size_t count, const char *help);
+
+/// Registers a histogram (see metrics_addCounter)
+///
+/// @param maxValue The largest value that is expected. Larger values are only counted in the +Inf bucket.
+struct Metric *metrics_addHistogram(struct MetricsRegistry *registry, const char *name, const char *labels,
+									uint64_t maxValue, const char *help);
+
+/// Adds the given amount to a counter
+void metrics_increment(struct Metric *counter, uint64_t amount);
+
+/// Adds the given amount to one of the counters of a counter vector (labels out of range are ignored)
+void metrics_incrementAt(struct Metric *vector, int label, uint64_t amount);
+
+void metrics_set(struct Metric *gauge, double value);
+
+/// Adds a value to a histogram
+void metrics_record(struct Metric *histogram, uint64_t value);
+
+/// @returns A monotonic timestamp in nanoseconds, e.g. for measuring durations that are recorded in histograms
+uint64_t metrics_timeNs();
+
+/// Renders all metrics in Prometheus' text format
+///
+/// @param[in,out] buffer The buffer to render into, grown as needed (it may be NULL initially and has to be freed with
+/// memory_free)
+/// @param[in,out] capacity The size of the buffer
+/// @returns The length of the text (without the terminator) or 0 if growing the buffer failed
+size_t metrics_format(struct MetricsRegistry *registry, char **buffer, size_t *capacity);
+
+/// Starts serving the metrics on a Unix domain socket at the given path. A socket left at the path is replaced,
+/// anything else there makes starting fail.
+///
+/// NOTE: This is only supported on Linux
+///
+/// @returns Whether the server has been started
+bool metrics_startServer(struct MetricsRegistry *registry, const char *path);
+
+#endif // MUMBLE_PLUGIN_METRICS_H_
@@ -0,0 +1,291 @@
+#include "mumblesettings.h"
+#include "memory.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WORD_COUNT ((sizeof(struct MumbleSettings) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+// The maximum size of a string setting's field in struct MumbleSettings
+#define MAX_STRING_SIZE 256
+
+enum SettingType { SETTING_BOOL, SETTING_INT, SETTING_DOUBLE, SETTING_STRING };
+
+struct SettingDescriptor {
+	mumble_settings_key_t key;
+	enum SettingType type;
+	/// Where the value is stored in struct MumbleSettings
+	size_t offset;
+	/// The size of the field (the buffer size for strings)
+	size_t size;
+};
+
+#define SETTING(key, type, field) \
+	{ key, type, offsetof(struct MumbleSettings, field), sizeof(((struct MumbleSettings *) 0)->field) }
+
+// Mumble doesn't expose any boolean or string settings yet, but new keys of any type only need an entry here (and a
+// field in struct MumbleSettings)
+static const struct SettingDescriptor descriptors[MUMBLESETTINGS_KEY_COUNT] = {
+	SETTING(MUMBLE_SK_AUDIO_INPUT_VOICE_HOLD, SETTING_INT, voiceHold),
+	SETTING(MUMBLE_SK_AUDIO_INPUT_VAD_SILENCE_THRESHOLD, SETTING_DOUBLE, vadSilenceThreshold),
+	SETTING(MUMBLE_SK_AUDIO_INPUT_VAD_SPEECH_THRESHOLD, SETTING_DOUBLE, vadSpeechThreshold),
+	SETTING(MUMBLE_SK_AUDIO_OUTPUT_PA_MINIMUM_DISTANCE, SETTING_DOUBLE, minimumDistance),
+	SETTING(MUMBLE_SK_AUDIO_OUTPUT_PA_MAXIMUM_DISTANCE, SETTING_DOUBLE, maximumDistance),
+	SETTING(MUMBLE_SK_AUDIO_OUTPUT_PA_BLOOM, SETTING_DOUBLE, bloom),
+	SETTING(MUMBLE_SK_AUDIO_OUTPUT_PA_MINIMUM_VOLUME, SETTING_DOUBLE, minimumVolume),
+};
+
+struct MumbleSettingsMirror {
+	struct MumbleSettingsBackend backend;
+
+	// Only accessed by the thread that refreshes and changes settings
+	struct MumbleSettings current;
+	uint64_t lastRefreshMs;
+
+	// The published snapshot, protected by the sequence counter (odd while it is being written). The words are atomic
+	// so that a reader racing with the writer never performs a data race, it just retries.
+	atomic_uint sequence;
+	_Atomic uint64_t words[WORD_COUNT];
+};
+
+
+static const struct SettingDescriptor *findDescriptor(mumble_settings_key_t key) {
+	for (size_t i = 0; i < MUMBLESETTINGS_KEY_COUNT; i++) {
+		if (descriptors[i].key == key) {
+			return &descriptors[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void publish(struct MumbleSettingsMirror *mirror) {
+	uint64_t words[WORD_COUNT] = { 0 };
+	memcpy(words, &mirror->current, sizeof(mirror->current));
+
+	unsigned sequence = atomic_load_explicit(&mirror->sequence, memory_order_relaxed);
+	atomic_store_explicit(&mirror->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	for (size_t i = 0; i < WORD_COUNT; i++) {
+		atomic_store_explicit(&mirror->words[i], words[i], memory_order_relaxed);
+	}
+
+	atomic_store_explicit(&mirror->sequence, sequence + 2, memory_order_release);
+}
+
+// Reads a single setting into the given snapshot
+//
+// Returns whether the value could be read
+static bool readSetting(const struct MumbleSettingsBackend *backend, const struct SettingDescriptor *descriptor,
+						struct MumbleSettings *settings) {
+	void *field = (char *) settings + descriptor->offset;
+
+	switch (descriptor->type) {
+		case SETTING_BOOL:
+			return backend->getBool(backend->pluginID, descriptor->key, field) == MUMBLE_STATUS_OK;
+		case SETTING_INT:
+			return backend->getInt(backend->pluginID, descriptor->key, field) == MUMBLE_STATUS_OK;
+		case SETTING_DOUBLE:
+			return backend->getDouble(backend->pluginID, descriptor->key, field) == MUMBLE_STATUS_OK;
+		case SETTING_STRING: {
+			const char *value;
+			if (backend->getString(backend->pluginID, descriptor->key, &value) != MUMBLE_STATUS_OK) {
+				return false;
+			}
+
+			// The string has been allocated by Mumble, so it is copied (truncating it if necessary) and given back
+			size_t length = strlen(value);
+			if (length >= descriptor->size) {
+				length = descriptor->size - 1;
+			}
+			memcpy(field, value, length);
+			((char *) field)[length] = '\0';
+			backend->freeMemory(backend->pluginID, value);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Publishes the given snapshot if it differs from the current one
+//
+// Returns whether it did
+static bool update(struct MumbleSettingsMirror *mirror, struct MumbleSettings *settings) {
+	settings->changedKeys = 0;
+	for (size_t i = 0; i < MUMBLESETTINGS_KEY_COUNT; i++) {
+		const struct SettingDescriptor *descriptor = &descriptors[i];
+		if (memcmp((const char *) settings + descriptor->offset, (const char *) &mirror->current + descriptor->offset,
+				   descriptor->size)
+			!= 0) {
+			settings->changedKeys |= 1u << descriptor->key;
+		}
+	}
+
+	if (settings->changedKeys == 0) {
+		return false;
+	}
+
+	settings->generation = mirror->current.generation + 1;
+	mirror->current      = *settings;
+	publish(mirror);
+
+	return true;
+}
+
+struct MumbleSettingsMirror *mumblesettings_create(const struct MumbleSettingsBackend *backend) {
+	struct MumbleSettingsMirror *mirror = memory_calloc(MEMORY_SETTINGS, 1, sizeof(struct MumbleSettingsMirror));
+	if (!mirror) {
+		return NULL;
+	}
+
+	mirror->backend = *backend;
+
+	// Mumble's defaults, used for anything that can't be read
+	mirror->current.voiceHold           = 50;
+	mirror->current.vadSilenceThreshold = 0.8;
+	mirror->current.vadSpeechThreshold  = 0.98;
+	mirror->current.minimumDistance     = 1.0;
+	mirror->current.maximumDistance     = 15.0;
+	mirror->current.bloom               = 0.5;
+	mirror->current.minimumVolume       = 0.8;
+
+	atomic_init(&mirror->sequence, 0);
+	for (size_t i = 0; i < WORD_COUNT; i++) {
+		atomic_init(&mirror->words[i], 0);
+	}
+	publish(mirror);
+
+	mumblesettings_refresh(mirror, 0);
+
+	return mirror;
+}
+
+void mumblesettings_destroy(struct MumbleSettingsMirror *mirror) {
+	memory_free(mirror);
+}
+
+void mumblesettings_get(const struct MumbleSettingsMirror *mirror, struct MumbleSettings *settings) {
+	// Readers never write, but the C11 atomic functions don't accept pointers to const
+	struct MumbleSettingsMirror *shared = (struct MumbleSettingsMirror *) mirror;
+	uint64_t words[WORD_COUNT];
+
+	while (true) {
+		unsigned before = atomic_load_explicit(&shared->sequence, memory_order_acquire);
+		if (before & 1) {
+			continue;
+		}
+
+		for (size_t i = 0; i < WORD_COUNT; i++) {
+			words[i] = atomic_load_explicit(&shared->words[i], memory_order_relaxed);
+		}
+
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&shared->sequence, memory_order_relaxed) == before) {
+			break;
+		}
+	}
+
+	memcpy(settings, words, sizeof(*settings));
+}
+
+bool mumblesettings_refresh(struct MumbleSettingsMirror *mirror, uint64_t nowMs) {
+	mirror->lastRefreshMs = nowMs;
+
+	struct MumbleSettings settings = mirror->current;
+	for (size_t i = 0; i < MUMBLESETTINGS_KEY_COUNT; i++) {
+		struct MumbleSettings value = settings;
+		// Only keep what has been read successfully
+		if (readSetting(&mirror->backend, &descriptors[i], &value)) {
+			memcpy((char *) &settings + descriptors[i].offset, (const char *) &value + descriptors[i].offset,
+				   descriptors[i].size);
+		}
+	}
+
+	return update(mirror, &settings);
+}
+
+bool mumblesettings_refreshIfDue(struct MumbleSettingsMirror *mirror, uint64_t nowMs) {
+	if (nowMs - mirror->lastRefreshMs < MUMBLESETTINGS_REFRESH_INTERVAL_MS) {
+		return false;
+	}
+
+	return mumblesettings_refresh(mirror, nowMs);
+}
+
+// Stores a value that has been written to Mumble successfully
+static void storeValue(struct MumbleSettingsMirror *mirror, const struct SettingDescriptor *descriptor,
+					   const void *value, size_t size) {
+	struct MumbleSettings settings = mirror->current;
+	memcpy((char *) &settings + descriptor->offset, value, size);
+	update(mirror, &settings);
+}
+
+// Looks up the key and checks its type
+static mumble_error_t checkKey(mumble_settings_key_t key, enum SettingType type,
+							   const struct SettingDescriptor **descriptor) {
+	*descriptor = findDescriptor(key);
+	if (!*descriptor) {
+		return MUMBLE_EC_UNKNOWN_SETTINGS_KEY;
+	}
+
+	return (*descriptor)->type == type ? MUMBLE_STATUS_OK : MUMBLE_EC_WRONG_SETTINGS_TYPE;
+}
+
+mumble_error_t mumblesettings_setBool(struct MumbleSettingsMirror *mirror, mumble_settings_key_t key, bool value) {
+	const struct SettingDescriptor *descriptor;
+	mumble_error_t error = checkKey(key, SETTING_BOOL, &descriptor);
+	if (error == MUMBLE_STATUS_OK) {
+		error = mirror->backend.setBool(mirror->backend.pluginID, key, value);
+	}
+	if (error == MUMBLE_STATUS_OK) {
+		storeValue(mirror, descriptor, &value, sizeof(value));
+	}
+
+	return error;
+}
+
+mumble_error_t mumblesettings_setInt(struct MumbleSettingsMirror *mirror, mumble_settings_key_t key, int64_t value) {
+	const struct SettingDescriptor *descriptor;
+	mumble_error_t error = checkKey(key, SETTING_INT, &descriptor);
+	if (error == MUMBLE_STATUS_OK) {
+		error = mirror->backend.setInt(mirror->backend.pluginID, key, value);
+	}
+	if (error == MUMBLE_STATUS_OK) {
+		storeValue(mirror, descriptor, &value, sizeof(value));
+	}
+
+	return error;
+}
+
+mumble_error_t mumblesettings_setDouble(struct MumbleSettingsMirror *mirror, mumble_settings_key_t key, double value) {
+	const struct SettingDescriptor *descriptor;
+	mumble_error_t error = checkKey(key, SETTING_DOUBLE, &descriptor);
+	if (error == MUMBLE_STATUS_OK) {
+		error = mirror->backend.setDouble(mirror->backend.pluginID, key, value);
+	}
+	if (error == MUMBLE_STATUS_OK) {
+		storeValue(mirror, descriptor, &value, sizeof(value));
+	}
+
+	return error;
+}
+
+mumble_error_t mumblesettings_setString(struct MumbleSettingsMirror *mirror, mumble_settings_key_t key,
+										const char *value) {
+	const struct SettingDescriptor *descriptor;
+	mumble_error_t error = checkKey(key, SETTING_STRING, &descriptor);
+	if (error == MUMBLE_STATUS_OK) {
+		error = mirror->backend.setString(mirror->backend.pluginID, key, value);
+	}
+	if (error == MUMBLE_STATUS_OK) {
+		// The mirror keeps the (possibly truncated) value including its terminator
+		char buffer[MAX_STRING_SIZE] = { 0 };
+		strncpy(buffer, value, descriptor->size - 1);
+		storeValue(mirror, descriptor, buffer, descriptor->size);
+	}
+
+	return error;
+}
@@ -0,0 +1,135 @@
+/// This header file declares a cached mirror of Mumble's own settings (see mumble_settings_key_t).
+///
+/// Reading a setting through the API crosses into Mumble (and blocks on its main thread when called from anywhere
+/// else), which is too expensive for code that needs settings like the positional audio distances on every audio frame.
+/// The mirror reads all keys into a typed snapshot that is refreshed at a low rate or on demand. Snapshots are
+/// published through a sequence lock, so mumblesettings_get never blocks and never calls into Mumble, which makes it
+/// safe to use from audio callbacks.
+///
+/// The plugin's own changes to Mumble's settings go through the mumblesettings_set* functions, which forward them to
+/// Mumble and publish the new value right away instead of waiting for the next refresh.
+///
+/// NOTE: mumblesettings_refresh, mumblesettings_refreshIfDue and the mumblesettings_set* functions call into Mumble and
+/// must all be called from the same thread (usually Mumble's main thread). mumblesettings_get may be called from any
+/// thread.
+
+#ifndef MUMBLE_PLUGIN_MUMBLESETTINGS_H_
+#define MUMBLE_PLUGIN_MUMBLESETTINGS_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The amount of keys in mumble_settings_key_t (not counting MUMBLE_SK_INVALID)
+#define MUMBLESETTINGS_KEY_COUNT 7
+/// How often mumblesettings_refreshIfDue actually re-reads the settings
+#define MUMBLESETTINGS_REFRESH_INTERVAL_MS 1000
+
+/// A snapshot of Mumble's settings. Settings that couldn't be read keep their previous value (initially Mumble's
+/// default).
+struct MumbleSettings {
+	/// Incremented whenever a snapshot with different values is published
+	uint64_t generation;
+	/// The keys (as 1 << key) whose values differ from the previous snapshot
+	uint32_t changedKeys;
+
+	/// MUMBLE_SK_AUDIO_INPUT_VOICE_HOLD (in 10ms frames)
+	int64_t voiceHold;
+	/// MUMBLE_SK_AUDIO_INPUT_VAD_SILENCE_THRESHOLD
+	double vadSilenceThreshold;
+	/// MUMBLE_SK_AUDIO_INPUT_VAD_SPEECH_THRESHOLD
+	double vadSpeechThreshold;
+	/// MUMBLE_SK_AUDIO_OUTPUT_PA_MINIMUM_DISTANCE (in meters)
+	double minimumDistance;
+	/// MUMBLE_SK_AUDIO_OUTPUT_PA_MAXIMUM_DISTANCE (in meters)
+	double maximumDistance;
+	/// MUMBLE_SK_AUDIO_OUTPUT_PA_BLOOM
+	double bloom;
+	/// MUMBLE_SK_AUDIO_OUTPUT_PA_MINIMUM_VOLUME (the volume at the maximum distance)
+	double minimumVolume;
+};
+
+// These match the signatures of the respective MumbleAPI functions, so they can be assigned directly
+typedef mumble_error_t(PLUGIN_CALLING_CONVENTION *MumbleSettingsGetBoolFunction)(mumble_plugin_id_t callerID,
+																				 mumble_settings_key_t key,
+																				 bool *outValue);
+typedef mumble_error_t(PLUGIN_CALLING_CONVENTION *MumbleSettingsGetIntFunction)(mumble_plugin_id_t callerID,
+																				mumble_settings_key_t key,
+																				int64_t *outValue);
+typedef mumble_error_t(PLUGIN_CALLING_CONVENTION *MumbleSettingsGetDoubleFunction)(mumble_plugin_id_t callerID,
+																				   mumble_settings_key_t key,
+																				   double *outValue);
+typedef mumble_error_t(PLUGIN_CALLING_CONVENTION *MumbleSettingsGetStringFunction)(mumble_plugin_id_t callerID,
+																				   mumble_settings_key_t key,
+																				   const char **outValue);
+typedef mumble_error_t(PLUGIN_CALLING_CONVENTION *MumbleSettingsSetBoolFunction)(mumble_plugin_id_t callerID,
+																				 mumble_settings_key_t key,
+																				 bool value);
+typedef mumble_error_t(PLUGIN_CALLING_CONVENTION *MumbleSettingsSetIntFunction)(mumble_plugin_id_t callerID,
+																				mumble_settings_key_t key,
+																				int64_t value);
+typedef mumble_error_t(PLUGIN_CALLING_CONVENTION *MumbleSettingsSetDoubleFunction)(mumble_plugin_id_t callerID,
+																				   mumble_settings_key_t key,
+																				   double value);
+typedef mumble_error_t(PLUGIN_CALLING_CONVENTION *MumbleSettingsSetStringFunction)(mumble_plugin_id_t callerID,
+																				   mumble_settings_key_t key,
+																				   const char *value);
+typedef mumble_error_t(PLUGIN_CALLING_CONVENTION *MumbleSettingsFreeFunction)(mumble_plugin_id_t callerID,
+																			  const void *pointer);
+
+/// The API functions the mirror uses to access Mumble's settings (usually the ones of the plugin's MumbleAPI struct)
+struct MumbleSettingsBackend {
+	mumble_plugin_id_t pluginID;
+	MumbleSettingsGetBoolFunction getBool;
+	MumbleSettingsGetIntFunction getInt;
+	MumbleSettingsGetDoubleFunction getDouble;
+	MumbleSettingsGetStringFunction getString;
+	MumbleSettingsSetBoolFunction setBool;
+	MumbleSettingsSetIntFunction setInt;
+	MumbleSettingsSetDoubleFunction setDouble;
+	MumbleSettingsSetStringFunction setString;
+	/// Frees the strings returned by getString
+	MumbleSettingsFreeFunction freeMemory;
+};
+
+struct MumbleSettingsMirror;
+
+/// Creates the mirror and reads all settings once
+///
+/// @param backend The functions used to access Mumble's settings. The struct is copied.
+/// @returns The new mirror or NULL if allocating it failed
+struct MumbleSettingsMirror *mumblesettings_create(const struct MumbleSettingsBackend *backend);
+
+void mumblesettings_destroy(struct MumbleSettingsMirror *mirror);
+
+/// Copies the current snapshot. This never blocks and never calls into Mumble.
+///
+/// @param[out] settings The snapshot
+void mumblesettings_get(const struct MumbleSettingsMirror *mirror, struct MumbleSettings *settings);
+
+/// Re-reads all settings from Mumble and publishes them if any of them changed
+///
+/// @param nowMs The current time in milliseconds (monotonic)
+/// @returns Whether any setting changed
+bool mumblesettings_refresh(struct MumbleSettingsMirror *mirror, uint64_t nowMs);
+
+/// Calls mumblesettings_refresh if the last refresh is more than MUMBLESETTINGS_REFRESH_INTERVAL_MS ago. This is cheap
+/// enough to be called from frequently invoked callbacks.
+///
+/// @param nowMs The current time in milliseconds (monotonic)
+/// @returns Whether any setting changed
+bool mumblesettings_refreshIfDue(struct MumbleSettingsMirror *mirror, uint64_t nowMs);
+
+/// Changes a setting in Mumble and, if that succeeded, in the mirror. The value's type has to match the key's.
+///
+/// @returns The error code returned by Mumble, MUMBLE_EC_UNKNOWN_SETTINGS_KEY if the mirror doesn't know the key or
+/// MUMBLE_EC_WRONG_SETTINGS_TYPE if the key isn't of the respective type
+mumble_error_t mumblesettings_setBool(struct MumbleSettingsMirror *mirror, mumble_settings_key_t key, bool value);
+mumble_error_t mumblesettings_setInt(struct MumbleSettingsMirror *mirror, mumble_settings_key_t key, int64_t value);
+mumble_error_t mumblesettings_setDouble(struct MumbleSettingsMirror *mirror, mumble_settings_key_t key, double value);
+mumble_error_t mumblesettings_setString(struct MumbleSettingsMirror *mirror, mumble_settings_key_t key,
+										const char *value);
+
+#endif // MUMBLE_PLUGIN_MUMBLESETTINGS_H_
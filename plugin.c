@@ -1,28 +1,1086 @@
 #include "MumblePlugin_v_1_0_x.h"
+#include "acoustics.h"
+#include "commands.h"
+#include "config.h"
+#include "connections.h"
+#include "control.h"
+#include "games.h"
+#include "governor.h"
+#include "keybindings.h"
+#include "logger.h"
+#include "memory.h"
+#include "meters.h"
+#include "metrics.h"
+#include "mumblesettings.h"
+#include "positional.h"
+#include "recipients.h"
+#include "replica.h"
+#include "soundboard.h"
+#include "spatial.h"
+#include "stages.h"
+#include "textindex.h"
+#include "transcription.h"
+#include "transport.h"
+#include "update.h"
 
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
 
-struct MumbleAPI_v_1_0_x mumbleAPI;
-mumble_plugin_id_t ownID;
+#define TRANSPORT_TICK_INTERVAL_MS 50
+#define TRANSPORT_OUTBOX_SIZE 256
+#define LOG_FILE_NAME "hello_mumble.log"
+#define LOG_FILE_MAX_SIZE (1024 * 1024)
+#define LOG_FILE_COUNT 3
+#define METRICS_SOCKET_NAME "metrics.sock"
+#define CONTROL_SOCKET_NAME "control.sock"
+// The longest DSP duration that is told apart from even longer ones
+#define METRICS_MAX_DSP_NS 100000000
+// The longest caption delay that is told apart from even longer ones
+#define METRICS_MAX_CAPTION_DELAY_MS 60000
+
+static struct MumbleAPI_v_1_0_x mumbleAPI;
+static mumble_plugin_id_t ownID;
+
+// Messages are queued from any thread and forwarded to Mumble (and the log file) by the ticker
+static struct Logger *logger;
+// Whether the log file is open (only accessed by the ticker, which drains the logger)
+static bool logFileOpen;
+
+// The stages the governor degrades once the audio callbacks take too long, in the order they are given up. They are
+// added to the governor in this order, so that their indices are the governor's stage indices.
+enum GovernedStage { GOVERNED_METERS, GOVERNED_REVERB, GOVERNED_ACOUSTICS, GOVERNED_STAGE_COUNT };
+static const char *governedStageNames[GOVERNED_STAGE_COUNT] = { "meters", "reverb", "acoustics" };
+// The tiers of the meters (the other stages are either on or bypassed)
+enum MetersTier { METERS_TIER_FULL, METERS_TIER_LEVELS, METERS_TIER_BYPASSED, METERS_TIER_COUNT };
+
+// Keeps the time spent in the audio callbacks within the configured share of the audio's duration
+static struct Governor *governor;
+
+// Updated from any thread (including audio threads) without locking and served on a Unix domain socket
+static struct MetricsRegistry *metrics;
+static struct PluginMetrics {
+	struct Metric *inputFrames;
+	struct Metric *sourceFrames;
+	struct Metric *outputFrames;
+	struct Metric *inputDuration;
+	struct Metric *sourceDuration;
+	struct Metric *outputDuration;
+	struct Metric *metersDuration;
+	struct Metric *governorLoad[GOVERNOR_CLOCK_COUNT];
+	struct Metric *governorTiers[GOVERNED_STAGE_COUNT];
+	struct Metric *governorStepsDown;
+	struct Metric *governorStepsUp;
+	struct Metric *commandsDispatched;
+	struct Metric *commandBatchSize;
+	struct Metric *outboxPackets;
+	struct Metric *sentBytes;
+	struct Metric *sendErrors;
+	struct Metric *transcriptionSegments[TRANSCRIPTION_DROPPED + 1];
+	struct Metric *transcriptionDelay;
+} pluginMetrics;
+
+// The Mumble_PluginFeature flags Mumble has asked us to deactivate. The callbacks of deactivated features are still
+// exported (that is decided at build time, see stages.h) but return right away.
+static atomic_uint deactivatedFeatures;
+
+// Packets produced by the transport are collected in an outbox while the transport lock is held and are only sent once
+// the lock has been released. The transport is driven by the main thread (received packets) and the ticker
+// (retransmissions and replica messages), each with an outbox of its own. Disconnects, which are reported from yet
+// another thread, merely forget peers and never produce packets.
+struct TransportOutbox {
+	size_t count;
+	struct {
+		mumble_connection_t connection;
+		mumble_userid_t peer;
+		size_t length;
+		uint8_t data[TRANSPORT_MTU];
+	} packets[TRANSPORT_OUTBOX_SIZE];
+};
+
+static struct Transport *transport;
+static pthread_mutex_t transportLock = PTHREAD_MUTEX_INITIALIZER;
+static struct TransportOutbox *activeOutbox;
+static struct TransportOutbox mainThreadOutbox;
+static struct TransportOutbox tickerOutbox;
+
+// Mumble doesn't offer a timer, so everything that has to happen regularly (including executing queued commands,
+// retransmitting packets and forwarding log messages) is done by the ticker every TRANSPORT_TICK_INTERVAL_MS. Calling
+// an API function from a thread other than Mumble's main thread blocks until the main thread executes it, and
+// mumble_shutdown waits for the ticker on the main thread. That is why mumble_shutdown stops the ticker before doing
+// anything else and the ticker checks tickerRunning before every step that calls into Mumble (see serviceMumble).
+static pthread_t tickerThread;
+static atomic_bool tickerRunning;
+
+// Requests to Mumble made by code that must not block (e.g. audio callbacks). They are executed by the ticker (see
+// serviceMumble).
+static struct CommandQueue *commandQueue;
+
+// Lets external tools queue commands and follow the users' state (only available on Linux)
+static struct ControlServer *controlServer;
+
+// Only created in builds with the positional stage (see recipients.h). Disconnects are reported from a different thread
+// than all other user and channel events.
+static struct RecipientGroups *recipientGroups;
+static pthread_mutex_t recipientsLock = PTHREAD_MUTEX_INITIALIZER;
+// A copy of the members of the group sendDataToGroup sends to (owned by the main thread)
+static mumble_userid_t *groupMembers;
+static size_t groupMemberCapacity;
+
+// The plugin's own configuration, which may be read from any thread (including audio threads)
+static struct Config *config;
+
+// Mumble's own settings, mirrored so that audio callbacks never have to call into Mumble. All of the plugin's changes
+// to Mumble's settings go through it.
+static struct MumbleSettingsMirror *mumbleSettings;
+
+static struct KeyBindings *keyBindings;
+// The configuration generation whose bindings have been compiled into keyBindings
+static uint64_t appliedBindingsGeneration;
+#define MAX_HELD_TRANSMISSION_MODES 8
+// The momentary transmission mode bindings that are held down (identified by the key that triggered them) in the order
+// they were pressed, each with the mode to restore once it is released
+static struct {
+	uint32_t keyCode;
+	mumble_transmission_mode_t previousMode;
+} heldTransmissionModes[MAX_HELD_TRANSMISSION_MODES];
+static size_t heldTransmissionModeCount;
+
+static struct Soundboard *soundboard;
+
+// The audio callbacks' scratch memory (see memory.h), far more than a buffer of Mumble's (10ms) frames needs
+#define FRAME_ARENA_SIZE (256 * 1024)
+// Reset at the start of every mumble_onAudioInput. Clips aren't mixed if it couldn't be created.
+static struct MemoryArena *inputFrameArena;
+
+// The state of every server connection (e.g. the positions published by other users' instances of this plugin).
+// Disconnects are reported from a different thread than all other events.
+#define SPATIAL_CELL_SIZE 10.0f
+// How often the local user's position is published to the users in the same channel
+#define POSITION_PUBLISH_INTERVAL_MS 200
+// How often the speakers whose acoustics are simulated are chosen anew from the published positions
+#define SPEAKER_SELECTION_INTERVAL_MS 100
+static struct ConnectionTable *connectionTable;
+static pthread_mutex_t connectionsLock = PTHREAD_MUTEX_INITIALIZER;
+// The messages of the connections' replicated state are created in here by the main thread
+static uint8_t replicaMessage[REPLICA_MAX_MESSAGE];
+
+// Only available if the current level's geometry has been provided
+static struct Acoustics *acoustics;
+// Holds the reverb sends of the output buffer that is being mixed. Mumble fetches every source of a buffer in a
+// callback of its own, so this is only reset once the buffer is about to be played.
+static struct MemoryArena *outputFrameArena;
+#if PLUGIN_FEATURE_POSITIONAL
+// The users that have been handed to the acoustics engine as speakers (owned by the main thread)
+static mumble_userid_t selectedSpeakers[ACOUSTICS_MAX_SPEAKERS];
+static size_t selectedSpeakerCount;
+static uint64_t lastSelectedSpeakersMs;
+#endif
+
+// The speakers' levels and spectra, published in shared memory
+static struct Meters *meters;
+
+// Positional data is either published by a game through shared memory or read from a supported game's memory. The
+// strings handed to Mumble point into positionalData.
+static struct GameRegistry *gameRegistry;
+#if PLUGIN_FEATURE_POSITIONAL
+static struct PositionalBridge *positionalBridge;
+static struct Game *attachedGame;
+static struct PositionalData positionalData;
+// When the local user's position has last been published (see publishPosition)
+static uint64_t lastPublishedMs;
+#endif
+
+// Only available if a manifest has been configured
+static struct UpdateChecker *updateChecker;
+
+// Transcription stays off (even if it has been enabled) unless the plugin has been built with a speech recognizer
+#if PLUGIN_SPEECH_RECOGNIZER
+static const TranscriptionRecognizeFunction speechRecognizer = &transcription_recognizeSpeech;
+#else
+static const TranscriptionRecognizeFunction speechRecognizer = NULL;
+#endif
+// Only available if transcription has been enabled (and there is a recognizer)
+static struct Transcriber *transcriber;
+// The connection whose speakers are transcribed (the active one), so that captions can be tagged with their channel
+static _Atomic(mumble_connection_t) transcribedConnection;
+
+// Only available if indexing has been enabled. It only holds channel events unless there is a speech recognizer.
+static struct TextIndex *textIndex;
+
+static uint64_t currentTimeMs() {
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static mumble_error_t queueTransportPacket(void *userData, mumble_connection_t connection, mumble_userid_t peer,
+										   const uint8_t *data, size_t dataLength) {
+	(void) userData;
+
+	if (!activeOutbox || activeOutbox->count == TRANSPORT_OUTBOX_SIZE) {
+		// The transport treats this like a lost packet and retransmits it later on
+		return MUMBLE_EC_GENERIC_ERROR;
+	}
+
+	activeOutbox->packets[activeOutbox->count].connection = connection;
+	activeOutbox->packets[activeOutbox->count].peer       = peer;
+	activeOutbox->packets[activeOutbox->count].length     = dataLength;
+	memcpy(activeOutbox->packets[activeOutbox->count].data, data, dataLength);
+	activeOutbox->count++;
+
+	return MUMBLE_STATUS_OK;
+}
+
+static void onTransportMessage(void *userData, mumble_connection_t connection, mumble_userid_t peer,
+							   const uint8_t *data, size_t dataLength) {
+	(void) userData;
+
+	// All messages sent through the transport belong to the replicated state
+	pthread_mutex_lock(&connectionsLock);
+	struct ConnectionShard *shard = connections_find(connectionTable, connection);
+	bool valid                    = !shard || replica_receive(shard->replicas, peer, data, dataLength);
+	pthread_mutex_unlock(&connectionsLock);
+
+	if (!valid) {
+		LOG_DEBUG(logger, "Discarded malformed replica message from user %u (%zu bytes)", peer, dataLength);
+	}
+}
+
+static void lockTransport(struct TransportOutbox *outbox) {
+	pthread_mutex_lock(&transportLock);
+	activeOutbox = outbox;
+}
+
+static void unlockTransport() {
+	struct TransportOutbox *outbox = activeOutbox;
+	activeOutbox                   = NULL;
+	pthread_mutex_unlock(&transportLock);
+
+	if (!outbox) {
+		return;
+	}
+
+	metrics_set(pluginMetrics.outboxPackets, (double) outbox->count);
+
+	for (size_t i = 0; i < outbox->count; i++) {
+		mumble_error_t error = mumbleAPI.sendData(ownID, outbox->packets[i].connection, &outbox->packets[i].peer, 1,
+												  outbox->packets[i].data, outbox->packets[i].length,
+												  TRANSPORT_DATA_ID);
+		if (error == MUMBLE_STATUS_OK) {
+			metrics_increment(pluginMetrics.sentBytes, outbox->packets[i].length);
+		} else {
+			metrics_incrementAt(pluginMetrics.sendErrors, error, 1);
+		}
+	}
+	outbox->count = 0;
+}
+
+static mumble_error_t executeCommand(void *userData, const struct Command *command) {
+	(void) userData;
+
+	switch (command->type) {
+		case COMMAND_MOVE_USER: {
+			mumble_channelid_t channelID = command->channelID;
+			mumble_error_t error         = MUMBLE_STATUS_OK;
+			if (command->text[0] != '\0') {
+				error = mumbleAPI.findChannelByName(ownID, command->connection, command->text, &channelID);
+			}
+			if (error != MUMBLE_STATUS_OK) {
+				return error;
+			}
+			return mumbleAPI.requestUserMove(ownID, command->connection, command->userID, channelID, NULL);
+		}
+		case COMMAND_LOCAL_MUTE:
+			return mumbleAPI.requestLocalMute(ownID, command->connection, command->userID, command->enabled);
+		case COMMAND_SELF_MUTE:
+			return mumbleAPI.requestLocalUserMute(ownID, command->enabled);
+		case COMMAND_TOGGLE_SELF_MUTE: {
+			bool muted;
+			mumble_error_t error = mumbleAPI.isLocalUserMuted(ownID, &muted);
+			if (error != MUMBLE_STATUS_OK) {
+				return error;
+			}
+			return mumbleAPI.requestLocalUserMute(ownID, !muted);
+		}
+		case COMMAND_SELF_DEAF:
+			return mumbleAPI.requestLocalUserDeaf(ownID, command->enabled);
+		case COMMAND_TRANSMISSION_MODE:
+			return mumbleAPI.requestLocalUserTransmissionMode(ownID, command->transmissionMode);
+		case COMMAND_SET_COMMENT:
+			return mumbleAPI.requestSetLocalUserComment(ownID, command->connection, command->text);
+		case COMMAND_PLAY_SAMPLE:
+			return mumbleAPI.playSample(ownID, command->text);
+	}
+
+	return MUMBLE_EC_GENERIC_ERROR;
+}
+
+// Executes the requests of external tools. This is called on the control channel's thread.
+static mumble_error_t executeControlRequest(void *userData, const struct ControlRequest *request) {
+	(void) userData;
+
+	struct Command command;
+	memset(&command, 0, sizeof(command));
+
+	switch (request->type) {
+		case CONTROL_REQUEST_MOVE_USER: {
+			// A channel name that doesn't fit into the command can't be looked up (rather than looking up a prefix)
+			size_t length = strlen(request->text);
+			if (length >= sizeof(command.text)) {
+				return MUMBLE_EC_DATA_TOO_BIG;
+			}
+			command.type       = COMMAND_MOVE_USER;
+			command.connection = request->connection;
+			command.userID     = request->userID;
+			command.channelID  = request->channelID;
+			memcpy(command.text, request->text, length + 1);
+			break;
+		}
+		case CONTROL_REQUEST_SOUNDBOARD: {
+			int clip = soundboard_findClip(soundboard, request->text);
+			if (clip < 0) {
+				return MUMBLE_EC_INVALID_SAMPLE;
+			}
+			return soundboard_trigger(soundboard, clip) ? MUMBLE_STATUS_OK : MUMBLE_EC_GENERIC_ERROR;
+		}
+		case CONTROL_REQUEST_SELF_MUTE:
+			command.type    = COMMAND_SELF_MUTE;
+			command.enabled = request->enabled;
+			break;
+		case CONTROL_REQUEST_TRANSMISSION_MODE:
+			command.type             = COMMAND_TRANSMISSION_MODE;
+			command.transmissionMode = request->transmissionMode;
+			break;
+		default:
+			return MUMBLE_EC_GENERIC_ERROR;
+	}
+
+	return commands_enqueue(commandQueue, &command) ? MUMBLE_STATUS_OK : MUMBLE_EC_GENERIC_ERROR;
+}
+
+// Builds the path of one of the plugin's directories following the XDG base directory specification, e.g.
+// $XDG_CACHE_HOME/hello_mumble or ~/.cache/hello_mumble
+static bool pluginDirectory(char *buffer, size_t size, const char *variable, const char *fallback) {
+	const char *base = getenv(variable);
+	int length;
+	if (base && base[0] != '\0') {
+		length = snprintf(buffer, size, "%s/hello_mumble", base);
+	} else if ((base = getenv("HOME"))) {
+		length = snprintf(buffer, size, "%s/%s/hello_mumble", base, fallback);
+	} else {
+		return false;
+	}
+
+	return length > 0 && (size_t) length < size;
+}
+
+// Determines the plugin's cache directory and creates it if necessary
+static bool cacheDirectory(char *buffer, size_t size) {
+	bool available = pluginDirectory(buffer, size, "XDG_CACHE_HOME", ".cache");
+#ifndef _WIN32
+	available = available && (mkdir(buffer, 0755) == 0 || errno == EEXIST);
+#endif
+
+	return available;
+}
+
+static void forwardLogMessage(void *userData, enum LogLevel level, const char *message) {
+	(void) userData;
+
+	// Debug messages only end up in the log file
+	if (level >= LOG_LEVEL_INFO) {
+		mumbleAPI.log(ownID, message);
+	}
+}
+
+// Opens or closes the log file as configured
+static void applyLogFile() {
+	const struct PluginSettings *settings = config_acquire(config);
+	bool enabled                          = settings->logFile;
+	config_release(config);
+
+	if (enabled == logFileOpen) {
+		return;
+	}
+
+	char path[4096];
+	if (enabled && pluginDirectory(path, sizeof(path) - strlen("/" LOG_FILE_NAME), "XDG_STATE_HOME", ".local/state")) {
+#ifndef _WIN32
+		mkdir(path, 0755);
+#endif
+		strcat(path, "/" LOG_FILE_NAME);
+		if (!logger_setFile(logger, path, LOG_FILE_MAX_SIZE, LOG_FILE_COUNT)) {
+			LOG_WARNING(logger, "Failed to open the log file %s", path);
+		}
+	} else {
+		logger_setFile(logger, NULL, 0, 0);
+	}
+
+	// Failing to open the file isn't retried until the setting changes
+	logFileOpen = enabled;
+}
+
+// Passes the configured budget on to the governor and publishes the load it measured
+static void applyGovernor() {
+	const struct PluginSettings *settings = config_acquire(config);
+	float budget                          = settings->cpuBudget;
+	config_release(config);
+
+	governor_setBudget(governor, budget);
+	for (size_t i = 0; i < GOVERNOR_CLOCK_COUNT; i++) {
+		metrics_set(pluginMetrics.governorLoad[i], governor_getLoad(governor, (enum GovernorClock) i));
+	}
+}
+
+static void registerMetrics() {
+	const char *frames       = "plugin_audio_frames_total";
+	const char *framesHelp   = "Audio frames processed per stage";
+	const char *duration     = "plugin_dsp_duration_ns";
+	const char *durationHelp = "Time spent processing a buffer per stage";
+
+	pluginMetrics.inputFrames  = metrics_addCounter(metrics, frames, "stage=\"input\"", framesHelp);
+	pluginMetrics.sourceFrames = metrics_addCounter(metrics, frames, "stage=\"source\"", framesHelp);
+	pluginMetrics.outputFrames = metrics_addCounter(metrics, frames, "stage=\"output\"", framesHelp);
+
+	pluginMetrics.inputDuration =
+		metrics_addHistogram(metrics, duration, "stage=\"input\"", METRICS_MAX_DSP_NS, durationHelp);
+	pluginMetrics.sourceDuration =
+		metrics_addHistogram(metrics, duration, "stage=\"source\"", METRICS_MAX_DSP_NS, durationHelp);
+	pluginMetrics.outputDuration =
+		metrics_addHistogram(metrics, duration, "stage=\"output\"", METRICS_MAX_DSP_NS, durationHelp);
+	pluginMetrics.metersDuration =
+		metrics_addHistogram(metrics, duration, "stage=\"meters\"", METRICS_MAX_DSP_NS, durationHelp);
+
+	const char *load     = "plugin_governor_load";
+	const char *loadHelp = "Share of the audio's duration spent in the audio callbacks per thread";
+	pluginMetrics.governorLoad[GOVERNOR_INPUT]  = metrics_addGauge(metrics, load, "thread=\"input\"", loadHelp);
+	pluginMetrics.governorLoad[GOVERNOR_OUTPUT] = metrics_addGauge(metrics, load, "thread=\"output\"", loadHelp);
+
+	const char *tier     = "plugin_governor_tier";
+	const char *tierHelp = "Quality tier the governor runs a stage at (0 is full quality)";
+	// The registry keeps pointers to the labels
+	static const char *tierLabels[GOVERNED_STAGE_COUNT] = { "stage=\"meters\"", "stage=\"reverb\"",
+															"stage=\"acoustics\"" };
+	for (size_t i = 0; i < GOVERNED_STAGE_COUNT; i++) {
+		pluginMetrics.governorTiers[i] = metrics_addGauge(metrics, tier, tierLabels[i], tierHelp);
+	}
+
+	const char *steps     = "plugin_governor_steps_total";
+	const char *stepsHelp = "Tier changes made by the governor";
+	pluginMetrics.governorStepsDown = metrics_addCounter(metrics, steps, "direction=\"down\"", stepsHelp);
+	pluginMetrics.governorStepsUp   = metrics_addCounter(metrics, steps, "direction=\"up\"", stepsHelp);
+
+	pluginMetrics.commandsDispatched = metrics_addCounter(metrics, "plugin_commands_dispatched_total", NULL,
+														  "Requests to Mumble executed on the main thread");
+	pluginMetrics.commandBatchSize   = metrics_addGauge(metrics, "plugin_command_batch_size", NULL,
+														"Requests executed during the last tick");
+	pluginMetrics.outboxPackets      = metrics_addGauge(metrics, "plugin_transport_outbox_packets", NULL,
+														"Packets sent by the last flush of a transport outbox");
+
+	pluginMetrics.sentBytes  = metrics_addCounter(metrics, "plugin_senddata_bytes_total", NULL,
+												  "Bytes successfully passed to sendData");
+	pluginMetrics.sendErrors = metrics_addCounterVector(metrics, "plugin_senddata_errors_total", "error",
+														MUMBLE_EC_INTERNAL_ERROR,
+														MUMBLE_EC_DATA_ID_TOO_LONG - MUMBLE_EC_INTERNAL_ERROR + 1,
+														"Failed sendData calls per mumble_error_t");
+
+	const char *segments     = "plugin_transcription_segments_total";
+	const char *segmentsHelp = "Speech segments that have been transcribed per result";
+	static const char *resultLabels[TRANSCRIPTION_DROPPED + 1] = {
+		[TRANSCRIPTION_CAPTIONED]    = "result=\"captioned\"",
+		[TRANSCRIPTION_UNRECOGNIZED] = "result=\"unrecognized\"",
+		[TRANSCRIPTION_DROPPED]      = "result=\"dropped\"",
+	};
+	for (size_t i = 0; i <= TRANSCRIPTION_DROPPED; i++) {
+		pluginMetrics.transcriptionSegments[i] = metrics_addCounter(metrics, segments, resultLabels[i], segmentsHelp);
+	}
+	pluginMetrics.transcriptionDelay =
+		metrics_addHistogram(metrics, "plugin_transcription_delay_ms", NULL, METRICS_MAX_CAPTION_DELAY_MS,
+							 "Time from the end of a speech segment to its caption");
+}
+
+// Builds the path of a socket in $XDG_RUNTIME_DIR/hello_mumble and creates the directory if necessary
+static bool socketPath(char *buffer, size_t size, const char *name) {
+	if (!pluginDirectory(buffer, size - strlen(name) - 1, "XDG_RUNTIME_DIR", ".cache")) {
+		return false;
+	}
+#ifndef _WIN32
+	mkdir(buffer, 0700);
+#endif
+	strcat(buffer, "/");
+	strcat(buffer, name);
+
+	return true;
+}
+
+// Starts the servers through which external tools talk to the plugin. The plugin works just as well without them.
+static void startServers() {
+#ifdef __linux__
+	char path[4096];
+	if (socketPath(path, sizeof(path), METRICS_SOCKET_NAME) && !metrics_startServer(metrics, path)) {
+		LOG_WARNING(logger, "Failed to serve metrics on %s", path);
+	}
+
+	if (socketPath(path, sizeof(path), CONTROL_SOCKET_NAME)) {
+		controlServer = control_create(path, textIndex, &executeControlRequest, NULL);
+		if (!controlServer) {
+			LOG_WARNING(logger, "Failed to start the control channel on %s", path);
+		}
+	}
+#endif
+}
+
+// Sends everything the connections' replicated state has queued
+static void flushReplicas() {
+	mumble_connection_t connections[CONNECTIONS_MAX_SHARDS];
+	pthread_mutex_lock(&connectionsLock);
+	size_t connectionCount = connections_list(connectionTable, connections);
+	pthread_mutex_unlock(&connectionsLock);
+
+	for (size_t i = 0; i < connectionCount && tickerRunning; i++) {
+		for (;;) {
+			mumble_userid_t peers[REPLICA_MAX_PEERS];
+			size_t peerCount = 0;
+			size_t length    = 0;
+
+			pthread_mutex_lock(&connectionsLock);
+			struct ConnectionShard *shard = connections_find(connectionTable, connections[i]);
+			if (shard) {
+				length = replica_nextMessage(shard->replicas, replicaMessage, peers, &peerCount);
+			}
+			pthread_mutex_unlock(&connectionsLock);
+
+			if (length == 0) {
+				break;
+			}
+
+			lockTransport(&tickerOutbox);
+			for (size_t j = 0; j < peerCount; j++) {
+				transport_send(transport, connections[i], peers[j], replicaMessage, length, currentTimeMs());
+			}
+			unlockTransport();
+		}
+	}
+}
+
+// Does the ticker's work that calls into Mumble. Every step blocks until Mumble's main thread has executed its API
+// calls, so the ticker stops in between steps once mumble_shutdown is waiting for it.
+static void serviceMumble() {
+	size_t dispatched = commands_dispatch(commandQueue);
+	metrics_increment(pluginMetrics.commandsDispatched, dispatched);
+	metrics_set(pluginMetrics.commandBatchSize, (double) dispatched);
+
+	if (tickerRunning) {
+		lockTransport(&tickerOutbox);
+		transport_tick(transport, currentTimeMs());
+		unlockTransport();
+	}
+
+	if (tickerRunning) {
+		flushReplicas();
+	}
+
+	if (tickerRunning) {
+		applyLogFile();
+		logger_drain(logger, currentTimeMs());
+	}
+}
+
+static void *runTicker(void *arg) {
+	(void) arg;
+
+	const struct timespec interval = { 0, TRANSPORT_TICK_INTERVAL_MS * 1000000L };
+
+	while (tickerRunning) {
+		transcription_tick(transcriber);
+		applyGovernor();
+		serviceMumble();
+
+		nanosleep(&interval, NULL);
+	}
+
+	return NULL;
+}
+
+static struct Config *createConfig() {
+	char path[4096];
+	if (!pluginDirectory(path, sizeof(path) - strlen("/" CONFIG_FILE_NAME), "XDG_CONFIG_HOME", ".config")) {
+		return config_create(CONFIG_FILE_NAME);
+	}
+#ifndef _WIN32
+	// The directory has to exist in order to be watched for the file being created
+	mkdir(path, 0755);
+#endif
+	strcat(path, "/" CONFIG_FILE_NAME);
+
+	return config_create(path);
+}
+
+static struct MumbleSettingsMirror *createMumbleSettings() {
+	struct MumbleSettingsBackend backend;
+	backend.pluginID   = ownID;
+	backend.getBool    = mumbleAPI.getMumbleSetting_bool;
+	backend.getInt     = mumbleAPI.getMumbleSetting_int;
+	backend.getDouble  = mumbleAPI.getMumbleSetting_double;
+	backend.getString  = mumbleAPI.getMumbleSetting_string;
+	backend.setBool    = mumbleAPI.setMumbleSetting_bool;
+	backend.setInt     = mumbleAPI.setMumbleSetting_int;
+	backend.setDouble  = mumbleAPI.setMumbleSetting_double;
+	backend.setString  = mumbleAPI.setMumbleSetting_string;
+	backend.freeMemory = mumbleAPI.freeMemory;
+
+	return mumblesettings_create(&backend);
+}
+
+static struct Soundboard *createSoundboard() {
+	// Without a cache directory, converted clips simply aren't cached
+	char directory[4096];
+	struct Soundboard *board = soundboard_create(cacheDirectory(directory, sizeof(directory)) ? directory : NULL);
+	if (!board) {
+		return NULL;
+	}
+
+	// All clips are decoded here so that triggering them later on never needs any I/O. Without the soundboard stage,
+	// they would never be played anyway.
+	char clipDirectory[4096];
+	if (PLUGIN_FEATURE_SOUNDBOARD
+		&& pluginDirectory(clipDirectory, sizeof(clipDirectory) - strlen("/soundboard"), "XDG_DATA_HOME",
+						".local/share")) {
+		strcat(clipDirectory, "/soundboard");
+		soundboard_loadDirectory(board, clipDirectory);
+	}
+
+	return board;
+}
+
+// Called on the audio thread whose load made the governor step a stage
+static void onGovernorStep(void *userData, size_t stage, unsigned int tier, bool down, double load) {
+	(void) userData;
+
+	metrics_set(pluginMetrics.governorTiers[stage], tier);
+	metrics_increment(down ? pluginMetrics.governorStepsDown : pluginMetrics.governorStepsUp, 1);
+
+	LOG_INFO(logger, "Running %s at tier %u (audio callbacks took %.1f%% of the audio's duration)",
+			 governedStageNames[stage], tier, load * 100.0);
+}
+
+static struct Governor *createGovernor() {
+	struct Governor *created = governor_create(&onGovernorStep, NULL);
+	if (!created) {
+		return NULL;
+	}
+
+	governor_addStage(created, GOVERNOR_OUTPUT, METERS_TIER_COUNT);
+	governor_addStage(created, GOVERNOR_OUTPUT, 2);
+	governor_addStage(created, GOVERNOR_OUTPUT, 2);
+
+	return created;
+}
+
+static struct Acoustics *createAcoustics() {
+	char geometryPath[4096];
+	if (!pluginDirectory(geometryPath, sizeof(geometryPath) - strlen("/level.bvh"), "XDG_DATA_HOME", ".local/share")) {
+		return NULL;
+	}
+	strcat(geometryPath, "/level.bvh");
+
+	return acoustics_create(geometryPath);
+}
+
+static struct UpdateChecker *createUpdateChecker() {
+	char manifestURL[CONFIG_MAX_URL];
+	const struct PluginSettings *settings = config_acquire(config);
+	strcpy(manifestURL, settings->updateManifest);
+	config_release(config);
+
+	if (manifestURL[0] == '\0') {
+		return NULL;
+	}
+
+	char directory[4096];
+	const char *cache             = cacheDirectory(directory, sizeof(directory)) ? directory : NULL;
+	struct UpdateChecker *checker = update_create(manifestURL, cache, mumble_getVersion(), NULL, UPDATE_TIMEOUT_MS);
+	if (!checker) {
+		LOG_WARNING(logger, "Failed to check for updates at %s", manifestURL);
+	}
+
+	return checker;
+}
+
+// Captions are tagged with the channel the speaker is in once their speech has been recognized
+static void indexCaption(const struct TranscriptionSegment *segment, const char *text) {
+	if (!textIndex) {
+		return;
+	}
+
+	pthread_mutex_lock(&recipientsLock);
+	mumble_channelid_t channelID =
+		recipients_getChannel(recipientGroups, atomic_load(&transcribedConnection), segment->userID);
+	pthread_mutex_unlock(&recipientsLock);
+
+	if (!textindex_add(textIndex, TEXTINDEX_TRANSCRIPT, segment->userID, channelID, segment->startMs, text)) {
+		LOG_WARNING(logger, "Failed to index a caption of user %u", segment->userID);
+	}
+}
+
+// Receives the speech segments of all speakers on the transcriber's workers
+static void onCaption(void *userData, const struct TranscriptionSegment *segment, enum TranscriptionResult result,
+					  const char *text) {
+	(void) userData;
+
+	uint64_t durationMs = segment->sampleCount * 1000 / TRANSCRIPTION_SAMPLE_RATE;
+	uint64_t endMs      = segment->startMs + durationMs;
+	uint64_t now        = currentTimeMs();
+	metrics_increment(pluginMetrics.transcriptionSegments[result], 1);
+	metrics_record(pluginMetrics.transcriptionDelay, now > endMs ? now - endMs : 0);
+
+	switch (result) {
+		case TRANSCRIPTION_CAPTIONED:
+			LOG_INFO(logger, "User %u: %s", segment->userID, text);
+			indexCaption(segment, text);
+			break;
+		case TRANSCRIPTION_UNRECOGNIZED:
+			LOG_DEBUG(logger, "User %u spoke for %llu ms", segment->userID, (unsigned long long) durationMs);
+			break;
+		case TRANSCRIPTION_DROPPED:
+			LOG_WARNING(logger, "Dropped %llu ms of speech by user %u that couldn't be transcribed in time",
+						(unsigned long long) durationMs, segment->userID);
+			break;
+	}
+}
+
+static struct Transcriber *createTranscriber() {
+	const struct PluginSettings *settings = config_acquire(config);
+	bool enabled                          = settings->transcription;
+	unsigned int workers                  = settings->transcriptionWorkers;
+	unsigned int latencyBudgetMs          = settings->transcriptionLatencyBudgetMs;
+	char model[CONFIG_MAX_PATH];
+	strcpy(model, settings->transcriptionModel);
+	config_release(config);
+
+	if (!enabled) {
+		return NULL;
+	}
+
+	// Without a recognizer every segment would come back unrecognized, so transcribing would only cost the audio
+	// callback and the workers their time
+	if (!speechRecognizer) {
+		LOG_WARNING(logger, "Transcription stays disabled as no speech recognizer is available");
+		return NULL;
+	}
+
+	struct Transcriber *created = transcription_create(model[0] != '\0' ? model : NULL, speechRecognizer, &onCaption,
+													   NULL, workers, latencyBudgetMs);
+	if (!created) {
+		LOG_WARNING(logger, "Failed to set up transcription");
+	}
+
+	return created;
+}
+
+static struct TextIndex *createTextIndex() {
+	const struct PluginSettings *settings = config_acquire(config);
+	bool enabled                          = settings->textIndex;
+	config_release(config);
+
+	char directory[4096];
+	if (!enabled
+		|| !pluginDirectory(directory, sizeof(directory) - strlen("/index"), "XDG_DATA_HOME", ".local/share")) {
+		return NULL;
+	}
+#ifndef _WIN32
+	mkdir(directory, 0755);
+#endif
+	strcat(directory, "/index");
+#ifndef _WIN32
+	mkdir(directory, 0755);
+#endif
+
+	struct TextIndex *created = textindex_create(directory);
+	if (!created) {
+		LOG_WARNING(logger, "Failed to open the index in %s", directory);
+	}
+
+	return created;
+}
+
+// Logs all memory that is still allocated once every subsystem has been destroyed
+static void reportLeaks() {
+	struct MemoryUsage usage[MEMORY_SUBSYSTEM_COUNT];
+	memory_getUsage(usage);
+
+	for (size_t i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+		// The logger is still needed to report the leaks
+		if (usage[i].blocks == 0 || i == MEMORY_LOGGER) {
+			continue;
+		}
+
+		LOG_WARNING(logger, "Leaked %zu blocks (%zu bytes) in %s (peak usage was %zu bytes)", usage[i].blocks,
+					usage[i].bytes, usage[i].name, usage[i].peakBytes);
+	}
+}
+
+// Fills the recipient groups of a connection that has been synchronized before it was attached
+static void fillRecipients(mumble_connection_t connection, mumble_userid_t localUserID, const mumble_userid_t *users,
+						   size_t userCount) {
+	for (size_t i = 0; i < userCount; i++) {
+		mumble_channelid_t channelID;
+		bool located = mumbleAPI.getChannelOfUser(ownID, connection, users[i], &channelID) == MUMBLE_STATUS_OK;
+
+		pthread_mutex_lock(&recipientsLock);
+		recipients_onUserAdded(recipientGroups, connection, users[i]);
+		if (located) {
+			recipients_onChannelEntered(recipientGroups, connection, users[i], channelID);
+		}
+		pthread_mutex_unlock(&recipientsLock);
+	}
+
+	pthread_mutex_lock(&recipientsLock);
+	recipients_setLocalUser(recipientGroups, connection, localUserID);
+	pthread_mutex_unlock(&recipientsLock);
+}
+
+// Attaches a shard to the given connection (unless it has one already) and returns whether it has one now. This asks
+// Mumble for the connection's users, so it has to be called on the main thread.
+static bool attachConnection(mumble_connection_t connection) {
+	// Connections that are synchronized already won't report the users that are there
+	mumble_userid_t localUserID;
+	mumble_userid_t *users = NULL;
+	size_t userCount       = 0;
+	bool synchronized      = mumbleAPI.getLocalUserID(ownID, connection, &localUserID) == MUMBLE_STATUS_OK
+						&& mumbleAPI.getAllUsers(ownID, connection, &users, &userCount) == MUMBLE_STATUS_OK;
+
+	pthread_mutex_lock(&connectionsLock);
+	bool attached                 = connections_find(connectionTable, connection) != NULL;
+	struct ConnectionShard *shard = connections_attach(connectionTable, connection);
+	if (shard && !attached && synchronized) {
+		replica_setLocalPeer(shard->replicas, localUserID);
+		for (size_t i = 0; i < userCount; i++) {
+			replica_addPeer(shard->replicas, users[i]);
+		}
+	}
+	pthread_mutex_unlock(&connectionsLock);
+
+	if (!attached && synchronized) {
+		fillRecipients(connection, localUserID, users, userCount);
+	}
+
+	if (users) {
+		mumbleAPI.freeMemory(ownID, users);
+	}
+
+	return shard;
+}
+
+// Destroys everything mumble_init creates except for the logger (in reverse order). Subsystems that haven't been
+// created are skipped, so this also cleans up after mumble_init failed halfway. The ticker must not be running.
+static void destroySubsystems() {
+	update_destroy(updateChecker);
+	updateChecker = NULL;
+
+	// Requests from external tools use the command queue, the soundboard and the text index
+	control_destroy(controlServer);
+	controlServer = NULL;
+
+	acoustics_destroy(acoustics);
+	acoustics = NULL;
+#if PLUGIN_FEATURE_POSITIONAL
+	selectedSpeakerCount   = 0;
+	lastSelectedSpeakersMs = 0;
+#endif
+	meters_destroy(meters);
+	meters = NULL;
+	memory_destroyArena(outputFrameArena);
+	outputFrameArena = NULL;
+	memory_destroyArena(inputFrameArena);
+	inputFrameArena = NULL;
+
+	transcription_destroy(transcriber);
+	transcriber = NULL;
+	textindex_destroy(textIndex);
+	textIndex = NULL;
+
+	governor_destroy(governor);
+	governor = NULL;
+
+	commands_destroy(commandQueue);
+	commandQueue = NULL;
+	mumblesettings_destroy(mumbleSettings);
+	mumbleSettings = NULL;
+	config_destroy(config);
+	config = NULL;
+	appliedBindingsGeneration = 0;
+	games_destroy(gameRegistry);
+	gameRegistry = NULL;
+	transport_destroy(transport);
+	transport = NULL;
+	recipients_destroy(recipientGroups);
+	recipientGroups = NULL;
+	memory_free(groupMembers);
+	groupMembers        = NULL;
+	groupMemberCapacity = 0;
+	keybindings_destroy(keyBindings);
+	keyBindings               = NULL;
+	heldTransmissionModeCount = 0;
+	soundboard_destroy(soundboard);
+	soundboard = NULL;
+	connections_destroy(connectionTable);
+	connectionTable = NULL;
+	metrics_destroy(metrics);
+	metrics = NULL;
+	memset(&pluginMetrics, 0, sizeof(pluginMetrics));
+}
 
 mumble_error_t mumble_init(mumble_plugin_id_t pluginID) {
 	ownID = pluginID;
+	// Deactivations only apply to the session they have been requested in
+	atomic_store_explicit(&deactivatedFeatures, MUMBLE_FEATURE_NONE, memory_order_relaxed);
+
+	logger = logger_create(&forwardLogMessage, NULL);
+	if (!logger) {
+		return MUMBLE_EC_GENERIC_ERROR;
+	}
+
+	metrics = metrics_create();
+	if (!metrics) {
+		goto failed;
+	}
+	registerMetrics();
+
+	governor = createGovernor();
+	if (!governor) {
+		goto failed;
+	}
+
+	connectionTable = connections_create(SPATIAL_CELL_SIZE);
+	if (!connectionTable) {
+		goto failed;
+	}
+
+	soundboard = createSoundboard();
+	if (!soundboard) {
+		goto failed;
+	}
+
+	keyBindings = keybindings_create();
+	if (!keyBindings) {
+		goto failed;
+	}
+
+	if (PLUGIN_FEATURE_POSITIONAL) {
+		recipientGroups = recipients_create();
+		if (!recipientGroups) {
+			goto failed;
+		}
+	}
+
+	transport = transport_create(&queueTransportPacket, &onTransportMessage, NULL);
+	if (!transport) {
+		goto failed;
+	}
 
-	if (mumbleAPI.log(ownID, "Hello Mumble") != MUMBLE_STATUS_OK) {
-		// Logging failed -> usually you'd probably want to log things like this in your plugin's
-		// logging system (if there is any)
+	char directory[4096];
+	gameRegistry = games_create(cacheDirectory(directory, sizeof(directory)) ? directory : NULL);
+	if (!gameRegistry) {
+		goto failed;
 	}
 
+	config = createConfig();
+	if (!config) {
+		goto failed;
+	}
+
+	mumbleSettings = createMumbleSettings();
+	if (!mumbleSettings) {
+		goto failed;
+	}
+
+	commandQueue = commands_create(&executeCommand, NULL);
+	if (!commandQueue) {
+		goto failed;
+	}
+
+	// Captions are indexed on the transcriber's workers, so the index has to outlive the transcriber
+	textIndex = createTextIndex();
+
+	// Speakers are transcribed in the same callback the acoustics are applied in. The ticker closes their segments.
+	transcriber = PLUGIN_FEATURE_ACOUSTICS ? createTranscriber() : NULL;
+
+	tickerRunning = true;
+	if (pthread_create(&tickerThread, NULL, &runTicker, NULL) != 0) {
+		tickerRunning = false;
+		goto failed;
+	}
+
+	startServers();
+
+	// Mumble asks for updates while starting up, which mustn't wait for the network
+	updateChecker = createUpdateChecker();
+
+	if (PLUGIN_FEATURE_SOUNDBOARD) {
+		inputFrameArena = memory_createArena(MEMORY_SOUNDBOARD, FRAME_ARENA_SIZE);
+		if (!inputFrameArena) {
+			LOG_WARNING(logger, "Failed to create the input frame arena");
+		}
+	}
+
+	// Without any geometry, audio simply passes through unmodified
+	if (PLUGIN_FEATURE_ACOUSTICS) {
+		acoustics        = createAcoustics();
+		outputFrameArena = memory_createArena(MEMORY_ACOUSTICS, FRAME_ARENA_SIZE);
+		if (!outputFrameArena) {
+			LOG_WARNING(logger, "Failed to create the output frame arena");
+		}
+	}
+
+	if (PLUGIN_FEATURE_METERS) {
+		meters = meters_create();
+		if (!meters) {
+			LOG_WARNING(logger, "Failed to create the level meters");
+		}
+	}
+
+	// A connection that has been established before the plugin was loaded won't report its users and channels
+	mumble_connection_t activeConnection;
+	if (mumbleAPI.getActiveServerConnection(ownID, &activeConnection) == MUMBLE_STATUS_OK) {
+		attachConnection(activeConnection);
+	}
+
+	LOG_INFO(logger, "Hello Mumble");
+
 	return MUMBLE_STATUS_OK;
+
+failed:
+	destroySubsystems();
+	logger_destroy(logger);
+	logger = NULL;
+
+	return MUMBLE_EC_GENERIC_ERROR;
 }
 
 void mumble_shutdown() {
-	if (mumbleAPI.log(ownID, "Goodbye Mumble") != MUMBLE_STATUS_OK) {
-		// Logging failed -> usually you'd probably want to log things like this in your plugin's
-		// logging system (if there is any)
-	}
+	// An API call the ticker would make from now on would wait for this thread, which is about to wait for the ticker
+	tickerRunning = false;
+	pthread_join(tickerThread, NULL);
+
+	destroySubsystems();
+
+	reportLeaks();
+
+	LOG_INFO(logger, "Goodbye Mumble");
+	// Everything that is still queued is forwarded from this (the main) thread
+	logger_destroy(logger);
+	logger = NULL;
+	logFileOpen = false;
+
+	atomic_store_explicit(&deactivatedFeatures, MUMBLE_FEATURE_NONE, memory_order_relaxed);
 }
 
 struct MumbleStringWrapper mumble_getName() {
@@ -48,10 +1106,646 @@ void mumble_registerAPIFunctions(void *apiStruct) {
 }
 
 void mumble_releaseResource(const void *pointer) {
-	// As we never pass a resource to Mumble that needs releasing, this function should never
-	// get called
-	printf("Called mumble_releaseResource but expected that this never gets called -> Aborting");
-	abort();
+	// The only resources handed to Mumble are the URLs returned by mumble_getUpdateDownloadURL
+	memory_free((void *) pointer);
+}
+
+
+bool mumble_onReceiveData(mumble_connection_t connection, mumble_userid_t sender, const uint8_t *data,
+						  size_t dataLength, const char *dataID) {
+	if (strcmp(dataID, TRANSPORT_DATA_ID) == 0) {
+		lockTransport(&mainThreadOutbox);
+		bool processed = transport_receive(transport, connection, sender, data, dataLength, currentTimeMs());
+		unlockTransport();
+
+		if (!processed) {
+			LOG_DEBUG(logger, "Discarded malformed transport packet from user %u (%zu bytes)", sender, dataLength);
+		}
+
+		return processed;
+	}
+
+	if (strcmp(dataID, SPATIAL_POSITION_DATA_ID) == 0) {
+		// Connections that have been established before the plugin was loaded don't have a shard yet
+		pthread_mutex_lock(&connectionsLock);
+		bool attached = connections_find(connectionTable, connection);
+		pthread_mutex_unlock(&connectionsLock);
+		if (!attached) {
+			attachConnection(connection);
+		}
+
+		pthread_mutex_lock(&connectionsLock);
+		struct ConnectionShard *shard = connections_find(connectionTable, connection);
+		bool processed = !shard || spatial_updateFromData(shard->spatial, sender, data, dataLength);
+		float position[3];
+		bool known = shard && processed && spatial_getPosition(shard->spatial, sender, position);
+		pthread_mutex_unlock(&connectionsLock);
+
+		// The acoustics engine's speakers are chosen from the known positions in mumble_fetchPositionalData
+		if (known) {
+			control_setPosition(controlServer, connection, sender, position);
+		}
+		if (!processed) {
+			LOG_DEBUG(logger, "Discarded malformed position from user %u (%zu bytes)", sender, dataLength);
+		}
+
+		return processed;
+	}
+
+	return false;
+}
+
+#if PLUGIN_FEATURE_POSITIONAL
+// Sends the given data to all members of the given recipient group (e.g. RECIPIENTS_GROUP_CHANNEL) without querying
+// Mumble for the group's members first. Only call this from the main thread: the members are copied into a buffer
+// owned by it, so that sendData isn't called with recipientsLock held.
+static mumble_error_t sendDataToGroup(mumble_connection_t connection, const char *groupName, const uint8_t *data,
+									  size_t dataLength, const char *dataID) {
+	pthread_mutex_lock(&recipientsLock);
+
+	size_t userCount;
+	recipients_group_t group     = recipients_findGroup(recipientGroups, connection, groupName);
+	const mumble_userid_t *users = recipients_get(recipientGroups, connection, group, &userCount);
+
+	if (userCount > groupMemberCapacity) {
+		mumble_userid_t *members =
+			memory_realloc(MEMORY_RECIPIENTS, groupMembers, userCount * sizeof(mumble_userid_t));
+		if (!members) {
+			pthread_mutex_unlock(&recipientsLock);
+			return MUMBLE_EC_GENERIC_ERROR;
+		}
+		groupMembers        = members;
+		groupMemberCapacity = userCount;
+	}
+	if (userCount > 0) {
+		memcpy(groupMembers, users, userCount * sizeof(mumble_userid_t));
+	}
+
+	pthread_mutex_unlock(&recipientsLock);
+
+	if (userCount == 0) {
+		return MUMBLE_STATUS_OK;
+	}
+
+	return mumbleAPI.sendData(ownID, connection, groupMembers, userCount, data, dataLength, dataID);
+}
+#endif
+
+void mumble_onServerConnected(mumble_connection_t connection) {
+	if (!attachConnection(connection)) {
+		LOG_WARNING(logger, "Failed to attach a shard to connection %d, other users' positions are ignored",
+					connection);
+	}
+}
+
+void mumble_onServerSynchronized(mumble_connection_t connection) {
+	mumble_userid_t localUserID;
+	if (mumbleAPI.getLocalUserID(ownID, connection, &localUserID) != MUMBLE_STATUS_OK) {
+		return;
+	}
+
+	pthread_mutex_lock(&recipientsLock);
+	recipients_setLocalUser(recipientGroups, connection, localUserID);
+	pthread_mutex_unlock(&recipientsLock);
+
+	// The replicated state starts talking to its peers once it knows which user is the local one
+	pthread_mutex_lock(&connectionsLock);
+	struct ConnectionShard *shard = connections_find(connectionTable, connection);
+	if (shard) {
+		replica_setLocalPeer(shard->replicas, localUserID);
+	}
+	pthread_mutex_unlock(&connectionsLock);
+
+	// Settings may have been changed while connecting
+	mumblesettings_refresh(mumbleSettings, currentTimeMs());
+}
+
+void mumble_onUserAdded(mumble_connection_t connection, mumble_userid_t userID) {
+	pthread_mutex_lock(&recipientsLock);
+	recipients_onUserAdded(recipientGroups, connection, userID);
+	pthread_mutex_unlock(&recipientsLock);
+
+	// Joining users are sent a digest of the replicated state, which is the only time state is exchanged in bulk
+	pthread_mutex_lock(&connectionsLock);
+	struct ConnectionShard *shard = connections_find(connectionTable, connection);
+	if (shard) {
+		replica_addPeer(shard->replicas, userID);
+	}
+	pthread_mutex_unlock(&connectionsLock);
+}
+
+void mumble_onUserRemoved(mumble_connection_t connection, mumble_userid_t userID) {
+	pthread_mutex_lock(&recipientsLock);
+	recipients_onUserRemoved(recipientGroups, connection, userID);
+	pthread_mutex_unlock(&recipientsLock);
+
+	lockTransport(NULL);
+	transport_removePeer(transport, connection, userID);
+	unlockTransport();
+
+	pthread_mutex_lock(&connectionsLock);
+	struct ConnectionShard *shard = connections_find(connectionTable, connection);
+	if (shard) {
+		spatial_remove(shard->spatial, userID);
+		replica_removePeer(shard->replicas, userID);
+	}
+	pthread_mutex_unlock(&connectionsLock);
+
+	if (acoustics) {
+		acoustics_removeSpeaker(acoustics, userID);
+	}
+	if (meters) {
+		meters_removeSpeaker(meters, userID);
+	}
+
+	control_removeUser(controlServer, connection, userID);
+}
+
+// Channel changes are indexed as "<user> entered <channel>", so that they can be found by either name
+static void indexChannelEntered(mumble_connection_t connection, mumble_userid_t userID, mumble_channelid_t channelID) {
+	if (!textIndex) {
+		return;
+	}
+
+	const char *userName    = NULL;
+	const char *channelName = NULL;
+	if (mumbleAPI.getUserName(ownID, connection, userID, &userName) != MUMBLE_STATUS_OK) {
+		userName = NULL;
+	}
+	if (mumbleAPI.getChannelName(ownID, connection, channelID, &channelName) != MUMBLE_STATUS_OK) {
+		channelName = NULL;
+	}
+
+	char text[TEXTINDEX_MAX_TEXT];
+	snprintf(text, sizeof(text), "%s entered %s", userName ? userName : "Unknown user",
+			 channelName ? channelName : "an unknown channel");
+	textindex_add(textIndex, TEXTINDEX_EVENT, userID, channelID, currentTimeMs(), text);
+
+	if (userName) {
+		mumbleAPI.freeMemory(ownID, userName);
+	}
+	if (channelName) {
+		mumbleAPI.freeMemory(ownID, channelName);
+	}
+}
+
+void mumble_onChannelEntered(mumble_connection_t connection, mumble_userid_t userID,
+							 mumble_channelid_t previousChannelID, mumble_channelid_t newChannelID) {
+	(void) previousChannelID;
+
+	pthread_mutex_lock(&recipientsLock);
+	recipients_onChannelEntered(recipientGroups, connection, userID, newChannelID);
+	pthread_mutex_unlock(&recipientsLock);
+
+	control_setChannel(controlServer, connection, userID, newChannelID);
+
+	indexChannelEntered(connection, userID, newChannelID);
+}
+
+void mumble_onChannelExited(mumble_connection_t connection, mumble_userid_t userID, mumble_channelid_t channelID) {
+	pthread_mutex_lock(&recipientsLock);
+	recipients_onChannelExited(recipientGroups, connection, userID, channelID);
+	pthread_mutex_unlock(&recipientsLock);
+
+	control_setChannel(controlServer, connection, userID, -1);
+}
+
+void mumble_onUserTalkingStateChanged(mumble_connection_t connection, mumble_userid_t userID,
+									  mumble_talking_state_t talkingState) {
+	control_setTalking(controlServer, connection, userID, talkingState);
+
+	// Only the active server's users are heard (and thus transcribed)
+	mumble_connection_t activeConnection;
+	if (transcriber && mumbleAPI.getActiveServerConnection(ownID, &activeConnection) == MUMBLE_STATUS_OK
+		&& activeConnection == connection) {
+		atomic_store(&transcribedConnection, connection);
+		transcription_setTalking(transcriber, userID,
+								 talkingState == MUMBLE_TS_TALKING || talkingState == MUMBLE_TS_WHISPERING
+									 || talkingState == MUMBLE_TS_SHOUTING);
+	}
+}
+
+void mumble_onServerDisconnected(mumble_connection_t connection) {
+	pthread_mutex_lock(&recipientsLock);
+	recipients_removeConnection(recipientGroups, connection);
+	pthread_mutex_unlock(&recipientsLock);
+
+	// Called from a different thread, but forgetting peers never produces packets
+	lockTransport(NULL);
+	transport_removeConnection(transport, connection);
+	unlockTransport();
+
+	// Releases all of the connection's state at once, other connections are left alone
+	pthread_mutex_lock(&connectionsLock);
+	connections_detach(connectionTable, connection);
+	pthread_mutex_unlock(&connectionsLock);
+
+	control_removeConnection(controlServer, connection);
+}
+
+static void holdTransmissionMode(uint32_t keyCode, mumble_transmission_mode_t mode) {
+	mumble_transmission_mode_t previousMode;
+	if (heldTransmissionModeCount == MAX_HELD_TRANSMISSION_MODES
+		|| mumbleAPI.getLocalUserTransmissionMode(ownID, &previousMode) != MUMBLE_STATUS_OK) {
+		return;
+	}
+	heldTransmissionModes[heldTransmissionModeCount].keyCode      = keyCode;
+	heldTransmissionModes[heldTransmissionModeCount].previousMode = previousMode;
+	heldTransmissionModeCount++;
+
+	mumbleAPI.requestLocalUserTransmissionMode(ownID, mode);
+}
+
+// Bindings may be released in any order. Only releasing the most recent one changes the mode, any other hands the mode
+// it would have restored down to the binding pressed after it.
+static void releaseTransmissionMode(uint32_t keyCode) {
+	size_t index = 0;
+	while (index < heldTransmissionModeCount && heldTransmissionModes[index].keyCode != keyCode) {
+		index++;
+	}
+	if (index == heldTransmissionModeCount) {
+		// Never took effect
+		return;
+	}
+
+	if (index + 1 == heldTransmissionModeCount) {
+		mumbleAPI.requestLocalUserTransmissionMode(ownID, heldTransmissionModes[index].previousMode);
+	} else {
+		heldTransmissionModes[index + 1].previousMode = heldTransmissionModes[index].previousMode;
+		memmove(&heldTransmissionModes[index], &heldTransmissionModes[index + 1],
+				(heldTransmissionModeCount - index - 1) * sizeof(heldTransmissionModes[0]));
+	}
+	heldTransmissionModeCount--;
+}
+
+static void performKeyAction(const struct KeyAction *action, uint32_t keyCode, bool activate) {
+	switch (action->type) {
+		case KEY_ACTION_TRANSMISSION_MODE:
+			if (!action->momentary) {
+				mumbleAPI.requestLocalUserTransmissionMode(ownID, action->transmissionMode);
+			} else if (activate) {
+				holdTransmissionMode(keyCode, action->transmissionMode);
+			} else {
+				releaseTransmissionMode(keyCode);
+			}
+			break;
+		case KEY_ACTION_MOVE_TO_CHANNEL: {
+			mumble_connection_t connection;
+			mumble_userid_t localUserID;
+			mumble_channelid_t channelID;
+			if (activate && mumbleAPI.getActiveServerConnection(ownID, &connection) == MUMBLE_STATUS_OK
+				&& mumbleAPI.getLocalUserID(ownID, connection, &localUserID) == MUMBLE_STATUS_OK
+				&& mumbleAPI.findChannelByName(ownID, connection, action->argument, &channelID) == MUMBLE_STATUS_OK) {
+				mumbleAPI.requestUserMove(ownID, connection, localUserID, channelID, NULL);
+			}
+			break;
+		}
+		case KEY_ACTION_PLAY_SAMPLE:
+			if (activate) {
+				mumbleAPI.playSample(ownID, action->argument);
+			}
+			break;
+		case KEY_ACTION_SOUNDBOARD:
+			if (activate) {
+				soundboard_trigger(soundboard, soundboard_findClip(soundboard, action->argument));
+			}
+			break;
+		case KEY_ACTION_SELF_MUTE: {
+			bool muted;
+			if (mumbleAPI.isLocalUserMuted(ownID, &muted) == MUMBLE_STATUS_OK) {
+				mumbleAPI.requestLocalUserMute(ownID, !muted);
+			}
+			break;
+		}
+		case KEY_ACTION_CUSTOM:
+			// This is where actions implemented by the plugin itself would be dispatched on action->customID
+			break;
+	}
+}
+
+static inline bool isDeactivated(uint32_t feature) {
+	return atomic_load_explicit(&deactivatedFeatures, memory_order_relaxed) & feature;
+}
+
+// The duration of the given amount of samples (per channel)
+static inline uint64_t audioDurationNs(uint32_t sampleCount, uint32_t sampleRate) {
+	return sampleRate > 0 ? (uint64_t) sampleCount * 1000000000ULL / sampleRate : 0;
+}
+
+#if PLUGIN_FEATURE_SOUNDBOARD
+static bool mixSoundboard(short *inputPCM, uint32_t sampleCount, uint16_t channelCount, uint32_t sampleRate) {
+	if (!inputFrameArena || isDeactivated(MUMBLE_FEATURE_AUDIO)) {
+		return false;
+	}
+	memory_arenaReset(inputFrameArena);
+
+	const struct PluginSettings *settings = config_acquire(config);
+	float volume                          = settings->soundboardVolume;
+	config_release(config);
+
+	uint64_t start = metrics_timeNs();
+	bool modified =
+		soundboard_mix(soundboard, inputPCM, sampleCount, channelCount, sampleRate, volume, inputFrameArena);
+	metrics_record(pluginMetrics.inputDuration, metrics_timeNs() - start);
+	metrics_increment(pluginMetrics.inputFrames, sampleCount);
+
+	return modified;
+}
+
+bool mumble_onAudioInput(short *inputPCM, uint32_t sampleCount, uint16_t channelCount, uint32_t sampleRate,
+						 bool isSpeech) {
+	// Clips are mixed in even if the input isn't transmitted (see soundboard.h), so that they keep playing in time
+	(void) isSpeech;
+
+	memory_setAudioThread(true);
+
+	// Mixing clips is never degraded, but it counts towards the input thread's load all the same
+	uint64_t start = metrics_timeNs();
+	bool modified  = mixSoundboard(inputPCM, sampleCount, channelCount, sampleRate);
+	governor_record(governor, GOVERNOR_INPUT, metrics_timeNs() - start, audioDurationNs(sampleCount, sampleRate));
+
+	return modified;
+}
+#endif
+
+#if PLUGIN_FEATURE_ACOUSTICS || PLUGIN_FEATURE_METERS
+
+static bool processSource(float *outputPCM, uint32_t sampleCount, uint16_t channelCount, uint32_t sampleRate,
+						  bool isSpeech, mumble_userid_t userID) {
+	// Samples are neither measured nor positioned in the level
+	if (!isSpeech || isDeactivated(MUMBLE_FEATURE_AUDIO)) {
+		return false;
+	}
+
+	const struct PluginSettings *settings = config_acquire(config);
+	bool enabled                          = settings->acoustics;
+	unsigned int spectrumRate             = settings->spectrumRate;
+	config_release(config);
+
+	// Speakers are measured as they arrive, whether the acoustics are applied or not
+	unsigned int metersTier = governor_getTier(governor, GOVERNED_METERS);
+	if (meters && metersTier != METERS_TIER_BYPASSED) {
+		uint64_t start = metrics_timeNs();
+		struct MeterLevels levels;
+		meters_process(meters, userID, outputPCM, sampleCount, channelCount, sampleRate,
+					   metersTier == METERS_TIER_FULL ? spectrumRate : 0, &levels);
+		control_publishLevel(controlServer, userID, levels.peak, levels.rms);
+		metrics_record(pluginMetrics.metersDuration, metrics_timeNs() - start);
+	}
+
+	// Speech is transcribed as it has been sent, before it is positioned
+	transcription_process(transcriber, userID, outputPCM, sampleCount, channelCount, sampleRate);
+
+	// Bypassed speakers are played as if there were no geometry
+	if (!PLUGIN_FEATURE_ACOUSTICS || !acoustics || !outputFrameArena || !enabled
+		|| governor_getTier(governor, GOVERNED_ACOUSTICS) > 0) {
+		return false;
+	}
+
+	struct MumbleSettings mumble;
+	mumblesettings_get(mumbleSettings, &mumble);
+	struct AcousticsDistanceModel distanceModel;
+	distanceModel.minimumDistance = (float) mumble.minimumDistance;
+	distanceModel.maximumDistance = (float) mumble.maximumDistance;
+	distanceModel.bloom           = (float) mumble.bloom;
+	distanceModel.minimumVolume   = (float) mumble.minimumVolume;
+
+	uint64_t start = metrics_timeNs();
+	bool modified  = acoustics_processSource(acoustics, outputPCM, sampleCount, channelCount, sampleRate, userID,
+											 &distanceModel, outputFrameArena);
+	metrics_record(pluginMetrics.sourceDuration, metrics_timeNs() - start);
+	metrics_increment(pluginMetrics.sourceFrames, sampleCount);
+
+	return modified;
+}
+
+bool mumble_onAudioSourceFetched(float *outputPCM, uint32_t sampleCount, uint16_t channelCount, uint32_t sampleRate,
+								 bool isSpeech, mumble_userid_t userID) {
+	memory_setAudioThread(true);
+
+	// Every speaker is fetched once per output buffer, so only mumble_onAudioOutputAboutToPlay advances the clock
+	uint64_t start = metrics_timeNs();
+	bool modified  = processSource(outputPCM, sampleCount, channelCount, sampleRate, isSpeech, userID);
+	governor_record(governor, GOVERNOR_OUTPUT, metrics_timeNs() - start, 0);
+
+	return modified;
+}
+#endif
+
+#if PLUGIN_FEATURE_ACOUSTICS
+static bool renderReverb(float *outputPCM, uint32_t sampleCount, uint16_t channelCount, uint32_t sampleRate) {
+	if (!acoustics) {
+		return false;
+	}
+	// The sends live in the frame arena, so they have to be dropped even if nothing is rendered
+	if (isDeactivated(MUMBLE_FEATURE_AUDIO)) {
+		acoustics_discardReverb(acoustics);
+		return false;
+	}
+
+	const struct PluginSettings *settings = config_acquire(config);
+	bool enabled                          = settings->reverb;
+	config_release(config);
+	if (!enabled || governor_getTier(governor, GOVERNED_REVERB) > 0) {
+		acoustics_discardReverb(acoustics);
+		return false;
+	}
+
+	uint64_t start = metrics_timeNs();
+	bool modified  = acoustics_renderReverb(acoustics, outputPCM, sampleCount, channelCount, sampleRate);
+	metrics_record(pluginMetrics.outputDuration, metrics_timeNs() - start);
+	metrics_increment(pluginMetrics.outputFrames, sampleCount);
+
+	return modified;
+}
+
+bool mumble_onAudioOutputAboutToPlay(float *outputPCM, uint32_t sampleCount, uint16_t channelCount,
+									 uint32_t sampleRate) {
+	memory_setAudioThread(true);
+
+	uint64_t start = metrics_timeNs();
+	bool modified  = renderReverb(outputPCM, sampleCount, channelCount, sampleRate);
+	governor_record(governor, GOVERNOR_OUTPUT, metrics_timeNs() - start, audioDurationNs(sampleCount, sampleRate));
+
+	// The sends have been rendered or discarded, which ends the buffer's use of the arena
+	if (outputFrameArena) {
+		memory_arenaReset(outputFrameArena);
+	}
+
+	return modified;
+}
+#endif
+
+#if PLUGIN_FEATURE_POSITIONAL
+// Lets the other instances of this plugin in the local user's channel know where the local user's avatar is (see
+// SPATIAL_POSITION_DATA_ID)
+static void publishPosition() {
+	uint64_t now = currentTimeMs();
+	if (!positionalData.active || now - lastPublishedMs < POSITION_PUBLISH_INTERVAL_MS) {
+		return;
+	}
+	lastPublishedMs = now;
+
+	mumble_connection_t connection;
+	if (mumbleAPI.getActiveServerConnection(ownID, &connection) != MUMBLE_STATUS_OK) {
+		return;
+	}
+
+	uint8_t data[SPATIAL_POSITION_DATA_SIZE];
+	spatial_encodePosition(positionalData.avatarPosition, data);
+
+	mumble_error_t error = sendDataToGroup(connection, RECIPIENTS_GROUP_CHANNEL, data, sizeof(data),
+										   SPATIAL_POSITION_DATA_ID);
+	if (error != MUMBLE_STATUS_OK) {
+		LOG_DEBUG(logger, "Failed to publish the local position (error %d)", error);
+	}
+}
+
+// Hands the users around the listener to the acoustics engine: everyone within Mumble's maximum distance, or the
+// closest ones if there are more of them than the engine can track
+static void selectSpeakers() {
+	uint64_t now = currentTimeMs();
+	if (!acoustics || !positionalData.active || now - lastSelectedSpeakersMs < SPEAKER_SELECTION_INTERVAL_MS) {
+		return;
+	}
+	lastSelectedSpeakersMs = now;
+
+	mumble_connection_t connection;
+	if (mumbleAPI.getActiveServerConnection(ownID, &connection) != MUMBLE_STATUS_OK) {
+		return;
+	}
+
+	struct MumbleSettings mumble;
+	mumblesettings_get(mumbleSettings, &mumble);
+
+	const float *listener = positionalData.cameraPosition;
+	mumble_userid_t speakers[ACOUSTICS_MAX_SPEAKERS];
+	float positions[ACOUSTICS_MAX_SPEAKERS][3];
+	size_t speakerCount = 0;
+
+	pthread_mutex_lock(&connectionsLock);
+	struct ConnectionShard *shard = connections_find(connectionTable, connection);
+	if (shard) {
+		speakerCount = spatial_queryRadius(shard->spatial, listener, (float) mumble.maximumDistance, speakers,
+										   ACOUSTICS_MAX_SPEAKERS);
+		if (speakerCount > ACOUSTICS_MAX_SPEAKERS) {
+			speakerCount = spatial_queryNearest(shard->spatial, listener, ACOUSTICS_MAX_SPEAKERS, speakers, NULL);
+		}
+		for (size_t i = 0; i < speakerCount; i++) {
+			spatial_getPosition(shard->spatial, speakers[i], positions[i]);
+		}
+	}
+	pthread_mutex_unlock(&connectionsLock);
+
+	for (size_t i = 0; i < selectedSpeakerCount; i++) {
+		bool stillSelected = false;
+		for (size_t j = 0; j < speakerCount && !stillSelected; j++) {
+			stillSelected = speakers[j] == selectedSpeakers[i];
+		}
+		if (!stillSelected) {
+			acoustics_removeSpeaker(acoustics, selectedSpeakers[i]);
+		}
+	}
+
+	for (size_t i = 0; i < speakerCount; i++) {
+		acoustics_setSpeaker(acoustics, speakers[i], positions[i]);
+		selectedSpeakers[i] = speakers[i];
+	}
+	selectedSpeakerCount = speakerCount;
+}
+
+uint8_t mumble_initPositionalData(const char *const *programNames, const uint64_t *programPIDs, size_t programCount) {
+	if (isDeactivated(MUMBLE_FEATURE_POSITIONAL)) {
+		return MUMBLE_PDEC_ERROR_PERM;
+	}
+
+	positionalBridge = positional_open(programPIDs, programCount);
+	if (!positionalBridge) {
+		attachedGame = games_attach(gameRegistry, programNames, programPIDs, programCount);
+	}
+
+	if (!positionalBridge && !attachedGame) {
+		// No game is publishing its coordinates and no supported game is running (yet)
+		return MUMBLE_PDEC_ERROR_TEMP;
+	}
+
+	memset(&positionalData, 0, sizeof(positionalData));
+
+	return MUMBLE_PDEC_OK;
+}
+
+bool mumble_fetchPositionalData(float *avatarPos, float *avatarDir, float *avatarAxis, float *cameraPos,
+								float *cameraDir, float *cameraAxis, const char **context, const char **identity) {
+	// This is called regularly from the main thread, which makes it a good place to keep the mirror up to date
+	mumblesettings_refreshIfDue(mumbleSettings, currentTimeMs());
+
+	bool alive = positionalBridge ? positional_read(positionalBridge, &positionalData)
+								  : games_read(attachedGame, &positionalData);
+	if (!alive) {
+		memset(&positionalData, 0, sizeof(positionalData));
+	}
+
+	memcpy(avatarPos, positionalData.avatarPosition, sizeof(positionalData.avatarPosition));
+	memcpy(avatarDir, positionalData.avatarFront, sizeof(positionalData.avatarFront));
+	memcpy(avatarAxis, positionalData.avatarTop, sizeof(positionalData.avatarTop));
+	memcpy(cameraPos, positionalData.cameraPosition, sizeof(positionalData.cameraPosition));
+	memcpy(cameraDir, positionalData.cameraFront, sizeof(positionalData.cameraFront));
+	memcpy(cameraAxis, positionalData.cameraTop, sizeof(positionalData.cameraTop));
+	*context  = positionalData.context;
+	*identity = positionalData.identity;
+
+	if (acoustics) {
+		if (positionalData.active) {
+			acoustics_setListener(acoustics, positionalData.cameraPosition);
+		} else {
+			acoustics_clearListener(acoustics);
+		}
+	}
+
+	publishPosition();
+	selectSpeakers();
+
+	return alive;
+}
+
+void mumble_shutdownPositionalData() {
+	positional_close(positionalBridge);
+	positionalBridge = NULL;
+	games_detach(attachedGame);
+	attachedGame    = NULL;
+	lastPublishedMs = 0;
+
+	if (acoustics) {
+		acoustics_clearListener(acoustics);
+	}
+}
+#endif
+
+// Compiles the configured bindings (once per configuration generation)
+static void applyBindings() {
+	const struct PluginSettings *settings = config_acquire(config);
+
+	if (settings->generation != appliedBindingsGeneration) {
+		keybindings_clear(keyBindings);
+		for (size_t i = 0; i < settings->bindingCount; i++) {
+			// Invalid or conflicting bindings are skipped
+			keybindings_add(keyBindings, settings->bindings[i].spec, &settings->bindings[i].action);
+		}
+		appliedBindingsGeneration = settings->generation;
+	}
+
+	config_release(config);
+}
+
+void mumble_onKeyEvent(uint32_t keyCode, bool wasPress) {
+	applyBindings();
+	mumblesettings_refreshIfDue(mumbleSettings, currentTimeMs());
+
+	bool activate;
+	const struct KeyAction *action = keybindings_onKeyEvent(keyBindings, keyCode, wasPress, currentTimeMs(), &activate);
+	if (action) {
+		performKeyAction(action, keyCode, activate);
+	}
 }
 
 
@@ -87,3 +1781,35 @@ struct MumbleStringWrapper mumble_getDescription() {
 
 	return wrapper;
 }
+
+uint32_t mumble_getFeatures() {
+	return PLUGIN_MUMBLE_FEATURES;
+}
+
+uint32_t mumble_deactivateFeatures(uint32_t features) {
+	// Features that haven't been compiled in are inactive already
+	atomic_fetch_or_explicit(&deactivatedFeatures, features & PLUGIN_MUMBLE_FEATURES, memory_order_relaxed);
+
+	return MUMBLE_FEATURE_NONE;
+}
+
+bool mumble_hasUpdate() {
+	// Answered from memory, the manifest is fetched in the background
+	return update_available(updateChecker);
+}
+
+struct MumbleStringWrapper mumble_getUpdateDownloadURL() {
+	struct MumbleStringWrapper wrapper;
+	wrapper.data           = "";
+	wrapper.size           = 0;
+	wrapper.needsReleasing = false;
+
+	char *url = update_available(updateChecker) ? memory_alloc(MEMORY_UPDATE, UPDATE_MAX_URL) : NULL;
+	if (url) {
+		wrapper.data           = url;
+		wrapper.size           = update_getURL(updateChecker, url, UPDATE_MAX_URL);
+		wrapper.needsReleasing = true;
+	}
+
+	return wrapper;
+}
@@ -0,0 +1,245 @@
+#include "positional.h"
+#include "memory.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+// If the writer keeps updating while the data is copied, give up after this many attempts and keep the old data
+#define MAX_READ_ATTEMPTS 16
+// Coordinates beyond this (in meters) are considered garbage
+#define MAX_COORDINATE 1.0e6f
+
+struct PositionalBridge {
+	const struct PositionalSharedData *shared;
+};
+
+// The fields protected by the sequence counter
+struct Snapshot {
+	uint32_t active;
+	float vectors[POSITIONAL_VECTOR_COUNT][3];
+	char context[POSITIONAL_MAX_STRING];
+	char identity[POSITIONAL_MAX_STRING];
+};
+
+static bool takeSnapshot(const struct PositionalSharedData *shared, struct Snapshot *snapshot) {
+	// The sequence counter is atomic, but as the region is mapped read-only it is never written through this pointer
+	atomic_uint *sequence = (atomic_uint *) &shared->sequence;
+
+	for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+		unsigned before = atomic_load_explicit(sequence, memory_order_acquire);
+		if (before & 1) {
+			continue;
+		}
+
+		snapshot->active = shared->active;
+		memcpy(snapshot->vectors[POSITIONAL_AVATAR_POSITION], shared->avatarPosition, sizeof(float[3]));
+		memcpy(snapshot->vectors[POSITIONAL_AVATAR_FRONT], shared->avatarFront, sizeof(float[3]));
+		memcpy(snapshot->vectors[POSITIONAL_AVATAR_TOP], shared->avatarTop, sizeof(float[3]));
+		memcpy(snapshot->vectors[POSITIONAL_CAMERA_POSITION], shared->cameraPosition, sizeof(float[3]));
+		memcpy(snapshot->vectors[POSITIONAL_CAMERA_FRONT], shared->cameraFront, sizeof(float[3]));
+		memcpy(snapshot->vectors[POSITIONAL_CAMERA_TOP], shared->cameraTop, sizeof(float[3]));
+		memcpy(snapshot->context, shared->context, sizeof(snapshot->context));
+		memcpy(snapshot->identity, shared->identity, sizeof(snapshot->identity));
+
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(sequence, memory_order_relaxed) == before) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static float unitScale(uint32_t units) {
+	switch (units) {
+		case POSITIONAL_UNITS_METERS:
+			return 1.0f;
+		case POSITIONAL_UNITS_CENTIMETERS:
+			return 0.01f;
+		case POSITIONAL_UNITS_INCHES:
+			return 0.0254f;
+		case POSITIONAL_UNITS_FEET:
+			return 0.3048f;
+		default:
+			return 0.0f;
+	}
+}
+
+// Converts the given vector into Mumble's coordinate system
+static bool convertAxes(uint32_t axes, const float in[3], float out[3]) {
+	switch (axes) {
+		case POSITIONAL_AXES_Y_UP_LEFT_HANDED:
+			out[0] = in[0];
+			out[1] = in[1];
+			out[2] = in[2];
+			return true;
+		case POSITIONAL_AXES_Y_UP_RIGHT_HANDED:
+			out[0] = in[0];
+			out[1] = in[1];
+			out[2] = -in[2];
+			return true;
+		case POSITIONAL_AXES_Z_UP_RIGHT_HANDED:
+			out[0] = -in[1];
+			out[1] = in[2];
+			out[2] = in[0];
+			return true;
+		default:
+			return false;
+	}
+}
+
+static bool convertPosition(uint32_t units, uint32_t axes, const float in[3], float out[3]) {
+	if (!convertAxes(axes, in, out)) {
+		return false;
+	}
+
+	float scale = unitScale(units);
+	for (int i = 0; i < 3; i++) {
+		out[i] *= scale;
+		if (!isfinite(out[i]) || fabsf(out[i]) > MAX_COORDINATE) {
+			return false;
+		}
+	}
+
+	return scale > 0.0f;
+}
+
+// Direction vectors are unitless, so they are only normalized. A zero vector is valid only if allowZero is set.
+static bool convertDirection(uint32_t axes, const float in[3], float out[3], bool allowZero) {
+	if (!convertAxes(axes, in, out)) {
+		return false;
+	}
+
+	float length = sqrtf(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+	if (!isfinite(length)) {
+		return false;
+	}
+	if (length < 1e-6f) {
+		out[0] = out[1] = out[2] = 0.0f;
+		return allowZero;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		out[i] /= length;
+	}
+
+	return true;
+}
+
+bool positional_convert(uint32_t units, uint32_t axes, const float vectors[POSITIONAL_VECTOR_COUNT][3],
+						struct PositionalData *data) {
+	// Convert into a temporary so that data remains untouched if anything is invalid
+	float out[POSITIONAL_VECTOR_COUNT][3];
+	bool valid = convertPosition(units, axes, vectors[POSITIONAL_AVATAR_POSITION], out[POSITIONAL_AVATAR_POSITION])
+				 && convertDirection(axes, vectors[POSITIONAL_AVATAR_FRONT], out[POSITIONAL_AVATAR_FRONT], false)
+				 && convertDirection(axes, vectors[POSITIONAL_AVATAR_TOP], out[POSITIONAL_AVATAR_TOP], true)
+				 && convertPosition(units, axes, vectors[POSITIONAL_CAMERA_POSITION], out[POSITIONAL_CAMERA_POSITION])
+				 && convertDirection(axes, vectors[POSITIONAL_CAMERA_FRONT], out[POSITIONAL_CAMERA_FRONT], false)
+				 && convertDirection(axes, vectors[POSITIONAL_CAMERA_TOP], out[POSITIONAL_CAMERA_TOP], true);
+	if (!valid) {
+		return false;
+	}
+
+	memcpy(data->avatarPosition, out[POSITIONAL_AVATAR_POSITION], sizeof(data->avatarPosition));
+	memcpy(data->avatarFront, out[POSITIONAL_AVATAR_FRONT], sizeof(data->avatarFront));
+	memcpy(data->avatarTop, out[POSITIONAL_AVATAR_TOP], sizeof(data->avatarTop));
+	memcpy(data->cameraPosition, out[POSITIONAL_CAMERA_POSITION], sizeof(data->cameraPosition));
+	memcpy(data->cameraFront, out[POSITIONAL_CAMERA_FRONT], sizeof(data->cameraFront));
+	memcpy(data->cameraTop, out[POSITIONAL_CAMERA_TOP], sizeof(data->cameraTop));
+
+	return true;
+}
+
+struct PositionalBridge *positional_open(const uint64_t *processIDs, size_t processCount) {
+#ifndef _WIN32
+	int fd = shm_open(POSITIONAL_SHM_NAME, O_RDONLY, 0);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(struct PositionalSharedData)) {
+		close(fd);
+		return NULL;
+	}
+
+	void *mapping = mmap(NULL, sizeof(struct PositionalSharedData), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return NULL;
+	}
+
+	const struct PositionalSharedData *shared = mapping;
+	bool writerRunning                        = false;
+	for (size_t i = 0; i < processCount; i++) {
+		writerRunning = writerRunning || processIDs[i] == shared->writerPID;
+	}
+
+	struct PositionalBridge *bridge = NULL;
+	if (shared->magic == POSITIONAL_MAGIC && shared->version == POSITIONAL_ABI_VERSION && writerRunning) {
+		bridge = memory_alloc(MEMORY_POSITIONAL, sizeof(struct PositionalBridge));
+	}
+	if (!bridge) {
+		munmap(mapping, sizeof(struct PositionalSharedData));
+		return NULL;
+	}
+
+	bridge->shared = shared;
+
+	return bridge;
+#else
+	(void) processIDs;
+	(void) processCount;
+
+	return NULL;
+#endif
+}
+
+void positional_close(struct PositionalBridge *bridge) {
+	if (!bridge) {
+		return;
+	}
+
+#ifndef _WIN32
+	munmap((void *) bridge->shared, sizeof(struct PositionalSharedData));
+#endif
+	memory_free(bridge);
+}
+
+bool positional_read(struct PositionalBridge *bridge, struct PositionalData *data) {
+	const struct PositionalSharedData *shared = bridge->shared;
+	if (shared->magic != POSITIONAL_MAGIC) {
+		return false;
+	}
+
+	struct Snapshot snapshot;
+	if (!takeSnapshot(shared, &snapshot)) {
+		return true;
+	}
+
+	if (!snapshot.active) {
+		memset(data, 0, sizeof(*data));
+		return true;
+	}
+
+	// Invalid data mustn't overwrite the last valid state
+	if (!positional_convert(shared->units, shared->axes, snapshot.vectors, data)) {
+		return true;
+	}
+
+	data->active = true;
+	memcpy(data->context, snapshot.context, sizeof(data->context));
+	data->context[POSITIONAL_MAX_STRING - 1] = '\0';
+	memcpy(data->identity, snapshot.identity, sizeof(data->identity));
+	data->identity[POSITIONAL_MAX_STRING - 1] = '\0';
+
+	return true;
+}
@@ -0,0 +1,134 @@
+/// This header file declares the shared-memory bridge through which games can publish their positional data directly.
+///
+/// A game creates a POSIX shared memory object named POSITIONAL_SHM_NAME (shm_open), sizes it to
+/// sizeof(struct PositionalSharedData) and keeps it updated. The plugin maps it read-only and copies the data out in
+/// mumble_fetchPositionalData without any syscalls.
+///
+/// Writers have to follow this protocol (a seqlock):
+/// 1. Once after creating the region: fill in magic, version, units, axes and writerPID
+/// 2. For every update: increment sequence (it becomes odd), write the data, increment sequence again (it becomes
+///    even).
+///    The increments need release semantics, e.g. atomic_fetch_add_explicit(&shared->sequence, 1,
+///    memory_order_release) followed by atomic_thread_fence(memory_order_release) for the first one.
+/// 3. When shutting down: set magic to 0 and unlink the region
+///
+/// Readers never block the writer. If an update happens while the plugin copies the data, the copy is simply retried.
+///
+/// NOTE: The shared memory bridge is only available on POSIX systems.
+
+#ifndef MUMBLE_PLUGIN_POSITIONAL_H_
+#define MUMBLE_PLUGIN_POSITIONAL_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define POSITIONAL_SHM_NAME "/hello_mumble_positional"
+#define POSITIONAL_MAGIC 0x50534d48 // "HMSP"
+#define POSITIONAL_ABI_VERSION 1
+/// The size of the context and identity buffers (including the terminating null byte)
+#define POSITIONAL_MAX_STRING 256
+
+/// The unit the game's coordinates are given in
+enum PositionalUnits {
+	POSITIONAL_UNITS_METERS      = 0,
+	POSITIONAL_UNITS_CENTIMETERS = 1,
+	POSITIONAL_UNITS_INCHES      = 2,
+	POSITIONAL_UNITS_FEET        = 3,
+};
+
+/// The game's coordinate system. Mumble expects a left-handed system with X pointing right, Y up and Z forward.
+enum PositionalAxes {
+	/// X right, Y up, Z forward (Mumble's own convention)
+	POSITIONAL_AXES_Y_UP_LEFT_HANDED  = 0,
+	/// X right, Y up, Z backward (e.g. OpenGL)
+	POSITIONAL_AXES_Y_UP_RIGHT_HANDED = 1,
+	/// X forward, Y left, Z up (e.g. Source engine)
+	POSITIONAL_AXES_Z_UP_RIGHT_HANDED = 2,
+};
+
+/// The layout of the shared memory region. All fields are in native byte order.
+struct PositionalSharedData {
+	/// POSITIONAL_MAGIC as long as the writer is alive
+	uint32_t magic;
+	/// POSITIONAL_ABI_VERSION
+	uint32_t version;
+	/// Odd while the writer is updating the fields below
+	atomic_uint sequence;
+	/// An enum PositionalUnits value
+	uint32_t units;
+	/// An enum PositionalAxes value
+	uint32_t axes;
+	/// The process ID of the game. The region is only used while this process is running.
+	uint32_t writerPID;
+
+	/// Whether the player is actually in a game. If this is zero, no positional audio is used.
+	uint32_t active;
+	uint32_t reserved;
+
+	float avatarPosition[3];
+	float avatarFront[3];
+	float avatarTop[3];
+	float cameraPosition[3];
+	float cameraFront[3];
+	float cameraTop[3];
+
+	/// Null-terminated, see mumble_fetchPositionalData
+	char context[POSITIONAL_MAX_STRING];
+	/// Null-terminated, see mumble_fetchPositionalData
+	char identity[POSITIONAL_MAX_STRING];
+};
+
+/// Positional data as Mumble expects it (meters, Mumble's coordinate system, normalized directions)
+struct PositionalData {
+	bool active;
+	float avatarPosition[3];
+	float avatarFront[3];
+	float avatarTop[3];
+	float cameraPosition[3];
+	float cameraFront[3];
+	float cameraTop[3];
+	char context[POSITIONAL_MAX_STRING];
+	char identity[POSITIONAL_MAX_STRING];
+};
+
+/// The vectors making up positional data in the order positional_convert expects them
+enum PositionalVector {
+	POSITIONAL_AVATAR_POSITION,
+	POSITIONAL_AVATAR_FRONT,
+	POSITIONAL_AVATAR_TOP,
+	POSITIONAL_CAMERA_POSITION,
+	POSITIONAL_CAMERA_FRONT,
+	POSITIONAL_CAMERA_TOP,
+	POSITIONAL_VECTOR_COUNT,
+};
+
+struct PositionalBridge;
+
+/// Maps the shared memory region if a game has created it
+///
+/// @param processIDs The IDs of the currently running processes (see mumble_initPositionalData). The region is only
+/// accepted if its writer is one of them, so that stale regions of crashed games are ignored.
+/// @returns The bridge or NULL if there's no valid region (yet)
+struct PositionalBridge *positional_open(const uint64_t *processIDs, size_t processCount);
+
+void positional_close(struct PositionalBridge *bridge);
+
+/// Copies the current data out of the shared memory region, converting and validating it on the way
+///
+/// @param[out] data The converted data. If the region currently holds invalid data (e.g. non-finite coordinates), the
+/// previously read data is kept.
+/// @returns Whether the writer is still alive. If this returns false, the bridge should be closed.
+bool positional_read(struct PositionalBridge *bridge, struct PositionalData *data);
+
+/// Converts the given vectors from the game's units and coordinate system and validates them
+///
+/// @param units An enum PositionalUnits value
+/// @param axes An enum PositionalAxes value
+/// @param[out] data Receives the converted vectors. Its other fields are left untouched.
+/// @returns Whether the vectors were valid. If not, data hasn't been modified.
+bool positional_convert(uint32_t units, uint32_t axes, const float vectors[POSITIONAL_VECTOR_COUNT][3],
+						struct PositionalData *data);
+
+#endif // MUMBLE_PLUGIN_POSITIONAL_H_
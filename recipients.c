@@ -0,0 +1,366 @@
+#include "recipients.h"
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GROUP_INDEX_CHANNEL 0
+#define GROUP_INDEX_SERVER 1
+#define BUILTIN_GROUP_COUNT 2
+
+// A sorted array of user IDs
+struct UserSet {
+	mumble_userid_t *ids;
+	size_t count;
+	size_t capacity;
+};
+
+struct Group {
+	char name[RECIPIENTS_MAX_GROUP_NAME];
+	struct UserSet members;
+};
+
+struct UserLocation {
+	mumble_userid_t userID;
+	mumble_channelid_t channelID;
+};
+
+struct ConnectionGroups {
+	bool inUse;
+	mumble_connection_t connection;
+	bool localUserKnown;
+	mumble_userid_t localUserID;
+	// Sorted by user ID
+	struct UserLocation *users;
+	size_t userCount;
+	size_t userCapacity;
+	struct Group groups[BUILTIN_GROUP_COUNT];
+	size_t groupCount;
+};
+
+struct RecipientGroups {
+	struct ConnectionGroups connections[RECIPIENTS_MAX_CONNECTIONS];
+};
+
+
+// Returns the index at which the given ID is or would have to be inserted
+static size_t lowerBound(const mumble_userid_t *ids, size_t count, mumble_userid_t userID) {
+	size_t low  = 0;
+	size_t high = count;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (ids[mid] < userID) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static bool userSet_insert(struct UserSet *set, mumble_userid_t userID) {
+	size_t index = lowerBound(set->ids, set->count, userID);
+	if (index < set->count && set->ids[index] == userID) {
+		return true;
+	}
+
+	if (set->count == set->capacity) {
+		size_t capacity      = set->capacity ? set->capacity * 2 : 16;
+		mumble_userid_t *ids = memory_realloc(MEMORY_RECIPIENTS, set->ids, capacity * sizeof(mumble_userid_t));
+		if (!ids) {
+			return false;
+		}
+		set->ids      = ids;
+		set->capacity = capacity;
+	}
+
+	memmove(set->ids + index + 1, set->ids + index, (set->count - index) * sizeof(mumble_userid_t));
+	set->ids[index] = userID;
+	set->count++;
+
+	return true;
+}
+
+static void userSet_remove(struct UserSet *set, mumble_userid_t userID) {
+	size_t index = lowerBound(set->ids, set->count, userID);
+	if (index == set->count || set->ids[index] != userID) {
+		return;
+	}
+
+	memmove(set->ids + index, set->ids + index + 1, (set->count - index - 1) * sizeof(mumble_userid_t));
+	set->count--;
+}
+
+
+static size_t userLowerBound(const struct ConnectionGroups *state, mumble_userid_t userID) {
+	size_t low  = 0;
+	size_t high = state->userCount;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (state->users[mid].userID < userID) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static struct UserLocation *findUser(struct ConnectionGroups *state, mumble_userid_t userID) {
+	size_t index = userLowerBound(state, userID);
+	if (index < state->userCount && state->users[index].userID == userID) {
+		return &state->users[index];
+	}
+
+	return NULL;
+}
+
+static struct UserLocation *insertUser(struct ConnectionGroups *state, mumble_userid_t userID) {
+	struct UserLocation *existing = findUser(state, userID);
+	if (existing) {
+		return existing;
+	}
+
+	if (state->userCount == state->userCapacity) {
+		size_t capacity = state->userCapacity ? state->userCapacity * 2 : 32;
+		struct UserLocation *users =
+			memory_realloc(MEMORY_RECIPIENTS, state->users, capacity * sizeof(struct UserLocation));
+		if (!users) {
+			return NULL;
+		}
+		state->users        = users;
+		state->userCapacity = capacity;
+	}
+
+	size_t index = userLowerBound(state, userID);
+	memmove(state->users + index + 1, state->users + index, (state->userCount - index) * sizeof(struct UserLocation));
+	state->users[index].userID    = userID;
+	state->users[index].channelID = -1;
+	state->userCount++;
+
+	if (!state->localUserKnown || state->localUserID != userID) {
+		userSet_insert(&state->groups[GROUP_INDEX_SERVER].members, userID);
+	}
+
+	return &state->users[index];
+}
+
+static mumble_channelid_t localChannel(struct ConnectionGroups *state) {
+	if (!state->localUserKnown) {
+		return -1;
+	}
+
+	struct UserLocation *local = findUser(state, state->localUserID);
+
+	return local ? local->channelID : -1;
+}
+
+static void rebuildChannelGroup(struct ConnectionGroups *state) {
+	struct UserSet *members = &state->groups[GROUP_INDEX_CHANNEL].members;
+	members->count          = 0;
+
+	mumble_channelid_t channelID = localChannel(state);
+	if (channelID < 0) {
+		return;
+	}
+
+	// Users are sorted by ID already, so this produces a sorted array
+	for (size_t i = 0; i < state->userCount; i++) {
+		if (state->users[i].channelID == channelID && state->users[i].userID != state->localUserID) {
+			userSet_insert(members, state->users[i].userID);
+		}
+	}
+}
+
+static void clearConnection(struct ConnectionGroups *state) {
+	for (size_t i = 0; i < state->groupCount; i++) {
+		memory_free(state->groups[i].members.ids);
+	}
+	memory_free(state->users);
+
+	memset(state, 0, sizeof(*state));
+}
+
+static struct ConnectionGroups *findConnection(const struct RecipientGroups *groups, mumble_connection_t connection) {
+	if (!groups) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < RECIPIENTS_MAX_CONNECTIONS; i++) {
+		if (groups->connections[i].inUse && groups->connections[i].connection == connection) {
+			return (struct ConnectionGroups *) &groups->connections[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct ConnectionGroups *getConnection(struct RecipientGroups *groups, mumble_connection_t connection) {
+	struct ConnectionGroups *state = findConnection(groups, connection);
+	if (state || !groups) {
+		return state;
+	}
+
+	for (size_t i = 0; i < RECIPIENTS_MAX_CONNECTIONS; i++) {
+		state = &groups->connections[i];
+		if (!state->inUse) {
+			state->inUse      = true;
+			state->connection = connection;
+			strcpy(state->groups[GROUP_INDEX_CHANNEL].name, RECIPIENTS_GROUP_CHANNEL);
+			strcpy(state->groups[GROUP_INDEX_SERVER].name, RECIPIENTS_GROUP_SERVER);
+			state->groupCount = BUILTIN_GROUP_COUNT;
+
+			return state;
+		}
+	}
+
+	return NULL;
+}
+
+
+struct RecipientGroups *recipients_create() {
+	return memory_calloc(MEMORY_RECIPIENTS, 1, sizeof(struct RecipientGroups));
+}
+
+void recipients_destroy(struct RecipientGroups *groups) {
+	if (!groups) {
+		return;
+	}
+
+	for (size_t i = 0; i < RECIPIENTS_MAX_CONNECTIONS; i++) {
+		clearConnection(&groups->connections[i]);
+	}
+
+	memory_free(groups);
+}
+
+recipients_group_t recipients_findGroup(const struct RecipientGroups *groups, mumble_connection_t connection,
+										const char *name) {
+	const struct ConnectionGroups *state = findConnection(groups, connection);
+	if (!state) {
+		return RECIPIENTS_INVALID_GROUP;
+	}
+
+	for (size_t i = 0; i < state->groupCount; i++) {
+		if (strcmp(state->groups[i].name, name) == 0) {
+			return (recipients_group_t) i;
+		}
+	}
+
+	return RECIPIENTS_INVALID_GROUP;
+}
+
+const mumble_userid_t *recipients_get(const struct RecipientGroups *groups, mumble_connection_t connection,
+									  recipients_group_t group, size_t *count) {
+	struct ConnectionGroups *state = findConnection(groups, connection);
+	if (!state || group < 0 || (size_t) group >= state->groupCount) {
+		*count = 0;
+		return NULL;
+	}
+
+	*count = state->groups[group].members.count;
+
+	return state->groups[group].members.ids;
+}
+
+mumble_channelid_t recipients_getChannel(const struct RecipientGroups *groups, mumble_connection_t connection,
+										 mumble_userid_t userID) {
+	struct ConnectionGroups *state = findConnection(groups, connection);
+	struct UserLocation *user      = state ? findUser(state, userID) : NULL;
+
+	return user ? user->channelID : -1;
+}
+
+void recipients_setLocalUser(struct RecipientGroups *groups, mumble_connection_t connection, mumble_userid_t userID) {
+	struct ConnectionGroups *state = getConnection(groups, connection);
+	if (!state) {
+		return;
+	}
+
+	state->localUserKnown = true;
+	state->localUserID    = userID;
+
+	userSet_remove(&state->groups[GROUP_INDEX_SERVER].members, userID);
+	rebuildChannelGroup(state);
+}
+
+void recipients_onUserAdded(struct RecipientGroups *groups, mumble_connection_t connection, mumble_userid_t userID) {
+	struct ConnectionGroups *state = getConnection(groups, connection);
+	if (state) {
+		insertUser(state, userID);
+	}
+}
+
+void recipients_onUserRemoved(struct RecipientGroups *groups, mumble_connection_t connection,
+							  mumble_userid_t userID) {
+	struct ConnectionGroups *state = findConnection(groups, connection);
+	if (!state) {
+		return;
+	}
+
+	struct UserLocation *user = findUser(state, userID);
+	if (user) {
+		size_t index = (size_t)(user - state->users);
+		memmove(state->users + index, state->users + index + 1,
+				(state->userCount - index - 1) * sizeof(struct UserLocation));
+		state->userCount--;
+	}
+
+	for (size_t i = 0; i < state->groupCount; i++) {
+		userSet_remove(&state->groups[i].members, userID);
+	}
+}
+
+void recipients_onChannelEntered(struct RecipientGroups *groups, mumble_connection_t connection,
+								 mumble_userid_t userID, mumble_channelid_t channelID) {
+	struct ConnectionGroups *state = getConnection(groups, connection);
+	if (!state) {
+		return;
+	}
+
+	struct UserLocation *user = insertUser(state, userID);
+	if (!user) {
+		return;
+	}
+
+	user->channelID = channelID;
+
+	if (state->localUserKnown && userID == state->localUserID) {
+		rebuildChannelGroup(state);
+	} else if (channelID >= 0 && channelID == localChannel(state)) {
+		userSet_insert(&state->groups[GROUP_INDEX_CHANNEL].members, userID);
+	} else {
+		userSet_remove(&state->groups[GROUP_INDEX_CHANNEL].members, userID);
+	}
+}
+
+void recipients_onChannelExited(struct RecipientGroups *groups, mumble_connection_t connection,
+								mumble_userid_t userID, mumble_channelid_t channelID) {
+	struct ConnectionGroups *state = findConnection(groups, connection);
+	if (!state) {
+		return;
+	}
+
+	struct UserLocation *user = findUser(state, userID);
+	if (!user || user->channelID != channelID) {
+		// Already moved on to another channel
+		return;
+	}
+
+	user->channelID = -1;
+
+	if (state->localUserKnown && userID == state->localUserID) {
+		rebuildChannelGroup(state);
+	} else {
+		userSet_remove(&state->groups[GROUP_INDEX_CHANNEL].members, userID);
+	}
+}
+
+void recipients_removeConnection(struct RecipientGroups *groups, mumble_connection_t connection) {
+	struct ConnectionGroups *state = findConnection(groups, connection);
+	if (state) {
+		clearConnection(state);
+	}
+}
@@ -0,0 +1,77 @@
+/// This header file declares cached recipient groups for sending plugin data.
+///
+/// A recipient group is a named, sorted array of user IDs that is kept up to date from Mumble's user and channel
+/// events. Sending to a group therefore doesn't require any API round-trips or allocations: the array returned by
+/// recipients_get can be passed to mumbleAPI.sendData as-is.
+///
+/// Every connection has two groups: RECIPIENTS_GROUP_CHANNEL (all users in the local user's channel) and
+/// RECIPIENTS_GROUP_SERVER (all users on the server). Neither of them contains the local user.
+///
+/// The groups are part of the positional stage, whose position updates are what the plugin sends to them (see
+/// stages.h). Builds without it don't create the groups at all, so every function accepts NULL and treats it like a
+/// set of groups that doesn't know about any connection.
+///
+/// NOTE: The functions in this file are not thread-safe. Pointers returned by recipients_get stay valid until the next
+/// call modifying the respective connection's state.
+
+#ifndef MUMBLE_PLUGIN_RECIPIENTS_H_
+#define MUMBLE_PLUGIN_RECIPIENTS_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RECIPIENTS_GROUP_CHANNEL "channel"
+#define RECIPIENTS_GROUP_SERVER "server"
+
+/// The maximum length of a group name (including the terminating null byte)
+#define RECIPIENTS_MAX_GROUP_NAME 32
+/// The maximum amount of connections tracked at the same time
+#define RECIPIENTS_MAX_CONNECTIONS 8
+
+/// A handle that can be used instead of a group's name in order to skip the name lookup
+typedef int recipients_group_t;
+
+#define RECIPIENTS_INVALID_GROUP (-1)
+
+struct RecipientGroups;
+
+/// @returns A new and empty set of recipient groups or NULL if allocating it failed
+struct RecipientGroups *recipients_create();
+
+void recipients_destroy(struct RecipientGroups *groups);
+
+/// Looks up the handle of the group with the given name. This never allocates.
+///
+/// @returns The handle of the group or RECIPIENTS_INVALID_GROUP if there is no such group (or nothing is known about
+/// the connection yet)
+recipients_group_t recipients_findGroup(const struct RecipientGroups *groups, mumble_connection_t connection,
+										const char *name);
+
+/// Gets the current members of the given group
+///
+/// @param[out] count A pointer to where the amount of members shall be written
+/// @returns A pointer to the sorted member array. If the group doesn't exist, NULL is returned and count is set to 0.
+const mumble_userid_t *recipients_get(const struct RecipientGroups *groups, mumble_connection_t connection,
+									  recipients_group_t group, size_t *count);
+
+/// Gets the channel the given user is in (-1 if it isn't known)
+mumble_channelid_t recipients_getChannel(const struct RecipientGroups *groups, mumble_connection_t connection,
+										 mumble_userid_t userID);
+
+/// Tells which user is the local one on the given connection (see mumbleAPI.getLocalUserID)
+void recipients_setLocalUser(struct RecipientGroups *groups, mumble_connection_t connection, mumble_userid_t userID);
+
+// Event hooks that have to be called from the corresponding plugin callbacks
+void recipients_onUserAdded(struct RecipientGroups *groups, mumble_connection_t connection, mumble_userid_t userID);
+void recipients_onUserRemoved(struct RecipientGroups *groups, mumble_connection_t connection, mumble_userid_t userID);
+void recipients_onChannelEntered(struct RecipientGroups *groups, mumble_connection_t connection,
+								 mumble_userid_t userID, mumble_channelid_t channelID);
+void recipients_onChannelExited(struct RecipientGroups *groups, mumble_connection_t connection,
+								mumble_userid_t userID, mumble_channelid_t channelID);
+
+/// Forgets everything known about the given connection
+void recipients_removeConnection(struct RecipientGroups *groups, mumble_connection_t connection);
+
+#endif // MUMBLE_PLUGIN_RECIPIENTS_H_
@@ -0,0 +1,880 @@
+#include "replica.h"
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Open addressing without deletion, as entries are never removed (a power of two)
+#define LOOKUP_SIZE (REPLICA_MAX_ENTRIES * 2)
+#define NONE (-1)
+
+// The encoded size of a version vector entry can't exceed this
+#define MAX_ENCODED_VERSION 18
+#define MAX_ENCODED_VERSIONS (2 + REPLICA_MAX_REPLICAS * MAX_ENCODED_VERSION)
+
+// Messages start with their type. Counts are little endian uint16_t, replicas little endian uint64_t and everything
+// else varints.
+// - MESSAGE_DIGEST: version vector
+// - MESSAGE_STATE: count, entries, uint8_t final. The final message of a reply is followed by the version vector.
+// - MESSAGE_DELTA: replica, count, entries, first dot - 1, last dot
+// A version vector is a count followed by pairs of replica and counter. An entry starts with its type (with
+// ENTRY_REMOVED set for tombstones), its name and key (uint8_t length and characters), its dot and the type's fields:
+// - REPLICA_REGISTER: time, uint8_t length and value (if it isn't a tombstone)
+// - REPLICA_ELEMENT: origin
+// - REPLICA_COUNTER: increments, decrements (the origin is the dot's replica)
+enum MessageType { MESSAGE_DIGEST = 1, MESSAGE_STATE, MESSAGE_DELTA };
+#define ENTRY_REMOVED 0x80
+
+struct Dot {
+	uint64_t replica;
+	uint64_t counter;
+};
+
+struct Entry {
+	uint8_t type;
+	// Whether the register has been deleted or the addition removed
+	bool removed;
+	// Whether the entry has been changed locally since the last delta
+	bool dirty;
+	char name[REPLICA_MAX_NAME];
+	char key[REPLICA_MAX_KEY];
+	// Tells additions apart (the dot of the addition) as well as the replicas' shares of a counter (the replica, with
+	// a counter of 0). Unused for registers.
+	struct Dot origin;
+	// The latest change
+	struct Dot dot;
+	// The Lamport time of a register's latest write. Writes at the same time are ordered by dot.replica.
+	uint64_t time;
+	uint64_t increments;
+	uint64_t decrements;
+	uint8_t valueLength;
+	uint8_t value[REPLICA_MAX_VALUE];
+};
+
+struct Reply {
+	mumble_userid_t peer;
+	struct Dot digest[REPLICA_MAX_REPLICAS];
+	size_t digestCount;
+	// The first entry that hasn't been considered yet
+	size_t cursor;
+};
+
+struct BatchEntry {
+	uint64_t counter;
+	size_t index;
+};
+
+struct ReplicaStore {
+	uint64_t replica;
+	bool localPeerKnown;
+	mumble_userid_t localPeer;
+	uint64_t time;
+
+	struct Entry entries[REPLICA_MAX_ENTRIES];
+	size_t entryCount;
+	int16_t lookup[LOOKUP_SIZE];
+
+	// The version vector. The first version is the local replica's.
+	struct Dot versions[REPLICA_MAX_REPLICAS];
+	size_t versionCount;
+	// The local changes up to which deltas have been created
+	uint64_t sentCounter;
+
+	// The peers that are known to run the plugin
+	mumble_userid_t peers[REPLICA_MAX_PEERS];
+	size_t peerCount;
+	// The peers a digest has to be sent to
+	mumble_userid_t digestPeers[REPLICA_MAX_PEERS];
+	size_t digestPeerCount;
+	struct Reply replies[REPLICA_MAX_PENDING_REPLIES];
+	size_t replyCount;
+
+	struct BatchEntry batch[REPLICA_MAX_ENTRIES];
+};
+
+struct Writer {
+	uint8_t *data;
+	size_t length;
+	size_t capacity;
+	bool overflow;
+};
+
+struct Reader {
+	const uint8_t *data;
+	size_t length;
+	size_t position;
+	bool failed;
+};
+
+
+////////////////////////////////// Encoding //////////////////////////////////
+
+static void writeByte(struct Writer *writer, uint8_t value) {
+	if (writer->length == writer->capacity) {
+		writer->overflow = true;
+		return;
+	}
+	writer->data[writer->length++] = value;
+}
+
+static void writeBytes(struct Writer *writer, const void *data, size_t length) {
+	if (writer->capacity - writer->length < length) {
+		writer->overflow = true;
+		return;
+	}
+	memcpy(writer->data + writer->length, data, length);
+	writer->length += length;
+}
+
+static void writeVarint(struct Writer *writer, uint64_t value) {
+	while (value >= 0x80) {
+		writeByte(writer, (uint8_t) (value | 0x80));
+		value >>= 7;
+	}
+	writeByte(writer, (uint8_t) value);
+}
+
+static void writeFixed(struct Writer *writer, uint64_t value, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		writeByte(writer, (uint8_t) (value >> (8 * i)));
+	}
+}
+
+static void writeString(struct Writer *writer, const char *string) {
+	size_t length = strlen(string);
+	writeByte(writer, (uint8_t) length);
+	writeBytes(writer, string, length);
+}
+
+static uint8_t readByte(struct Reader *reader) {
+	if (reader->position == reader->length) {
+		reader->failed = true;
+		return 0;
+	}
+	return reader->data[reader->position++];
+}
+
+static uint64_t readVarint(struct Reader *reader) {
+	uint64_t value = 0;
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		uint8_t byte = readByte(reader);
+		value |= (uint64_t) (byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+	}
+
+	reader->failed = true;
+	return 0;
+}
+
+static uint64_t readFixed(struct Reader *reader, size_t size) {
+	uint64_t value = 0;
+	for (size_t i = 0; i < size; i++) {
+		value |= (uint64_t) readByte(reader) << (8 * i);
+	}
+
+	return value;
+}
+
+static void readString(struct Reader *reader, char *string, size_t capacity) {
+	size_t length = readByte(reader);
+	if (length >= capacity || reader->length - reader->position < length) {
+		reader->failed = true;
+		string[0]      = '\0';
+		return;
+	}
+	memcpy(string, reader->data + reader->position, length);
+	string[length] = '\0';
+	reader->position += length;
+}
+
+static void writeEntry(struct Writer *writer, const struct Entry *entry) {
+	writeByte(writer, entry->type | (entry->removed ? ENTRY_REMOVED : 0));
+	writeString(writer, entry->name);
+	writeString(writer, entry->key);
+	writeFixed(writer, entry->dot.replica, 8);
+	writeVarint(writer, entry->dot.counter);
+
+	switch (entry->type) {
+		case REPLICA_REGISTER:
+			writeVarint(writer, entry->time);
+			if (!entry->removed) {
+				writeByte(writer, entry->valueLength);
+				writeBytes(writer, entry->value, entry->valueLength);
+			}
+			break;
+		case REPLICA_ELEMENT:
+			writeFixed(writer, entry->origin.replica, 8);
+			writeVarint(writer, entry->origin.counter);
+			break;
+		case REPLICA_COUNTER:
+			writeVarint(writer, entry->increments);
+			writeVarint(writer, entry->decrements);
+			break;
+	}
+}
+
+static void readEntry(struct Reader *reader, struct Entry *entry) {
+	memset(entry, 0, sizeof(*entry));
+
+	uint8_t type   = readByte(reader);
+	entry->type    = type & ~ENTRY_REMOVED;
+	entry->removed = type & ENTRY_REMOVED;
+	readString(reader, entry->name, sizeof(entry->name));
+	readString(reader, entry->key, sizeof(entry->key));
+	entry->dot.replica = readFixed(reader, 8);
+	entry->dot.counter = readVarint(reader);
+
+	switch (entry->type) {
+		case REPLICA_REGISTER:
+			entry->time = readVarint(reader);
+			if (!entry->removed) {
+				entry->valueLength = readByte(reader);
+				if (entry->valueLength > REPLICA_MAX_VALUE
+					|| reader->length - reader->position < entry->valueLength) {
+					reader->failed = true;
+					return;
+				}
+				memcpy(entry->value, reader->data + reader->position, entry->valueLength);
+				reader->position += entry->valueLength;
+			}
+			break;
+		case REPLICA_ELEMENT:
+			entry->origin.replica = readFixed(reader, 8);
+			entry->origin.counter = readVarint(reader);
+			break;
+		case REPLICA_COUNTER:
+			entry->origin.replica = entry->dot.replica;
+			entry->increments     = readVarint(reader);
+			entry->decrements     = readVarint(reader);
+			break;
+		default:
+			reader->failed = true;
+			break;
+	}
+}
+
+
+////////////////////////////////// Entries //////////////////////////////////
+
+static uint32_t hashEntry(uint8_t type, const char *name, const char *key) {
+	uint32_t hash = 2166136261u ^ type;
+	for (const char *c = name; *c; c++) {
+		hash = (hash ^ (uint8_t) *c) * 16777619u;
+	}
+	hash = (hash ^ 0xFF) * 16777619u;
+	for (const char *c = key; *c; c++) {
+		hash = (hash ^ (uint8_t) *c) * 16777619u;
+	}
+
+	return hash & (LOOKUP_SIZE - 1);
+}
+
+static bool matches(const struct Entry *entry, uint8_t type, const char *name, const char *key) {
+	return entry->type == type && strcmp(entry->name, name) == 0 && strcmp(entry->key, key) == 0;
+}
+
+// Iterates over all entries with the given type, name and key
+#define FOR_EACH_MATCH(store, type, name, key, entry)                                                \
+	for (uint32_t entry##Slot = hashEntry(type, name, key); (store)->lookup[entry##Slot] != NONE;    \
+		 entry##Slot          = (entry##Slot + 1) & (LOOKUP_SIZE - 1))                               \
+		for (struct Entry *entry = (struct Entry *) &(store)->entries[(store)->lookup[entry##Slot]]; \
+			 entry && matches(entry, type, name, key); entry = NULL)
+
+static struct Entry *findEntry(const struct ReplicaStore *store, uint8_t type, const char *name, const char *key,
+							   struct Dot origin) {
+	FOR_EACH_MATCH(store, type, name, key, entry) {
+		if (entry->origin.replica == origin.replica && entry->origin.counter == origin.counter) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static bool validNames(const char *name, const char *key) {
+	return strlen(name) < REPLICA_MAX_NAME && strlen(key) < REPLICA_MAX_KEY;
+}
+
+static struct Entry *addEntry(struct ReplicaStore *store, uint8_t type, const char *name, const char *key,
+							  struct Dot origin) {
+	if (store->entryCount == REPLICA_MAX_ENTRIES) {
+		return NULL;
+	}
+
+	size_t index        = store->entryCount++;
+	struct Entry *entry = &store->entries[index];
+	memset(entry, 0, sizeof(*entry));
+	entry->type   = type;
+	entry->origin = origin;
+	strcpy(entry->name, name);
+	strcpy(entry->key, key);
+
+	uint32_t slot = hashEntry(type, name, key);
+	while (store->lookup[slot] != NONE) {
+		slot = (slot + 1) & (LOOKUP_SIZE - 1);
+	}
+	store->lookup[slot] = (int16_t) index;
+
+	return entry;
+}
+
+static uint64_t versionOf(const struct Dot *versions, size_t count, uint64_t replica) {
+	for (size_t i = 0; i < count; i++) {
+		if (versions[i].replica == replica) {
+			return versions[i].counter;
+		}
+	}
+
+	return 0;
+}
+
+static void advanceVersion(struct ReplicaStore *store, uint64_t replica, uint64_t counter) {
+	for (size_t i = 0; i < store->versionCount; i++) {
+		if (store->versions[i].replica == replica) {
+			if (counter > store->versions[i].counter) {
+				store->versions[i].counter = counter;
+			}
+			return;
+		}
+	}
+
+	if (store->versionCount < REPLICA_MAX_REPLICAS) {
+		store->versions[store->versionCount].replica = replica;
+		store->versions[store->versionCount].counter = counter;
+		store->versionCount++;
+	}
+}
+
+// Records a local change of the given entry
+static void touch(struct ReplicaStore *store, struct Entry *entry) {
+	entry->dot.replica = store->replica;
+	entry->dot.counter = ++store->versions[0].counter;
+	entry->dirty       = true;
+}
+
+static void merge(struct ReplicaStore *store, const struct Entry *incoming) {
+	if (incoming->time > store->time) {
+		store->time = incoming->time;
+	}
+
+	struct Entry *entry = findEntry(store, incoming->type, incoming->name, incoming->key, incoming->origin);
+	if (!entry) {
+		entry = addEntry(store, incoming->type, incoming->name, incoming->key, incoming->origin);
+		if (entry) {
+			*entry       = *incoming;
+			entry->dirty = false;
+		}
+		return;
+	}
+
+	bool newer = false;
+	switch (entry->type) {
+		case REPLICA_REGISTER:
+			newer = incoming->time > entry->time
+					|| (incoming->time == entry->time && incoming->dot.replica > entry->dot.replica);
+			break;
+		case REPLICA_ELEMENT:
+			// Additions can only ever be removed
+			newer = incoming->removed && !entry->removed;
+			break;
+		case REPLICA_COUNTER:
+			// Only the origin changes its share
+			newer = incoming->dot.counter > entry->dot.counter;
+			break;
+	}
+
+	if (newer) {
+		// A local change that lost doesn't have to be sent anymore
+		*entry       = *incoming;
+		entry->dirty = false;
+	}
+}
+
+static void addPeer(mumble_userid_t *peers, size_t *count, mumble_userid_t peer) {
+	for (size_t i = 0; i < *count; i++) {
+		if (peers[i] == peer) {
+			return;
+		}
+	}
+	if (*count < REPLICA_MAX_PEERS) {
+		peers[(*count)++] = peer;
+	}
+}
+
+static void removePeer(mumble_userid_t *peers, size_t *count, mumble_userid_t peer) {
+	for (size_t i = 0; i < *count; i++) {
+		if (peers[i] == peer) {
+			peers[i] = peers[--(*count)];
+			return;
+		}
+	}
+}
+
+
+////////////////////////////////// Messages //////////////////////////////////
+
+static void writeVersions(struct Writer *writer, const struct Dot *versions, size_t count) {
+	writeFixed(writer, count, 2);
+	for (size_t i = 0; i < count; i++) {
+		writeFixed(writer, versions[i].replica, 8);
+		writeVarint(writer, versions[i].counter);
+	}
+}
+
+static size_t readVersions(struct Reader *reader, struct Dot *versions) {
+	size_t count = (size_t) readFixed(reader, 2);
+	if (count > REPLICA_MAX_REPLICAS) {
+		reader->failed = true;
+		return 0;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		versions[i].replica = readFixed(reader, 8);
+		versions[i].counter = readVarint(reader);
+	}
+
+	return count;
+}
+
+// Writes the entry unless that would leave less than the reserved amount of bytes in the message
+static bool tryWriteEntry(struct Writer *writer, size_t reserved, const struct Entry *entry) {
+	size_t length = writer->length;
+	writeEntry(writer, entry);
+	if (writer->overflow || writer->capacity - writer->length < reserved) {
+		writer->length   = length;
+		writer->overflow = false;
+		return false;
+	}
+
+	return true;
+}
+
+static size_t writeReply(struct ReplicaStore *store, struct Reply *reply, struct Writer *writer, bool *done) {
+	writeByte(writer, MESSAGE_STATE);
+	size_t countPosition = writer->length;
+	writeFixed(writer, 0, 2);
+
+	size_t count = 0;
+	*done        = true;
+	for (; reply->cursor < store->entryCount; reply->cursor++) {
+		const struct Entry *entry = &store->entries[reply->cursor];
+		if (entry->dot.counter <= versionOf(reply->digest, reply->digestCount, entry->dot.replica)) {
+			continue;
+		}
+
+		// Room for the final flag and the version vector is kept in every message
+		if (!tryWriteEntry(writer, 1 + MAX_ENCODED_VERSIONS, entry)) {
+			*done = false;
+			break;
+		}
+		count++;
+	}
+
+	writer->data[countPosition]     = (uint8_t) count;
+	writer->data[countPosition + 1] = (uint8_t) (count >> 8);
+	writeByte(writer, *done);
+	if (*done) {
+		writeVersions(writer, store->versions, store->versionCount);
+	}
+
+	return writer->length;
+}
+
+static int compareBatchEntries(const void *a, const void *b) {
+	uint64_t first  = ((const struct BatchEntry *) a)->counter;
+	uint64_t second = ((const struct BatchEntry *) b)->counter;
+
+	return first < second ? -1 : first > second;
+}
+
+static size_t writeDelta(struct ReplicaStore *store, struct Writer *writer) {
+	size_t count = 0;
+	for (size_t i = 0; i < store->entryCount; i++) {
+		if (store->entries[i].dirty) {
+			store->batch[count].counter = store->entries[i].dot.counter;
+			store->batch[count].index   = i;
+			count++;
+		}
+	}
+	if (count == 0) {
+		return 0;
+	}
+
+	// Deltas are cut in the order of their changes, so that every delta covers all changes up to its last one (the
+	// changes in between have been overwritten by changes to entries in later deltas)
+	qsort(store->batch, count, sizeof(struct BatchEntry), &compareBatchEntries);
+
+	writeByte(writer, MESSAGE_DELTA);
+	writeFixed(writer, store->replica, 8);
+	size_t countPosition = writer->length;
+	writeFixed(writer, 0, 2);
+
+	// Room is kept for the range of the delta
+	size_t written = 0;
+	while (written < count && tryWriteEntry(writer, 20, &store->entries[store->batch[written].index])) {
+		written++;
+	}
+
+	uint64_t last = written == count ? store->versions[0].counter
+				  : written > 0		 ? store->batch[written - 1].counter
+									 : store->sentCounter;
+	for (size_t i = 0; i < written; i++) {
+		store->entries[store->batch[i].index].dirty = false;
+	}
+
+	writer->data[countPosition]     = (uint8_t) written;
+	writer->data[countPosition + 1] = (uint8_t) (written >> 8);
+	writeVarint(writer, store->sentCounter);
+	writeVarint(writer, last);
+	store->sentCounter = last;
+
+	return writer->length;
+}
+
+
+////////////////////////////////// API //////////////////////////////////
+
+struct ReplicaStore *replica_createInArena(struct MemoryArena *arena) {
+	struct ReplicaStore *store = memory_arenaAlloc(arena, sizeof(struct ReplicaStore));
+	if (!store) {
+		return NULL;
+	}
+	memset(store, 0, sizeof(*store));
+
+	for (size_t i = 0; i < LOOKUP_SIZE; i++) {
+		store->lookup[i] = NONE;
+	}
+
+	// User IDs are reused by servers, so replicas identify themselves with a random number instead
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+	uint64_t seed = ((uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec) ^ (uintptr_t) store
+					^ ((uint64_t) rand() << 32);
+	seed += 0x9E3779B97F4A7C15ULL;
+	seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+
+	store->replica             = seed ^ (seed >> 31);
+	store->versions[0].replica = store->replica;
+	store->versionCount        = 1;
+
+	return store;
+}
+
+void replica_setLocalPeer(struct ReplicaStore *store, mumble_userid_t peer) {
+	store->localPeer      = peer;
+	store->localPeerKnown = true;
+
+	removePeer(store->peers, &store->peerCount, peer);
+	removePeer(store->digestPeers, &store->digestPeerCount, peer);
+}
+
+bool replica_set(struct ReplicaStore *store, const char *map, const char *key, const void *value, size_t length) {
+	if (!validNames(map, key) || length > REPLICA_MAX_VALUE) {
+		return false;
+	}
+
+	struct Dot none     = { 0, 0 };
+	struct Entry *entry = findEntry(store, REPLICA_REGISTER, map, key, none);
+	if (!entry) {
+		entry = addEntry(store, REPLICA_REGISTER, map, key, none);
+		if (!entry) {
+			return false;
+		}
+	}
+
+	entry->time        = ++store->time;
+	entry->removed     = false;
+	entry->valueLength = (uint8_t) length;
+	memcpy(entry->value, value, length);
+	touch(store, entry);
+
+	return true;
+}
+
+void replica_delete(struct ReplicaStore *store, const char *map, const char *key) {
+	struct Dot none     = { 0, 0 };
+	struct Entry *entry = validNames(map, key) ? findEntry(store, REPLICA_REGISTER, map, key, none) : NULL;
+	if (!entry || entry->removed) {
+		return;
+	}
+
+	entry->time        = ++store->time;
+	entry->removed     = true;
+	entry->valueLength = 0;
+	touch(store, entry);
+}
+
+bool replica_get(const struct ReplicaStore *store, const char *map, const char *key, const void **value,
+				 size_t *length) {
+	struct Dot none           = { 0, 0 };
+	const struct Entry *entry = validNames(map, key) ? findEntry(store, REPLICA_REGISTER, map, key, none) : NULL;
+	if (!entry || entry->removed) {
+		return false;
+	}
+
+	*value  = entry->value;
+	*length = entry->valueLength;
+
+	return true;
+}
+
+bool replica_add(struct ReplicaStore *store, const char *set, const char *element) {
+	if (!validNames(set, element)) {
+		return false;
+	}
+
+	// Every addition takes up an entry of its own, so elements that are present already aren't added again
+	if (replica_contains(store, set, element)) {
+		return true;
+	}
+
+	struct Dot origin   = { store->replica, store->versions[0].counter + 1 };
+	struct Entry *entry = addEntry(store, REPLICA_ELEMENT, set, element, origin);
+	if (!entry) {
+		return false;
+	}
+	touch(store, entry);
+
+	return true;
+}
+
+void replica_remove(struct ReplicaStore *store, const char *set, const char *element) {
+	if (!validNames(set, element)) {
+		return;
+	}
+
+	FOR_EACH_MATCH(store, REPLICA_ELEMENT, set, element, entry) {
+		if (!entry->removed) {
+			entry->removed = true;
+			touch(store, entry);
+		}
+	}
+}
+
+bool replica_contains(const struct ReplicaStore *store, const char *set, const char *element) {
+	if (!validNames(set, element)) {
+		return false;
+	}
+
+	FOR_EACH_MATCH(store, REPLICA_ELEMENT, set, element, entry) {
+		if (!entry->removed) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool replica_increment(struct ReplicaStore *store, const char *counter, const char *key, int64_t amount) {
+	if (!validNames(counter, key)) {
+		return false;
+	}
+
+	struct Dot origin   = { store->replica, 0 };
+	struct Entry *entry = findEntry(store, REPLICA_COUNTER, counter, key, origin);
+	if (!entry) {
+		entry = addEntry(store, REPLICA_COUNTER, counter, key, origin);
+		if (!entry) {
+			return false;
+		}
+	}
+
+	if (amount >= 0) {
+		entry->increments += (uint64_t) amount;
+	} else {
+		entry->decrements += (uint64_t) -amount;
+	}
+	touch(store, entry);
+
+	return true;
+}
+
+int64_t replica_getCounter(const struct ReplicaStore *store, const char *counter, const char *key) {
+	if (!validNames(counter, key)) {
+		return 0;
+	}
+
+	uint64_t value = 0;
+	FOR_EACH_MATCH(store, REPLICA_COUNTER, counter, key, entry) {
+		value += entry->increments - entry->decrements;
+	}
+
+	return (int64_t) value;
+}
+
+void replica_forEach(const struct ReplicaStore *store, enum ReplicaType type, const char *name,
+					 ReplicaVisitFunction visit, void *userData) {
+	for (size_t i = 0; i < store->entryCount; i++) {
+		const struct Entry *entry = &store->entries[i];
+		if (entry->type != type || entry->removed || strcmp(entry->name, name) != 0) {
+			continue;
+		}
+
+		if (type == REPLICA_REGISTER) {
+			visit(userData, entry->key, entry->value, entry->valueLength);
+			continue;
+		}
+
+		// Elements that have been added several times are only visited for their first live addition
+		bool visited = false;
+		FOR_EACH_MATCH(store, entry->type, entry->name, entry->key, other) {
+			visited = visited || (other < entry && !other->removed);
+		}
+		if (visited) {
+			continue;
+		}
+
+		if (type == REPLICA_COUNTER) {
+			int64_t value = replica_getCounter(store, entry->name, entry->key);
+			visit(userData, entry->key, &value, sizeof(value));
+		} else {
+			visit(userData, entry->key, NULL, 0);
+		}
+	}
+}
+
+void replica_addPeer(struct ReplicaStore *store, mumble_userid_t peer) {
+	if (!store->localPeerKnown || peer != store->localPeer) {
+		addPeer(store->digestPeers, &store->digestPeerCount, peer);
+	}
+}
+
+void replica_removePeer(struct ReplicaStore *store, mumble_userid_t peer) {
+	removePeer(store->peers, &store->peerCount, peer);
+	removePeer(store->digestPeers, &store->digestPeerCount, peer);
+
+	for (size_t i = 0; i < store->replyCount; i++) {
+		if (store->replies[i].peer == peer) {
+			memmove(&store->replies[i], &store->replies[i + 1], (store->replyCount - i - 1) * sizeof(struct Reply));
+			store->replyCount--;
+			break;
+		}
+	}
+}
+
+bool replica_receive(struct ReplicaStore *store, mumble_userid_t peer, const uint8_t *data, size_t length) {
+	struct Reader reader = { data, length, 0, false };
+	uint8_t type         = readByte(&reader);
+
+	if (type == MESSAGE_DIGEST) {
+		struct Dot digest[REPLICA_MAX_REPLICAS];
+		size_t digestCount = readVersions(&reader, digest);
+		if (reader.failed || reader.position != reader.length) {
+			return false;
+		}
+
+		// A newer digest replaces an older one that hasn't been replied to yet
+		size_t index = 0;
+		while (index < store->replyCount && store->replies[index].peer != peer) {
+			index++;
+		}
+		if (index == REPLICA_MAX_PENDING_REPLIES) {
+			return true;
+		}
+		if (index == store->replyCount) {
+			store->replyCount++;
+		}
+
+		struct Reply *reply = &store->replies[index];
+		reply->peer         = peer;
+		reply->digestCount = digestCount;
+		reply->cursor      = 0;
+		memcpy(reply->digest, digest, digestCount * sizeof(struct Dot));
+	} else if (type == MESSAGE_STATE || type == MESSAGE_DELTA) {
+		uint64_t replica = type == MESSAGE_DELTA ? readFixed(&reader, 8) : 0;
+		size_t count     = (size_t) readFixed(&reader, 2);
+		for (size_t i = 0; i < count && !reader.failed; i++) {
+			struct Entry entry;
+			readEntry(&reader, &entry);
+			if (!reader.failed) {
+				merge(store, &entry);
+			}
+		}
+
+		if (type == MESSAGE_DELTA) {
+			uint64_t base = readVarint(&reader);
+			uint64_t last = readVarint(&reader);
+			// The changes before the delta may not have arrived yet (e.g. because the peer joined in the meantime)
+			if (!reader.failed && versionOf(store->versions, store->versionCount, replica) >= base) {
+				advanceVersion(store, replica, last);
+			}
+		} else if (readByte(&reader)) {
+			// The reply is complete, so everything the peer had has been merged by now
+			struct Dot versions[REPLICA_MAX_REPLICAS];
+			size_t versionCount = readVersions(&reader, versions);
+			for (size_t i = 0; i < versionCount && !reader.failed; i++) {
+				if (versions[i].replica != store->replica) {
+					advanceVersion(store, versions[i].replica, versions[i].counter);
+				}
+			}
+		}
+
+		if (reader.failed || reader.position != reader.length) {
+			return false;
+		}
+	} else {
+		return false;
+	}
+
+	if (!store->localPeerKnown || peer != store->localPeer) {
+		addPeer(store->peers, &store->peerCount, peer);
+	}
+
+	return true;
+}
+
+size_t replica_nextMessage(struct ReplicaStore *store, uint8_t *buffer, mumble_userid_t *peers, size_t *peerCount) {
+	*peerCount = 0;
+	if (!store->localPeerKnown) {
+		return 0;
+	}
+
+	struct Writer writer = { buffer, 0, REPLICA_MAX_MESSAGE, false };
+
+	if (store->digestPeerCount > 0) {
+		peers[0]   = store->digestPeers[--store->digestPeerCount];
+		*peerCount = 1;
+
+		writeByte(&writer, MESSAGE_DIGEST);
+		writeVersions(&writer, store->versions, store->versionCount);
+
+		return writer.length;
+	}
+
+	if (store->replyCount > 0) {
+		struct Reply *reply = &store->replies[0];
+		peers[0]            = reply->peer;
+		*peerCount          = 1;
+
+		bool done;
+		size_t length = writeReply(store, reply, &writer, &done);
+		if (done) {
+			memmove(&store->replies[0], &store->replies[1], (store->replyCount - 1) * sizeof(struct Reply));
+			store->replyCount--;
+		}
+
+		return length;
+	}
+
+	if (store->peerCount == 0) {
+		// Nobody to send deltas to. Peers joining later on get everything in reply to their digests.
+		for (size_t i = 0; i < store->entryCount; i++) {
+			store->entries[i].dirty = false;
+		}
+		store->sentCounter = store->versions[0].counter;
+
+		return 0;
+	}
+
+	size_t length = writeDelta(store, &writer);
+	if (length > 0) {
+		memcpy(peers, store->peers, store->peerCount * sizeof(mumble_userid_t));
+		*peerCount = store->peerCount;
+	}
+
+	return length;
+}
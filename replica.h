@@ -0,0 +1,127 @@
+/// This header file declares the replicated state that is shared by all instances of this plugin on a server.
+///
+/// The state consists of conflict-free replicated data types (delta-state CRDTs), each identified by its type and a
+/// name (e.g. the set "ready" or the map "markers"):
+/// - Maps of last-writer-wins registers, whose values are small binary blobs. Concurrent writes are ordered by a
+///   Lamport clock (ties are broken by the writing replica).
+/// - Observed-remove sets of strings. Removing an element only removes the additions that have been observed, so that
+///   an addition concurrent to a removal wins.
+/// - Counters that can be incremented and decremented by every replica.
+///
+/// Every change is a dot (the replica that made it and a counter incremented with every change the replica makes).
+/// Every entry (a register, an addition to a set or a replica's share of a counter) remembers the dot of its latest
+/// change and each replica keeps a version vector of the dots it has seen. Local changes mark their entries as dirty.
+/// Dirty entries are batched into deltas, which are sent to all peers known to run the plugin, so that repeated changes
+/// to the same entry only cost a single entry per batch: The traffic depends on how often the state changes, not on how
+/// large it is.
+///
+/// Peers that join get a digest (the version vector) and reply with all entries the digest doesn't cover, along with
+/// their own version vector. As both sides do this when they see each other join, both end up with the union of their
+/// states. Nothing else is ever sent in bulk.
+///
+/// Messages are meant to be delivered reliably and in order (see transport.h) and are merged idempotently, so receiving
+/// something twice (e.g. as a delta as well as in reply to a digest) does no harm.
+///
+/// NOTE: The functions in this file are not thread-safe. Removed registers and set elements are kept as tombstones, so
+/// a store can hold at most REPLICA_MAX_ENTRIES entries over its lifetime.
+
+#ifndef MUMBLE_PLUGIN_REPLICA_H_
+#define MUMBLE_PLUGIN_REPLICA_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The maximum amount of entries (including tombstones)
+#define REPLICA_MAX_ENTRIES 512
+/// The maximum length of a name (including the terminating null byte)
+#define REPLICA_MAX_NAME 16
+/// The maximum length of a key or set element (including the terminating null byte)
+#define REPLICA_MAX_KEY 32
+/// The maximum size of a register's value
+#define REPLICA_MAX_VALUE 64
+/// The maximum amount of replicas whose changes are tracked in the version vector. Changes of further replicas are
+/// still merged, but sent again in reply to every digest.
+#define REPLICA_MAX_REPLICAS 64
+/// The maximum amount of peers that are known to run the plugin
+#define REPLICA_MAX_PEERS 32
+/// The maximum amount of digests that may be waiting to be replied to
+#define REPLICA_MAX_PENDING_REPLIES 16
+/// The maximum size of a message created by replica_nextMessage
+#define REPLICA_MAX_MESSAGE (16 * 1024)
+
+enum ReplicaType { REPLICA_REGISTER = 1, REPLICA_ELEMENT, REPLICA_COUNTER };
+
+/// Visits an entry (see replica_forEach)
+///
+/// @param value The register's value or the counter's total (NULL for set elements)
+typedef void (*ReplicaVisitFunction)(void *userData, const char *key, const void *value, size_t valueLength);
+
+struct MemoryArena;
+struct ReplicaStore;
+
+/// Creates an empty store in the given arena. It is released along with the arena's other allocations.
+///
+/// @returns The new store or NULL if the arena is exhausted
+struct ReplicaStore *replica_createInArena(struct MemoryArena *arena);
+
+/// Tells which user is the local one. No messages are created before it is known.
+void replica_setLocalPeer(struct ReplicaStore *store, mumble_userid_t peer);
+
+/// Sets a register of the given map
+///
+/// @returns Whether the register has been set. This fails if the store is full or any of the arguments is too long.
+bool replica_set(struct ReplicaStore *store, const char *map, const char *key, const void *value, size_t length);
+
+/// Removes a register from the given map
+void replica_delete(struct ReplicaStore *store, const char *map, const char *key);
+
+/// @param[out] value A pointer to the register's value, which stays valid until the store is modified
+/// @param[out] length The size of the value
+/// @returns Whether the map contains the register
+bool replica_get(const struct ReplicaStore *store, const char *map, const char *key, const void **value,
+				 size_t *length);
+
+/// Adds the element unless it is present already
+///
+/// @returns Whether the set contains the element. This fails if the store is full or any of the arguments is too long.
+bool replica_add(struct ReplicaStore *store, const char *set, const char *element);
+
+/// Removes all additions of the element that have been observed so far
+void replica_remove(struct ReplicaStore *store, const char *set, const char *element);
+
+bool replica_contains(const struct ReplicaStore *store, const char *set, const char *element);
+
+/// Adds the given (possibly negative) amount to a counter
+///
+/// @returns Whether the counter has been changed. This fails if the store is full or the name is too long.
+bool replica_increment(struct ReplicaStore *store, const char *counter, const char *key, int64_t amount);
+
+int64_t replica_getCounter(const struct ReplicaStore *store, const char *counter, const char *key);
+
+/// Visits every register of a map, every element of a set or every key of a counter (in no particular order). Counters
+/// are visited with their total as an int64_t value.
+void replica_forEach(const struct ReplicaStore *store, enum ReplicaType type, const char *name,
+					 ReplicaVisitFunction visit, void *userData);
+
+/// Sends a digest to the given peer, which may or may not run the plugin. Has to be called whenever a user is added.
+void replica_addPeer(struct ReplicaStore *store, mumble_userid_t peer);
+
+void replica_removePeer(struct ReplicaStore *store, mumble_userid_t peer);
+
+/// Merges a message received from the given peer
+///
+/// @returns Whether the message was valid
+bool replica_receive(struct ReplicaStore *store, mumble_userid_t peer, const uint8_t *data, size_t length);
+
+/// Creates the next message that has to be sent (digests, replies to digests and finally a batch of deltas)
+///
+/// @param[out] buffer The buffer the message is written to. It has to hold REPLICA_MAX_MESSAGE bytes.
+/// @param[out] peers The peers the message has to be sent to. It has to hold REPLICA_MAX_PEERS peers.
+/// @param[out] peerCount The amount of peers
+/// @returns The size of the message (0 if there is nothing to send)
+size_t replica_nextMessage(struct ReplicaStore *store, uint8_t *buffer, mumble_userid_t *peers, size_t *peerCount);
+
+#endif // MUMBLE_PLUGIN_REPLICA_H_
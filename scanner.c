@@ -0,0 +1,631 @@
+#ifdef __linux__
+// process_vm_readv
+#	define _GNU_SOURCE
+#endif
+
+#include "scanner.h"
+#include "memory.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
+#ifdef __linux__
+#	include <elf.h>
+#	include <fcntl.h>
+#	include <strings.h>
+#	include <sys/stat.h>
+#	include <sys/uio.h>
+#	include <unistd.h>
+#endif
+
+// Process memory is read in chunks of this size (consecutive chunks overlap by the longest pattern's length). Every
+// chunk is read with a single syscall and scanned by one thread.
+#define SCAN_CHUNK_SIZE (4 * 1024 * 1024)
+#define MAX_SCAN_THREADS 8
+// Notes containing the build ID are tiny, anything bigger than this is not worth reading
+#define MAX_NOTE_SEGMENT_SIZE (64 * 1024)
+
+// Bytes that are very common in x86 machine code and data, most common first. All other bytes are considered rare.
+static const uint8_t commonBytes[] = {
+	0x00, 0xFF, 0x48, 0x8B, 0x89, 0x24, 0x0F, 0xE8, 0x4C, 0x44, 0x85, 0xC0, 0x01, 0x83, 0x8D, 0x74,
+	0x75, 0x45, 0x49, 0x41, 0x08, 0x10, 0x20, 0x04, 0x02, 0x03, 0xC3, 0xCC, 0x90, 0x31, 0x50, 0x40,
+};
+
+static size_t commonness(uint8_t byte) {
+	for (size_t i = 0; i < sizeof(commonBytes); i++) {
+		if (commonBytes[i] == byte) {
+			return sizeof(commonBytes) - i;
+		}
+	}
+
+	return 0;
+}
+
+static int hexValue(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	c = (char) tolower((unsigned char) c);
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+
+	return -1;
+}
+
+bool scanner_parsePattern(const char *text, struct SignaturePattern *pattern) {
+	memset(pattern, 0, sizeof(*pattern));
+
+	while (*text != '\0') {
+		if (*text == ' ') {
+			text++;
+			continue;
+		}
+
+		if (pattern->length == SCANNER_MAX_PATTERN) {
+			return false;
+		}
+
+		if (text[0] == '?') {
+			text += text[1] == '?' ? 2 : 1;
+		} else {
+			int high = hexValue(text[0]);
+			int low  = high >= 0 ? hexValue(text[1]) : -1;
+			if (low < 0) {
+				return false;
+			}
+
+			pattern->bytes[pattern->length] = (uint8_t) (high << 4 | low);
+			pattern->mask[pattern->length]  = 0xFF;
+			text += 2;
+		}
+
+		if (*text != ' ' && *text != '\0') {
+			return false;
+		}
+
+		pattern->length++;
+	}
+
+	// The rarer the anchor, the less candidates have to be compared against the whole pattern
+	bool hasAnchor = false;
+	for (size_t i = 0; i < pattern->length; i++) {
+		if (pattern->mask[i]
+			&& (!hasAnchor || commonness(pattern->bytes[i]) < commonness(pattern->bytes[pattern->anchor]))) {
+			pattern->anchor = i;
+			hasAnchor       = true;
+		}
+	}
+
+	return hasAnchor;
+}
+
+// Checks whether the pattern matches at the given position. available is the amount of bytes that may be read from
+// data, which has to be at least the pattern's length.
+static bool matches(const uint8_t *data, size_t available, const struct SignaturePattern *pattern) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	// The pattern's arrays are zero-padded, so whole blocks can be compared as long as the data is long enough
+	for (; i < pattern->length && i + 16 <= available; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i *) (data + i));
+		__m128i diff  = _mm_xor_si128(bytes, _mm_loadu_si128((const __m128i *) (pattern->bytes + i)));
+		diff          = _mm_and_si128(diff, _mm_loadu_si128((const __m128i *) (pattern->mask + i)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF) {
+			return false;
+		}
+	}
+#elif defined(__ARM_NEON)
+	for (; i < pattern->length && i + 16 <= available; i += 16) {
+		uint8x16_t diff = veorq_u8(vld1q_u8(data + i), vld1q_u8(pattern->bytes + i));
+		diff            = vandq_u8(diff, vld1q_u8(pattern->mask + i));
+		if (vmaxvq_u8(diff) != 0) {
+			return false;
+		}
+	}
+#endif
+
+	for (; i < pattern->length; i++) {
+		if ((data[i] ^ pattern->bytes[i]) & pattern->mask[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static unsigned lowestBit(unsigned value) {
+#if defined(__GNUC__)
+	return (unsigned) __builtin_ctz(value);
+#else
+	unsigned bit = 0;
+	while (!(value & 1)) {
+		value >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+// Returns a bit mask of the positions in data[block, block + 16) that hold the given byte
+static unsigned findAnchor(const uint8_t *data, size_t length, size_t block, uint8_t anchor) {
+	if (block + 16 <= length) {
+#if defined(__SSE2__)
+		__m128i bytes = _mm_loadu_si128((const __m128i *) (data + block));
+		return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char) anchor)));
+#elif defined(__ARM_NEON)
+		static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+		uint8x16_t equal = vandq_u8(vceqq_u8(vld1q_u8(data + block), vdupq_n_u8(anchor)), vld1q_u8(weights));
+		return (unsigned) vaddv_u8(vget_low_u8(equal)) | (unsigned) vaddv_u8(vget_high_u8(equal)) << 8;
+#endif
+	}
+
+	unsigned candidates = 0;
+	for (size_t i = block; i < length && i < block + 16; i++) {
+		if (data[i] == anchor) {
+			candidates |= 1u << (i - block);
+		}
+	}
+
+	return candidates;
+}
+
+// Finds the first match of each of the given patterns in a single pass over the data
+//
+// @param[out] results The offset of each pattern's first match or SIZE_MAX if there is none
+static void findPatterns(const uint8_t *data, size_t length, const struct SignaturePattern *patterns,
+						 size_t patternCount, size_t *results) {
+	bool pending[SCANNER_MAX_PATTERNS];
+	size_t remaining = 0;
+	for (size_t i = 0; i < patternCount; i++) {
+		results[i] = SIZE_MAX;
+		pending[i] = patterns[i].length > 0 && patterns[i].length <= length;
+		remaining += pending[i];
+	}
+
+	for (size_t block = 0; block < length && remaining > 0; block += 16) {
+		for (size_t i = 0; i < patternCount; i++) {
+			if (!pending[i]) {
+				continue;
+			}
+
+			const struct SignaturePattern *pattern = &patterns[i];
+			unsigned candidates = findAnchor(data, length, block, pattern->bytes[pattern->anchor]);
+			while (candidates) {
+				size_t position = block + lowestBit(candidates);
+				candidates &= candidates - 1;
+
+				if (position < pattern->anchor) {
+					continue;
+				}
+				size_t start = position - pattern->anchor;
+				if (start + pattern->length > length) {
+					break;
+				}
+
+				if (matches(data + start, length - start, pattern)) {
+					results[i] = start;
+					pending[i] = false;
+					remaining--;
+					break;
+				}
+			}
+		}
+	}
+}
+
+size_t scanner_find(const uint8_t *data, size_t length, const struct SignaturePattern *pattern) {
+	size_t result;
+	findPatterns(data, length, pattern, 1, &result);
+
+	return result;
+}
+
+#ifdef __linux__
+
+struct Region {
+	uint64_t start;
+	uint64_t end;
+	bool readable;
+	char path[4096];
+};
+
+// Calls the given function for every mapping of the given process until it returns false
+static bool forEachRegion(uint64_t pid, bool (*callback)(const struct Region *, void *), void *userData) {
+	char mapsPath[64];
+	snprintf(mapsPath, sizeof(mapsPath), "/proc/%llu/maps", (unsigned long long) pid);
+
+	FILE *maps = fopen(mapsPath, "r");
+	if (!maps) {
+		return false;
+	}
+
+	char line[4096 + 256];
+	while (fgets(line, sizeof(line), maps)) {
+		struct Region region;
+		char permissions[8];
+		int pathStart = 0;
+		unsigned long long start, end;
+		if (sscanf(line, "%llx-%llx %7s %*s %*s %*s %n", &start, &end, permissions, &pathStart) < 3) {
+			continue;
+		}
+
+		region.start    = start;
+		region.end      = end;
+		region.readable = permissions[0] == 'r';
+		snprintf(region.path, sizeof(region.path), "%s", line + pathStart);
+		region.path[strcspn(region.path, "\n")] = '\0';
+
+		if (!callback(&region, userData)) {
+			break;
+		}
+	}
+
+	fclose(maps);
+
+	return true;
+}
+
+struct ModuleSearch {
+	const char *name;
+	struct ModuleInfo *module;
+	bool found;
+};
+
+static bool collectModule(const struct Region *region, void *userData) {
+	struct ModuleSearch *search = userData;
+
+	const char *fileName = strrchr(region->path, '/');
+	if (!fileName || strcasecmp(fileName + 1, search->name) != 0) {
+		return true;
+	}
+
+	if (!search->found) {
+		search->found        = true;
+		search->module->base = region->start;
+		snprintf(search->module->path, sizeof(search->module->path), "%s", region->path);
+	}
+	if (strcmp(region->path, search->module->path) == 0 && region->end > search->module->base) {
+		search->module->size = region->end - search->module->base;
+	}
+
+	return true;
+}
+
+static bool readFile(int fd, uint64_t offset, void *buffer, size_t size) {
+	return pread(fd, buffer, size, (off_t) offset) == (ssize_t) size;
+}
+
+static void readElfBuildID(int fd, struct ModuleInfo *module) {
+	unsigned char ident[EI_NIDENT];
+	if (!readFile(fd, 0, ident, sizeof(ident))) {
+		return;
+	}
+
+	// Collect the program headers of type PT_NOTE independently of the ELF class
+	uint64_t noteOffsets[16], noteSizes[16];
+	size_t noteCount = 0;
+	if (ident[EI_CLASS] == ELFCLASS64) {
+		Elf64_Ehdr header;
+		if (!readFile(fd, 0, &header, sizeof(header))) {
+			return;
+		}
+		for (size_t i = 0; i < header.e_phnum && noteCount < 16; i++) {
+			Elf64_Phdr program;
+			if (!readFile(fd, header.e_phoff + i * header.e_phentsize, &program, sizeof(program))) {
+				return;
+			}
+			if (program.p_type == PT_NOTE) {
+				noteOffsets[noteCount] = program.p_offset;
+				noteSizes[noteCount++] = program.p_filesz;
+			}
+		}
+	} else if (ident[EI_CLASS] == ELFCLASS32) {
+		Elf32_Ehdr header;
+		if (!readFile(fd, 0, &header, sizeof(header))) {
+			return;
+		}
+		for (size_t i = 0; i < header.e_phnum && noteCount < 16; i++) {
+			Elf32_Phdr program;
+			if (!readFile(fd, header.e_phoff + i * header.e_phentsize, &program, sizeof(program))) {
+				return;
+			}
+			if (program.p_type == PT_NOTE) {
+				noteOffsets[noteCount] = program.p_offset;
+				noteSizes[noteCount++] = program.p_filesz;
+			}
+		}
+	}
+
+	uint8_t notes[MAX_NOTE_SEGMENT_SIZE];
+	for (size_t i = 0; i < noteCount; i++) {
+		if (noteSizes[i] > sizeof(notes) || !readFile(fd, noteOffsets[i], notes, noteSizes[i])) {
+			continue;
+		}
+
+		// Both ELF classes use the same note layout (Elf32_Nhdr == Elf64_Nhdr)
+		size_t position = 0;
+		while (position + sizeof(Elf64_Nhdr) <= noteSizes[i]) {
+			Elf64_Nhdr note;
+			memcpy(&note, notes + position, sizeof(note));
+			size_t nameStart = position + sizeof(note);
+			size_t descStart = nameStart + ((note.n_namesz + 3) & ~3u);
+			size_t next      = descStart + ((note.n_descsz + 3) & ~3u);
+			if (next > noteSizes[i]) {
+				break;
+			}
+
+			if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 && memcmp(notes + nameStart, "GNU", 4) == 0) {
+				module->buildIDLength = note.n_descsz < SCANNER_MAX_BUILD_ID ? note.n_descsz : SCANNER_MAX_BUILD_ID;
+				memcpy(module->buildID, notes + descStart, module->buildIDLength);
+				return;
+			}
+
+			position = next;
+		}
+	}
+}
+
+// Windows binaries (run through Wine) don't have a build ID. The linker timestamp together with the image size is what
+// symbol servers use to identify them, so that's used instead.
+static void readPeBuildID(int fd, struct ModuleInfo *module) {
+	uint32_t headerOffset;
+	uint8_t headers[24 + 60];
+	if (!readFile(fd, 0x3C, &headerOffset, sizeof(headerOffset)) || !readFile(fd, headerOffset, headers, sizeof(headers))
+		|| memcmp(headers, "PE\0\0", 4) != 0) {
+		return;
+	}
+
+	// TimeDateStamp in the COFF header and SizeOfImage in the optional header
+	memcpy(module->buildID, headers + 8, 4);
+	memcpy(module->buildID + 4, headers + 24 + 56, 4);
+	module->buildIDLength = 8;
+}
+
+bool scanner_findModule(uint64_t pid, const char *moduleName, struct ModuleInfo *module) {
+	memset(module, 0, sizeof(*module));
+
+	struct ModuleSearch search = { moduleName, module, false };
+	if (!forEachRegion(pid, &collectModule, &search) || !search.found) {
+		return false;
+	}
+
+	// The file has to be opened through the process as it might live in a different mount namespace
+	char filePath[4096 + 64];
+	snprintf(filePath, sizeof(filePath), "/proc/%llu/root%s", (unsigned long long) pid, module->path);
+	int fd = open(filePath, O_RDONLY);
+	if (fd < 0) {
+		fd = open(module->path, O_RDONLY);
+	}
+	if (fd >= 0) {
+		char magic[4];
+		if (readFile(fd, 0, magic, sizeof(magic))) {
+			if (memcmp(magic, ELFMAG, SELFMAG) == 0) {
+				readElfBuildID(fd, module);
+			} else if (magic[0] == 'M' && magic[1] == 'Z') {
+				readPeBuildID(fd, module);
+			}
+		}
+
+		struct stat info;
+		if (module->buildIDLength == 0 && fstat(fd, &info) == 0) {
+			uint64_t identity[3] = { (uint64_t) info.st_size, (uint64_t) info.st_mtime, (uint64_t) info.st_ino };
+			memcpy(module->buildID, identity, sizeof(identity));
+			module->buildIDLength = sizeof(identity);
+		}
+
+		close(fd);
+	}
+
+	return true;
+}
+
+bool scanner_read(uint64_t pid, uint64_t address, void *buffer, size_t size) {
+	struct iovec local  = { buffer, size };
+	struct iovec remote = { (void *) (uintptr_t) address, size };
+
+	return process_vm_readv((pid_t) pid, &local, 1, &remote, 1, 0) == (ssize_t) size;
+}
+
+struct ScanJob {
+	uint64_t address;
+	size_t size;
+};
+
+struct ModuleScan {
+	uint64_t pid;
+	const char *path;
+	const struct SignaturePattern *patterns;
+	size_t patternCount;
+	size_t overlap;
+
+	struct ScanJob *jobs;
+	size_t jobCount;
+	size_t jobCapacity;
+	bool failed;
+	atomic_size_t nextJob;
+
+	// The lowest address each pattern has been found at so far
+	_Atomic uint64_t matches[SCANNER_MAX_PATTERNS];
+};
+
+static bool collectJobs(const struct Region *region, void *userData) {
+	struct ModuleScan *scan = userData;
+	if (!region->readable || strcmp(region->path, scan->path) != 0) {
+		return true;
+	}
+
+	for (uint64_t address = region->start; address < region->end; address += SCAN_CHUNK_SIZE) {
+		if (scan->jobCount == scan->jobCapacity) {
+			size_t capacity      = scan->jobCapacity > 0 ? 2 * scan->jobCapacity : 64;
+			struct ScanJob *jobs = memory_realloc(MEMORY_SCANNER, scan->jobs, capacity * sizeof(struct ScanJob));
+			if (!jobs) {
+				scan->failed = true;
+				return false;
+			}
+			scan->jobs        = jobs;
+			scan->jobCapacity = capacity;
+		}
+
+		uint64_t remaining                = region->end - address;
+		scan->jobs[scan->jobCount].address = address;
+		scan->jobs[scan->jobCount].size =
+			remaining < SCAN_CHUNK_SIZE + scan->overlap ? (size_t) remaining : SCAN_CHUNK_SIZE + scan->overlap;
+		scan->jobCount++;
+	}
+
+	return true;
+}
+
+static void recordMatch(_Atomic uint64_t *match, uint64_t address) {
+	uint64_t current = atomic_load(match);
+	while (address < current && !atomic_compare_exchange_weak(match, &current, address)) {
+	}
+}
+
+static void scanJob(struct ModuleScan *scan, const struct ScanJob *job, uint8_t *buffer) {
+	// Patterns that have already been found in an earlier chunk don't have to be searched for anymore
+	struct SignaturePattern patterns[SCANNER_MAX_PATTERNS];
+	size_t indices[SCANNER_MAX_PATTERNS];
+	size_t patternCount = 0;
+	for (size_t i = 0; i < scan->patternCount; i++) {
+		if (atomic_load_explicit(&scan->matches[i], memory_order_relaxed) > job->address) {
+			patterns[patternCount] = scan->patterns[i];
+			indices[patternCount++] = i;
+		}
+	}
+	if (patternCount == 0) {
+		return;
+	}
+
+	struct iovec local  = { buffer, job->size };
+	struct iovec remote = { (void *) (uintptr_t) job->address, job->size };
+	ssize_t length      = process_vm_readv((pid_t) scan->pid, &local, 1, &remote, 1, 0);
+	if (length <= 0) {
+		return;
+	}
+
+	size_t results[SCANNER_MAX_PATTERNS];
+	findPatterns(buffer, (size_t) length, patterns, patternCount, results);
+	for (size_t i = 0; i < patternCount; i++) {
+		if (results[i] != SIZE_MAX) {
+			recordMatch(&scan->matches[indices[i]], job->address + results[i]);
+		}
+	}
+}
+
+static void *runScanWorker(void *arg) {
+	struct ModuleScan *scan = arg;
+
+	uint8_t *buffer = memory_allocLarge(MEMORY_SCANNER, SCAN_CHUNK_SIZE + SCANNER_MAX_PATTERN);
+	if (!buffer) {
+		return NULL;
+	}
+
+	size_t job;
+	while ((job = atomic_fetch_add(&scan->nextJob, 1)) < scan->jobCount) {
+		scanJob(scan, &scan->jobs[job], buffer);
+	}
+
+	memory_freeLarge(buffer);
+
+	return NULL;
+}
+
+bool scanner_scanModule(uint64_t pid, const struct ModuleInfo *module, const struct SignaturePattern *patterns,
+						size_t patternCount, uint64_t *addresses) {
+	if (patternCount > SCANNER_MAX_PATTERNS) {
+		return false;
+	}
+
+	struct ModuleScan scan;
+	memset(&scan, 0, sizeof(scan));
+	scan.pid          = pid;
+	scan.path         = module->path;
+	scan.patterns     = patterns;
+	scan.patternCount = patternCount;
+	atomic_init(&scan.nextJob, 0);
+	for (size_t i = 0; i < patternCount; i++) {
+		atomic_init(&scan.matches[i], UINT64_MAX);
+		if (patterns[i].length > scan.overlap + 1) {
+			scan.overlap = patterns[i].length - 1;
+		}
+	}
+
+	if (!forEachRegion(pid, &collectJobs, &scan) || scan.failed) {
+		memory_free(scan.jobs);
+		return false;
+	}
+
+	long processors    = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threadCount = processors > 1 ? (size_t) processors : 1;
+	threadCount        = threadCount < MAX_SCAN_THREADS ? threadCount : MAX_SCAN_THREADS;
+	threadCount        = threadCount < scan.jobCount ? threadCount : scan.jobCount;
+
+	// The calling thread does its share of the work as well
+	pthread_t threads[MAX_SCAN_THREADS];
+	size_t startedThreads = 0;
+	for (size_t i = 1; i < threadCount; i++) {
+		if (pthread_create(&threads[startedThreads], NULL, &runScanWorker, &scan) == 0) {
+			startedThreads++;
+		}
+	}
+	runScanWorker(&scan);
+	for (size_t i = 0; i < startedThreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	memory_free(scan.jobs);
+
+	bool foundAll = true;
+	for (size_t i = 0; i < patternCount; i++) {
+		addresses[i] = atomic_load(&scan.matches[i]);
+		foundAll     = foundAll && addresses[i] != UINT64_MAX;
+	}
+
+	return foundAll;
+}
+
+#else
+
+bool scanner_findModule(uint64_t pid, const char *moduleName, struct ModuleInfo *module) {
+	(void) pid;
+	(void) moduleName;
+	(void) module;
+
+	return false;
+}
+
+bool scanner_read(uint64_t pid, uint64_t address, void *buffer, size_t size) {
+	(void) pid;
+	(void) address;
+	(void) buffer;
+	(void) size;
+
+	return false;
+}
+
+bool scanner_scanModule(uint64_t pid, const struct ModuleInfo *module, const struct SignaturePattern *patterns,
+						size_t patternCount, uint64_t *addresses) {
+	(void) pid;
+	(void) module;
+	(void) patterns;
+
+	for (size_t i = 0; i < patternCount; i++) {
+		addresses[i] = UINT64_MAX;
+	}
+
+	return false;
+}
+
+#endif
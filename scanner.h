@@ -0,0 +1,73 @@
+/// This header file declares the signature scanner used to locate data in other processes' memory.
+///
+/// Signatures are byte patterns that may contain wildcards, written like "48 8B 05 ?? ?? ?? ?? 48 85 C0". Each pattern
+/// has an anchor: its rarest non-wildcard byte (judged by how common bytes are in machine code). Buffers are searched
+/// for the anchors of all patterns at once, 16 bytes at a time, and only candidates whose anchor matches are compared
+/// against the full pattern using the wildcard mask.
+///
+/// Modules are read in large chunks (one syscall each) which are distributed across several threads.
+///
+/// NOTE: Accessing other processes is only implemented on Linux (via /proc and process_vm_readv).
+
+#ifndef MUMBLE_PLUGIN_SCANNER_H_
+#define MUMBLE_PLUGIN_SCANNER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The maximum length of a signature in bytes
+#define SCANNER_MAX_PATTERN 64
+/// The maximum amount of patterns that can be searched for at once
+#define SCANNER_MAX_PATTERNS 16
+/// The maximum length of a module's build ID
+#define SCANNER_MAX_BUILD_ID 32
+
+struct SignaturePattern {
+	uint8_t bytes[SCANNER_MAX_PATTERN];
+	/// 0xFF for bytes that have to match, 0x00 for wildcards
+	uint8_t mask[SCANNER_MAX_PATTERN];
+	size_t length;
+	/// The offset of the byte that candidates are searched for
+	size_t anchor;
+};
+
+struct ModuleInfo {
+	uint64_t base;
+	uint64_t size;
+	char path[4096];
+	/// Identifies the module's binary: The GNU build ID of ELF modules or the PE timestamp and image size of Windows
+	/// modules. If neither is available, the file's size, modification time and inode are used.
+	uint8_t buildID[SCANNER_MAX_BUILD_ID];
+	size_t buildIDLength;
+};
+
+/// Parses a textual signature (hex bytes separated by spaces, "?" or "??" for wildcards)
+///
+/// @returns Whether the signature was valid. It has to contain at least one non-wildcard byte.
+bool scanner_parsePattern(const char *text, struct SignaturePattern *pattern);
+
+/// Finds the first occurrence of the given pattern in the given buffer
+///
+/// @returns The offset of the match or SIZE_MAX if there is none
+size_t scanner_find(const uint8_t *data, size_t length, const struct SignaturePattern *pattern);
+
+/// Locates the given module (matched by file name, ignoring case) in the given process and determines its build ID
+///
+/// @returns Whether the module has been found
+bool scanner_findModule(uint64_t pid, const char *moduleName, struct ModuleInfo *module);
+
+/// Reads memory of the given process
+///
+/// @returns Whether all requested bytes could be read
+bool scanner_read(uint64_t pid, uint64_t address, void *buffer, size_t size);
+
+/// Searches the readable memory of the given module for the given patterns
+///
+/// @param patternCount The amount of patterns (at most SCANNER_MAX_PATTERNS)
+/// @param[out] addresses The address of each pattern's first match or UINT64_MAX if it hasn't been found
+/// @returns Whether all patterns have been found
+bool scanner_scanModule(uint64_t pid, const struct ModuleInfo *module, const struct SignaturePattern *patterns,
+						size_t patternCount, uint64_t *addresses);
+
+#endif // MUMBLE_PLUGIN_SCANNER_H_
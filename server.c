@@ -0,0 +1,154 @@
+#ifdef __linux__
+// accept4
+#	define _GNU_SOURCE
+#endif
+
+#include "server.h"
+
+#ifdef __linux__
+
+#	include <errno.h>
+#	include <string.h>
+#	include <sys/eventfd.h>
+#	include <sys/socket.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+
+static bool watch(struct SocketServer *server, int fd, uint64_t tag) {
+	struct epoll_event event;
+	event.events   = EPOLLIN;
+	event.data.u64 = tag;
+
+	return epoll_ctl(server->epollFD, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+bool server_open(struct SocketServer *server, const char *path, size_t maxClients) {
+	server->listenFD   = -1;
+	server->epollFD    = -1;
+	server->wakeFD     = -1;
+	server->bound      = false;
+	server->maxClients = maxClients;
+	for (size_t i = 0; i < SERVER_MAX_CLIENTS; i++) {
+		server->clientFDs[i] = -1;
+	}
+
+	if (maxClients > SERVER_MAX_CLIENTS || strlen(path) >= sizeof(server->path)) {
+		return false;
+	}
+	strcpy(server->path, path);
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	// A socket left behind by a previous instance would make binding fail. A regular file (e.g. because the path has
+	// been misconfigured) is never removed.
+	struct stat status;
+	if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode)) {
+		unlink(path);
+	}
+
+	server->listenFD = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	server->epollFD  = epoll_create1(EPOLL_CLOEXEC);
+	server->wakeFD   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (server->listenFD < 0 || server->epollFD < 0 || server->wakeFD < 0) {
+		return false;
+	}
+
+	server->bound = bind(server->listenFD, (struct sockaddr *) &address, sizeof(address)) == 0;
+
+	return server->bound && listen(server->listenFD, (int) maxClients) == 0
+		   && watch(server, server->listenFD, SERVER_TAG_LISTENER) && watch(server, server->wakeFD, SERVER_TAG_WAKE);
+}
+
+void server_close(struct SocketServer *server) {
+	for (size_t i = 0; i < SERVER_MAX_CLIENTS; i++) {
+		if (server->clientFDs[i] >= 0) {
+			server_closeClient(server, i);
+		}
+	}
+	if (server->listenFD >= 0) {
+		close(server->listenFD);
+		server->listenFD = -1;
+	}
+	if (server->bound) {
+		unlink(server->path);
+		server->bound = false;
+	}
+	if (server->epollFD >= 0) {
+		close(server->epollFD);
+		server->epollFD = -1;
+	}
+	if (server->wakeFD >= 0) {
+		close(server->wakeFD);
+		server->wakeFD = -1;
+	}
+}
+
+int server_wait(struct SocketServer *server, struct epoll_event *events, int capacity) {
+	int count = epoll_wait(server->epollFD, events, capacity, -1);
+	if (count < 0 && errno == EINTR) {
+		return 0;
+	}
+
+	return count;
+}
+
+int server_accept(struct SocketServer *server) {
+	while (true) {
+		int fd = accept4(server->listenFD, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			return -1;
+		}
+
+		int slot = -1;
+		for (size_t i = 0; i < server->maxClients && slot < 0; i++) {
+			if (server->clientFDs[i] < 0) {
+				slot = (int) i;
+			}
+		}
+
+		struct epoll_event event;
+		event.events   = EPOLLIN;
+		event.data.u64 = slot >= 0 ? (uint64_t) slot : 0;
+		if (slot < 0 || epoll_ctl(server->epollFD, EPOLL_CTL_ADD, fd, &event) != 0) {
+			// Too many clients at once
+			close(fd);
+			continue;
+		}
+
+		server->clientFDs[slot] = fd;
+
+		return slot;
+	}
+}
+
+bool server_watchClient(struct SocketServer *server, size_t slot, uint32_t events) {
+	struct epoll_event event;
+	event.events   = events;
+	event.data.u64 = slot;
+
+	return epoll_ctl(server->epollFD, EPOLL_CTL_MOD, server->clientFDs[slot], &event) == 0;
+}
+
+void server_closeClient(struct SocketServer *server, size_t slot) {
+	epoll_ctl(server->epollFD, EPOLL_CTL_DEL, server->clientFDs[slot], NULL);
+	close(server->clientFDs[slot]);
+	server->clientFDs[slot] = -1;
+}
+
+bool server_wake(struct SocketServer *server) {
+	uint64_t one = 1;
+
+	return write(server->wakeFD, &one, sizeof(one)) == sizeof(one);
+}
+
+void server_clearWake(struct SocketServer *server) {
+	uint64_t counter;
+	if (read(server->wakeFD, &counter, sizeof(counter)) != sizeof(counter)) {
+		// Nothing to reset
+	}
+}
+
+#endif
@@ -0,0 +1,79 @@
+/// This header file declares the Unix domain socket server that the control channel and the metrics endpoint are built
+/// on.
+///
+/// A server owns the listening socket, the epoll instance its thread waits on, an eventfd that wakes that thread up and
+/// the sockets of its clients. Every client occupies one of maxClients slots, and the events of its socket are tagged
+/// with the slot's index (those of the listening socket and the eventfd with SERVER_TAG_LISTENER and SERVER_TAG_WAKE).
+/// Connections beyond maxClients are closed right away. What is exchanged with the clients, and the thread running the
+/// loop, are up to the user of the server.
+///
+/// A socket left at the path (by a previous instance that didn't shut down cleanly) is replaced. Anything else at the
+/// path is left alone, which makes opening the server fail.
+///
+/// Only available on Linux.
+
+#ifndef MUMBLE_PLUGIN_SERVER_H_
+#define MUMBLE_PLUGIN_SERVER_H_
+
+#ifdef __linux__
+
+#	include <stdbool.h>
+#	include <stddef.h>
+#	include <stdint.h>
+#	include <sys/epoll.h>
+#	include <sys/un.h>
+
+#	define SERVER_MAX_CLIENTS 8
+#	define SERVER_TAG_LISTENER UINT64_MAX
+#	define SERVER_TAG_WAKE (UINT64_MAX - 1)
+
+struct SocketServer {
+	int listenFD;
+	int epollFD;
+	int wakeFD;
+	/// Whether the path has been bound to (and has to be removed again)
+	bool bound;
+	char path[sizeof(((struct sockaddr_un *) NULL)->sun_path)];
+	size_t maxClients;
+	/// The clients' sockets (-1 for free slots)
+	int clientFDs[SERVER_MAX_CLIENTS];
+};
+
+/// Starts listening on the given path
+///
+/// @param maxClients The amount of slots (at most SERVER_MAX_CLIENTS)
+/// @returns Whether listening succeeded. Either way, the server has to be closed with server_close.
+bool server_open(struct SocketServer *server, const char *path, size_t maxClients);
+
+/// Closes all clients and the listening socket and removes the socket's path
+void server_close(struct SocketServer *server);
+
+/// Waits for events, tagged with the slot of the client they belong to
+///
+/// @returns The amount of events (0 if the wait has been interrupted by a signal, negative if it failed)
+int server_wait(struct SocketServer *server, struct epoll_event *events, int capacity);
+
+/// Accepts one of the pending connections and watches it for EPOLLIN
+///
+/// @returns The slot the client occupies or -1 if there are no more pending connections
+int server_accept(struct SocketServer *server);
+
+/// Changes the epoll events a client is watched for
+///
+/// @returns Whether changing them succeeded
+bool server_watchClient(struct SocketServer *server, size_t slot, uint32_t events);
+
+/// Closes a client's socket and frees its slot
+void server_closeClient(struct SocketServer *server, size_t slot);
+
+/// Makes server_wait return an event tagged with SERVER_TAG_WAKE. May be called from any thread.
+///
+/// @returns Whether waking up the server succeeded
+bool server_wake(struct SocketServer *server);
+
+/// Resets the wake-up event once it has been handled
+void server_clearWake(struct SocketServer *server);
+
+#endif
+
+#endif // MUMBLE_PLUGIN_SERVER_H_
@@ -0,0 +1,560 @@
+#include "soundboard.h"
+#include "memory.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#	include <dirent.h>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
+// Layout of a cache file: magic (4) | version (4) | sample rate (4) | padding (4) | sample count (8) | samples
+#define CACHE_MAGIC 0x4253484d // "MHSB"
+#define CACHE_VERSION 1
+#define CACHE_HEADER_SIZE 24
+
+enum VoiceState { VOICE_IDLE, VOICE_CLAIMED, VOICE_PLAYING };
+
+struct Clip {
+	char name[SOUNDBOARD_MAX_CLIP_NAME];
+	const int16_t *samples;
+	size_t sampleCount;
+	// Either the mapping of the cache file or a heap allocation
+	void *storage;
+	size_t mappedLength;
+};
+
+struct Voice {
+	atomic_int state;
+	atomic_bool stopRequested;
+	int clip;
+	size_t position;
+};
+
+struct Soundboard {
+	char *cacheDirectory;
+	struct Clip clips[SOUNDBOARD_MAX_CLIPS];
+	size_t clipCount;
+	struct Voice voices[SOUNDBOARD_MAX_VOICES];
+};
+
+
+static uint32_t readLE(const uint8_t *data, int bytes) {
+	uint32_t value = 0;
+	for (int i = 0; i < bytes; i++) {
+		value |= (uint32_t) data[i] << (8 * i);
+	}
+
+	return value;
+}
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t length) {
+	const uint8_t *bytes = data;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static uint8_t *readFile(const char *path, size_t *length) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		return NULL;
+	}
+
+	uint8_t *data = NULL;
+	if (fseek(file, 0, SEEK_END) == 0) {
+		long size = ftell(file);
+		if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+			data = memory_alloc(MEMORY_SOUNDBOARD, (size_t) size);
+			if (data && fread(data, 1, (size_t) size, file) != (size_t) size) {
+				memory_free(data);
+				data = NULL;
+			}
+			*length = (size_t) size;
+		}
+	}
+
+	fclose(file);
+
+	return data;
+}
+
+static float decodeSample(const uint8_t *data, uint16_t format, uint16_t bitsPerSample) {
+	if (format == 3) {
+		float value;
+		uint32_t bits = readLE(data, 4);
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	switch (bitsPerSample) {
+		case 8:
+			return ((float) data[0] - 128.0f) / 128.0f;
+		case 16:
+			return (float) (int16_t) readLE(data, 2) / 32768.0f;
+		case 24:
+			return (float) ((int32_t)(readLE(data, 3) << 8) >> 8) / 8388608.0f;
+		default:
+			return (float) (int32_t) readLE(data, 4) / 2147483648.0f;
+	}
+}
+
+// Decodes a WAV file into mono int16 samples at SOUNDBOARD_SAMPLE_RATE
+static int16_t *decodeWav(const uint8_t *file, size_t fileLength, size_t *sampleCount) {
+	if (fileLength < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0) {
+		return NULL;
+	}
+
+	uint16_t format = 0, channels = 0, bitsPerSample = 0;
+	uint32_t sampleRate = 0;
+	const uint8_t *data = NULL;
+	size_t dataLength   = 0;
+
+	size_t offset = 12;
+	while (offset + 8 <= fileLength) {
+		const uint8_t *chunk = file + offset;
+		size_t chunkLength   = readLE(chunk + 4, 4);
+		if (chunkLength > fileLength - offset - 8) {
+			chunkLength = fileLength - offset - 8;
+		}
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && chunkLength >= 16) {
+			format        = (uint16_t) readLE(chunk + 8, 2);
+			channels      = (uint16_t) readLE(chunk + 10, 2);
+			sampleRate    = readLE(chunk + 12, 4);
+			bitsPerSample = (uint16_t) readLE(chunk + 22, 2);
+			if (format == 0xFFFE && chunkLength >= 26) {
+				// WAVE_FORMAT_EXTENSIBLE: the actual format is at the beginning of the sub-format GUID
+				format = (uint16_t) readLE(chunk + 32, 2);
+			}
+		} else if (memcmp(chunk, "data", 4) == 0) {
+			data       = chunk + 8;
+			dataLength = chunkLength;
+		}
+
+		offset += 8 + chunkLength + (chunkLength & 1);
+	}
+
+	bool supported = (format == 1 && (bitsPerSample == 8 || bitsPerSample == 16 || bitsPerSample == 24
+									  || bitsPerSample == 32))
+					 || (format == 3 && bitsPerSample == 32);
+	if (!data || !supported || channels == 0 || sampleRate == 0) {
+		return NULL;
+	}
+
+	size_t frameSize  = (size_t) channels * (bitsPerSample / 8);
+	size_t frameCount = dataLength / frameSize;
+	if (frameCount == 0) {
+		return NULL;
+	}
+
+	float *mono = memory_alloc(MEMORY_SOUNDBOARD, frameCount * sizeof(float));
+	if (!mono) {
+		return NULL;
+	}
+
+	for (size_t frame = 0; frame < frameCount; frame++) {
+		float sum = 0.0f;
+		for (uint16_t channel = 0; channel < channels; channel++) {
+			sum += decodeSample(data + frame * frameSize + channel * (bitsPerSample / 8), format, bitsPerSample);
+		}
+		mono[frame] = sum / channels;
+	}
+
+	size_t outputCount = (size_t)((uint64_t) frameCount * SOUNDBOARD_SAMPLE_RATE / sampleRate);
+	int16_t *samples   = outputCount > 0 ? memory_alloc(MEMORY_SOUNDBOARD, outputCount * sizeof(int16_t)) : NULL;
+	if (samples) {
+		// Linear interpolation is good enough for sound effects
+		double step = (double) sampleRate / SOUNDBOARD_SAMPLE_RATE;
+		for (size_t i = 0; i < outputCount; i++) {
+			double position = i * step;
+			size_t index    = (size_t) position;
+			float fraction  = (float) (position - index);
+			float next      = index + 1 < frameCount ? mono[index + 1] : mono[index];
+			float value     = (mono[index] + (next - mono[index]) * fraction) * 32767.0f;
+
+			if (value > 32767.0f) {
+				value = 32767.0f;
+			} else if (value < -32768.0f) {
+				value = -32768.0f;
+			}
+			samples[i] = (int16_t) value;
+		}
+		*sampleCount = outputCount;
+	}
+
+	memory_free(mono);
+
+	return samples;
+}
+
+#ifndef _WIN32
+static bool mapCacheFile(const char *path, struct Clip *clip) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < CACHE_HEADER_SIZE) {
+		close(fd);
+		return false;
+	}
+
+	void *mapping = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+
+	const uint8_t *header = mapping;
+	uint64_t sampleCount  = readLE(header + 16, 4) | ((uint64_t) readLE(header + 20, 4) << 32);
+	if (readLE(header, 4) != CACHE_MAGIC || readLE(header + 4, 4) != CACHE_VERSION
+		|| readLE(header + 8, 4) != SOUNDBOARD_SAMPLE_RATE
+		|| sampleCount != ((uint64_t) info.st_size - CACHE_HEADER_SIZE) / sizeof(int16_t)) {
+		munmap(mapping, (size_t) info.st_size);
+		return false;
+	}
+
+	// Clips are played right after being triggered, so make sure they are paged in already
+	madvise(mapping, (size_t) info.st_size, MADV_WILLNEED);
+
+	clip->storage      = mapping;
+	clip->mappedLength = (size_t) info.st_size;
+	clip->samples      = (const int16_t *) (header + CACHE_HEADER_SIZE);
+	clip->sampleCount  = (size_t) sampleCount;
+
+	return true;
+}
+
+static bool writeCacheFile(const char *path, const int16_t *samples, size_t sampleCount) {
+	// Write to a temporary file first so that a concurrently starting instance never maps a partial file
+	char temporaryPath[4096];
+	if ((size_t) snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", path) >= sizeof(temporaryPath)) {
+		return false;
+	}
+
+	FILE *file = fopen(temporaryPath, "wb");
+	if (!file) {
+		return false;
+	}
+
+	uint8_t header[CACHE_HEADER_SIZE] = { 0 };
+	uint32_t fields[3]                = { CACHE_MAGIC, CACHE_VERSION, SOUNDBOARD_SAMPLE_RATE };
+	for (int field = 0; field < 3; field++) {
+		for (int i = 0; i < 4; i++) {
+			header[field * 4 + i] = (uint8_t)(fields[field] >> (8 * i));
+		}
+	}
+	for (int i = 0; i < 8; i++) {
+		header[16 + i] = (uint8_t)((uint64_t) sampleCount >> (8 * i));
+	}
+
+	// Samples are stored in native byte order. Mumble only runs on little endian machines.
+	bool success = fwrite(header, 1, sizeof(header), file) == sizeof(header)
+				   && fwrite(samples, sizeof(int16_t), sampleCount, file) == sampleCount;
+	success = fclose(file) == 0 && success;
+
+	if (!success || rename(temporaryPath, path) != 0) {
+		remove(temporaryPath);
+		return false;
+	}
+
+	return true;
+}
+#endif
+
+static bool loadClip(struct Soundboard *soundboard, struct Clip *clip, const char *path) {
+	struct stat info;
+	if (stat(path, &info) != 0) {
+		return false;
+	}
+
+#ifndef _WIN32
+	char cachePath[4096];
+	if (soundboard->cacheDirectory) {
+		uint64_t hash = fnv1a(0xcbf29ce484222325ULL, path, strlen(path));
+		int64_t size = (int64_t) info.st_size, modified = (int64_t) info.st_mtime;
+		hash = fnv1a(hash, &size, sizeof(size));
+		hash = fnv1a(hash, &modified, sizeof(modified));
+
+		if ((size_t) snprintf(cachePath, sizeof(cachePath), "%s/%016llx.pcm", soundboard->cacheDirectory,
+							  (unsigned long long) hash)
+				< sizeof(cachePath)
+			&& mapCacheFile(cachePath, clip)) {
+			return true;
+		}
+	}
+#endif
+
+	size_t fileLength;
+	uint8_t *file = readFile(path, &fileLength);
+	if (!file) {
+		return false;
+	}
+
+	size_t sampleCount;
+	int16_t *samples = decodeWav(file, fileLength, &sampleCount);
+	memory_free(file);
+	if (!samples) {
+		return false;
+	}
+
+#ifndef _WIN32
+	if (soundboard->cacheDirectory && writeCacheFile(cachePath, samples, sampleCount)
+		&& mapCacheFile(cachePath, clip)) {
+		memory_free(samples);
+		return true;
+	}
+#endif
+
+	clip->storage      = samples;
+	clip->mappedLength = 0;
+	clip->samples      = samples;
+	clip->sampleCount  = sampleCount;
+
+	return true;
+}
+
+static void releaseClip(struct Clip *clip) {
+#ifndef _WIN32
+	if (clip->mappedLength > 0) {
+		munmap(clip->storage, clip->mappedLength);
+		return;
+	}
+#endif
+	memory_free(clip->storage);
+}
+
+static void mixSaturating(int16_t *destination, const int16_t *source, size_t count) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (destination + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (source + i));
+		_mm_storeu_si128((__m128i *) (destination + i), _mm_adds_epi16(a, b));
+	}
+#elif defined(__ARM_NEON)
+	for (; i + 8 <= count; i += 8) {
+		vst1q_s16(destination + i, vqaddq_s16(vld1q_s16(destination + i), vld1q_s16(source + i)));
+	}
+#endif
+
+	for (; i < count; i++) {
+		int32_t sum = (int32_t) destination[i] + source[i];
+		if (sum > INT16_MAX) {
+			sum = INT16_MAX;
+		} else if (sum < INT16_MIN) {
+			sum = INT16_MIN;
+		}
+		destination[i] = (int16_t) sum;
+	}
+}
+
+
+struct Soundboard *soundboard_create(const char *cacheDirectory) {
+	struct Soundboard *soundboard = memory_calloc(MEMORY_SOUNDBOARD, 1, sizeof(struct Soundboard));
+	if (!soundboard) {
+		return NULL;
+	}
+
+	if (cacheDirectory) {
+		soundboard->cacheDirectory = memory_alloc(MEMORY_SOUNDBOARD, strlen(cacheDirectory) + 1);
+		if (!soundboard->cacheDirectory) {
+			memory_free(soundboard);
+			return NULL;
+		}
+		strcpy(soundboard->cacheDirectory, cacheDirectory);
+	}
+
+	for (size_t i = 0; i < SOUNDBOARD_MAX_VOICES; i++) {
+		atomic_init(&soundboard->voices[i].state, VOICE_IDLE);
+		atomic_init(&soundboard->voices[i].stopRequested, false);
+	}
+
+	return soundboard;
+}
+
+void soundboard_destroy(struct Soundboard *soundboard) {
+	if (!soundboard) {
+		return;
+	}
+
+	for (size_t i = 0; i < soundboard->clipCount; i++) {
+		releaseClip(&soundboard->clips[i]);
+	}
+
+	memory_free(soundboard->cacheDirectory);
+	memory_free(soundboard);
+}
+
+bool soundboard_loadClip(struct Soundboard *soundboard, const char *name, const char *path) {
+	if (soundboard->clipCount == SOUNDBOARD_MAX_CLIPS || strlen(name) >= SOUNDBOARD_MAX_CLIP_NAME
+		|| soundboard_findClip(soundboard, name) >= 0) {
+		return false;
+	}
+
+	struct Clip *clip = &soundboard->clips[soundboard->clipCount];
+	if (!loadClip(soundboard, clip, path)) {
+		return false;
+	}
+
+	strcpy(clip->name, name);
+	soundboard->clipCount++;
+
+	return true;
+}
+
+size_t soundboard_loadDirectory(struct Soundboard *soundboard, const char *directory) {
+	size_t loaded = 0;
+
+#ifndef _WIN32
+	DIR *dir = opendir(directory);
+	if (!dir) {
+		return 0;
+	}
+
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		size_t length = strlen(entry->d_name);
+		if (length <= 4 || length - 4 >= SOUNDBOARD_MAX_CLIP_NAME || strcmp(entry->d_name + length - 4, ".wav") != 0) {
+			continue;
+		}
+
+		char name[SOUNDBOARD_MAX_CLIP_NAME];
+		memcpy(name, entry->d_name, length - 4);
+		name[length - 4] = '\0';
+
+		char path[4096];
+		if ((size_t) snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name) < sizeof(path)
+			&& soundboard_loadClip(soundboard, name, path)) {
+			loaded++;
+		}
+	}
+
+	closedir(dir);
+#else
+	// Directory scanning isn't implemented for Windows yet -> use soundboard_loadClip instead
+	(void) soundboard;
+	(void) directory;
+#endif
+
+	return loaded;
+}
+
+int soundboard_findClip(const struct Soundboard *soundboard, const char *name) {
+	for (size_t i = 0; i < soundboard->clipCount; i++) {
+		if (strcmp(soundboard->clips[i].name, name) == 0) {
+			return (int) i;
+		}
+	}
+
+	return -1;
+}
+
+bool soundboard_trigger(struct Soundboard *soundboard, int clip) {
+	if (clip < 0 || (size_t) clip >= soundboard->clipCount) {
+		return false;
+	}
+
+	for (size_t i = 0; i < SOUNDBOARD_MAX_VOICES; i++) {
+		struct Voice *voice = &soundboard->voices[i];
+
+		int expected = VOICE_IDLE;
+		if (atomic_compare_exchange_strong(&voice->state, &expected, VOICE_CLAIMED)) {
+			voice->clip     = clip;
+			voice->position = 0;
+			atomic_store_explicit(&voice->stopRequested, false, memory_order_relaxed);
+			atomic_store_explicit(&voice->state, VOICE_PLAYING, memory_order_release);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void soundboard_stopAll(struct Soundboard *soundboard) {
+	// Only the mixer moves voices back to idle, so it never races with a voice being reused
+	for (size_t i = 0; i < SOUNDBOARD_MAX_VOICES; i++) {
+		atomic_store_explicit(&soundboard->voices[i].stopRequested, true, memory_order_relaxed);
+	}
+}
+
+bool soundboard_mix(struct Soundboard *soundboard, short *pcm, uint32_t sampleCount, uint16_t channelCount,
+					uint32_t sampleRate, float volume, struct MemoryArena *scratch) {
+	if (sampleRate != SOUNDBOARD_SAMPLE_RATE || channelCount == 0) {
+		return false;
+	}
+
+	// All voices are summed into a mono buffer first so that expanding to the channel layout happens only once
+	int16_t *mono        = NULL;
+	int16_t *interleaved = NULL;
+
+	for (size_t i = 0; i < SOUNDBOARD_MAX_VOICES; i++) {
+		struct Voice *voice = &soundboard->voices[i];
+		if (atomic_load_explicit(&voice->state, memory_order_acquire) != VOICE_PLAYING) {
+			continue;
+		}
+
+		const struct Clip *clip = &soundboard->clips[voice->clip];
+		if (atomic_load_explicit(&voice->stopRequested, memory_order_relaxed) || voice->position >= clip->sampleCount) {
+			atomic_store_explicit(&voice->state, VOICE_IDLE, memory_order_release);
+			continue;
+		}
+
+		if (!mono) {
+			// If the frame doesn't fit into the scratch arena, the voices simply pause for a frame
+			size_t interleavedSize = (size_t) sampleCount * channelCount * sizeof(int16_t);
+			mono                   = memory_arenaAlloc(scratch, sampleCount * sizeof(int16_t));
+			interleaved            = channelCount > 1 ? memory_arenaAlloc(scratch, interleavedSize) : mono;
+			if (!mono || !interleaved) {
+				return false;
+			}
+			memset(mono, 0, sampleCount * sizeof(int16_t));
+		}
+
+		size_t remaining = clip->sampleCount - voice->position;
+		size_t count     = remaining < sampleCount ? remaining : sampleCount;
+		mixSaturating(mono, clip->samples + voice->position, count);
+		voice->position += count;
+	}
+
+	if (!mono) {
+		return false;
+	}
+
+	if (volume != 1.0f) {
+		for (uint32_t i = 0; i < sampleCount; i++) {
+			float sample = mono[i] * volume;
+			mono[i]      = (int16_t) (sample > INT16_MAX ? INT16_MAX : sample < INT16_MIN ? INT16_MIN : sample);
+		}
+	}
+
+	if (channelCount > 1) {
+		for (uint32_t i = 0; i < sampleCount; i++) {
+			for (uint16_t channel = 0; channel < channelCount; channel++) {
+				interleaved[(size_t) i * channelCount + channel] = mono[i];
+			}
+		}
+	}
+	mixSaturating((int16_t *) pcm, interleaved, (size_t) sampleCount * channelCount);
+
+	return true;
+}
@@ -0,0 +1,76 @@
+/// This header file declares the soundboard that mixes clips into the outgoing audio stream.
+///
+/// Clips are WAV files that are decoded, downmixed to mono and resampled to SOUNDBOARD_SAMPLE_RATE once while loading.
+/// The result is stored in a cache directory and memory-mapped from there, so subsequent starts skip decoding
+/// altogether. Triggering a clip only claims a voice slot; all mixing happens in soundboard_mix, which is meant to be
+/// called from mumble_onAudioInput.
+///
+/// The input clips are mixed into has to run at SOUNDBOARD_SAMPLE_RATE (48 kHz) as well, as Mumble's input does. Clips
+/// are never resampled while mixing, so input at any other rate is left alone and the clips don't advance.
+///
+/// Mumble only transmits its input while the local user is talking (isSpeech in mumble_onAudioInput). Clips are mixed
+/// in and advance regardless, so a clip that plays while the user isn't talking (e.g. doesn't hold push-to-talk) isn't
+/// heard by anyone, and one that starts before the user talks is heard from where it has got to.
+///
+/// soundboard_trigger and soundboard_mix may be called from different threads without any locking. Loading clips has
+/// to be done before the soundboard is being used from several threads.
+
+#ifndef MUMBLE_PLUGIN_SOUNDBOARD_H_
+#define MUMBLE_PLUGIN_SOUNDBOARD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The sample rate clips are converted to. This is the rate Mumble's audio input runs at.
+#define SOUNDBOARD_SAMPLE_RATE 48000
+/// The maximum amount of clips that can be loaded
+#define SOUNDBOARD_MAX_CLIPS 64
+/// The maximum amount of clips that can be playing at the same time
+#define SOUNDBOARD_MAX_VOICES 8
+/// The maximum length of a clip's name (including the terminating null byte)
+#define SOUNDBOARD_MAX_CLIP_NAME 64
+
+struct MemoryArena;
+struct Soundboard;
+
+/// @param cacheDirectory The (existing) directory that converted clips are cached in. If NULL, converted clips are
+/// kept in memory only.
+/// @returns A new soundboard or NULL if allocating it failed
+struct Soundboard *soundboard_create(const char *cacheDirectory);
+
+void soundboard_destroy(struct Soundboard *soundboard);
+
+/// Loads the given WAV file (PCM with 8, 16, 24 or 32 bits or 32 bit float) as a clip
+///
+/// @param name The name the clip can be triggered by
+/// @returns Whether loading the clip succeeded
+bool soundboard_loadClip(struct Soundboard *soundboard, const char *name, const char *path);
+
+/// Loads all .wav files in the given directory. The clips are named after the file without the extension.
+///
+/// @returns The amount of clips that have been loaded
+size_t soundboard_loadDirectory(struct Soundboard *soundboard, const char *directory);
+
+/// @returns The index of the clip with the given name or -1 if there is no such clip
+int soundboard_findClip(const struct Soundboard *soundboard, const char *name);
+
+/// Starts playing the given clip. Neither does any I/O nor any allocation.
+///
+/// @returns Whether a free voice was available
+bool soundboard_trigger(struct Soundboard *soundboard, int clip);
+
+/// Stops all playing clips
+void soundboard_stopAll(struct Soundboard *soundboard);
+
+/// Mixes all playing clips into the given interleaved PCM buffer using saturating arithmetic
+///
+/// @param sampleRate The buffer's sample rate. Nothing is mixed unless it is SOUNDBOARD_SAMPLE_RATE.
+/// @param volume The gain applied to the clips (1 leaves them unchanged)
+/// @param scratch The arena the mix is prepared in (e.g. the audio thread's frame arena). It needs room for two
+/// buffers of sampleCount * channelCount samples.
+/// @returns Whether the buffer has been modified
+bool soundboard_mix(struct Soundboard *soundboard, short *pcm, uint32_t sampleCount, uint16_t channelCount,
+					uint32_t sampleRate, float volume, struct MemoryArena *scratch);
+
+#endif // MUMBLE_PLUGIN_SOUNDBOARD_H_
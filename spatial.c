@@ -0,0 +1,449 @@
+#include "spatial.h"
+#include "memory.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Both tables are open addressing / bucket tables with a power of two size
+#define USER_TABLE_SIZE (SPATIAL_MAX_USERS * 2)
+#define CELL_BUCKET_COUNT 4096
+
+#define NONE (-1)
+
+// Cell coordinates are clamped to this, so that a tiny cell size can't overflow them and neighbouring cells can be
+// addressed by adding a few cells
+#define MAX_CELL (1 << 30)
+
+struct Entry {
+	bool inUse;
+	mumble_userid_t userID;
+	float position[3];
+	int32_t cell[3];
+	// Doubly linked list of the entries in the same cell bucket
+	int next;
+	int previous;
+};
+
+struct SpatialIndex {
+	float cellSize;
+	size_t count;
+	struct Entry entries[SPATIAL_MAX_USERS];
+	// Indices of unused entries
+	int freeList[SPATIAL_MAX_USERS];
+	size_t freeCount;
+	// Maps user IDs to entry indices (NONE = empty slot). Deletion uses backward shifting so no tombstones are needed.
+	int userTable[USER_TABLE_SIZE];
+	int cellBuckets[CELL_BUCKET_COUNT];
+};
+
+
+static uint32_t hashUser(mumble_userid_t userID) {
+	return (userID * 2654435761u) & (USER_TABLE_SIZE - 1);
+}
+
+static uint32_t hashCell(const int32_t cell[3]) {
+	uint32_t hash = (uint32_t) cell[0] * 73856093u ^ (uint32_t) cell[1] * 19349663u ^ (uint32_t) cell[2] * 83492791u;
+
+	return hash & (CELL_BUCKET_COUNT - 1);
+}
+
+static int32_t cellCoordinate(const struct SpatialIndex *index, float coordinate) {
+	double cell = floor((double) coordinate / index->cellSize);
+
+	// Also catches NaN, which no comparison holds for
+	if (!(cell > -MAX_CELL)) {
+		return -MAX_CELL;
+	}
+	if (!(cell < MAX_CELL)) {
+		return MAX_CELL;
+	}
+
+	return (int32_t) cell;
+}
+
+static void cellOf(const struct SpatialIndex *index, const float position[3], int32_t cell[3]) {
+	for (int i = 0; i < 3; i++) {
+		cell[i] = cellCoordinate(index, position[i]);
+	}
+}
+
+static bool isValidPosition(const float position[3]) {
+	for (int i = 0; i < 3; i++) {
+		if (!(fabsf(position[i]) <= SPATIAL_MAX_COORDINATE)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static float distanceSquared(const float a[3], const float b[3]) {
+	float dx = a[0] - b[0];
+	float dy = a[1] - b[1];
+	float dz = a[2] - b[2];
+
+	return dx * dx + dy * dy + dz * dz;
+}
+
+static int findEntry(const struct SpatialIndex *index, mumble_userid_t userID) {
+	for (uint32_t slot = hashUser(userID);; slot = (slot + 1) & (USER_TABLE_SIZE - 1)) {
+		int entry = index->userTable[slot];
+		if (entry == NONE) {
+			return NONE;
+		}
+		if (index->entries[entry].userID == userID) {
+			return entry;
+		}
+	}
+}
+
+static void removeFromUserTable(struct SpatialIndex *index, mumble_userid_t userID) {
+	uint32_t slot = hashUser(userID);
+	while (index->entries[index->userTable[slot]].userID != userID) {
+		slot = (slot + 1) & (USER_TABLE_SIZE - 1);
+	}
+
+	// Shift following entries of the same probe sequence back into the hole
+	uint32_t hole = slot;
+	for (uint32_t next = (hole + 1) & (USER_TABLE_SIZE - 1); index->userTable[next] != NONE;
+		 next          = (next + 1) & (USER_TABLE_SIZE - 1)) {
+		uint32_t home = hashUser(index->entries[index->userTable[next]].userID);
+		// Move the element if its home slot doesn't lie cyclically within (hole, next]
+		bool movable = hole <= next ? (home <= hole || home > next) : (home <= hole && home > next);
+		if (movable) {
+			index->userTable[hole] = index->userTable[next];
+			hole                   = next;
+		}
+	}
+	index->userTable[hole] = NONE;
+}
+
+static void linkIntoCell(struct SpatialIndex *index, int entryIndex) {
+	struct Entry *entry = &index->entries[entryIndex];
+	uint32_t bucket     = hashCell(entry->cell);
+
+	entry->previous = NONE;
+	entry->next     = index->cellBuckets[bucket];
+	if (entry->next != NONE) {
+		index->entries[entry->next].previous = entryIndex;
+	}
+	index->cellBuckets[bucket] = entryIndex;
+}
+
+static void unlinkFromCell(struct SpatialIndex *index, int entryIndex) {
+	struct Entry *entry = &index->entries[entryIndex];
+
+	if (entry->previous != NONE) {
+		index->entries[entry->previous].next = entry->next;
+	} else {
+		index->cellBuckets[hashCell(entry->cell)] = entry->next;
+	}
+	if (entry->next != NONE) {
+		index->entries[entry->next].previous = entry->previous;
+	}
+}
+
+// Iterates over all entries in the given cell. Several cells share a bucket, so entries are filtered by cell.
+#define FOR_EACH_IN_CELL(index, cellCoordinates, entryVariable)                                                \
+	for (int entryVariable##Index = (index)->cellBuckets[hashCell(cellCoordinates)];                           \
+		 entryVariable##Index != NONE; entryVariable##Index = (index)->entries[entryVariable##Index].next)      \
+		for (const struct Entry *entryVariable = &(index)->entries[entryVariable##Index];                      \
+			 entryVariable && entryVariable->cell[0] == (cellCoordinates)[0]                                    \
+			 && entryVariable->cell[1] == (cellCoordinates)[1] && entryVariable->cell[2] == (cellCoordinates)[2]; \
+			 entryVariable = NULL)
+
+// Keeps the k closest candidates sorted by distance
+static void insertCandidate(mumble_userid_t *results, float *distances, size_t *found, size_t k,
+							mumble_userid_t userID, float distance) {
+	if (*found == k && distance >= distances[k - 1]) {
+		return;
+	}
+
+	size_t position = *found < k ? (*found)++ : k - 1;
+	while (position > 0 && distances[position - 1] > distance) {
+		results[position]   = results[position - 1];
+		distances[position] = distances[position - 1];
+		position--;
+	}
+	results[position]   = userID;
+	distances[position] = distance;
+}
+
+
+struct SpatialIndex *spatial_create(float cellSize) {
+	if (!(cellSize > 0.0f)) {
+		return NULL;
+	}
+
+	struct SpatialIndex *index = memory_alloc(MEMORY_SPATIAL, sizeof(struct SpatialIndex));
+	if (!index) {
+		return NULL;
+	}
+
+	index->cellSize = cellSize;
+	spatial_clear(index);
+
+	return index;
+}
+
+struct SpatialIndex *spatial_createInArena(struct MemoryArena *arena, float cellSize) {
+	if (!(cellSize > 0.0f)) {
+		return NULL;
+	}
+
+	struct SpatialIndex *index = memory_arenaAlloc(arena, sizeof(struct SpatialIndex));
+	if (!index) {
+		return NULL;
+	}
+
+	index->cellSize = cellSize;
+	spatial_clear(index);
+
+	return index;
+}
+
+void spatial_destroy(struct SpatialIndex *index) {
+	memory_free(index);
+}
+
+bool spatial_update(struct SpatialIndex *index, mumble_userid_t userID, const float position[3]) {
+	if (!isValidPosition(position)) {
+		return false;
+	}
+
+	int entryIndex = findEntry(index, userID);
+
+	if (entryIndex == NONE) {
+		if (index->freeCount == 0) {
+			return false;
+		}
+
+		entryIndex          = index->freeList[--index->freeCount];
+		struct Entry *entry = &index->entries[entryIndex];
+		entry->inUse        = true;
+		entry->userID       = userID;
+		memcpy(entry->position, position, sizeof(entry->position));
+		cellOf(index, position, entry->cell);
+		linkIntoCell(index, entryIndex);
+
+		uint32_t slot = hashUser(userID);
+		while (index->userTable[slot] != NONE) {
+			slot = (slot + 1) & (USER_TABLE_SIZE - 1);
+		}
+		index->userTable[slot] = entryIndex;
+		index->count++;
+
+		return true;
+	}
+
+	struct Entry *entry = &index->entries[entryIndex];
+	memcpy(entry->position, position, sizeof(entry->position));
+
+	int32_t cell[3];
+	cellOf(index, position, cell);
+	if (memcmp(cell, entry->cell, sizeof(cell)) != 0) {
+		unlinkFromCell(index, entryIndex);
+		memcpy(entry->cell, cell, sizeof(cell));
+		linkIntoCell(index, entryIndex);
+	}
+
+	return true;
+}
+
+bool spatial_updateFromData(struct SpatialIndex *index, mumble_userid_t userID, const uint8_t *data,
+							size_t dataLength) {
+	if (dataLength != SPATIAL_POSITION_DATA_SIZE) {
+		return false;
+	}
+
+	float position[3];
+	for (int i = 0; i < 3; i++) {
+		uint32_t bits = (uint32_t) data[4 * i] | ((uint32_t) data[4 * i + 1] << 8) | ((uint32_t) data[4 * i + 2] << 16)
+						| ((uint32_t) data[4 * i + 3] << 24);
+		memcpy(&position[i], &bits, sizeof(float));
+	}
+
+	return spatial_update(index, userID, position);
+}
+
+void spatial_encodePosition(const float position[3], uint8_t data[SPATIAL_POSITION_DATA_SIZE]) {
+	for (int i = 0; i < 3; i++) {
+		uint32_t bits;
+		memcpy(&bits, &position[i], sizeof(float));
+
+		data[4 * i]     = (uint8_t) bits;
+		data[4 * i + 1] = (uint8_t) (bits >> 8);
+		data[4 * i + 2] = (uint8_t) (bits >> 16);
+		data[4 * i + 3] = (uint8_t) (bits >> 24);
+	}
+}
+
+void spatial_remove(struct SpatialIndex *index, mumble_userid_t userID) {
+	int entryIndex = findEntry(index, userID);
+	if (entryIndex == NONE) {
+		return;
+	}
+
+	unlinkFromCell(index, entryIndex);
+	removeFromUserTable(index, userID);
+
+	index->entries[entryIndex].inUse    = false;
+	index->freeList[index->freeCount++] = entryIndex;
+	index->count--;
+}
+
+void spatial_clear(struct SpatialIndex *index) {
+	index->count     = 0;
+	index->freeCount = SPATIAL_MAX_USERS;
+	for (int i = 0; i < SPATIAL_MAX_USERS; i++) {
+		index->entries[i].inUse = false;
+		// Hand out low indices first
+		index->freeList[i] = SPATIAL_MAX_USERS - 1 - i;
+	}
+	for (size_t i = 0; i < USER_TABLE_SIZE; i++) {
+		index->userTable[i] = NONE;
+	}
+	for (size_t i = 0; i < CELL_BUCKET_COUNT; i++) {
+		index->cellBuckets[i] = NONE;
+	}
+}
+
+bool spatial_getPosition(const struct SpatialIndex *index, mumble_userid_t userID, float position[3]) {
+	int entryIndex = findEntry(index, userID);
+	if (entryIndex == NONE) {
+		return false;
+	}
+
+	memcpy(position, index->entries[entryIndex].position, 3 * sizeof(float));
+
+	return true;
+}
+
+size_t spatial_queryRadius(const struct SpatialIndex *index, const float center[3], float radius,
+						   mumble_userid_t *results, size_t maxResults) {
+	if (!isfinite(center[0]) || !isfinite(center[1]) || !isfinite(center[2]) || !isfinite(radius)
+		|| radius < 0.0f) {
+		return 0;
+	}
+
+	float radiusSquared = radius * radius;
+	size_t found        = 0;
+
+	int32_t low[3], high[3];
+	for (int i = 0; i < 3; i++) {
+		low[i]  = cellCoordinate(index, center[i] - radius);
+		high[i] = cellCoordinate(index, center[i] + radius);
+	}
+
+	double cellCount = (double) (high[0] - low[0] + 1) * (high[1] - low[1] + 1) * (high[2] - low[2] + 1);
+	if (cellCount > (double) index->count) {
+		// Visiting the cells would be more expensive than looking at every entry
+		for (size_t i = 0; i < SPATIAL_MAX_USERS; i++) {
+			const struct Entry *entry = &index->entries[i];
+			if (entry->inUse && distanceSquared(entry->position, center) <= radiusSquared) {
+				if (found < maxResults) {
+					results[found] = entry->userID;
+				}
+				found++;
+			}
+		}
+
+		return found;
+	}
+
+	int32_t cell[3];
+	for (cell[0] = low[0]; cell[0] <= high[0]; cell[0]++) {
+		for (cell[1] = low[1]; cell[1] <= high[1]; cell[1]++) {
+			for (cell[2] = low[2]; cell[2] <= high[2]; cell[2]++) {
+				FOR_EACH_IN_CELL(index, cell, entry) {
+					if (distanceSquared(entry->position, center) <= radiusSquared) {
+						if (found < maxResults) {
+							results[found] = entry->userID;
+						}
+						found++;
+					}
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+size_t spatial_queryNearest(const struct SpatialIndex *index, const float center[3], size_t k,
+							mumble_userid_t *results, float *distances) {
+	if (k == 0 || index->count == 0 || !isfinite(center[0]) || !isfinite(center[1]) || !isfinite(center[2])) {
+		return 0;
+	}
+
+	float localDistances[64];
+	float *candidateDistances = k <= 64 ? localDistances : memory_alloc(MEMORY_SPATIAL, k * sizeof(float));
+	if (!candidateDistances) {
+		return 0;
+	}
+
+	size_t found = 0;
+	size_t seen  = 0;
+
+	int32_t origin[3];
+	cellOf(index, center, origin);
+
+	// Search the grid in growing shells of cells around the query point. After shell r has been processed, every
+	// entry that hasn't been seen yet is at least r cells away. Very sparse data makes shells expensive, in which
+	// case all remaining entries are simply scanned.
+	for (int32_t r = 0; seen < index->count; r++) {
+		double outer      = 2.0 * r + 1.0;
+		double inner      = r == 0 ? 0.0 : 2.0 * r - 1.0;
+		double shellCells = outer * outer * outer - inner * inner * inner;
+		if (shellCells > (double) (index->count - seen) * 4.0) {
+			found = 0;
+			for (size_t i = 0; i < SPATIAL_MAX_USERS; i++) {
+				const struct Entry *entry = &index->entries[i];
+				if (entry->inUse) {
+					insertCandidate(results, candidateDistances, &found, k, entry->userID,
+									distanceSquared(entry->position, center));
+				}
+			}
+			break;
+		}
+
+		int32_t cell[3];
+		for (int32_t dx = -r; dx <= r; dx++) {
+			for (int32_t dy = -r; dy <= r; dy++) {
+				bool onShell = abs(dx) == r || abs(dy) == r;
+				// Within the shell's interior in x and y only the two z faces belong to the shell
+				int32_t dzStep = onShell || r == 0 ? 1 : 2 * r;
+				for (int32_t dz = -r; dz <= r; dz += dzStep) {
+					cell[0] = origin[0] + dx;
+					cell[1] = origin[1] + dy;
+					cell[2] = origin[2] + dz;
+
+					FOR_EACH_IN_CELL(index, cell, entry) {
+						seen++;
+						insertCandidate(results, candidateDistances, &found, k, entry->userID,
+										distanceSquared(entry->position, center));
+					}
+				}
+			}
+		}
+
+		float bound = (float) r * index->cellSize;
+		if (found == k && candidateDistances[k - 1] <= bound * bound) {
+			break;
+		}
+	}
+
+	if (distances) {
+		for (size_t i = 0; i < found; i++) {
+			distances[i] = sqrtf(candidateDistances[i]);
+		}
+	}
+
+	if (candidateDistances != localDistances) {
+		memory_free(candidateDistances);
+	}
+
+	return found;
+}
@@ -0,0 +1,85 @@
+/// This header file declares a spatial index over the positions of other users.
+///
+/// Positions are bucketed into a uniform grid (hashed, so the world doesn't need to be bounded) which allows radius and
+/// k-nearest queries to only look at the cells around the query point instead of at every user.
+///
+/// NOTE: The functions in this file are not thread-safe.
+
+#ifndef MUMBLE_PLUGIN_SPATIAL_H_
+#define MUMBLE_PLUGIN_SPATIAL_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The data ID other instances of this plugin publish their user's position with. The payload consists of three
+/// little endian 32 bit floats (x, y, z in meters).
+#define SPATIAL_POSITION_DATA_ID "hello_mumble:position"
+/// The size of a SPATIAL_POSITION_DATA_ID payload
+#define SPATIAL_POSITION_DATA_SIZE 12
+/// Positions with a coordinate whose magnitude exceeds this (in meters) are rejected
+#define SPATIAL_MAX_COORDINATE 1.0e6f
+/// The maximum amount of users that can be tracked at the same time
+#define SPATIAL_MAX_USERS 1024
+
+struct MemoryArena;
+struct SpatialIndex;
+
+/// @param cellSize The edge length of the grid's cells in meters. It should be in the order of the typical query
+/// radius.
+/// @returns A new, empty index or NULL if allocating it failed
+struct SpatialIndex *spatial_create(float cellSize);
+
+/// Creates an index in the given arena instead of on the heap. It is released along with the arena's other
+/// allocations and must not be passed to spatial_destroy.
+///
+/// @returns A new, empty index or NULL if the arena is exhausted
+struct SpatialIndex *spatial_createInArena(struct MemoryArena *arena, float cellSize);
+
+void spatial_destroy(struct SpatialIndex *index);
+
+/// Sets the position of the given user (inserting the user if necessary)
+///
+/// @returns Whether the position has been stored. This fails if SPATIAL_MAX_USERS users are tracked already or if
+/// a coordinate isn't finite or exceeds SPATIAL_MAX_COORDINATE.
+bool spatial_update(struct SpatialIndex *index, mumble_userid_t userID, const float position[3]);
+
+/// Parses a SPATIAL_POSITION_DATA_ID payload and stores the contained position for the given user
+///
+/// @returns Whether the payload was valid
+bool spatial_updateFromData(struct SpatialIndex *index, mumble_userid_t userID, const uint8_t *data,
+							size_t dataLength);
+
+/// Writes the given position as a SPATIAL_POSITION_DATA_ID payload
+void spatial_encodePosition(const float position[3], uint8_t data[SPATIAL_POSITION_DATA_SIZE]);
+
+void spatial_remove(struct SpatialIndex *index, mumble_userid_t userID);
+
+/// Removes all users
+void spatial_clear(struct SpatialIndex *index);
+
+/// @param[out] position The position of the given user
+/// @returns Whether a position is known for the given user
+bool spatial_getPosition(const struct SpatialIndex *index, mumble_userid_t userID, float position[3]);
+
+/// Finds all users within the given radius around the given point. A center or radius that isn't finite (or a
+/// negative radius) finds nobody.
+///
+/// @param[out] results The array the found users are written to (in no particular order)
+/// @param maxResults The capacity of the results array
+/// @returns The amount of found users. This may exceed maxResults, in which case only maxResults users have been
+/// written.
+size_t spatial_queryRadius(const struct SpatialIndex *index, const float center[3], float radius,
+						   mumble_userid_t *results, size_t maxResults);
+
+/// Finds the k users closest to the given point
+///
+/// @param[out] results The array the found users are written to (closest first). It has to hold at least k elements.
+/// @param[out] distances The array the distances of the found users are written to. May be NULL.
+/// @returns The amount of found users (less than k if less users are known, 0 if the center isn't finite)
+size_t spatial_queryNearest(const struct SpatialIndex *index, const float center[3], size_t k,
+							mumble_userid_t *results, float *distances);
+
+#endif // MUMBLE_PLUGIN_SPATIAL_H_
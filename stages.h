@@ -0,0 +1,46 @@
+/// This header file describes which of the plugin's optional stages are compiled in.
+///
+/// Mumble calls the audio callbacks for every frame (mumble_onAudioSourceFetched even once per audio source) as soon
+/// as a plugin exports them, no matter whether they end up doing anything. Every stage is therefore selected when the
+/// plugin is built (see the PLUGIN_SOUNDBOARD, PLUGIN_ACOUSTICS, PLUGIN_METERS and PLUGIN_POSITIONAL CMake options)
+/// and the callbacks of disabled stages aren't compiled in at all:
+///
+/// - PLUGIN_FEATURE_SOUNDBOARD: Mixing soundboard clips into the microphone input (mumble_onAudioInput)
+/// - PLUGIN_FEATURE_ACOUSTICS: Occlusion and reverb (mumble_onAudioSourceFetched and mumble_onAudioOutputAboutToPlay).
+///   Requires PLUGIN_FEATURE_POSITIONAL, as the listener is placed at the camera position reported by the game.
+/// - PLUGIN_FEATURE_METERS: Measuring the other users' levels and spectra for the control channel
+///   (mumble_onAudioSourceFetched)
+/// - PLUGIN_FEATURE_POSITIONAL: Positional data (mumble_initPositionalData, mumble_fetchPositionalData and
+///   mumble_shutdownPositionalData) and the recipient groups the local position is published to (see recipients.h)
+///
+/// The macros are always defined as either 0 or 1, so they may be used in regular conditions as well.
+
+#ifndef MUMBLE_PLUGIN_STAGES_H_
+#define MUMBLE_PLUGIN_STAGES_H_
+
+#ifndef PLUGIN_FEATURE_SOUNDBOARD
+#	define PLUGIN_FEATURE_SOUNDBOARD 1
+#endif
+
+#ifndef PLUGIN_FEATURE_ACOUSTICS
+#	define PLUGIN_FEATURE_ACOUSTICS 1
+#endif
+
+#ifndef PLUGIN_FEATURE_METERS
+#	define PLUGIN_FEATURE_METERS 1
+#endif
+
+#ifndef PLUGIN_FEATURE_POSITIONAL
+#	define PLUGIN_FEATURE_POSITIONAL 1
+#endif
+
+#if PLUGIN_FEATURE_ACOUSTICS && !PLUGIN_FEATURE_POSITIONAL
+#	error "PLUGIN_FEATURE_ACOUSTICS requires PLUGIN_FEATURE_POSITIONAL"
+#endif
+
+/// The Mumble_PluginFeature flags matching the compiled-in stages
+#define PLUGIN_MUMBLE_FEATURES                                                                                   \
+	((PLUGIN_FEATURE_SOUNDBOARD || PLUGIN_FEATURE_ACOUSTICS || PLUGIN_FEATURE_METERS ? MUMBLE_FEATURE_AUDIO : 0) \
+	 | (PLUGIN_FEATURE_POSITIONAL ? MUMBLE_FEATURE_POSITIONAL : 0))
+
+#endif // MUMBLE_PLUGIN_STAGES_H_
@@ -0,0 +1,222 @@
+// Writes level geometry with acoustics_writeGeometry and loads it into the engine: a wall between the listener and a
+// speaker has to occlude that speaker while one in the open stays untouched. Geometry files with broken headers and
+// node references have to be rejected by the loader rather than being traversed.
+//
+// The module is included rather than linked so that the test can take the written nodes apart.
+
+#include "acoustics.c"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FRAME_SIZE 480
+#define SAMPLE_RATE 48000
+#define OCCLUDED_USER 1
+#define OPEN_USER 2
+// How long the worker gets to cast its first rays
+#define WORKER_TIMEOUT_MS 2000
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+static char geometryPath[64];
+
+// A wall at x = 5 between the listener (at the origin) and a speaker at x = 10, plus a floor and a ceiling far away so
+// that the BVH consists of more than a single leaf
+static const struct AcousticTriangle level[] = {
+	{ { { 5, -10, -10 }, { 5, 10, -10 }, { 5, 10, 10 } } },
+	{ { { 5, -10, -10 }, { 5, 10, 10 }, { 5, -10, 10 } } },
+	{ { { -30, -20, -30 }, { 30, -20, -30 }, { 30, -20, 30 } } },
+	{ { { -30, -20, -30 }, { 30, -20, 30 }, { -30, -20, 30 } } },
+	{ { { -30, 20, -30 }, { 30, 20, -30 }, { 30, 20, 30 } } },
+	{ { { -30, 20, -30 }, { 30, 20, 30 }, { -30, 20, 30 } } },
+};
+
+static bool writeFile(const char *path, const void *data, size_t size) {
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+
+	bool written = size == 0 || fwrite(data, size, 1, file) == 1;
+
+	return fclose(file) == 0 && written;
+}
+
+static bool loads(const void *data, size_t size) {
+	if (!writeFile(geometryPath, data, size)) {
+		return false;
+	}
+
+	struct Acoustics *acoustics = acoustics_create(geometryPath);
+	acoustics_destroy(acoustics);
+
+	return acoustics != NULL;
+}
+
+// Plays a constant signal from the given user and returns the last sample that comes out
+static float playConstant(struct Acoustics *acoustics, mumble_userid_t userID, struct MemoryArena *arena,
+						  bool *processed) {
+	static const struct AcousticsDistanceModel distanceModel = { 1.0f, 15.0f, 0.5f, 0.1f };
+
+	float pcm[FRAME_SIZE];
+	for (size_t i = 0; i < FRAME_SIZE; i++) {
+		pcm[i] = 1.0f;
+	}
+
+	*processed = acoustics_processSource(acoustics, pcm, FRAME_SIZE, 1, SAMPLE_RATE, userID, &distanceModel, arena);
+	acoustics_discardReverb(acoustics);
+	memory_arenaReset(arena);
+
+	return pcm[FRAME_SIZE - 1];
+}
+
+static bool testOcclusion() {
+	CHECK(acoustics_writeGeometry(geometryPath, level, sizeof(level) / sizeof(level[0])));
+
+	struct Acoustics *acoustics = acoustics_create(geometryPath);
+	struct MemoryArena *arena   = memory_createArena(MEMORY_ACOUSTICS, 64 * 1024);
+	CHECK(acoustics);
+	CHECK(arena);
+
+	static const float listener[3]   = { 0, 0, 0 };
+	static const float behindWall[3] = { 10, 0, 0 };
+	static const float inTheOpen[3]  = { -10, 0, 0 };
+	acoustics_setListener(acoustics, listener);
+	acoustics_setSpeaker(acoustics, OCCLUDED_USER, behindWall);
+	acoustics_setSpeaker(acoustics, OPEN_USER, inTheOpen);
+
+	// Nothing is processed until the worker has cast the rays to both speakers
+	bool occludedProcessed = false;
+	bool openProcessed     = false;
+	for (int waited = 0; waited < WORKER_TIMEOUT_MS && !(occludedProcessed && openProcessed); waited += 10) {
+		usleep(10 * 1000);
+		playConstant(acoustics, OCCLUDED_USER, arena, &occludedProcessed);
+		playConstant(acoustics, OPEN_USER, arena, &openProcessed);
+	}
+
+	// The low-pass filter settles within a frame, so the last sample is the speaker's gain
+	float occluded = playConstant(acoustics, OCCLUDED_USER, arena, &occludedProcessed);
+	float open     = playConstant(acoustics, OPEN_USER, arena, &openProcessed);
+
+	// Without a listener, nothing is processed anymore
+	acoustics_clearListener(acoustics);
+	bool cleared;
+	playConstant(acoustics, OPEN_USER, arena, &cleared);
+
+	memory_destroyArena(arena);
+	acoustics_destroy(acoustics);
+
+	CHECK(occludedProcessed);
+	CHECK(openProcessed);
+	CHECK(fabsf(occluded - OCCLUDED_GAIN) < 0.01f);
+	CHECK(fabsf(open - 1.0f) < 0.01f);
+	CHECK(!cleared);
+
+	return true;
+}
+
+static bool testMalformedGeometry() {
+	// Nothing to build a BVH from
+	CHECK(!acoustics_writeGeometry(geometryPath, level, 0));
+
+	CHECK(acoustics_writeGeometry(geometryPath, level, sizeof(level) / sizeof(level[0])));
+	FILE *file = fopen(geometryPath, "rb");
+	CHECK(file);
+	alignas(struct Node) static uint8_t valid[4096];
+	size_t size = fread(valid, 1, sizeof(valid), file);
+	fclose(file);
+
+	uint32_t header[4];
+	memcpy(header, valid, sizeof(header));
+	// The root has to be an inner node followed by its left child for the node references to be tampered with
+	struct Node nodes[3];
+	CHECK(header[2] == 3 && header[3] == sizeof(level) / sizeof(level[0]));
+	CHECK(size == GEOMETRY_HEADER_SIZE + sizeof(nodes) + sizeof(level));
+	memcpy(nodes, valid + GEOMETRY_HEADER_SIZE, sizeof(nodes));
+	CHECK(nodes[0].triangleCount == 0 && nodes[1].triangleCount > 0);
+
+	CHECK(loads(valid, size));
+
+	alignas(struct Node) static uint8_t broken[sizeof(valid)];
+	uint32_t *brokenHeader   = (uint32_t *) broken;
+	struct Node *brokenNodes = (struct Node *) (broken + GEOMETRY_HEADER_SIZE);
+
+	// Empty, shorter than the header and truncated files
+	CHECK(!loads(valid, 0));
+	CHECK(!loads(valid, GEOMETRY_HEADER_SIZE / 2));
+	CHECK(!loads(valid, size - 1));
+
+	// Headers
+	const uint32_t headers[][4] = {
+		{ GEOMETRY_MAGIC ^ 1, header[1], header[2], header[3] },
+		{ header[0], GEOMETRY_VERSION + 1, header[2], header[3] },
+		{ header[0], header[1], 0, header[3] },
+		{ header[0], header[1], header[2] + 1, header[3] },
+		{ header[0], header[1], header[2], header[3] + 1 },
+		{ header[0], header[1], UINT32_MAX, UINT32_MAX },
+	};
+	for (size_t i = 0; i < sizeof(headers) / sizeof(headers[0]); i++) {
+		memcpy(broken, valid, size);
+		memcpy(brokenHeader, headers[i], sizeof(headers[i]));
+		if (loads(broken, size)) {
+			fprintf(stderr, "Header %zu has been accepted\n", i);
+			return false;
+		}
+	}
+
+	// Inner nodes whose right child isn't behind their left one (which would loop) or doesn't exist
+	const uint32_t rightChildren[] = { 0, 1, header[2], UINT32_MAX };
+	for (size_t i = 0; i < sizeof(rightChildren) / sizeof(rightChildren[0]); i++) {
+		memcpy(broken, valid, size);
+		brokenNodes[0].rightOrFirst = rightChildren[i];
+		if (loads(broken, size)) {
+			fprintf(stderr, "Right child %u has been accepted\n", rightChildren[i]);
+			return false;
+		}
+	}
+
+	// Leaves whose triangles lie (partly) beyond the end of the file
+	const uint32_t leaves[][2] = { { header[3] - 1, 2 }, { header[3], 1 }, { UINT32_MAX, 1 }, { 0, UINT32_MAX } };
+	for (size_t i = 0; i < sizeof(leaves) / sizeof(leaves[0]); i++) {
+		memcpy(broken, valid, size);
+		brokenNodes[1].rightOrFirst  = leaves[i][0];
+		brokenNodes[1].triangleCount = leaves[i][1];
+		if (loads(broken, size)) {
+			fprintf(stderr, "Leaf %zu has been accepted\n", i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main() {
+	snprintf(geometryPath, sizeof(geometryPath), "/tmp/hello_mumble-acoustics-test-%d.bvh", (int) getpid());
+
+	bool (*tests[])() = { &testOcclusion, &testMalformedGeometry };
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		passed = tests[i]() && passed;
+	}
+	unlink(geometryPath);
+
+	struct MemoryUsage usage[MEMORY_SUBSYSTEM_COUNT];
+	memory_getUsage(usage);
+	if (usage[MEMORY_ACOUSTICS].blocks != 0) {
+		fprintf(stderr, "Leaked %zu blocks\n", usage[MEMORY_ACOUSTICS].blocks);
+		passed = false;
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
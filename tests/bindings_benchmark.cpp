@@ -0,0 +1,245 @@
+// Measures the overhead of the C++ bindings (MumblePlugin_v_1_0_x.hpp) over calling the C API directly. Both go through
+// the same stand-in API struct, whose functions do as little as possible so that only the calls themselves (and what
+// the bindings add around them) are measured. Every pair of loops also has to produce the same results and hand back
+// every allocation through freeMemory.
+//
+// Usage: bindings_benchmark [ITERATIONS]
+
+#include "MumblePlugin_v_1_0_x.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+static const mumble_userid_t users[] = { 3, 5, 8, 13, 21, 34, 55, 89 };
+static const char userName[]          = "Benchmark User";
+
+// The amount of allocations that haven't been handed back
+static long outstanding;
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION freeMemory(mumble_plugin_id_t callerID, const void *pointer) {
+	(void) callerID;
+	(void) pointer;
+
+	outstanding--;
+
+	return MUMBLE_STATUS_OK;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION getLocalUserID(mumble_plugin_id_t callerID,
+															   mumble_connection_t connection,
+															   mumble_userid_t *userID) {
+	(void) callerID;
+
+	*userID = (mumble_userid_t) connection;
+
+	return MUMBLE_STATUS_OK;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION getUserName(mumble_plugin_id_t callerID,
+															mumble_connection_t connection, mumble_userid_t userID,
+															const char **name) {
+	(void) callerID;
+	(void) connection;
+	(void) userID;
+
+	outstanding++;
+	*name = userName;
+
+	return MUMBLE_STATUS_OK;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION getAllUsers(mumble_plugin_id_t callerID,
+															mumble_connection_t connection, mumble_userid_t **result,
+															size_t *userCount) {
+	(void) callerID;
+	(void) connection;
+
+	outstanding++;
+	*result    = const_cast< mumble_userid_t * >(users);
+	*userCount = sizeof(users) / sizeof(users[0]);
+
+	return MUMBLE_STATUS_OK;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION sendData(mumble_plugin_id_t callerID, mumble_connection_t connection,
+														 const mumble_userid_t *recipients, size_t userCount,
+														 const uint8_t *data, size_t dataLength,
+														 const char *dataID) {
+	(void) callerID;
+	(void) connection;
+	(void) recipients;
+	(void) dataID;
+
+	return userCount > 0 && data && dataLength > 0 ? MUMBLE_STATUS_OK : MUMBLE_EC_INVALID_PLUGIN_ID;
+}
+
+static MumbleAPI_v_1_0_x api;
+// Read through a volatile pointer so that the compiler can't resolve the calls at compile time in either loop
+static const MumbleAPI_v_1_0_x *volatile apiPointer = &api;
+
+static unsigned long iterations = 10000000;
+
+template< typename Function > static double measure(const char *name, Function function, uint64_t &sum) {
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned long i = 0; i < iterations; i++) {
+		sum += function(i);
+	}
+	std::chrono::duration< double, std::nano > elapsed = std::chrono::steady_clock::now() - start;
+
+	double perCall = elapsed.count() / (double) iterations;
+	printf("%-24s %8.2f ns/call\n", name, perCall);
+
+	return perCall;
+}
+
+static bool benchmarkGetter() {
+	const MumbleAPI_v_1_0_x &raw = *apiPointer;
+	mumble::API wrapped(*apiPointer, 1);
+
+	uint64_t rawSum = 0, wrappedSum = 0;
+	measure(
+		"getLocalUserID (C)",
+		[&](unsigned long i) {
+			mumble_userid_t userID;
+			return raw.getLocalUserID(1, (mumble_connection_t) i, &userID) == MUMBLE_STATUS_OK ? userID : 0;
+		},
+		rawSum);
+	measure(
+		"getLocalUserID (C++)",
+		[&](unsigned long i) { return wrapped.getLocalUserID((mumble_connection_t) i).valueOr(0); }, wrappedSum);
+
+	CHECK(rawSum == wrappedSum);
+
+	return true;
+}
+
+static bool benchmarkString() {
+	const MumbleAPI_v_1_0_x &raw = *apiPointer;
+	mumble::API wrapped(*apiPointer, 1);
+
+	uint64_t rawSum = 0, wrappedSum = 0;
+	measure(
+		"getUserName (C)",
+		[&](unsigned long i) {
+			const char *name;
+			if (raw.getUserName(1, 1, (mumble_userid_t) i, &name) != MUMBLE_STATUS_OK) {
+				return (size_t) 0;
+			}
+			size_t length = strlen(name);
+			raw.freeMemory(1, name);
+			return length;
+		},
+		rawSum);
+	measure(
+		"getUserName (C++)",
+		[&](unsigned long i) {
+			auto name = wrapped.getUserName(1, (mumble_userid_t) i);
+			return name ? name->view().size() : 0;
+		},
+		wrappedSum);
+
+	CHECK(rawSum == wrappedSum);
+	CHECK(outstanding == 0);
+
+	return true;
+}
+
+static bool benchmarkArray() {
+	const MumbleAPI_v_1_0_x &raw = *apiPointer;
+	mumble::API wrapped(*apiPointer, 1);
+
+	uint64_t rawSum = 0, wrappedSum = 0;
+	measure(
+		"getAllUsers (C)",
+		[&](unsigned long) {
+			mumble_userid_t *result;
+			size_t count;
+			if (raw.getAllUsers(1, 1, &result, &count) != MUMBLE_STATUS_OK) {
+				return (uint64_t) 0;
+			}
+			uint64_t sum = 0;
+			for (size_t i = 0; i < count; i++) {
+				sum += result[i];
+			}
+			raw.freeMemory(1, result);
+			return sum;
+		},
+		rawSum);
+	measure(
+		"getAllUsers (C++)",
+		[&](unsigned long) {
+			uint64_t sum = 0;
+			if (auto result = wrapped.getAllUsers(1)) {
+				for (mumble_userid_t userID : *result) {
+					sum += userID;
+				}
+			}
+			return sum;
+		},
+		wrappedSum);
+
+	CHECK(rawSum == wrappedSum);
+	CHECK(outstanding == 0);
+
+	return true;
+}
+
+static bool benchmarkSendData() {
+	const MumbleAPI_v_1_0_x &raw = *apiPointer;
+	mumble::API wrapped(*apiPointer, 1);
+
+	const uint8_t data[12] = { 0 };
+	const size_t userCount = sizeof(users) / sizeof(users[0]);
+
+	uint64_t rawSum = 0, wrappedSum = 0;
+	measure(
+		"sendData (C)",
+		[&](unsigned long) {
+			return raw.sendData(1, 1, users, userCount, data, sizeof(data), "benchmark") == MUMBLE_STATUS_OK;
+		},
+		rawSum);
+	measure(
+		"sendData (C++)",
+		[&](unsigned long) {
+			return wrapped.sendData(1, mumble::Span< const mumble_userid_t >(users, userCount),
+									mumble::Span< const uint8_t >(data, sizeof(data)), "benchmark")
+				   == MUMBLE_STATUS_OK;
+		},
+		wrappedSum);
+
+	CHECK(rawSum == iterations);
+	CHECK(rawSum == wrappedSum);
+
+	return true;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1) {
+		iterations = strtoul(argv[1], NULL, 10);
+	}
+
+	api.freeMemory     = &freeMemory;
+	api.getLocalUserID = &getLocalUserID;
+	api.getUserName    = &getUserName;
+	api.getAllUsers    = &getAllUsers;
+	api.sendData       = &sendData;
+
+	bool (*benchmarks[])() = { &benchmarkGetter, &benchmarkString, &benchmarkArray, &benchmarkSendData };
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+		passed = benchmarks[i]() && passed;
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
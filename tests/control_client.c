@@ -0,0 +1,499 @@
+// A command line client for the plugin's control channel (see control.h). Besides sending single requests, it can
+// load-test the channel: several connections keep a window of pings in flight while following all state deltas, and
+// every reply is checked against the request it belongs to.
+//
+//     control_client SOCKET ping
+//     control_client SOCKET mute 0|1
+//     control_client SOCKET soundboard CLIP
+//     control_client SOCKET move CONNECTION USER CHANNEL_ID [CHANNEL_NAME]
+//     control_client SOCKET watch SECONDS
+//     control_client SOCKET search PHRASE [FROM_MS TO_MS]
+//     control_client SOCKET load CONNECTIONS REQUESTS
+//
+// The exit status is non-zero if a request failed or, when load-testing, if any reply was missing or didn't match.
+
+#include "control.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// The type and the sequence number following a frame's length
+#define FRAME_HEADER_SIZE 5
+// The amount of pings every connection keeps in flight when load-testing
+#define LOAD_WINDOW 32
+#define LOAD_PAYLOAD_SIZE 16
+#define LOAD_TIMEOUT_MS 60000
+#define REPLY_TIMEOUT_MS 5000
+
+struct Connection {
+	int fd;
+	uint8_t input[4 + CONTROL_MAX_FRAME];
+	size_t received;
+
+	// Load-testing: the next sequence number to send and the next one a pong is expected for
+	uint32_t nextSent;
+	uint32_t nextExpected;
+	uint64_t *sentAtNs;
+};
+
+struct LoadStatistics {
+	uint64_t *latenciesNs;
+	size_t latencyCount;
+	size_t userEvents;
+	bool mismatched;
+};
+
+static uint64_t timeNs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+static void putU32(uint8_t *data, uint32_t value) {
+	data[0] = (uint8_t) value;
+	data[1] = (uint8_t) (value >> 8);
+	data[2] = (uint8_t) (value >> 16);
+	data[3] = (uint8_t) (value >> 24);
+}
+
+static uint32_t getU32(const uint8_t *data) {
+	return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static void putU64(uint8_t *data, uint64_t value) {
+	putU32(data, (uint32_t) value);
+	putU32(data + 4, (uint32_t) (value >> 32));
+}
+
+static uint64_t getU64(const uint8_t *data) {
+	return (uint64_t) getU32(data) | ((uint64_t) getU32(data + 4) << 32);
+}
+
+static bool connectTo(struct Connection *connection, const char *path) {
+	memset(connection, 0, sizeof(*connection));
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "The socket path is too long\n");
+		return false;
+	}
+	strcpy(address.sun_path, path);
+
+	connection->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connection->fd < 0 || connect(connection->fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+		perror("connect");
+		if (connection->fd >= 0) {
+			close(connection->fd);
+		}
+		connection->fd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+static bool sendFrame(struct Connection *connection, uint8_t type, uint32_t sequence, const uint8_t *payload,
+					  size_t payloadSize) {
+	uint8_t frame[4 + CONTROL_MAX_FRAME];
+	if (FRAME_HEADER_SIZE + payloadSize > CONTROL_MAX_FRAME) {
+		fprintf(stderr, "The request is too big\n");
+		return false;
+	}
+
+	putU32(frame, (uint32_t) (FRAME_HEADER_SIZE + payloadSize));
+	frame[4] = type;
+	putU32(frame + 5, sequence);
+	if (payloadSize > 0) {
+		memcpy(frame + 4 + FRAME_HEADER_SIZE, payload, payloadSize);
+	}
+
+	size_t size = 4 + FRAME_HEADER_SIZE + payloadSize;
+	for (size_t sent = 0; sent < size;) {
+		ssize_t count = send(connection->fd, frame + sent, size - sent, MSG_NOSIGNAL);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("send");
+			return false;
+		}
+		sent += (size_t) count;
+	}
+
+	return true;
+}
+
+// Reads whatever is available and hands every complete frame to the given function. Returns false if the connection
+// has been closed or broke.
+static bool receiveFrames(struct Connection *connection,
+						  void (*handle)(struct Connection *, uint8_t, uint32_t, const uint8_t *, size_t, void *),
+						  void *userData) {
+	ssize_t count = recv(connection->fd, connection->input + connection->received,
+						 sizeof(connection->input) - connection->received, 0);
+	if (count <= 0) {
+		if (count < 0 && errno == EINTR) {
+			return true;
+		}
+		return false;
+	}
+	connection->received += (size_t) count;
+
+	size_t consumed = 0;
+	while (connection->received - consumed >= 4) {
+		const uint8_t *frame = connection->input + consumed;
+		uint32_t length      = getU32(frame);
+		if (length < FRAME_HEADER_SIZE || length > CONTROL_MAX_FRAME) {
+			fprintf(stderr, "Received a malformed frame\n");
+			return false;
+		}
+		if (connection->received - consumed < 4 + (size_t) length) {
+			break;
+		}
+
+		handle(connection, frame[4], getU32(frame + 5), frame + 4 + FRAME_HEADER_SIZE, length - FRAME_HEADER_SIZE,
+			   userData);
+		consumed += 4 + (size_t) length;
+	}
+
+	memmove(connection->input, connection->input + consumed, connection->received - consumed);
+	connection->received -= consumed;
+
+	return true;
+}
+
+static void printUser(const uint8_t *payload, size_t size) {
+	if (size < 9) {
+		return;
+	}
+
+	printf("connection %d, user %u:", (int32_t) getU32(payload), getU32(payload + 4));
+	uint8_t changes = payload[8];
+	size_t offset   = 9;
+	if (changes & CONTROL_USER_REMOVED) {
+		printf(" removed");
+	}
+	if ((changes & CONTROL_TOPIC_TALKING) && offset + 4 <= size) {
+		printf(" talking state %d", (int32_t) getU32(payload + offset));
+		offset += 4;
+	}
+	if ((changes & CONTROL_TOPIC_CHANNEL) && offset + 4 <= size) {
+		printf(" channel %d", (int32_t) getU32(payload + offset));
+		offset += 4;
+	}
+	if ((changes & CONTROL_TOPIC_POSITION) && offset + 12 <= size) {
+		float position[3];
+		for (int i = 0; i < 3; i++) {
+			uint32_t bits = getU32(payload + offset + 4 * (size_t) i);
+			memcpy(&position[i], &bits, sizeof(float));
+		}
+		printf(" position (%.2f, %.2f, %.2f)", position[0], position[1], position[2]);
+	}
+	printf("\n");
+}
+
+static void printHit(const uint8_t *payload, size_t size) {
+	if (size < 25) {
+		return;
+	}
+
+	printf("document %llu at %llu ms (%s) by user %u in channel %d: %.*s\n", (unsigned long long) getU64(payload),
+		   (unsigned long long) getU64(payload + 8), payload[16] == 0 ? "transcript" : "event", getU32(payload + 17),
+		   (int32_t) getU32(payload + 21), (int) (size - 25), (const char *) payload + 25);
+}
+
+// Single requests
+
+struct Exchange {
+	uint32_t sequence;
+	bool done;
+	int32_t status;
+	uint64_t sentAtNs;
+};
+
+static void handleExchange(struct Connection *connection, uint8_t type, uint32_t sequence, const uint8_t *payload,
+						   size_t size, void *userData) {
+	(void) connection;
+	struct Exchange *exchange = userData;
+
+	if (type == CONTROL_EVENT_USER) {
+		printUser(payload, size);
+	}
+	if (sequence != exchange->sequence) {
+		return;
+	}
+
+	if (type == CONTROL_EVENT_HIT) {
+		printHit(payload, size);
+	} else if (type == CONTROL_EVENT_PONG) {
+		printf("pong after %.3f ms\n", (double) (timeNs() - exchange->sentAtNs) / 1e6);
+		exchange->done   = true;
+		exchange->status = 0;
+	} else if (type == CONTROL_EVENT_REPLY && size >= 4) {
+		exchange->done   = true;
+		exchange->status = (int32_t) getU32(payload);
+	}
+}
+
+// Sends a single request and waits for its reply (or, if duration is given, keeps printing events for that long)
+static int sendRequest(const char *path, uint8_t type, const uint8_t *payload, size_t size, uint64_t durationMs) {
+	struct Connection connection;
+	if (!connectTo(&connection, path)) {
+		return EXIT_FAILURE;
+	}
+
+	struct Exchange exchange = { .sequence = 1, .sentAtNs = timeNs() };
+	if (!sendFrame(&connection, type, exchange.sequence, payload, size)) {
+		close(connection.fd);
+		return EXIT_FAILURE;
+	}
+
+	uint64_t timeoutMs = durationMs > 0 ? durationMs : REPLY_TIMEOUT_MS;
+	while ((!exchange.done || durationMs > 0) && (timeNs() - exchange.sentAtNs) / 1000000 < timeoutMs) {
+		struct pollfd descriptor = { .fd = connection.fd, .events = POLLIN };
+		if (poll(&descriptor, 1, 100) > 0 && !receiveFrames(&connection, &handleExchange, &exchange)) {
+			fprintf(stderr, "The connection has been closed\n");
+			break;
+		}
+	}
+	close(connection.fd);
+
+	if (!exchange.done) {
+		fprintf(stderr, "No reply\n");
+		return EXIT_FAILURE;
+	}
+	if (exchange.status != 0) {
+		fprintf(stderr, "The request failed with status %d\n", exchange.status);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+// Load-testing
+
+static void handleLoad(struct Connection *connection, uint8_t type, uint32_t sequence, const uint8_t *payload,
+					   size_t size, void *userData) {
+	struct LoadStatistics *statistics = userData;
+
+	switch (type) {
+		case CONTROL_EVENT_USER:
+			statistics->userEvents++;
+			return;
+		case CONTROL_EVENT_REPLY:
+			// The reply to the subscription (sequence number 0 is never used for requests)
+			if (size < 4 || getU32(payload) != 0) {
+				statistics->mismatched = true;
+			}
+			return;
+		case CONTROL_EVENT_PONG: {
+			// Replies have to arrive in order and echo the payload that has been sent
+			uint8_t expected[LOAD_PAYLOAD_SIZE];
+			memset(expected, (int) (sequence & 0xFF), sizeof(expected));
+			putU32(expected, sequence);
+			if (sequence != connection->nextExpected || size != LOAD_PAYLOAD_SIZE
+				|| memcmp(payload, expected, size) != 0) {
+				statistics->mismatched = true;
+				return;
+			}
+
+			statistics->latenciesNs[statistics->latencyCount++] = timeNs() - connection->sentAtNs[sequence - 1];
+			connection->nextExpected++;
+			return;
+		}
+		default:
+			return;
+	}
+}
+
+static int compareLatencies(const void *a, const void *b) {
+	uint64_t left  = *(const uint64_t *) a;
+	uint64_t right = *(const uint64_t *) b;
+
+	return left < right ? -1 : left > right;
+}
+
+static int load(const char *path, size_t connectionCount, uint32_t requestCount) {
+	struct Connection *connections = calloc(connectionCount, sizeof(struct Connection));
+	struct LoadStatistics statistics;
+	memset(&statistics, 0, sizeof(statistics));
+	statistics.latenciesNs = calloc(connectionCount * requestCount, sizeof(uint64_t));
+	if (!connections || !statistics.latenciesNs) {
+		free(connections);
+		free(statistics.latenciesNs);
+		fprintf(stderr, "Out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	bool failed = false;
+	size_t open = 0;
+	for (; open < connectionCount && !failed; open++) {
+		failed = !connectTo(&connections[open], path);
+		if (!failed) {
+			connections[open].nextSent     = 1;
+			connections[open].nextExpected = 1;
+			connections[open].sentAtNs     = calloc(requestCount, sizeof(uint64_t));
+			failed                         = !connections[open].sentAtNs;
+		}
+
+		// Follow all state changes while pinging, like a companion app would
+		uint8_t topics[4];
+		putU32(topics, CONTROL_TOPIC_TALKING | CONTROL_TOPIC_CHANNEL | CONTROL_TOPIC_POSITION);
+		failed = failed || !sendFrame(&connections[open], CONTROL_REQUEST_SUBSCRIBE, 0, topics, sizeof(topics));
+	}
+
+	struct pollfd *descriptors = calloc(connectionCount, sizeof(struct pollfd));
+	failed                     = failed || !descriptors;
+
+	uint64_t start = timeNs();
+	while (!failed && !statistics.mismatched && statistics.latencyCount < connectionCount * requestCount) {
+		if ((timeNs() - start) / 1000000 > LOAD_TIMEOUT_MS) {
+			fprintf(stderr, "Timed out\n");
+			failed = true;
+			break;
+		}
+
+		for (size_t i = 0; i < connectionCount && !failed; i++) {
+			struct Connection *connection = &connections[i];
+			while (connection->nextSent <= requestCount
+				   && connection->nextSent - connection->nextExpected < LOAD_WINDOW) {
+				uint8_t payload[LOAD_PAYLOAD_SIZE];
+				memset(payload, (int) (connection->nextSent & 0xFF), sizeof(payload));
+				putU32(payload, connection->nextSent);
+
+				connection->sentAtNs[connection->nextSent - 1] = timeNs();
+				if (!sendFrame(connection, CONTROL_REQUEST_PING, connection->nextSent, payload, sizeof(payload))) {
+					failed = true;
+					break;
+				}
+				connection->nextSent++;
+			}
+
+			descriptors[i].fd     = connection->fd;
+			descriptors[i].events = POLLIN;
+		}
+
+		if (failed || poll(descriptors, connectionCount, 100) < 0) {
+			break;
+		}
+		for (size_t i = 0; i < connectionCount; i++) {
+			if ((descriptors[i].revents & (POLLIN | POLLHUP | POLLERR))
+				&& !receiveFrames(&connections[i], &handleLoad, &statistics)) {
+				fprintf(stderr, "Connection %zu has been closed\n", i);
+				failed = true;
+			}
+		}
+	}
+	double seconds = (double) (timeNs() - start) / 1e9;
+
+	size_t answered = statistics.latencyCount;
+	if (answered > 0) {
+		qsort(statistics.latenciesNs, answered, sizeof(uint64_t), &compareLatencies);
+		printf("%zu requests over %zu connections in %.3f s (%.0f requests/s)\n", answered, connectionCount, seconds,
+			   (double) answered / seconds);
+		printf("latency: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", (double) statistics.latenciesNs[answered / 2] / 1e6,
+			   (double) statistics.latenciesNs[answered * 99 / 100] / 1e6,
+			   (double) statistics.latenciesNs[answered - 1] / 1e6);
+		printf("%zu user events received\n", statistics.userEvents);
+	}
+	if (statistics.mismatched) {
+		fprintf(stderr, "A reply didn't match its request\n");
+	}
+
+	for (size_t i = 0; i < open; i++) {
+		if (connections[i].fd >= 0) {
+			close(connections[i].fd);
+		}
+		free(connections[i].sentAtNs);
+	}
+	free(connections);
+	free(descriptors);
+	free(statistics.latenciesNs);
+
+	return failed || statistics.mismatched ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int usage(const char *program) {
+	fprintf(stderr,
+			"Usage: %s SOCKET ping\n"
+			"       %s SOCKET mute 0|1\n"
+			"       %s SOCKET soundboard CLIP\n"
+			"       %s SOCKET move CONNECTION USER CHANNEL_ID [CHANNEL_NAME]\n"
+			"       %s SOCKET watch SECONDS\n"
+			"       %s SOCKET search PHRASE [FROM_MS TO_MS]\n"
+			"       %s SOCKET load CONNECTIONS REQUESTS\n",
+			program, program, program, program, program, program, program);
+
+	return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		return usage(argv[0]);
+	}
+
+	const char *path    = argv[1];
+	const char *command = argv[2];
+	uint8_t payload[CONTROL_MAX_FRAME];
+
+	if (strcmp(command, "ping") == 0 && argc == 3) {
+		return sendRequest(path, CONTROL_REQUEST_PING, NULL, 0, 0);
+	}
+	if (strcmp(command, "mute") == 0 && argc == 4) {
+		payload[0] = (uint8_t) (atoi(argv[3]) != 0);
+		return sendRequest(path, CONTROL_REQUEST_SELF_MUTE, payload, 1, 0);
+	}
+	if (strcmp(command, "soundboard") == 0 && argc == 4) {
+		size_t length = strlen(argv[3]);
+		if (length > sizeof(payload)) {
+			return usage(argv[0]);
+		}
+		memcpy(payload, argv[3], length);
+		return sendRequest(path, CONTROL_REQUEST_SOUNDBOARD, payload, length, 0);
+	}
+	if (strcmp(command, "move") == 0 && (argc == 6 || argc == 7)) {
+		putU32(payload, (uint32_t) atoi(argv[3]));
+		putU32(payload + 4, (uint32_t) strtoul(argv[4], NULL, 10));
+		putU32(payload + 8, (uint32_t) atoi(argv[5]));
+		size_t length = argc == 7 ? strlen(argv[6]) : 0;
+		if (length > sizeof(payload) - 12) {
+			return usage(argv[0]);
+		}
+		memcpy(payload + 12, argc == 7 ? argv[6] : "", length);
+		return sendRequest(path, CONTROL_REQUEST_MOVE_USER, payload, 12 + length, 0);
+	}
+	if (strcmp(command, "watch") == 0 && argc == 4) {
+		putU32(payload, CONTROL_TOPIC_TALKING | CONTROL_TOPIC_CHANNEL | CONTROL_TOPIC_POSITION);
+		return sendRequest(path, CONTROL_REQUEST_SUBSCRIBE, payload, 4, strtoull(argv[3], NULL, 10) * 1000);
+	}
+	if (strcmp(command, "search") == 0 && (argc == 4 || argc == 6)) {
+		putU64(payload, argc == 6 ? strtoull(argv[4], NULL, 10) : 0);
+		putU64(payload + 8, argc == 6 ? strtoull(argv[5], NULL, 10) : UINT64_MAX);
+		payload[16]   = CONTROL_MAX_HITS;
+		size_t length = strlen(argv[3]);
+		if (length > sizeof(payload) - 17) {
+			return usage(argv[0]);
+		}
+		memcpy(payload + 17, argv[3], length);
+		return sendRequest(path, CONTROL_REQUEST_SEARCH, payload, 17 + length, 0);
+	}
+	if (strcmp(command, "load") == 0 && argc == 5) {
+		long connectionCount = atol(argv[3]);
+		long requestCount    = atol(argv[4]);
+		if (connectionCount < 1 || connectionCount > CONTROL_MAX_CLIENTS || requestCount < 1) {
+			return usage(argv[0]);
+		}
+		return load(path, (size_t) connectionCount, (uint32_t) requestCount);
+	}
+
+	return usage(argv[0]);
+}
@@ -0,0 +1,251 @@
+// Hosts a control server and load-tests it with the bundled CLI client (control_client), which runs as a separate
+// process, while the users' state keeps changing underneath it. Searches are run against an index in a temporary
+// directory.
+
+#include "control.h"
+#include "textindex.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+#define USER_COUNT 64
+
+extern char **environ;
+
+static atomic_size_t requestCount;
+static atomic_bool changing;
+
+static mumble_error_t executeRequest(void *userData, const struct ControlRequest *request) {
+	(void) userData;
+	(void) request;
+
+	atomic_fetch_add(&requestCount, 1);
+
+	return MUMBLE_STATUS_OK;
+}
+
+// Keeps moving the users around like the plugin does while positional data arrives
+static void *changeState(void *arg) {
+	struct ControlServer *server = arg;
+
+	for (unsigned step = 0; atomic_load(&changing); step++) {
+		mumble_userid_t userID  = step % USER_COUNT;
+		const float position[3] = { (float) step, 0.0f, 0.0f };
+		control_setPosition(server, 1, userID, position);
+		control_setTalking(server, 1, userID, step % 3 == 0 ? MUMBLE_TS_TALKING : MUMBLE_TS_PASSIVE);
+		if (step % 1000 == 0) {
+			control_setChannel(server, 1, userID, (mumble_channelid_t) (step / 1000 % 4));
+		}
+	}
+
+	return NULL;
+}
+
+// Runs the client, writing what it prints into the given buffer (unless that is NULL)
+static int runClient(char **arguments, char *output, size_t outputSize) {
+	int pipeFDs[2] = { -1, -1 };
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if (output) {
+		if (pipe(pipeFDs) != 0) {
+			posix_spawn_file_actions_destroy(&actions);
+			return -1;
+		}
+		posix_spawn_file_actions_adddup2(&actions, pipeFDs[1], STDOUT_FILENO);
+		posix_spawn_file_actions_addclose(&actions, pipeFDs[0]);
+	}
+
+	pid_t client;
+	int spawned = posix_spawn(&client, CONTROL_CLIENT_PATH, &actions, NULL, arguments, environ);
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (output) {
+		close(pipeFDs[1]);
+		size_t length = 0;
+		ssize_t count;
+		while (spawned == 0 && length + 1 < outputSize
+			   && (count = read(pipeFDs[0], output + length, outputSize - 1 - length)) > 0) {
+			length += (size_t) count;
+		}
+		output[length] = '\0';
+		close(pipeFDs[0]);
+	}
+
+	int status;
+	if (spawned != 0 || waitpid(client, &status, 0) != client || !WIFEXITED(status)) {
+		return -1;
+	}
+
+	return WEXITSTATUS(status);
+}
+
+static size_t countLines(const char *text, const char *prefix) {
+	size_t count = 0;
+	for (const char *line = text; *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : line + strlen(line)) {
+		count += strncmp(line, prefix, strlen(prefix)) == 0;
+	}
+
+	return count;
+}
+
+static bool testLoad() {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/hello_mumble-control-test-%d.sock", (int) getpid());
+
+	struct ControlServer *server = control_create(path, NULL, &executeRequest, NULL);
+	CHECK(server);
+
+	atomic_store(&changing, true);
+	pthread_t changer;
+	CHECK(pthread_create(&changer, NULL, &changeState, server) == 0);
+
+	char *load[]   = { CONTROL_CLIENT_PATH, path, "load", "4", "20000", NULL };
+	int loadStatus = runClient(load, NULL, 0);
+
+	// Requests that have to be executed by the plugin reach the request function
+	char *mute[]   = { CONTROL_CLIENT_PATH, path, "mute", "1", NULL };
+	int muteStatus = runClient(mute, NULL, 0);
+
+	// Without an index searches fail
+	char *search[]   = { CONTROL_CLIENT_PATH, path, "search", "anything", NULL };
+	int searchStatus = runClient(search, NULL, 0);
+
+	atomic_store(&changing, false);
+	pthread_join(changer, NULL);
+	control_destroy(server);
+
+	CHECK(loadStatus == 0);
+	CHECK(muteStatus == 0);
+	CHECK(searchStatus != 0);
+	CHECK(atomic_load(&requestCount) == 1);
+
+	return true;
+}
+
+// Removes the index's directory along with its segment files
+static void removeDirectory(const char *path) {
+	DIR *directory = opendir(path);
+	if (directory) {
+		char file[256];
+		for (struct dirent *entry; (entry = readdir(directory));) {
+			int length = snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+			if (entry->d_name[0] != '.' && length > 0 && (size_t) length < sizeof(file)) {
+				unlink(file);
+			}
+		}
+		closedir(directory);
+	}
+	rmdir(path);
+}
+
+static bool testSearch() {
+	char directory[] = "/tmp/hello_mumble-control-test-XXXXXX";
+	CHECK(mkdtemp(directory));
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/hello_mumble-control-test-%d.sock", (int) getpid());
+
+	struct TextIndex *index = textindex_create(directory);
+	CHECK(index);
+	for (uint64_t i = 0; i < 40; i++) {
+		const char *text = i % 2 == 0 ? "meet me at the north gate" : "the north wind is cold";
+		CHECK(textindex_add(index, TEXTINDEX_TRANSCRIPT, (mumble_userid_t) i % 4, 1, 1000 + i, text));
+	}
+	CHECK(textindex_add(index, TEXTINDEX_EVENT, 7, 2, 2000, "entered Lobby"));
+
+	struct ControlServer *server = control_create(path, index, &executeRequest, NULL);
+	CHECK(server);
+
+	static char output[64 * 1024];
+	char *phrase[]   = { CONTROL_CLIENT_PATH, path, "search", "north gate", NULL };
+	int phraseStatus = runClient(phrase, output, sizeof(output));
+	size_t phraseHits = countLines(output, "document ");
+
+	char *range[]   = { CONTROL_CLIENT_PATH, path, "search", "north", "1000", "1009", NULL };
+	int rangeStatus = runClient(range, output, sizeof(output));
+	size_t rangeHits = countLines(output, "document ");
+
+	char *event[]   = { CONTROL_CLIENT_PATH, path, "search", "lobby", NULL };
+	int eventStatus = runClient(event, output, sizeof(output));
+	bool eventFound = strstr(output, "(event) by user 7 in channel 2: entered Lobby") != NULL;
+
+	control_destroy(server);
+	textindex_destroy(index);
+	removeDirectory(directory);
+
+	// Hits are capped, the time range is inclusive and phrases have to match as a whole
+	CHECK(phraseStatus == 0);
+	CHECK(phraseHits == CONTROL_MAX_HITS);
+	CHECK(rangeStatus == 0);
+	CHECK(rangeHits == 10);
+	CHECK(eventStatus == 0);
+	CHECK(eventFound);
+
+	return true;
+}
+
+static bool testStalePath() {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/hello_mumble-control-test-%d.sock", (int) getpid());
+
+	// Anything but a socket at the path is left alone
+	FILE *file = fopen(path, "w");
+	CHECK(file);
+	fclose(file);
+
+	struct ControlServer *server = control_create(path, NULL, &executeRequest, NULL);
+	struct stat status;
+	bool kept = stat(path, &status) == 0 && S_ISREG(status.st_mode);
+	control_destroy(server);
+	bool keptAfterDestroy = stat(path, &status) == 0 && S_ISREG(status.st_mode);
+	unlink(path);
+
+	CHECK(!server);
+	CHECK(kept);
+	CHECK(keptAfterDestroy);
+
+	// A socket left behind (e.g. by a crashed instance) is replaced
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	CHECK(fd >= 0);
+	bool bound = bind(fd, (struct sockaddr *) &address, sizeof(address)) == 0;
+	close(fd);
+	CHECK(bound);
+
+	server = control_create(path, NULL, &executeRequest, NULL);
+	CHECK(server);
+	control_destroy(server);
+	CHECK(stat(path, &status) != 0);
+
+	return true;
+}
+
+int main() {
+	bool (*tests[])() = { &testLoad, &testSearch, &testStalePath };
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		passed = tests[i]() && passed;
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
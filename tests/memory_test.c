@@ -0,0 +1,323 @@
+// Exercises the allocators of the memory subsystem and their accounting: heap blocks and large blocks, pools (including
+// several threads taking objects from and returning them to a nearly exhausted pool, which is where a pool without ABA
+// protection would hand out an object twice), arenas, and leaks showing up in the usage.
+//
+// The module is included rather than linked so that the ABA test can look at a pool's head, as a thread that has been
+// preempted in the middle of memory_poolAlloc would.
+
+#include "memory.c"
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POOL_CAPACITY 16
+#define STRESS_THREADS 4
+#define STRESS_POOL_CAPACITY 6
+#define STRESS_HELD_OBJECTS 2
+#define STRESS_ITERATIONS 200000
+#define ARENA_CAPACITY 1024
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+static struct MemoryUsage usageOf(enum MemorySubsystem subsystem) {
+	struct MemoryUsage usage[MEMORY_SUBSYSTEM_COUNT];
+	memory_getUsage(usage);
+
+	return usage[subsystem];
+}
+
+static bool testHeap() {
+	struct MemoryUsage before = usageOf(MEMORY_COMMANDS);
+
+	unsigned char *block = memory_alloc(MEMORY_COMMANDS, 100);
+	int *zeroed          = memory_calloc(MEMORY_COMMANDS, 10, sizeof(int));
+	CHECK(block && zeroed);
+	CHECK((uintptr_t) block % alignof(max_align_t) == 0);
+	for (size_t i = 0; i < 10; i++) {
+		CHECK(zeroed[i] == 0);
+	}
+
+	struct MemoryUsage allocated = usageOf(MEMORY_COMMANDS);
+	CHECK(allocated.blocks == before.blocks + 2);
+	CHECK(allocated.bytes == before.bytes + 100 + 10 * sizeof(int));
+	CHECK(allocated.allocations == before.allocations + 2);
+	CHECK(strcmp(allocated.name, "commands") == 0);
+
+	// Growing keeps the contents and is accounted as the new size
+	memset(block, 0x5a, 100);
+	block = memory_realloc(MEMORY_COMMANDS, block, 1000);
+	CHECK(block && block[0] == 0x5a && block[99] == 0x5a);
+	CHECK(usageOf(MEMORY_COMMANDS).bytes == before.bytes + 1000 + 10 * sizeof(int));
+
+	memory_free(block);
+	memory_free(zeroed);
+	memory_free(NULL);
+
+	// The peak is kept after everything has been freed
+	struct MemoryUsage freed = usageOf(MEMORY_COMMANDS);
+	CHECK(freed.blocks == before.blocks && freed.bytes == before.bytes);
+	CHECK(freed.peakBytes >= before.bytes + 1000 + 10 * sizeof(int));
+
+	// Other subsystems aren't affected
+	CHECK(usageOf(MEMORY_CONFIG).allocations == 0);
+
+	return true;
+}
+
+static bool testLarge() {
+	const size_t size         = 3 * 4096 + 1;
+	struct MemoryUsage before = usageOf(MEMORY_ACOUSTICS);
+
+	unsigned char *block = memory_allocLarge(MEMORY_ACOUSTICS, size);
+	CHECK(block);
+	CHECK((uintptr_t) block % 4096 == 0);
+	for (size_t i = 0; i < size; i++) {
+		CHECK(block[i] == 0);
+	}
+	block[size - 1] = 1;
+
+	// The accounted bytes include the header page and the rounding to whole pages
+	struct MemoryUsage allocated = usageOf(MEMORY_ACOUSTICS);
+	CHECK(allocated.blocks == before.blocks + 1);
+	CHECK(allocated.bytes >= before.bytes + size);
+
+	memory_freeLarge(block);
+	memory_freeLarge(NULL);
+	CHECK(usageOf(MEMORY_ACOUSTICS).blocks == before.blocks);
+	CHECK(usageOf(MEMORY_ACOUSTICS).bytes == before.bytes);
+
+	return true;
+}
+
+static bool testPool() {
+	CHECK(!memory_createPool(MEMORY_TRANSPORT, 8, 0));
+
+	struct MemoryPool *pool = memory_createPool(MEMORY_TRANSPORT, 24, POOL_CAPACITY);
+	CHECK(pool);
+	struct MemoryUsage created = usageOf(MEMORY_TRANSPORT);
+
+	// Every object is distinct, aligned and fully usable
+	unsigned char *objects[POOL_CAPACITY];
+	for (size_t i = 0; i < POOL_CAPACITY; i++) {
+		objects[i] = memory_poolAlloc(pool);
+		CHECK(objects[i]);
+		CHECK((uintptr_t) objects[i] % alignof(max_align_t) == 0);
+		memset(objects[i], (int) i, 24);
+	}
+	for (size_t i = 0; i < POOL_CAPACITY; i++) {
+		for (size_t j = 0; j < 24; j++) {
+			CHECK(objects[i][j] == i);
+		}
+	}
+	CHECK(!memory_poolAlloc(pool));
+
+	// Objects count as blocks and allocations, but their bytes are part of the slab
+	struct MemoryUsage exhausted = usageOf(MEMORY_TRANSPORT);
+	CHECK(exhausted.blocks == created.blocks + POOL_CAPACITY);
+	CHECK(exhausted.allocations == created.allocations + POOL_CAPACITY);
+	CHECK(exhausted.bytes == created.bytes);
+
+	// Freed objects are handed out again (the most recently freed one first)
+	memory_poolFree(pool, objects[3]);
+	memory_poolFree(pool, objects[7]);
+	memory_poolFree(pool, NULL);
+	CHECK(memory_poolAlloc(pool) == objects[7]);
+	CHECK(memory_poolAlloc(pool) == objects[3]);
+	CHECK(!memory_poolAlloc(pool));
+
+	// An object that isn't returned shows up as a leaked block, even once the pool is gone
+	for (size_t i = 1; i < POOL_CAPACITY; i++) {
+		memory_poolFree(pool, objects[i]);
+	}
+	CHECK(usageOf(MEMORY_TRANSPORT).blocks == created.blocks + 1);
+	memory_destroyPool(pool);
+	memory_destroyPool(NULL);
+	CHECK(usageOf(MEMORY_TRANSPORT).blocks == 1);
+	CHECK(usageOf(MEMORY_TRANSPORT).bytes == 0);
+
+	return true;
+}
+
+static bool testPoolTagging() {
+	struct MemoryPool *pool = memory_createPool(MEMORY_RECIPIENTS, 8, POOL_CAPACITY);
+	CHECK(pool);
+
+	// A thread taking an object reads the head and the first object's successor...
+	uint_least64_t stale = atomic_load(&pool->head);
+	uint32_t staleNext   = atomic_load(&pool->next[(uint32_t) stale]);
+
+	// ...and before it installs the successor as the new head, others take both objects and return the first one
+	void *first  = memory_poolAlloc(pool);
+	void *second = memory_poolAlloc(pool);
+	CHECK(first && second);
+	memory_poolFree(pool, first);
+
+	// The first object is at the head again, but the stale head must not compare equal, as installing the successor
+	// would hand out the second object twice
+	uint_least64_t head = atomic_load(&pool->head);
+	CHECK((uint32_t) head == (uint32_t) stale);
+	CHECK(head != stale);
+	CHECK(staleNext == (uint32_t) (((unsigned char *) second - pool->objects) / pool->objectSize));
+
+	memory_poolFree(pool, second);
+	memory_destroyPool(pool);
+
+	return true;
+}
+
+struct StressObject {
+	// The thread holding the object (0 if it's free)
+	atomic_int owner;
+	int value;
+};
+
+struct StressContext {
+	struct MemoryPool *pool;
+	int thread;
+	atomic_bool *failed;
+};
+
+// Takes objects and returns them in a different order, checking that no other thread holds them at the same time
+static void *stressPool(void *argument) {
+	struct StressContext *context = argument;
+	struct StressObject *held[STRESS_HELD_OBJECTS] = { NULL };
+
+	for (int i = 0; i < STRESS_ITERATIONS && !atomic_load(context->failed); i++) {
+		size_t slot = (size_t) i % STRESS_HELD_OBJECTS;
+		if (held[slot]) {
+			if (held[slot]->value != context->thread * STRESS_ITERATIONS + i - STRESS_HELD_OBJECTS) {
+				atomic_store(context->failed, true);
+			}
+			atomic_store(&held[slot]->owner, 0);
+			memory_poolFree(context->pool, held[slot]);
+		}
+
+		// The pool may be exhausted momentarily, as every thread holds objects
+		held[slot] = memory_poolAlloc(context->pool);
+		if (held[slot]) {
+			int expected = 0;
+			if (!atomic_compare_exchange_strong(&held[slot]->owner, &expected, context->thread + 1)) {
+				atomic_store(context->failed, true);
+			}
+			held[slot]->value = context->thread * STRESS_ITERATIONS + i;
+		}
+	}
+
+	for (size_t slot = 0; slot < STRESS_HELD_OBJECTS; slot++) {
+		if (held[slot]) {
+			atomic_store(&held[slot]->owner, 0);
+			memory_poolFree(context->pool, held[slot]);
+		}
+	}
+
+	return NULL;
+}
+
+static bool testPoolConcurrency() {
+	struct MemoryPool *pool = memory_createPool(MEMORY_SPATIAL, sizeof(struct StressObject), STRESS_POOL_CAPACITY);
+	CHECK(pool);
+
+	// The slab is zero-initialized, so every object starts out without an owner
+	atomic_bool failed = false;
+	struct StressContext contexts[STRESS_THREADS];
+	pthread_t threads[STRESS_THREADS];
+	size_t started = 0;
+	for (; started < STRESS_THREADS; started++) {
+		contexts[started] = (struct StressContext){ pool, (int) started, &failed };
+		if (pthread_create(&threads[started], NULL, &stressPool, &contexts[started]) != 0) {
+			break;
+		}
+	}
+	for (size_t i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	CHECK(started == STRESS_THREADS);
+	CHECK(!failed);
+	CHECK(usageOf(MEMORY_SPATIAL).blocks == 3);
+
+	// Every object has made it back into the free list exactly once
+	struct StressObject *objects[STRESS_POOL_CAPACITY];
+	for (size_t i = 0; i < STRESS_POOL_CAPACITY; i++) {
+		objects[i] = memory_poolAlloc(pool);
+		CHECK(objects[i]);
+		for (size_t j = 0; j < i; j++) {
+			CHECK(objects[j] != objects[i]);
+		}
+	}
+	CHECK(!memory_poolAlloc(pool));
+	for (size_t i = 0; i < STRESS_POOL_CAPACITY; i++) {
+		memory_poolFree(pool, objects[i]);
+	}
+
+	memory_destroyPool(pool);
+
+	return true;
+}
+
+static bool testArena() {
+	struct MemoryArena *arena = memory_createArena(MEMORY_SOUNDBOARD, ARENA_CAPACITY);
+	CHECK(arena);
+	struct MemoryUsage created = usageOf(MEMORY_SOUNDBOARD);
+	CHECK(created.bytes >= ARENA_CAPACITY);
+
+	// Allocations are aligned regardless of the sizes before them
+	unsigned char *first  = memory_arenaAlloc(arena, 1);
+	unsigned char *second = memory_arenaAlloc(arena, 17);
+	unsigned char *third  = memory_arenaAlloc(arena, 0);
+	CHECK(first && second && third);
+	CHECK((uintptr_t) first % 16 == 0 && (uintptr_t) second % 16 == 0 && (uintptr_t) third % 16 == 0);
+	CHECK(second == first + 16 && third == second + 32);
+
+	// Running out of room fails without touching the heap, but what is left can still be used
+	CHECK(!memory_arenaAlloc(arena, ARENA_CAPACITY));
+	CHECK(!memory_arenaAlloc(arena, SIZE_MAX));
+	CHECK(memory_arenaAlloc(arena, ARENA_CAPACITY - 48));
+	CHECK(!memory_arenaAlloc(arena, 1));
+
+	struct MemoryUsage used = usageOf(MEMORY_SOUNDBOARD);
+	CHECK(used.blocks == created.blocks && used.bytes == created.bytes && used.allocations == created.allocations);
+
+	// Resetting hands out the same memory again
+	memory_arenaReset(arena);
+	CHECK(memory_arenaAlloc(arena, ARENA_CAPACITY) == first);
+
+	memory_destroyArena(arena);
+	memory_destroyArena(NULL);
+	CHECK(usageOf(MEMORY_SOUNDBOARD).blocks == 0 && usageOf(MEMORY_SOUNDBOARD).bytes == 0);
+
+	return true;
+}
+
+int main() {
+	bool (*tests[])() = { &testHeap, &testLarge, &testPool, &testPoolTagging, &testPoolConcurrency, &testArena };
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		passed = tests[i]() && passed;
+	}
+
+	// The object testPool leaks on purpose is the only block left
+	struct MemoryUsage usage[MEMORY_SUBSYSTEM_COUNT];
+	memory_getUsage(usage);
+	for (size_t i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+		size_t expected = i == MEMORY_TRANSPORT ? 1 : 0;
+		if (usage[i].blocks != expected) {
+			fprintf(stderr, "Leaked %zu blocks in %s\n", usage[i].blocks, usage[i].name);
+			passed = false;
+		}
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,112 @@
+// Runs the bundled test writer (positional_writer) as a separate process and reads its shared-memory region through
+// the bridge while it keeps updating it, checking that the data is converted correctly and never torn.
+
+#include "positional.h"
+
+#include <math.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+// How long the writer runs (it is terminated earlier once the test is done)
+#define WRITER_DURATION "10000"
+#define OPEN_TIMEOUT_MS 2000
+#define READ_DURATION_MS 500
+
+extern char **environ;
+
+static pid_t writer = -1;
+
+static uint64_t currentTimeMs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static bool isClose(float value, float expected) {
+	return fabsf(value - expected) <= 1e-3f * fmaxf(1.0f, fabsf(expected));
+}
+
+static void stopWriter() {
+	if (writer > 0) {
+		kill(writer, SIGTERM);
+		waitpid(writer, NULL, 0);
+		writer = -1;
+	}
+}
+
+static bool testWriterProcess() {
+	char *arguments[] = { POSITIONAL_WRITER_PATH, WRITER_DURATION, NULL };
+	CHECK(posix_spawn(&writer, POSITIONAL_WRITER_PATH, NULL, NULL, arguments, environ) == 0);
+
+	// A region left behind by a process that isn't running is never used
+	uint64_t otherProcess = 0;
+	uint64_t writerID     = (uint64_t) writer;
+
+	struct PositionalBridge *bridge = NULL;
+	uint64_t start                  = currentTimeMs();
+	while (!bridge && currentTimeMs() - start < OPEN_TIMEOUT_MS) {
+		CHECK(!positional_open(&otherProcess, 1));
+		bridge = positional_open(&writerID, 1);
+	}
+	CHECK(bridge);
+
+	struct PositionalData data;
+	unsigned long firstStep = 0;
+	unsigned long lastStep  = 0;
+	size_t readCount        = 0;
+	for (start = currentTimeMs(); currentTimeMs() - start < READ_DURATION_MS; readCount++) {
+		CHECK(positional_read(bridge, &data));
+		CHECK(data.active);
+
+		// Centimeters in a Z-up right-handed system have to arrive as meters in Mumble's system
+		unsigned long step = strtoul(data.identity, NULL, 10);
+		float n            = (float) step;
+		CHECK(isClose(data.avatarPosition[0], -0.02f * n));
+		CHECK(isClose(data.avatarPosition[1], 0.03f * n));
+		CHECK(isClose(data.avatarPosition[2], 0.01f * n));
+		CHECK(isClose(data.cameraPosition[0], -0.02f * n));
+		CHECK(isClose(data.cameraPosition[1], 0.03f * n + 1.0f));
+		CHECK(isClose(data.cameraPosition[2], 0.01f * n));
+		CHECK(isClose(data.avatarFront[2], 1.0f));
+		CHECK(isClose(data.avatarTop[1], 1.0f));
+
+		CHECK(step >= lastStep);
+		if (readCount == 0) {
+			firstStep = step;
+		}
+		lastStep = step;
+	}
+	CHECK(lastStep > firstStep);
+
+	// Once the writer has shut down, the bridge has to be closed
+	stopWriter();
+	CHECK(!positional_read(bridge, &data));
+	positional_close(bridge);
+
+	return true;
+}
+
+int main() {
+	bool (*tests[])() = { &testWriterProcess };
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		passed = tests[i]() && passed;
+		stopWriter();
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,110 @@
+// A stand-in for a game that publishes its coordinates through the shared-memory bridge (see positional.h). It walks
+// the avatar along a straight line, in centimeters and a Z-up right-handed coordinate system, for the given amount of
+// milliseconds (or until it is terminated) and removes the region again when it exits.
+//
+// All vectors of an update are derived from the same step number, which is also written as the identity, so that a
+// reader can tell whether it has ever seen a torn update:
+//   avatar position = (n, 2n, 3n), camera position = (n, 2n, 3n + 100), identity = n
+
+#include "positional.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UPDATE_INTERVAL_NS 100000
+
+static volatile sig_atomic_t stopped;
+
+static void stop(int signal) {
+	(void) signal;
+	stopped = 1;
+}
+
+static uint64_t currentTimeMs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static void publish(struct PositionalSharedData *shared, uint32_t step) {
+	float n = (float) step;
+
+	atomic_fetch_add_explicit(&shared->sequence, 1, memory_order_release);
+	atomic_thread_fence(memory_order_release);
+
+	shared->active = 1;
+
+	const float position[3] = { n, 2.0f * n, 3.0f * n };
+	const float camera[3]   = { n, 2.0f * n, 3.0f * n + 100.0f };
+	const float front[3]    = { 1.0f, 0.0f, 0.0f };
+	const float top[3]      = { 0.0f, 0.0f, 1.0f };
+	memcpy(shared->avatarPosition, position, sizeof(position));
+	memcpy(shared->avatarFront, front, sizeof(front));
+	memcpy(shared->avatarTop, top, sizeof(top));
+	memcpy(shared->cameraPosition, camera, sizeof(camera));
+	memcpy(shared->cameraFront, front, sizeof(front));
+	memcpy(shared->cameraTop, top, sizeof(top));
+	snprintf(shared->context, sizeof(shared->context), "positional_writer");
+	snprintf(shared->identity, sizeof(shared->identity), "%u", step);
+
+	atomic_fetch_add_explicit(&shared->sequence, 1, memory_order_release);
+}
+
+int main(int argc, char **argv) {
+	uint64_t durationMs = argc > 1 ? strtoull(argv[1], NULL, 10) : 0;
+
+	signal(SIGINT, &stop);
+	signal(SIGTERM, &stop);
+
+	int fd = shm_open(POSITIONAL_SHM_NAME, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		perror("shm_open");
+		return EXIT_FAILURE;
+	}
+
+	if (ftruncate(fd, sizeof(struct PositionalSharedData)) != 0) {
+		perror("ftruncate");
+		close(fd);
+		shm_unlink(POSITIONAL_SHM_NAME);
+		return EXIT_FAILURE;
+	}
+
+	struct PositionalSharedData *shared =
+		mmap(NULL, sizeof(struct PositionalSharedData), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shared == MAP_FAILED) {
+		perror("mmap");
+		shm_unlink(POSITIONAL_SHM_NAME);
+		return EXIT_FAILURE;
+	}
+
+	memset(shared, 0, sizeof(struct PositionalSharedData));
+	shared->version   = POSITIONAL_ABI_VERSION;
+	shared->units     = POSITIONAL_UNITS_CENTIMETERS;
+	shared->axes      = POSITIONAL_AXES_Z_UP_RIGHT_HANDED;
+	shared->writerPID = (uint32_t) getpid();
+	publish(shared, 0);
+	// The magic comes last, so that readers never see a region that hasn't been filled in yet
+	atomic_thread_fence(memory_order_release);
+	shared->magic = POSITIONAL_MAGIC;
+
+	const struct timespec interval = { 0, UPDATE_INTERVAL_NS };
+	uint64_t start                 = currentTimeMs();
+	for (uint32_t step = 1; !stopped && (durationMs == 0 || currentTimeMs() - start < durationMs); step++) {
+		publish(shared, step);
+		nanosleep(&interval, NULL);
+	}
+
+	shared->magic = 0;
+	munmap(shared, sizeof(struct PositionalSharedData));
+	shm_unlink(POSITIONAL_SHM_NAME);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,315 @@
+// Runs several replicated stores over the transport on a simulated network that loses and reorders packets, lets them
+// change the same registers, sets and counters concurrently (with one replica joining late) and checks that they all
+// converge to the same state. It also checks that a change is sent as a small delta no matter how large the state is.
+
+#include "memory.h"
+#include "replica.h"
+#include "transport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_IN_FLIGHT 65536
+#define STEP_MS 5
+#define TICK_INTERVAL_MS 50
+#define REPLICA_COUNT 4
+#define ARENA_SIZE (256 * 1024)
+#define KEY_COUNT 20
+#define COUNTER_KEY_COUNT 5
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+struct Replica {
+	mumble_userid_t id;
+	bool joined;
+	struct Transport *transport;
+	struct MemoryArena *arena;
+	struct ReplicaStore *store;
+	bool invalidMessage;
+};
+
+struct Packet {
+	struct Replica *to;
+	mumble_userid_t from;
+	uint64_t arrivesAt;
+	size_t length;
+	uint8_t data[TRANSPORT_MTU];
+};
+
+static struct Replica replicas[REPLICA_COUNT];
+static struct Packet inFlight[MAX_IN_FLIGHT];
+static size_t inFlightCount;
+static uint64_t nowMs;
+static float lossRate;
+static unsigned long long rngState = 88172645463325252ULL;
+
+// The sum of all increments made to every counter key by any replica
+static int64_t expectedCounters[COUNTER_KEY_COUNT];
+
+static unsigned long long nextRandom() {
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 7;
+	rngState ^= rngState << 17;
+	return rngState;
+}
+
+static void deliverMessage(void *userData, mumble_connection_t connection, mumble_userid_t peer,
+						   const uint8_t *data, size_t dataLength) {
+	(void) connection;
+
+	struct Replica *replica = userData;
+	if (!replica_receive(replica->store, peer, data, dataLength)) {
+		replica->invalidMessage = true;
+	}
+}
+
+static mumble_error_t sendPacket(void *userData, mumble_connection_t connection, mumble_userid_t peer,
+								 const uint8_t *data, size_t dataLength) {
+	(void) connection;
+
+	struct Replica *from = userData;
+	struct Replica *to   = NULL;
+	for (size_t i = 0; i < REPLICA_COUNT; i++) {
+		if (replicas[i].id == peer) {
+			to = &replicas[i];
+		}
+	}
+
+	if (!to || inFlightCount == MAX_IN_FLIGHT || (float) (nextRandom() % 1000) < lossRate * 1000.0f) {
+		return MUMBLE_STATUS_OK;
+	}
+
+	// A random delay reorders packets
+	struct Packet *packet = &inFlight[inFlightCount++];
+	packet->to            = to;
+	packet->from          = from->id;
+	packet->arrivesAt     = nowMs + 5 + nextRandom() % 80;
+	packet->length        = dataLength;
+	memcpy(packet->data, data, dataLength);
+
+	return MUMBLE_STATUS_OK;
+}
+
+static bool createReplicas() {
+	for (size_t i = 0; i < REPLICA_COUNT; i++) {
+		struct Replica *replica = &replicas[i];
+		memset(replica, 0, sizeof(*replica));
+		replica->id        = (mumble_userid_t) (10 + i);
+		replica->transport = transport_create(&sendPacket, &deliverMessage, replica);
+		replica->arena     = memory_createArena(MEMORY_CONNECTIONS, ARENA_SIZE);
+		replica->store     = replica->arena ? replica_createInArena(replica->arena) : NULL;
+		if (!replica->transport || !replica->store) {
+			return false;
+		}
+		replica_setLocalPeer(replica->store, replica->id);
+	}
+
+	return true;
+}
+
+static void destroyReplicas() {
+	for (size_t i = 0; i < REPLICA_COUNT; i++) {
+		transport_destroy(replicas[i].transport);
+		memory_destroyArena(replicas[i].arena);
+		memset(&replicas[i], 0, sizeof(replicas[i]));
+	}
+	inFlightCount = 0;
+	memset(expectedCounters, 0, sizeof(expectedCounters));
+}
+
+// Lets the given replica join: it and everybody that has joined before see each other being added (like
+// mumble_onUserAdded does)
+static void join(struct Replica *replica) {
+	for (size_t i = 0; i < REPLICA_COUNT; i++) {
+		if (replicas[i].joined) {
+			replica_addPeer(replicas[i].store, replica->id);
+			replica_addPeer(replica->store, replicas[i].id);
+		}
+	}
+	replica->joined = true;
+}
+
+static void changeRandomly(struct Replica *replica) {
+	char key[REPLICA_MAX_KEY];
+	unsigned index = (unsigned) (nextRandom() % KEY_COUNT);
+	snprintf(key, sizeof(key), "k%u", index);
+
+	switch (nextRandom() % 6) {
+		case 0:
+		case 1: {
+			char value[REPLICA_MAX_VALUE];
+			int length = snprintf(value, sizeof(value), "%u@%llu", replica->id, (unsigned long long) nowMs);
+			replica_set(replica->store, "markers", key, value, (size_t) length);
+			break;
+		}
+		case 2:
+			replica_delete(replica->store, "markers", key);
+			break;
+		case 3:
+			replica_add(replica->store, "ready", key);
+			break;
+		case 4:
+			replica_remove(replica->store, "ready", key);
+			break;
+		case 5: {
+			index           = index % COUNTER_KEY_COUNT;
+			int64_t amount  = (int64_t) (nextRandom() % 11) - 5;
+			snprintf(key, sizeof(key), "k%u", index);
+			if (replica_increment(replica->store, "score", key, amount)) {
+				expectedCounters[index] += amount;
+			}
+			break;
+		}
+	}
+}
+
+// Hands the replica's pending messages to its transport
+static void flushReplica(struct Replica *replica) {
+	static uint8_t message[REPLICA_MAX_MESSAGE];
+	mumble_userid_t peers[REPLICA_MAX_PEERS];
+	size_t peerCount;
+
+	size_t length;
+	while ((length = replica_nextMessage(replica->store, message, peers, &peerCount)) > 0) {
+		for (size_t i = 0; i < peerCount; i++) {
+			transport_send(replica->transport, 1, peers[i], message, length, nowMs);
+		}
+	}
+}
+
+// Advances the simulated time by the given amount. Every joined replica changes something with the given probability
+// (in percent) per step.
+static void run(uint64_t durationMs, unsigned changeChance) {
+	for (uint64_t end = nowMs + durationMs; nowMs < end;) {
+		nowMs += STEP_MS;
+
+		for (size_t i = 0; i < inFlightCount;) {
+			if (inFlight[i].arrivesAt > nowMs) {
+				i++;
+				continue;
+			}
+
+			struct Packet packet = inFlight[i];
+			inFlight[i]          = inFlight[--inFlightCount];
+			transport_receive(packet.to->transport, 1, packet.from, packet.data, packet.length, nowMs);
+		}
+
+		for (size_t i = 0; i < REPLICA_COUNT; i++) {
+			if (replicas[i].joined && nextRandom() % 100 < changeChance) {
+				changeRandomly(&replicas[i]);
+			}
+		}
+
+		if (nowMs % TICK_INTERVAL_MS == 0) {
+			for (size_t i = 0; i < REPLICA_COUNT; i++) {
+				if (replicas[i].joined) {
+					flushReplica(&replicas[i]);
+				}
+				transport_tick(replicas[i].transport, nowMs);
+			}
+		}
+	}
+}
+
+static bool isConverged() {
+	const struct ReplicaStore *reference = replicas[0].store;
+
+	for (size_t r = 1; r < REPLICA_COUNT; r++) {
+		const struct ReplicaStore *store = replicas[r].store;
+
+		for (unsigned i = 0; i < KEY_COUNT; i++) {
+			char key[REPLICA_MAX_KEY];
+			snprintf(key, sizeof(key), "k%u", i);
+
+			const void *expected, *actual;
+			size_t expectedLength, actualLength;
+			bool present = replica_get(reference, "markers", key, &expected, &expectedLength);
+			CHECK(replica_get(store, "markers", key, &actual, &actualLength) == present);
+			CHECK(!present || (actualLength == expectedLength && memcmp(actual, expected, actualLength) == 0));
+
+			CHECK(replica_contains(store, "ready", key) == replica_contains(reference, "ready", key));
+		}
+	}
+
+	for (size_t r = 0; r < REPLICA_COUNT; r++) {
+		for (unsigned i = 0; i < COUNTER_KEY_COUNT; i++) {
+			char key[REPLICA_MAX_KEY];
+			snprintf(key, sizeof(key), "k%u", i);
+			CHECK(replica_getCounter(replicas[r].store, "score", key) == expectedCounters[i]);
+		}
+		CHECK(!replicas[r].invalidMessage);
+	}
+
+	return true;
+}
+
+static bool testConvergence() {
+	CHECK(createReplicas());
+
+	lossRate = 0.1f;
+	for (size_t i = 0; i < REPLICA_COUNT - 1; i++) {
+		join(&replicas[i]);
+	}
+	run(3000, 10);
+
+	// The last replica has missed everything so far and gets it in reply to its digests
+	join(&replicas[REPLICA_COUNT - 1]);
+	run(3000, 10);
+
+	run(60000, 0);
+	CHECK(isConverged());
+
+	return true;
+}
+
+static bool testDeltaSize() {
+	CHECK(createReplicas());
+
+	lossRate = 0.0f;
+	join(&replicas[0]);
+	join(&replicas[1]);
+	run(1000, 0);
+
+	// A large state...
+	for (unsigned i = 0; i < 200; i++) {
+		char key[REPLICA_MAX_KEY];
+		snprintf(key, sizeof(key), "marker%u", i);
+		CHECK(replica_set(replicas[0].store, "markers", key, "0123456789abcdef0123456789abcdef", 32));
+	}
+	run(5000, 0);
+
+	const void *value;
+	size_t length;
+	CHECK(replica_get(replicas[1].store, "markers", "marker199", &value, &length));
+
+	// ...of which a single register changes
+	CHECK(replica_set(replicas[0].store, "markers", "marker7", "moved", 5));
+
+	static uint8_t message[REPLICA_MAX_MESSAGE];
+	mumble_userid_t peers[REPLICA_MAX_PEERS];
+	size_t peerCount;
+	length = replica_nextMessage(replicas[0].store, message, peers, &peerCount);
+	CHECK(length > 0 && length < 128);
+	CHECK(peerCount == 1 && peers[0] == replicas[1].id);
+
+	return true;
+}
+
+int main() {
+	bool (*tests[])() = { &testConvergence, &testDeltaSize };
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		passed = tests[i]() && passed;
+		destroyReplicas();
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
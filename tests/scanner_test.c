@@ -0,0 +1,322 @@
+// Checks the signature scanner against a naive search: the anchor prefilter must not miss matches (wildcards, anchors
+// in the middle of a pattern, matches at the very start and end of a buffer) and must not report matches that the
+// full pattern doesn't confirm. Modules are scanned in chunks by several threads, so matches spanning the boundary
+// between two chunks have to be found as well. The module is a file mapped into the test's own process.
+//
+// Afterwards, a module of machine code-like bytes is scanned for the signatures of a few games. Without arguments, the
+// module is a few megabytes large and the time isn't checked. To benchmark the scanner, run the test with the amount
+// of megabytes to scan in a Release build: 200 MB have to be scanned in under a second.
+//
+// Usage: scanner_test [MEGABYTES]
+//
+// The module is included rather than linked so that the test knows where the chunks end.
+
+#include "scanner.c"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_MEGABYTES 16
+// How fast modules have to be scanned when benchmarking
+#define BENCHMARK_MEGABYTES_PER_SECOND 200
+#define RANDOM_ROUNDS 20000
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+static size_t megabytes = TEST_MEGABYTES;
+static bool benchmarking;
+static char modulePath[64];
+static unsigned long long rngState = 0x5CA7E5ULL;
+
+static unsigned long long nextRandom() {
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 7;
+	rngState ^= rngState << 17;
+	return rngState;
+}
+
+static uint64_t currentTimeMs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static size_t naiveFind(const uint8_t *data, size_t length, const struct SignaturePattern *pattern) {
+	for (size_t start = 0; start + pattern->length <= length; start++) {
+		size_t i = 0;
+		while (i < pattern->length && ((data[start + i] ^ pattern->bytes[i]) & pattern->mask[i]) == 0) {
+			i++;
+		}
+		if (i == pattern->length) {
+			return start;
+		}
+	}
+
+	return SIZE_MAX;
+}
+
+// Maps a file of the given size as the test's module
+static uint8_t *mapModule(size_t size, struct ModuleInfo *module) {
+	int fd = open(modulePath, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	uint8_t *data = NULL;
+	if (ftruncate(fd, (off_t) size) == 0) {
+		data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		data = data != MAP_FAILED ? data : NULL;
+	}
+	close(fd);
+
+	memset(module, 0, sizeof(*module));
+	module->base = (uint64_t) (uintptr_t) data;
+	module->size = size;
+	snprintf(module->path, sizeof(module->path), "%s", modulePath);
+
+	return data;
+}
+
+static bool testParse() {
+	struct SignaturePattern pattern;
+
+	CHECK(scanner_parsePattern("48 8b 05 ?? ? ?? ?? 48 85 C0", &pattern));
+	CHECK(pattern.length == 10);
+	CHECK(pattern.bytes[1] == 0x8B && pattern.mask[1] == 0xFF);
+	CHECK(pattern.bytes[4] == 0x00 && pattern.mask[4] == 0x00);
+	CHECK(pattern.bytes[9] == 0xC0 && pattern.mask[9] == 0xFF);
+
+	// The anchor is the rarest byte, never a wildcard
+	CHECK(scanner_parsePattern("00 48 7A 8B", &pattern) && pattern.anchor == 2);
+	CHECK(scanner_parsePattern("?? 00 ?? FF", &pattern) && pattern.anchor == 3);
+
+	// Only wildcards, malformed bytes and missing separators
+	const char *invalid[] = { "", "  ", "?? ?", "4", "4G", "488B", "48 8B0", "48,8B", "?48" };
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		if (scanner_parsePattern(invalid[i], &pattern)) {
+			fprintf(stderr, "\"%s\" has been accepted\n", invalid[i]);
+			return false;
+		}
+	}
+
+	char text[3 * (SCANNER_MAX_PATTERN + 1) + 1] = "";
+	for (size_t i = 0; i < SCANNER_MAX_PATTERN; i++) {
+		strcat(text, "AB ");
+	}
+	CHECK(scanner_parsePattern(text, &pattern) && pattern.length == SCANNER_MAX_PATTERN);
+	strcat(text, "AB");
+	CHECK(!scanner_parsePattern(text, &pattern));
+
+	return true;
+}
+
+// Compares scanner_find against the naive search on random data. The data only consists of a few different bytes so
+// that most anchor candidates turn out not to match.
+static bool testFind() {
+	static const uint8_t alphabet[] = { 0x00, 0x48, 0x8B, 0x7A };
+	uint8_t data[512];
+
+	for (size_t round = 0; round < RANDOM_ROUNDS; round++) {
+		size_t length = 1 + nextRandom() % sizeof(data);
+		for (size_t i = 0; i < length; i++) {
+			data[i] = alphabet[nextRandom() % sizeof(alphabet)];
+		}
+
+		// Half of the patterns are taken from the data (so that there is a match), the others are random
+		struct SignaturePattern pattern;
+		memset(&pattern, 0, sizeof(pattern));
+		pattern.length = 1 + nextRandom() % (length < SCANNER_MAX_PATTERN ? length : SCANNER_MAX_PATTERN);
+		size_t source  = nextRandom() % (length - pattern.length + 1);
+		bool fromData  = nextRandom() % 2 == 0;
+		for (size_t i = 0; i < pattern.length; i++) {
+			pattern.bytes[i] = fromData ? data[source + i] : alphabet[nextRandom() % sizeof(alphabet)];
+			pattern.mask[i]  = nextRandom() % 4 == 0 ? 0x00 : 0xFF;
+		}
+		// The anchor isn't necessarily the first byte that has to match
+		pattern.anchor = nextRandom() % pattern.length;
+		pattern.mask[pattern.anchor] = 0xFF;
+		for (size_t i = 0; i < pattern.length; i++) {
+			pattern.bytes[i] &= pattern.mask[i];
+		}
+
+		size_t expected = naiveFind(data, length, &pattern);
+		size_t found    = scanner_find(data, length, &pattern);
+		if (found != expected) {
+			fprintf(stderr, "Round %zu: Found the pattern at %zu instead of %zu\n", round, found, expected);
+			return false;
+		}
+	}
+
+	// Matches at the very start and the very end of the data
+	struct SignaturePattern pattern;
+	memset(data, 0, sizeof(data));
+	data[0]                = 0x7A;
+	data[1]                = 0x8B;
+	data[sizeof(data) - 2] = 0x5E;
+	data[sizeof(data) - 1] = 0x6F;
+	CHECK(scanner_parsePattern("7A ?? 00", &pattern));
+	CHECK(scanner_find(data, sizeof(data), &pattern) == 0);
+	CHECK(scanner_parsePattern("?? 5E 6F", &pattern));
+	CHECK(scanner_find(data, sizeof(data), &pattern) == sizeof(data) - 3);
+	CHECK(scanner_find(data, sizeof(data) - 1, &pattern) == SIZE_MAX);
+	// Longer than the data
+	CHECK(scanner_find(data, 2, &pattern) == SIZE_MAX);
+
+	return true;
+}
+
+// Places patterns across and right next to the boundaries between the chunks a module is read in
+static bool testChunkBoundaries() {
+	// Chunks are counted from the beginning of the mapping
+	const char *signatures[] = {
+		// Its anchor (5E) lies behind the boundary between the first and the second chunk
+		"01 02 03 04 ?? ?? 5E 06 07",
+		// Ends right at the end of the second chunk
+		"21 ?? 7B",
+		// Starts right at the beginning of the third chunk
+		"7C ?? 31",
+		// As long as a pattern can be, spanning the boundary between the third and the fourth chunk
+		"41 42 43 44 45 46 47 48 49 4A 4B 4C 4D 4E 4F 50 51 52 53 54 55 56 57 58 59 5A 5B 5C 5D ?? ?? 60 "
+		"61 62 63 64 65 66 67 68 69 6A 6B 6C 6D 6E 6F 70 71 72 73 74 75 76 77 78 79 7A 7D 7E 7F 80 81 82",
+		// Its anchor (5F) lies right in front of the boundary between the fourth and the last chunk
+		"5F ?? 11 12 13 14 15 16",
+		// Ends at the end of the module
+		"91 92 93",
+		// Occurs in the second and in the fourth chunk
+		"A1 ?? A3",
+	};
+	const size_t signatureCount = sizeof(signatures) / sizeof(signatures[0]);
+
+	struct SignaturePattern patterns[sizeof(signatures) / sizeof(signatures[0])];
+	for (size_t i = 0; i < signatureCount; i++) {
+		CHECK(scanner_parsePattern(signatures[i], &patterns[i]));
+	}
+	CHECK(patterns[0].anchor == 6);
+	CHECK(patterns[3].length == SCANNER_MAX_PATTERN);
+	CHECK(patterns[4].anchor == 0);
+
+	const size_t size      = 4 * SCAN_CHUNK_SIZE + 4096;
+	const size_t offsets[] = {
+		SCAN_CHUNK_SIZE - 5, 2 * SCAN_CHUNK_SIZE - 3, 2 * SCAN_CHUNK_SIZE, 3 * SCAN_CHUNK_SIZE - 40,
+		4 * SCAN_CHUNK_SIZE - 1, size - 3, SCAN_CHUNK_SIZE + 100,
+	};
+
+	struct ModuleInfo module;
+	uint8_t *data = mapModule(size, &module);
+	CHECK(data);
+
+	for (size_t i = 0; i < signatureCount; i++) {
+		memcpy(data + offsets[i], patterns[i].bytes, patterns[i].length);
+	}
+	// Only the first occurrence is reported
+	memcpy(data + 3 * SCAN_CHUNK_SIZE + 100, patterns[6].bytes, patterns[6].length);
+
+	uint64_t addresses[sizeof(signatures) / sizeof(signatures[0])];
+	bool foundAll = scanner_scanModule((uint64_t) getpid(), &module, patterns, signatureCount, addresses);
+
+	// A pattern that doesn't occur
+	struct SignaturePattern missing;
+	uint64_t missingAddress = 0;
+	CHECK(scanner_parsePattern("EE ?? EF", &missing));
+	bool foundMissing = scanner_scanModule((uint64_t) getpid(), &module, &missing, 1, &missingAddress);
+
+	munmap(data, size);
+
+	CHECK(foundAll);
+	for (size_t i = 0; i < signatureCount; i++) {
+		if (addresses[i] != module.base + offsets[i]) {
+			fprintf(stderr, "Found \"%s\" at offset %lld instead of %zu\n", signatures[i],
+					(long long) (addresses[i] - module.base), offsets[i]);
+			return false;
+		}
+	}
+	CHECK(!foundMissing);
+	CHECK(missingAddress == UINT64_MAX);
+
+	return true;
+}
+
+static bool benchmarkScan() {
+	const char *signatures[] = {
+		"48 8B 05 ?? ?? ?? ?? 48 85 C0 74 ?? F3 0F 10 40",
+		"F3 0F 11 05 ?? ?? ?? ?? F3 0F 11 0D ?? ?? ?? ?? E8",
+		"48 8D 0D ?? ?? ?? ?? E8 ?? ?? ?? ?? 84 C0 0F 84",
+		"8B 0D ?? ?? ?? ?? 85 C9 74 ?? 8B 81 ?? ?? ?? ?? C3",
+	};
+	const size_t signatureCount = sizeof(signatures) / sizeof(signatures[0]);
+
+	struct SignaturePattern patterns[sizeof(signatures) / sizeof(signatures[0])];
+	for (size_t i = 0; i < signatureCount; i++) {
+		CHECK(scanner_parsePattern(signatures[i], &patterns[i]));
+	}
+
+	size_t size = megabytes * 1024 * 1024;
+	struct ModuleInfo module;
+	uint8_t *data = mapModule(size, &module);
+	CHECK(data);
+
+	// Mostly bytes that are common in machine code, which makes for plenty of anchor candidates. The patterns are
+	// placed at the end so that the whole module has to be scanned.
+	for (size_t i = 0; i < size; i++) {
+		unsigned long long random = nextRandom();
+		data[i] = random % 4 != 0 ? commonBytes[(random >> 8) % sizeof(commonBytes)] : (uint8_t) (random >> 16);
+	}
+	for (size_t i = 0; i < signatureCount; i++) {
+		memcpy(data + size - (i + 1) * SCANNER_MAX_PATTERN, patterns[i].bytes, patterns[i].length);
+	}
+
+	uint64_t addresses[sizeof(signatures) / sizeof(signatures[0])];
+	uint64_t start    = currentTimeMs();
+	bool foundAll     = scanner_scanModule((uint64_t) getpid(), &module, patterns, signatureCount, addresses);
+	uint64_t duration = currentTimeMs() - start;
+
+	munmap(data, size);
+
+	printf("Scanned %zu MB for %zu patterns in %llu ms\n", megabytes, signatureCount, (unsigned long long) duration);
+
+	CHECK(foundAll);
+	for (size_t i = 0; i < signatureCount; i++) {
+		// The padding between the patterns may happen to complete one of them earlier
+		CHECK(addresses[i] <= module.base + size - (i + 1) * SCANNER_MAX_PATTERN);
+	}
+	CHECK(!benchmarking || duration < 1000 * megabytes / BENCHMARK_MEGABYTES_PER_SECOND);
+
+	return true;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1) {
+		megabytes    = strtoul(argv[1], NULL, 10);
+		benchmarking = true;
+	}
+	snprintf(modulePath, sizeof(modulePath), "/tmp/hello_mumble-scanner-test-%d.bin", (int) getpid());
+
+	bool (*tests[])() = { &testParse, &testFind, &testChunkBoundaries, &benchmarkScan };
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		passed = tests[i]() && passed;
+	}
+	unlink(modulePath);
+
+	struct MemoryUsage usage[MEMORY_SUBSYSTEM_COUNT];
+	memory_getUsage(usage);
+	if (usage[MEMORY_SCANNER].blocks != 0) {
+		fprintf(stderr, "Leaked %zu blocks\n", usage[MEMORY_SCANNER].blocks);
+		passed = false;
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
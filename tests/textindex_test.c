@@ -0,0 +1,214 @@
+// Fills text indices in temporary directories and queries them: phrases have to match as a whole and in order,
+// time ranges are inclusive and hits come newest first. Enough documents are added to have the background thread write
+// TEXTINDEX_MERGE_FACTOR segments and merge them into one, and the merged segment is searched again after reopening
+// the index (which maps the segment files instead of rebuilding anything).
+
+#include "memory.h"
+#include "textindex.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_HITS 64
+#define WAIT_TIMEOUT_MS 10000
+#define NEEDLE_INTERVAL 1000
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+static void sleepMs(unsigned int ms) {
+	struct timespec duration = { ms / 1000, (long) (ms % 1000) * 1000000L };
+	nanosleep(&duration, NULL);
+}
+
+static void removeDirectory(const char *path) {
+	DIR *directory = opendir(path);
+	if (directory) {
+		char file[256];
+		for (struct dirent *entry; (entry = readdir(directory));) {
+			int length = snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+			if (entry->d_name[0] != '.' && length > 0 && (size_t) length < sizeof(file)) {
+				unlink(file);
+			}
+		}
+		closedir(directory);
+	}
+	rmdir(path);
+}
+
+// Counts the segment files in the given directory (leaving out temporary files)
+static size_t countSegments(const char *path) {
+	size_t count   = 0;
+	DIR *directory = opendir(path);
+	if (directory) {
+		for (struct dirent *entry; (entry = readdir(directory));) {
+			size_t length = strlen(entry->d_name);
+			count += length > 4 && strcmp(entry->d_name + length - 4, ".seg") == 0;
+		}
+		closedir(directory);
+	}
+
+	return count;
+}
+
+static bool waitForSegments(const char *path, size_t count) {
+	for (unsigned int waited = 0; countSegments(path) != count; waited++) {
+		if (waited == WAIT_TIMEOUT_MS) {
+			return false;
+		}
+		sleepMs(1);
+	}
+
+	return true;
+}
+
+static bool testQueries() {
+	char directory[] = "/tmp/hello_mumble-textindex-test-XXXXXX";
+	CHECK(mkdtemp(directory));
+
+	struct TextIndex *index = textindex_create(directory);
+	CHECK(index);
+	CHECK(textindex_add(index, TEXTINDEX_TRANSCRIPT, 1, 10, 1000, "The quick brown fox"));
+	CHECK(textindex_add(index, TEXTINDEX_TRANSCRIPT, 2, 10, 2000, "brown quick, or quick brown?"));
+	CHECK(textindex_add(index, TEXTINDEX_TRANSCRIPT, 3, 11, 3000, "QUICK BROWN dogs everywhere"));
+	CHECK(textindex_add(index, TEXTINDEX_EVENT, 4, 12, 4000, "Alice entered Quick Brown Lounge"));
+	CHECK(textindex_add(index, TEXTINDEX_TRANSCRIPT, 5, 10, 5000, "brown is quick"));
+
+	struct TextIndexHit hits[MAX_HITS];
+	size_t found = textindex_search(index, "quick brown", 0, UINT64_MAX, hits, MAX_HITS);
+	size_t range = textindex_search(index, "quick brown", 2000, 3000, hits + 8, MAX_HITS - 8);
+	size_t all   = textindex_search(index, "", 0, UINT64_MAX, hits + 16, MAX_HITS - 16);
+	size_t first = textindex_search(index, "quick", 0, UINT64_MAX, hits + 24, 1);
+	size_t none  = textindex_search(index, "brown fox quick", 0, UINT64_MAX, hits + 32, MAX_HITS - 32);
+	size_t empty = textindex_search(index, "quick brown", 1001, 1999, hits + 40, MAX_HITS - 40);
+
+	textindex_destroy(index);
+	removeDirectory(directory);
+
+	// Matches are case-insensitive and ignore punctuation, newest first
+	CHECK(found == 4);
+	CHECK(hits[0].userID == 4 && hits[0].kind == TEXTINDEX_EVENT && hits[0].channelID == 12);
+	CHECK(strcmp(hits[0].text, "Alice entered Quick Brown Lounge") == 0);
+	CHECK(hits[1].userID == 3 && hits[2].userID == 2 && hits[3].userID == 1);
+	CHECK(hits[3].document == 0 && hits[3].timestampMs == 1000);
+
+	// Both ends of the range are inclusive
+	CHECK(range == 2);
+	CHECK(hits[8].timestampMs == 3000 && hits[9].timestampMs == 2000);
+
+	CHECK(all == 5);
+	CHECK(first == 1 && hits[24].userID == 5);
+	CHECK(none == 0);
+	CHECK(empty == 0);
+
+	return true;
+}
+
+// Adds the given documents (every NEEDLE_INTERVAL-th of which contains "needle in the haystack"), timestamped with
+// their number
+static bool addDocuments(struct TextIndex *index, uint64_t first, uint64_t count) {
+	for (uint64_t i = first; i < first + count; i++) {
+		char text[64];
+		snprintf(text, sizeof(text), i % NEEDLE_INTERVAL == 0 ? "needle in the haystack %llu" : "hay %llu straw",
+				 (unsigned long long) i);
+		CHECK(textindex_add(index, TEXTINDEX_TRANSCRIPT, (mumble_userid_t) (i % 16), 1, i, text));
+	}
+
+	return true;
+}
+
+// Checks that every needle is found, in the given time range only
+static bool findNeedles(struct TextIndex *index, uint64_t documentCount) {
+	static struct TextIndexHit hits[MAX_HITS];
+
+	size_t needleCount = (documentCount + NEEDLE_INTERVAL - 1) / NEEDLE_INTERVAL;
+	CHECK(needleCount <= MAX_HITS);
+	CHECK(textindex_search(index, "needle in the haystack", 0, UINT64_MAX, hits, MAX_HITS) == needleCount);
+	for (size_t i = 0; i < needleCount; i++) {
+		uint64_t expected = (needleCount - 1 - i) * NEEDLE_INTERVAL;
+		CHECK(hits[i].document == expected && hits[i].timestampMs == expected);
+		CHECK(hits[i].userID == expected % 16);
+	}
+
+	// A range that covers documents of several segments
+	CHECK(textindex_search(index, "needle", 5000, 20000, hits, MAX_HITS) == 16);
+	CHECK(hits[0].timestampMs == 20000 && hits[15].timestampMs == 5000);
+
+	// A term that is part of every document (a long posting list crossing the merged segments' boundaries)
+	CHECK(textindex_search(index, "hay", documentCount - 3, documentCount - 1, hits, MAX_HITS) == 3);
+	CHECK(textindex_search(index, "straw", 0, UINT64_MAX, hits, 1) == 1);
+	CHECK(hits[0].document == documentCount - 1);
+
+	return true;
+}
+
+static bool testSegments() {
+	char directory[] = "/tmp/hello_mumble-textindex-test-XXXXXX";
+	CHECK(mkdtemp(directory));
+
+	struct TextIndex *index = textindex_create(directory);
+	CHECK(index);
+
+	// Every batch fills the in-memory table, which is written into a segment of its own...
+	uint64_t documentCount = 0;
+	for (size_t i = 1; i < TEXTINDEX_MERGE_FACTOR; i++) {
+		CHECK(addDocuments(index, documentCount, TEXTINDEX_FLUSH_DOCUMENTS));
+		documentCount += TEXTINDEX_FLUSH_DOCUMENTS;
+		CHECK(waitForSegments(directory, i));
+	}
+	CHECK(findNeedles(index, documentCount));
+
+	// ...until the last one makes the segments be merged into one
+	CHECK(addDocuments(index, documentCount, TEXTINDEX_FLUSH_DOCUMENTS));
+	documentCount += TEXTINDEX_FLUSH_DOCUMENTS;
+	CHECK(waitForSegments(directory, 1));
+	CHECK(findNeedles(index, documentCount));
+
+	// Documents that haven't been written yet are written when the index is destroyed
+	CHECK(addDocuments(index, documentCount, 10));
+	documentCount += 10;
+	textindex_destroy(index);
+	CHECK(countSegments(directory) == 2);
+
+	// The reopened index continues the documents' numbering
+	index = textindex_create(directory);
+	CHECK(index);
+	CHECK(findNeedles(index, documentCount));
+	CHECK(textindex_add(index, TEXTINDEX_EVENT, 1, 2, documentCount, "needle in the haystack again"));
+
+	struct TextIndexHit hit;
+	CHECK(textindex_search(index, "again", 0, UINT64_MAX, &hit, 1) == 1);
+	CHECK(hit.document == documentCount);
+
+	textindex_destroy(index);
+	removeDirectory(directory);
+
+	return true;
+}
+
+int main() {
+	bool (*tests[])() = { &testQueries, &testSegments };
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		passed = tests[i]() && passed;
+	}
+
+	struct MemoryUsage usage[MEMORY_SUBSYSTEM_COUNT];
+	memory_getUsage(usage);
+	if (usage[MEMORY_TEXTINDEX].blocks != 0) {
+		fprintf(stderr, "Leaked %zu blocks\n", usage[MEMORY_TEXTINDEX].blocks);
+		passed = false;
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
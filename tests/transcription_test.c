@@ -0,0 +1,318 @@
+// Drives the transcriber with synthetic audio and a fake recognizer: segments piling up while the recognizer is busy
+// are recognized in a single batch, segments that have waited longer than the latency budget are dropped, long
+// monologues continue in a new segment every TRANSCRIPTION_MAX_SEGMENT_MS and the decimated samples keep the input's
+// level.
+
+#include "memory.h"
+#include "transcription.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_CAPTIONS 64
+#define MAX_CALLS 64
+#define FRAME_MS 10
+#define WAIT_TIMEOUT_MS 5000
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+struct Caption {
+	mumble_userid_t userID;
+	uint64_t startMs;
+	size_t sampleCount;
+	bool continued;
+	enum TranscriptionResult result;
+	char text[TRANSCRIPTION_MAX_TEXT];
+	// The smallest and largest sample of the segment
+	int16_t minimum;
+	int16_t maximum;
+};
+
+static pthread_mutex_t captionsLock = PTHREAD_MUTEX_INITIALIZER;
+static struct Caption captions[MAX_CAPTIONS];
+static size_t captionCount;
+
+// The amount of segments passed to every call of the recognizer
+static size_t batchSizes[MAX_CALLS];
+static atomic_size_t callCount;
+// The first call of the recognizer waits until it is released, so that segments pile up behind it
+static atomic_bool holdFirstCall;
+
+static void sleepMs(unsigned int ms) {
+	struct timespec duration = { ms / 1000, (long) (ms % 1000) * 1000000L };
+	nanosleep(&duration, NULL);
+}
+
+static bool recognize(void *userData, const void *model, size_t modelSize, const struct TranscriptionSegment *segments,
+					  size_t segmentCount, char (*texts)[TRANSCRIPTION_MAX_TEXT]) {
+	(void) userData;
+	(void) model;
+	(void) modelSize;
+
+	size_t call = atomic_fetch_add(&callCount, 1);
+	if (call < MAX_CALLS) {
+		batchSizes[call] = segmentCount;
+	}
+	while (call == 0 && atomic_load(&holdFirstCall)) {
+		sleepMs(1);
+	}
+
+	for (size_t i = 0; i < segmentCount; i++) {
+		snprintf(texts[i], TRANSCRIPTION_MAX_TEXT, "user %u", segments[i].userID);
+	}
+
+	return true;
+}
+
+static void onCaption(void *userData, const struct TranscriptionSegment *segment, enum TranscriptionResult result,
+					  const char *text) {
+	(void) userData;
+
+	pthread_mutex_lock(&captionsLock);
+	if (captionCount < MAX_CAPTIONS) {
+		struct Caption *caption = &captions[captionCount++];
+		caption->userID         = segment->userID;
+		caption->startMs        = segment->startMs;
+		caption->sampleCount    = segment->sampleCount;
+		caption->continued      = segment->continued;
+		caption->result         = result;
+		snprintf(caption->text, sizeof(caption->text), "%s", text ? text : "");
+
+		caption->minimum = segment->sampleCount > 0 ? segment->samples[0] : 0;
+		caption->maximum = caption->minimum;
+		for (size_t i = 0; i < segment->sampleCount; i++) {
+			caption->minimum = segment->samples[i] < caption->minimum ? segment->samples[i] : caption->minimum;
+			caption->maximum = segment->samples[i] > caption->maximum ? segment->samples[i] : caption->maximum;
+		}
+	}
+	pthread_mutex_unlock(&captionsLock);
+}
+
+static void reset() {
+	pthread_mutex_lock(&captionsLock);
+	captionCount = 0;
+	pthread_mutex_unlock(&captionsLock);
+	atomic_store(&callCount, 0);
+	atomic_store(&holdFirstCall, false);
+}
+
+static size_t countCaptions() {
+	pthread_mutex_lock(&captionsLock);
+	size_t count = captionCount;
+	pthread_mutex_unlock(&captionsLock);
+
+	return count;
+}
+
+static bool waitForCaptions(size_t count) {
+	for (unsigned int waited = 0; countCaptions() < count; waited++) {
+		if (waited == WAIT_TIMEOUT_MS) {
+			return false;
+		}
+		sleepMs(1);
+	}
+
+	return true;
+}
+
+// Feeds the given duration of a constant signal to the speaker's segment in frames of FRAME_MS
+static void speak(struct Transcriber *transcriber, mumble_userid_t userID, unsigned int durationMs,
+				  uint32_t sampleRate, uint16_t channelCount, float value) {
+	static float frame[48000 / 1000 * FRAME_MS * 2];
+	uint32_t frameSamples = sampleRate * FRAME_MS / 1000;
+	for (size_t i = 0; i < (size_t) frameSamples * channelCount; i++) {
+		frame[i] = value;
+	}
+
+	for (unsigned int elapsed = 0; elapsed < durationMs; elapsed += FRAME_MS) {
+		transcription_process(transcriber, userID, frame, frameSamples, channelCount, sampleRate);
+	}
+}
+
+static void talk(struct Transcriber *transcriber, mumble_userid_t userID, unsigned int durationMs) {
+	transcription_setTalking(transcriber, userID, true);
+	speak(transcriber, userID, durationMs, 48000, 1, 0.25f);
+	transcription_setTalking(transcriber, userID, false);
+}
+
+static bool testBatching() {
+	reset();
+	struct Transcriber *transcriber = transcription_create(NULL, &recognize, &onCaption, NULL, 1, 60000);
+	CHECK(transcriber);
+
+	// The only worker is kept busy with the first segment while three more speakers finish theirs
+	atomic_store(&holdFirstCall, true);
+	talk(transcriber, 1, 500);
+	for (unsigned int waited = 0; atomic_load(&callCount) == 0 && waited < WAIT_TIMEOUT_MS; waited++) {
+		sleepMs(1);
+	}
+	CHECK(atomic_load(&callCount) == 1);
+
+	talk(transcriber, 2, 500);
+	talk(transcriber, 3, 500);
+	talk(transcriber, 4, 500);
+	// Too short to be recognized at all
+	talk(transcriber, 5, TRANSCRIPTION_MIN_SEGMENT_MS / 2);
+	atomic_store(&holdFirstCall, false);
+
+	CHECK(waitForCaptions(4));
+	sleepMs(50);
+	transcription_destroy(transcriber);
+
+	CHECK(countCaptions() == 4);
+	CHECK(atomic_load(&callCount) == 2);
+	CHECK(batchSizes[0] == 1 && batchSizes[1] == 3);
+	for (size_t i = 0; i < 4; i++) {
+		char expected[TRANSCRIPTION_MAX_TEXT];
+		snprintf(expected, sizeof(expected), "user %u", captions[i].userID);
+		CHECK(captions[i].result == TRANSCRIPTION_CAPTIONED);
+		CHECK(strcmp(captions[i].text, expected) == 0);
+		CHECK(captions[i].sampleCount == TRANSCRIPTION_SAMPLE_RATE / 2);
+		CHECK(!captions[i].continued);
+	}
+
+	return true;
+}
+
+static bool testLatencyBudget() {
+	reset();
+	struct Transcriber *transcriber = transcription_create(NULL, &recognize, &onCaption, NULL, 1, 100);
+	CHECK(transcriber);
+
+	atomic_store(&holdFirstCall, true);
+	talk(transcriber, 1, 500);
+	for (unsigned int waited = 0; atomic_load(&callCount) == 0 && waited < WAIT_TIMEOUT_MS; waited++) {
+		sleepMs(1);
+	}
+	talk(transcriber, 2, 500);
+	talk(transcriber, 3, 500);
+
+	// Both wait for the busy worker for longer than the budget
+	sleepMs(300);
+	atomic_store(&holdFirstCall, false);
+
+	CHECK(waitForCaptions(3));
+	sleepMs(50);
+	transcription_destroy(transcriber);
+
+	CHECK(atomic_load(&callCount) == 1);
+	CHECK(captions[0].userID == 1 && captions[0].result == TRANSCRIPTION_CAPTIONED);
+	for (size_t i = 1; i < 3; i++) {
+		CHECK(captions[i].result == TRANSCRIPTION_DROPPED);
+		CHECK(captions[i].text[0] == '\0');
+		CHECK(captions[i].sampleCount == TRANSCRIPTION_SAMPLE_RATE / 2);
+	}
+
+	return true;
+}
+
+static bool testContinuation() {
+	reset();
+	struct Transcriber *transcriber = transcription_create(NULL, &recognize, &onCaption, NULL, 2, 60000);
+	CHECK(transcriber);
+
+	// Audio beyond the segment's capacity is lost until the next tick starts the continuation
+	transcription_setTalking(transcriber, 7, true);
+	speak(transcriber, 7, TRANSCRIPTION_MAX_SEGMENT_MS + 500, 48000, 2, 0.25f);
+	transcription_tick(transcriber);
+	speak(transcriber, 7, 1000, 48000, 2, 0.25f);
+	transcription_setTalking(transcriber, 7, false);
+
+	CHECK(waitForCaptions(2));
+	transcription_destroy(transcriber);
+
+	// Either worker may report first
+	struct Caption *first  = captions[0].continued ? &captions[1] : &captions[0];
+	struct Caption *second = captions[0].continued ? &captions[0] : &captions[1];
+	CHECK(!first->continued && second->continued);
+	CHECK(first->sampleCount == (size_t) TRANSCRIPTION_MAX_SEGMENT_MS * TRANSCRIPTION_SAMPLE_RATE / 1000);
+	CHECK(second->sampleCount == TRANSCRIPTION_SAMPLE_RATE);
+	CHECK(second->startMs == first->startMs + TRANSCRIPTION_MAX_SEGMENT_MS);
+	CHECK(first->userID == 7 && second->userID == 7);
+
+	return true;
+}
+
+// Decimates a second of a constant signal into a single segment
+static bool decimate(uint32_t sampleRate, uint16_t channelCount, float value, struct Caption *caption) {
+	reset();
+	struct Transcriber *transcriber = transcription_create(NULL, NULL, &onCaption, NULL, 1, 60000);
+	CHECK(transcriber);
+
+	transcription_setTalking(transcriber, 9, true);
+	speak(transcriber, 9, 1000, sampleRate, channelCount, value);
+	transcription_setTalking(transcriber, 9, false);
+
+	bool reported = waitForCaptions(1);
+	transcription_destroy(transcriber);
+	CHECK(reported);
+
+	*caption = captions[0];
+	// Without a recognizer, segments are still reported
+	CHECK(caption->result == TRANSCRIPTION_UNRECOGNIZED);
+
+	return true;
+}
+
+static bool testDecimation() {
+	struct Caption caption;
+
+	// Downmixing averages the channels
+	CHECK(decimate(48000, 2, 0.5f, &caption));
+	CHECK(caption.sampleCount == TRANSCRIPTION_SAMPLE_RATE);
+	CHECK(caption.minimum >= 16382 && caption.maximum <= 16384);
+
+	CHECK(decimate(48000, 1, -0.25f, &caption));
+	CHECK(caption.sampleCount == TRANSCRIPTION_SAMPLE_RATE);
+	CHECK(caption.minimum >= -8192 && caption.maximum <= -8190);
+
+	// Rates that aren't a multiple of the segments' rate
+	CHECK(decimate(44100, 1, 0.5f, &caption));
+	CHECK(caption.sampleCount >= TRANSCRIPTION_SAMPLE_RATE - 1 && caption.sampleCount <= TRANSCRIPTION_SAMPLE_RATE);
+	CHECK(caption.minimum >= 16382 && caption.maximum <= 16384);
+
+	// Levels beyond full scale are clipped
+	CHECK(decimate(48000, 1, 2.0f, &caption));
+	CHECK(caption.minimum == 32767 && caption.maximum == 32767);
+
+	// Audio below the segments' rate is ignored, which leaves a segment that is too short to be reported
+	reset();
+	struct Transcriber *transcriber = transcription_create(NULL, NULL, &onCaption, NULL, 1, 60000);
+	CHECK(transcriber);
+	transcription_setTalking(transcriber, 9, true);
+	speak(transcriber, 9, 1000, 8000, 1, 0.5f);
+	transcription_setTalking(transcriber, 9, false);
+	sleepMs(50);
+	transcription_destroy(transcriber);
+	CHECK(countCaptions() == 0);
+
+	return true;
+}
+
+int main() {
+	bool (*tests[])() = { &testBatching, &testLatencyBudget, &testContinuation, &testDecimation };
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		passed = tests[i]() && passed;
+	}
+
+	struct MemoryUsage usage[MEMORY_SUBSYSTEM_COUNT];
+	memory_getUsage(usage);
+	if (usage[MEMORY_TRANSCRIPTION].blocks != 0) {
+		fprintf(stderr, "Leaked %zu blocks\n", usage[MEMORY_TRANSCRIPTION].blocks);
+		passed = false;
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
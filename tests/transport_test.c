@@ -0,0 +1,316 @@
+// Runs the transport over a simulated network that loses, delays and reorders packets and checks that every message
+// arrives intact and in order, also when either side restarts in the middle of a stream.
+
+#include "transport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_IN_FLIGHT 65536
+#define STEP_MS 5
+#define TICK_INTERVAL_MS 50
+#define MAX_ENDPOINTS 16
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+struct Endpoint {
+	struct Transport *transport;
+	mumble_userid_t id;
+	// The amount of packets it may still send, all further ones are lost (SIZE_MAX for no limit)
+	size_t sendLimit;
+	// The index of the last message that has been delivered to it (-1 if there hasn't been any)
+	long lastIndex;
+	size_t deliveredCount;
+	bool outOfOrder;
+	bool corrupted;
+};
+
+struct Packet {
+	struct Endpoint *to;
+	mumble_userid_t from;
+	uint64_t arrivesAt;
+	size_t length;
+	uint8_t data[TRANSPORT_MTU];
+};
+
+static struct Endpoint endpoints[MAX_ENDPOINTS];
+static size_t endpointCount;
+static struct Packet inFlight[MAX_IN_FLIGHT];
+static size_t inFlightCount;
+static uint64_t nowMs;
+static float lossRate;
+static unsigned long long rngState = 88172645463325252ULL;
+
+// Packets from the first session of a restarted sender, which are replayed later on
+static struct Packet recorded[4096];
+static size_t recordedCount;
+static bool recording;
+
+static unsigned long long nextRandom() {
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 7;
+	rngState ^= rngState << 17;
+	return rngState;
+}
+
+static size_t messageLength(long index) {
+	return 4 + (size_t) (index * 7919) % 4000;
+}
+
+static uint8_t messageByte(long index, size_t offset) {
+	return (uint8_t) (index * 31 + (long) offset);
+}
+
+static void deliverMessage(void *userData, mumble_connection_t connection, mumble_userid_t peer,
+						   const uint8_t *data, size_t dataLength) {
+	(void) connection;
+	(void) peer;
+
+	struct Endpoint *endpoint = userData;
+	long index = (long) ((uint32_t) data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16
+						 | (uint32_t) data[3] << 24);
+
+	if (dataLength != messageLength(index)) {
+		endpoint->corrupted = true;
+	}
+	for (size_t i = 4; i < dataLength && !endpoint->corrupted; i++) {
+		endpoint->corrupted = data[i] != messageByte(index, i);
+	}
+	if (endpoint->lastIndex >= 0 && index != endpoint->lastIndex + 1) {
+		endpoint->outOfOrder = true;
+	}
+
+	endpoint->lastIndex = index;
+	endpoint->deliveredCount++;
+}
+
+static mumble_error_t sendPacket(void *userData, mumble_connection_t connection, mumble_userid_t peer,
+								 const uint8_t *data, size_t dataLength) {
+	(void) connection;
+
+	struct Endpoint *endpoint = userData;
+	if (endpoint->sendLimit == 0) {
+		return MUMBLE_STATUS_OK;
+	}
+	if (endpoint->sendLimit != SIZE_MAX) {
+		endpoint->sendLimit--;
+	}
+
+	struct Endpoint *to = NULL;
+	for (size_t i = 0; i < endpointCount; i++) {
+		if (endpoints[i].id == peer) {
+			to = &endpoints[i];
+		}
+	}
+
+	if (recording && recordedCount < sizeof(recorded) / sizeof(recorded[0])) {
+		recorded[recordedCount].to     = to;
+		recorded[recordedCount].from   = endpoint->id;
+		recorded[recordedCount].length = dataLength;
+		memcpy(recorded[recordedCount].data, data, dataLength);
+		recordedCount++;
+	}
+
+	if (!to || inFlightCount == MAX_IN_FLIGHT || (float) (nextRandom() % 1000) < lossRate * 1000.0f) {
+		return MUMBLE_STATUS_OK;
+	}
+
+	// A random delay reorders packets
+	struct Packet *packet = &inFlight[inFlightCount++];
+	packet->to            = to;
+	packet->from          = endpoint->id;
+	packet->arrivesAt     = nowMs + 5 + nextRandom() % 80;
+	packet->length        = dataLength;
+	memcpy(packet->data, data, dataLength);
+
+	return MUMBLE_STATUS_OK;
+}
+
+static struct Endpoint *addEndpoint(mumble_userid_t id) {
+	struct Endpoint *endpoint = &endpoints[endpointCount++];
+	memset(endpoint, 0, sizeof(*endpoint));
+	endpoint->id        = id;
+	endpoint->sendLimit = SIZE_MAX;
+	endpoint->lastIndex = -1;
+	endpoint->transport = transport_create(&sendPacket, &deliverMessage, endpoint);
+
+	return endpoint->transport ? endpoint : NULL;
+}
+
+// Replaces the endpoint's transport with a new one, as if the plugin had been restarted
+static bool restartEndpoint(struct Endpoint *endpoint) {
+	transport_destroy(endpoint->transport);
+	endpoint->transport  = transport_create(&sendPacket, &deliverMessage, endpoint);
+	endpoint->lastIndex  = -1;
+	endpoint->outOfOrder = false;
+
+	return endpoint->transport;
+}
+
+static void removeEndpoints() {
+	for (size_t i = 0; i < endpointCount; i++) {
+		transport_destroy(endpoints[i].transport);
+	}
+	endpointCount = 0;
+	inFlightCount = 0;
+	recordedCount = 0;
+	recording     = false;
+}
+
+static bool sendMessage(struct Endpoint *from, struct Endpoint *to, long index) {
+	static uint8_t message[TRANSPORT_MAX_MESSAGE_SIZE];
+	size_t length = messageLength(index);
+	for (size_t i = 0; i < 4; i++) {
+		message[i] = (uint8_t) (index >> (8 * i));
+	}
+	for (size_t i = 4; i < length; i++) {
+		message[i] = messageByte(index, i);
+	}
+
+	return transport_send(from->transport, 1, to->id, message, length, nowMs) == MUMBLE_STATUS_OK;
+}
+
+// Advances the simulated time by the given amount, delivering and ticking along the way
+static void run(uint64_t durationMs) {
+	for (uint64_t end = nowMs + durationMs; nowMs < end;) {
+		nowMs += STEP_MS;
+
+		for (size_t i = 0; i < inFlightCount;) {
+			if (inFlight[i].arrivesAt > nowMs) {
+				i++;
+				continue;
+			}
+
+			struct Packet packet = inFlight[i];
+			inFlight[i]          = inFlight[--inFlightCount];
+			transport_receive(packet.to->transport, 1, packet.from, packet.data, packet.length, nowMs);
+		}
+
+		if (nowMs % TICK_INTERVAL_MS == 0) {
+			for (size_t i = 0; i < endpointCount; i++) {
+				transport_tick(endpoints[i].transport, nowMs);
+			}
+		}
+	}
+}
+
+static bool testLossAndReordering() {
+	struct Endpoint *a = addEndpoint(1);
+	struct Endpoint *b = addEndpoint(2);
+	CHECK(a && b);
+	lossRate = 0.1f;
+
+	for (long i = 0; i < 300; i++) {
+		CHECK(sendMessage(a, b, i));
+		CHECK(sendMessage(b, a, i));
+		run(20);
+	}
+	run(600000);
+
+	CHECK(!a->corrupted && !b->corrupted && !a->outOfOrder && !b->outOfOrder);
+	CHECK(a->deliveredCount == 300 && b->deliveredCount == 300);
+
+	return true;
+}
+
+// A receiver that starts in the middle of a stream continues with the sender's oldest unacknowledged fragment
+static bool testReceiverRestart() {
+	struct Endpoint *a = addEndpoint(1);
+	struct Endpoint *b = addEndpoint(2);
+	CHECK(a && b);
+	lossRate = 0.1f;
+
+	for (long i = 0; i < 200; i++) {
+		CHECK(sendMessage(a, b, i));
+		run(20);
+		if (i == 100) {
+			CHECK(restartEndpoint(b));
+		}
+	}
+	run(120000);
+
+	// Only the message that was being reassembled during the restart may be lost
+	CHECK(!b->corrupted && !b->outOfOrder);
+	CHECK(b->lastIndex == 199);
+
+	return true;
+}
+
+// Delayed packets of a sender's previous session must not disturb its current one
+static bool testStaleSession() {
+	struct Endpoint *a = addEndpoint(1);
+	struct Endpoint *b = addEndpoint(2);
+	CHECK(a && b);
+	lossRate = 0.1f;
+
+	recording = true;
+	for (long i = 0; i < 50; i++) {
+		CHECK(sendMessage(a, b, i));
+		run(20);
+	}
+	recording = false;
+	run(120000);
+	CHECK(b->deliveredCount == 50);
+
+	CHECK(restartEndpoint(a));
+	b->lastIndex = -1;
+	for (long i = 0; i < 100; i++) {
+		CHECK(sendMessage(a, b, i));
+		run(20);
+
+		const struct Packet *stale = &recorded[nextRandom() % recordedCount];
+		transport_receive(b->transport, 1, stale->from, stale->data, stale->length, nowMs);
+	}
+	run(120000);
+
+	CHECK(!b->corrupted && !b->outOfOrder);
+	CHECK(b->deliveredCount == 150);
+
+	return true;
+}
+
+// Senders that give up in the middle of a message must not hold on to the receiver's reassembly buffers
+static bool testAbandonedReassembly() {
+	struct Endpoint *receiver = addEndpoint(2);
+	CHECK(receiver);
+	lossRate = 0.0f;
+
+	for (size_t i = 0; i < TRANSPORT_REASSEMBLY_POOL_SIZE; i++) {
+		struct Endpoint *abandoning = addEndpoint((mumble_userid_t) (10 + i));
+		CHECK(abandoning);
+		// Only the message's first fragment ever leaves
+		abandoning->sendLimit = 1;
+		CHECK(sendMessage(abandoning, receiver, 10));
+	}
+	// The pool is exhausted for a while, but not for as long as the sender keeps retransmitting
+	run(20000);
+
+	struct Endpoint *sender = addEndpoint(1);
+	CHECK(sender);
+	CHECK(sendMessage(sender, receiver, 10));
+	run(60000);
+
+	CHECK(!receiver->corrupted);
+	CHECK(receiver->deliveredCount == 1);
+
+	return true;
+}
+
+int main() {
+	bool (*tests[])() = { &testLossAndReordering, &testReceiverRestart, &testStaleSession, &testAbandonedReassembly };
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		passed = tests[i]() && passed;
+		removeEndpoints();
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
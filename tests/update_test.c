@@ -0,0 +1,442 @@
+// Fetches manifests from a TLS server on the loopback interface that stands in for the update server. Its certificate
+// is created on the fly and handed to the checker as its CA file. The server answers a single request per test with a
+// canned response: a manifest, a 304 revalidating the cached one, a chunked manifest, nothing at all (to check the
+// timeout), or a handshake with a certificate the checker doesn't trust.
+
+#include "memory.h"
+#include "update.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ACCEPT_TIMEOUT_MS 5000
+#define WAIT_TIMEOUT_MS 5000
+#define SHORT_TIMEOUT_MS 300
+#define MAX_REQUEST 2048
+
+#define CHECK(condition)                                                               \
+	do {                                                                               \
+		if (!(condition)) {                                                            \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			return false;                                                              \
+		}                                                                              \
+	} while (0)
+
+static const mumble_version_t currentVersion = { 1, 0, 0 };
+
+// The certificate the server presents and the one the checker trusts (unless a test swaps them)
+static char serverCertificatePath[64];
+static char otherCertificatePath[64];
+static char directory[] = "/tmp/hello_mumble-update-test-XXXXXX";
+
+// A server that answers a single connection on a thread of its own
+struct Server {
+	int listenFD;
+	unsigned short port;
+	SSL_CTX *context;
+	pthread_t thread;
+	// The response to send (NULL to send nothing until the client gives up)
+	const char *response;
+
+	char request[MAX_REQUEST];
+	bool accepted;
+	bool handshakeFailed;
+	// How long the client kept the connection open while waiting for a response
+	uint64_t waitedMs;
+};
+
+static uint64_t currentTimeMs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static void sleepMs(unsigned int ms) {
+	struct timespec duration = { ms / 1000, (long) (ms % 1000) * 1000000L };
+	nanosleep(&duration, NULL);
+}
+
+static bool addExtension(X509 *certificate, int nid, const char *value) {
+	X509V3_CTX context;
+	X509V3_set_ctx_nodb(&context);
+	X509V3_set_ctx(&context, certificate, certificate, NULL, NULL, 0);
+
+	X509_EXTENSION *extension = X509V3_EXT_conf_nid(NULL, &context, nid, value);
+	bool added                = extension && X509_add_ext(certificate, extension, -1) == 1;
+	X509_EXTENSION_free(extension);
+
+	return added;
+}
+
+// Creates a self-signed certificate for 127.0.0.1
+static X509 *createCertificate(EVP_PKEY *key, long serial) {
+	static const unsigned char commonName[] = "hello_mumble update test";
+
+	X509 *certificate = X509_new();
+	X509_NAME *name   = certificate ? X509_get_subject_name(certificate) : NULL;
+	bool created      = name && X509_set_version(certificate, 2) == 1
+				   && ASN1_INTEGER_set(X509_get_serialNumber(certificate), serial) == 1
+				   && X509_gmtime_adj(X509_getm_notBefore(certificate), -60)
+				   && X509_gmtime_adj(X509_getm_notAfter(certificate), 3600) && X509_set_pubkey(certificate, key) == 1
+				   && X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, commonName, -1, -1, 0) == 1
+				   && X509_set_issuer_name(certificate, name) == 1
+				   && addExtension(certificate, NID_subject_alt_name, "IP:127.0.0.1")
+				   && addExtension(certificate, NID_basic_constraints, "critical,CA:TRUE")
+				   && X509_sign(certificate, key, EVP_sha256()) > 0;
+	if (!created) {
+		X509_free(certificate);
+		return NULL;
+	}
+
+	return certificate;
+}
+
+static EVP_PKEY *createKey() {
+	EVP_PKEY *key         = NULL;
+	EVP_PKEY_CTX *context = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+	if (context && EVP_PKEY_keygen_init(context) == 1
+		&& EVP_PKEY_CTX_set_ec_paramgen_curve_nid(context, NID_X9_62_prime256v1) == 1) {
+		EVP_PKEY_keygen(context, &key);
+	}
+	EVP_PKEY_CTX_free(context);
+
+	return key;
+}
+
+static bool writeCertificate(const char *path, X509 *certificate) {
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		return false;
+	}
+
+	bool written = PEM_write_X509(file, certificate) == 1;
+
+	return fclose(file) == 0 && written;
+}
+
+// Creates the server's certificate (written to serverCertificatePath) and a second one that has nothing to do with
+// it (written to otherCertificatePath)
+static bool createServer(struct Server *server) {
+	memset(server, 0, sizeof(*server));
+	server->listenFD = -1;
+
+	EVP_PKEY *key          = createKey();
+	EVP_PKEY *otherKey     = createKey();
+	X509 *certificate      = key ? createCertificate(key, 1) : NULL;
+	X509 *otherCertificate = otherKey ? createCertificate(otherKey, 2) : NULL;
+	server->context        = SSL_CTX_new(TLS_server_method());
+	bool created           = certificate && otherCertificate && server->context
+				   && SSL_CTX_use_certificate(server->context, certificate) == 1
+				   && SSL_CTX_use_PrivateKey(server->context, key) == 1
+				   && writeCertificate(serverCertificatePath, certificate)
+				   && writeCertificate(otherCertificatePath, otherCertificate);
+	X509_free(certificate);
+	X509_free(otherCertificate);
+	EVP_PKEY_free(key);
+	EVP_PKEY_free(otherKey);
+	CHECK(created);
+
+	struct sockaddr_in address;
+	socklen_t addressSize = sizeof(address);
+	memset(&address, 0, sizeof(address));
+	address.sin_family      = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	server->listenFD = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	CHECK(server->listenFD >= 0);
+	CHECK(bind(server->listenFD, (struct sockaddr *) &address, sizeof(address)) == 0);
+	CHECK(listen(server->listenFD, 4) == 0);
+	CHECK(getsockname(server->listenFD, (struct sockaddr *) &address, &addressSize) == 0);
+	server->port = ntohs(address.sin_port);
+
+	return true;
+}
+
+static void destroyServer(struct Server *server) {
+	if (server->listenFD >= 0) {
+		close(server->listenFD);
+	}
+	SSL_CTX_free(server->context);
+}
+
+static void *serve(void *argument) {
+	struct Server *server = argument;
+
+	struct pollfd listening = { server->listenFD, POLLIN, 0 };
+	if (poll(&listening, 1, ACCEPT_TIMEOUT_MS) != 1) {
+		return NULL;
+	}
+	int clientFD = accept(server->listenFD, NULL, NULL);
+	if (clientFD < 0) {
+		return NULL;
+	}
+	server->accepted = true;
+	uint64_t start   = currentTimeMs();
+
+	SSL *tls = SSL_new(server->context);
+	if (!tls || SSL_set_fd(tls, clientFD) != 1 || SSL_accept(tls) != 1) {
+		server->handshakeFailed = true;
+		SSL_free(tls);
+		close(clientFD);
+		return NULL;
+	}
+
+	size_t length = 0;
+	while (length < sizeof(server->request) - 1 && !strstr(server->request, "\r\n\r\n")) {
+		int result = SSL_read(tls, server->request + length, (int) (sizeof(server->request) - 1 - length));
+		if (result <= 0) {
+			break;
+		}
+		length += (size_t) result;
+		server->request[length] = '\0';
+	}
+
+	if (server->response) {
+		SSL_write(tls, server->response, (int) strlen(server->response));
+		SSL_shutdown(tls);
+	} else {
+		// Nothing is sent, so the client only closes the connection once it has given up
+		char byte;
+		while (SSL_read(tls, &byte, 1) > 0) {
+		}
+		server->waitedMs = currentTimeMs() - start;
+	}
+
+	SSL_free(tls);
+	close(clientFD);
+
+	return NULL;
+}
+
+static bool startServer(struct Server *server, const char *response) {
+	server->response        = response;
+	server->request[0]      = '\0';
+	server->accepted        = false;
+	server->handshakeFailed = false;
+	server->waitedMs        = 0;
+
+	return pthread_create(&server->thread, NULL, &serve, server) == 0;
+}
+
+static struct UpdateChecker *createChecker(const struct Server *server, const char *caFile, unsigned int timeoutMs) {
+	char url[64];
+	snprintf(url, sizeof(url), "https://127.0.0.1:%u/manifest", server->port);
+
+	return update_create(url, directory, currentVersion, caFile, timeoutMs);
+}
+
+static bool waitForUpdate(struct UpdateChecker *checker) {
+	for (uint64_t start = currentTimeMs(); !update_available(checker);) {
+		if (currentTimeMs() - start >= WAIT_TIMEOUT_MS) {
+			return false;
+		}
+		sleepMs(1);
+	}
+
+	return true;
+}
+
+// Reads the cache file (an empty string if there is none)
+static void readCache(char *buffer, size_t size) {
+	char path[128];
+	snprintf(path, sizeof(path), "%s/" UPDATE_CACHE_FILE_NAME, directory);
+
+	size_t length = 0;
+	FILE *file    = fopen(path, "rb");
+	if (file) {
+		length = fread(buffer, 1, size - 1, file);
+		fclose(file);
+	}
+	buffer[length] = '\0';
+}
+
+static void removeCache() {
+	char path[128];
+	snprintf(path, sizeof(path), "%s/" UPDATE_CACHE_FILE_NAME, directory);
+	remove(path);
+}
+
+static bool testFetchAndRevalidate(struct Server *server) {
+	removeCache();
+
+	static const char manifest[] = "HTTP/1.1 200 OK\r\n"
+								   "Content-Type: text/plain\r\n"
+								   "ETag: \"v2\"\r\n"
+								   "Last-Modified: Mon, 19 Oct 2026 08:00:00 GMT\r\n"
+								   "Content-Length: 63\r\n"
+								   "\r\n"
+								   "# The next release\n"
+								   "version = 2.0.0\n"
+								   "url = https://example.com/2\n"
+								   "Ignored trailing bytes";
+	CHECK(startServer(server, manifest));
+	struct UpdateChecker *checker = createChecker(server, serverCertificatePath, UPDATE_TIMEOUT_MS);
+	CHECK(checker);
+	CHECK(!update_available(checker));
+
+	CHECK(waitForUpdate(checker));
+	char url[UPDATE_MAX_URL];
+	CHECK(update_getURL(checker, url, sizeof(url)) == strlen("https://example.com/2"));
+	CHECK(strcmp(url, "https://example.com/2") == 0);
+	update_destroy(checker);
+	pthread_join(server->thread, NULL);
+
+	// Without a cached manifest, the request isn't conditional
+	char host[64];
+	snprintf(host, sizeof(host), "Host: 127.0.0.1:%u\r\n", server->port);
+	CHECK(strncmp(server->request, "GET /manifest HTTP/1.1\r\n", strlen("GET /manifest HTTP/1.1\r\n")) == 0);
+	CHECK(strstr(server->request, host));
+	CHECK(strstr(server->request, "User-Agent: hello_mumble/1.0.0\r\n"));
+	CHECK(!strstr(server->request, "If-None-Match"));
+	CHECK(!strstr(server->request, "If-Modified-Since"));
+
+	char cached[UPDATE_MAX_RESPONSE + 1];
+	readCache(cached, sizeof(cached));
+	CHECK(strstr(cached, "ETag: \"v2\"\r\n"));
+	CHECK(strstr(cached, "\r\n\r\n# The next release\nversion = 2.0.0\nurl = https://example.com/2\n"));
+	CHECK(!strstr(cached, "Ignored"));
+
+	// The cached manifest answers before anything has been fetched, and the server confirms it with a 304
+	CHECK(startServer(server, "HTTP/1.1 304 Not Modified\r\nETag: \"v2\"\r\n\r\n"));
+	checker = createChecker(server, serverCertificatePath, UPDATE_TIMEOUT_MS);
+	CHECK(checker);
+	CHECK(update_available(checker));
+	pthread_join(server->thread, NULL);
+	update_destroy(checker);
+
+	CHECK(strstr(server->request, "If-None-Match: \"v2\"\r\n"));
+	CHECK(strstr(server->request, "If-Modified-Since: Mon, 19 Oct 2026 08:00:00 GMT\r\n"));
+
+	char revalidated[UPDATE_MAX_RESPONSE + 1];
+	readCache(revalidated, sizeof(revalidated));
+	CHECK(strcmp(revalidated, cached) == 0);
+
+	return true;
+}
+
+static bool testChunked(struct Server *server) {
+	removeCache();
+
+	// The chunks split the manifest in the middle of lines, and the first one carries an extension
+	static const char manifest[] = "HTTP/1.1 200 OK\r\n"
+								   "Transfer-Encoding: chunked\r\n"
+								   "\r\n"
+								   "a;name=value\r\n"
+								   "version = \r\n"
+								   "6\r\n"
+								   "3.1.4\n\r\n"
+								   "1C\r\n"
+								   "url = https://example.com/3\n\r\n"
+								   "0\r\n"
+								   "\r\n";
+	CHECK(startServer(server, manifest));
+	struct UpdateChecker *checker = createChecker(server, serverCertificatePath, UPDATE_TIMEOUT_MS);
+	CHECK(checker);
+
+	CHECK(waitForUpdate(checker));
+	char url[UPDATE_MAX_URL];
+	CHECK(update_getURL(checker, url, sizeof(url)) > 0);
+	CHECK(strcmp(url, "https://example.com/3") == 0);
+	update_destroy(checker);
+	pthread_join(server->thread, NULL);
+
+	// The decoded body is cached, without validators
+	char cached[UPDATE_MAX_RESPONSE + 1];
+	readCache(cached, sizeof(cached));
+	CHECK(strstr(cached, "\r\n\r\nversion = 3.1.4\nurl = https://example.com/3\n"));
+
+	return true;
+}
+
+static bool testTimeout(struct Server *server) {
+	removeCache();
+
+	CHECK(startServer(server, NULL));
+	struct UpdateChecker *checker = createChecker(server, serverCertificatePath, SHORT_TIMEOUT_MS);
+	CHECK(checker);
+
+	// The server only returns once the checker has given up and closed the connection
+	pthread_join(server->thread, NULL);
+	CHECK(server->accepted && !server->handshakeFailed);
+	CHECK(server->waitedMs + 50 >= SHORT_TIMEOUT_MS && server->waitedMs < WAIT_TIMEOUT_MS);
+	CHECK(!update_available(checker));
+	update_destroy(checker);
+
+	char cached[UPDATE_MAX_RESPONSE + 1];
+	readCache(cached, sizeof(cached));
+	CHECK(cached[0] == '\0');
+
+	return true;
+}
+
+static bool testUntrusted(struct Server *server) {
+	removeCache();
+
+	// The server presents a certificate that isn't the one in the CA file
+	CHECK(startServer(server, "HTTP/1.1 200 OK\r\n\r\nversion = 9.0.0\nurl = https://example.com/9\n"));
+	struct UpdateChecker *checker = createChecker(server, otherCertificatePath, UPDATE_TIMEOUT_MS);
+	CHECK(checker);
+
+	pthread_join(server->thread, NULL);
+	update_destroy(checker);
+	CHECK(server->accepted && server->handshakeFailed);
+	CHECK(server->request[0] == '\0');
+
+	char cached[UPDATE_MAX_RESPONSE + 1];
+	readCache(cached, sizeof(cached));
+	CHECK(cached[0] == '\0');
+
+	// Plain HTTP (or any other scheme) isn't accepted in the first place
+	CHECK(!update_create("http://127.0.0.1/manifest", directory, currentVersion, NULL, UPDATE_TIMEOUT_MS));
+
+	return true;
+}
+
+int main() {
+	// The checker writes to sockets the server may have closed already
+	signal(SIGPIPE, SIG_IGN);
+
+	if (!mkdtemp(directory)) {
+		return EXIT_FAILURE;
+	}
+	snprintf(serverCertificatePath, sizeof(serverCertificatePath), "%s/server.pem", directory);
+	snprintf(otherCertificatePath, sizeof(otherCertificatePath), "%s/other.pem", directory);
+
+	struct Server server;
+	bool passed = createServer(&server);
+	if (passed) {
+		bool (*tests[])(struct Server *) = { &testFetchAndRevalidate, &testChunked, &testTimeout, &testUntrusted };
+		for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+			passed = tests[i](&server) && passed;
+		}
+	}
+	destroyServer(&server);
+
+	removeCache();
+	remove(serverCertificatePath);
+	remove(otherCertificatePath);
+	rmdir(directory);
+
+	struct MemoryUsage usage[MEMORY_SUBSYSTEM_COUNT];
+	memory_getUsage(usage);
+	if (usage[MEMORY_UPDATE].blocks != 0) {
+		fprintf(stderr, "Leaked %zu blocks\n", usage[MEMORY_UPDATE].blocks);
+		passed = false;
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
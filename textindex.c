@@ -0,0 +1,1551 @@
+#include "textindex.h"
+#include "memory.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#	include <dirent.h>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#define SEGMENT_MAGIC 0x58444948
+#define SEGMENT_VERSION 1
+// "<first document>-<last document>.seg" with both documents as 16 hex digits
+#define SEGMENT_NAME_LENGTH 37
+#define MAX_PATH_LENGTH 4096
+// The maximum amount of segment files that are considered when opening the index
+#define MAX_SEGMENT_FILES (4 * TEXTINDEX_MAX_SEGMENTS)
+// A term takes at least one byte and is followed by a separator
+#define MAX_DOCUMENT_TERMS (TEXTINDEX_MAX_TEXT / 2)
+#define MAX_VARINT_LENGTH 10
+// Marks documents that are missing from a segment (because a segment they had been in couldn't be read)
+#define MISSING_DOCUMENT UINT32_MAX
+#define WAKE_INTERVAL_MS 1000
+// How long to wait before trying to write a segment again after it failed
+#define RETRY_INTERVAL_MS 10000
+
+// A segment file consists of this header followed by the sections in the order of their offsets. The offsets are
+// determined by the counts and sizes (see layOut), so that they can be checked for consistency.
+struct SegmentHeader {
+	uint32_t magic;
+	uint32_t version;
+	// The amount of merges the segment is the result of (0 for segments written from the in-memory table)
+	uint32_t level;
+	uint32_t reserved;
+	uint64_t firstDocument;
+	uint64_t documentCount;
+	uint64_t termCount;
+	uint64_t minTimestampMs;
+	uint64_t maxTimestampMs;
+	// struct DocumentRecord[documentCount] (ordered by document)
+	uint64_t documentsOffset;
+	// struct TermRecord[termCount] (ordered by term)
+	uint64_t termsOffset;
+	uint64_t termBlobOffset;
+	uint64_t termBlobSize;
+	uint64_t textsOffset;
+	uint64_t textsSize;
+	uint64_t postingsOffset;
+	uint64_t postingsSize;
+};
+
+struct DocumentRecord {
+	uint64_t timestampMs;
+	uint64_t textOffset;
+	uint32_t textLength;
+	// An enum TextIndexKind (or MISSING_DOCUMENT)
+	uint32_t kind;
+	uint32_t userID;
+	int32_t channelID;
+};
+
+// A posting list consists of an entry for every document containing the term: the document (relative to the previous
+// entry's, or to the segment's first document for the first entry), the amount of positions and the positions (each
+// relative to the previous one), all as varints.
+struct TermRecord {
+	uint64_t termOffset;
+	uint64_t postingsOffset;
+	uint64_t postingsLength;
+	// The last document containing the term, which is where the posting list of the next segment continues from
+	uint64_t lastDocument;
+	uint32_t termLength;
+	uint32_t documentCount;
+};
+
+struct Segment {
+	const uint8_t *data;
+	size_t size;
+	const struct SegmentHeader *header;
+	const struct DocumentRecord *documents;
+	const struct TermRecord *terms;
+	const uint8_t *termBlob;
+	const char *texts;
+	const uint8_t *postings;
+};
+
+struct MemTerm {
+	// The length of the term (0 if the slot is unused)
+	uint8_t length;
+	char term[TEXTINDEX_MAX_TERM];
+	uint32_t documentCount;
+	uint64_t lastDocument;
+	// Encoded exactly like a segment's posting list
+	uint8_t *postings;
+	size_t postingsLength;
+	size_t postingsCapacity;
+};
+
+// The documents that haven't been written into a segment yet
+struct MemTable {
+	uint64_t firstDocument;
+	struct DocumentRecord *documents;
+	size_t documentCount;
+	size_t documentCapacity;
+	char *texts;
+	size_t textsSize;
+	size_t textsCapacity;
+	// Open addressing with linear probing (the capacity is a power of two)
+	struct MemTerm *terms;
+	size_t termCount;
+	size_t termCapacity;
+	// The sizes of the sections a segment written from the table has
+	size_t termBlobSize;
+	size_t postingsSize;
+	uint64_t minTimestampMs;
+	uint64_t maxTimestampMs;
+	// CLOCK_MONOTONIC when the first document has been added
+	uint64_t createdAt;
+};
+
+struct TextIndex {
+	char directory[MAX_PATH_LENGTH];
+
+	// Protects the active table. Adding documents never takes any other lock.
+	pthread_mutex_t tableLock;
+	// Wakes up the background thread (waited on with the table's lock)
+	pthread_cond_t wake;
+	struct MemTable table;
+	bool stopping;
+
+	// Protects the segments and the frozen table (a table that is being written into a segment), which are only ever
+	// replaced by the background thread. Queries hold it for reading. If both locks are needed, this one is taken
+	// first.
+	pthread_rwlock_t segmentsLock;
+	struct MemTable frozen;
+	bool hasFrozen;
+	// Ordered by document
+	struct Segment *segments[TEXTINDEX_MAX_SEGMENTS];
+	size_t segmentCount;
+
+	pthread_t thread;
+};
+
+struct Token {
+	uint32_t position;
+	uint8_t length;
+	char term[TEXTINDEX_MAX_TERM];
+};
+
+struct PostingCursor {
+	const uint8_t *next;
+	const uint8_t *end;
+	// The current entry's document (before the first entry: the document the first one is relative to)
+	uint64_t document;
+	bool positioned;
+	uint64_t positionCount;
+	const uint8_t *positions;
+	uint32_t documentCount;
+};
+
+struct Query {
+	struct Token terms[TEXTINDEX_MAX_PHRASE_TERMS];
+	size_t termCount;
+	uint64_t fromMs;
+	uint64_t toMs;
+	struct PostingCursor cursors[TEXTINDEX_MAX_PHRASE_TERMS];
+	// The cursors ordered by the amount of documents they have, so that the rarest term leads
+	size_t order[TEXTINDEX_MAX_PHRASE_TERMS];
+	uint32_t positions[TEXTINDEX_MAX_PHRASE_TERMS][MAX_DOCUMENT_TERMS];
+	size_t positionCounts[TEXTINDEX_MAX_PHRASE_TERMS];
+};
+
+// The documents of a table or a segment
+struct Source {
+	uint64_t firstDocument;
+	size_t documentCount;
+	const struct DocumentRecord *documents;
+	const char *texts;
+	size_t textsSize;
+	uint64_t minTimestampMs;
+	uint64_t maxTimestampMs;
+	// Exactly one of them is set
+	const struct MemTable *table;
+	const struct Segment *segment;
+};
+
+static uint64_t monotonicMs() {
+	struct timespec now;
+#ifndef _WIN32
+	clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+	timespec_get(&now, TIME_UTC);
+#endif
+
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static int compareBytes(const void *a, size_t aLength, const void *b, size_t bLength) {
+	int order = memcmp(a, b, aLength < bLength ? aLength : bLength);
+	if (order != 0) {
+		return order;
+	}
+
+	return aLength < bLength ? -1 : aLength > bLength ? 1 : 0;
+}
+
+// Grows an array to hold at least the required amount of elements
+//
+// @returns The (possibly moved) array or NULL if growing it failed (in which case it is left untouched). It is never
+// NULL otherwise, even if nothing is required.
+static void *reserve(void *array, size_t *capacity, size_t required, size_t elementSize) {
+	if (array && required <= *capacity) {
+		return array;
+	}
+
+	size_t grown = *capacity ? *capacity * 2 : 64;
+	while (grown < required) {
+		grown *= 2;
+	}
+	void *resized = memory_realloc(MEMORY_TEXTINDEX, array, grown * elementSize);
+	if (resized) {
+		*capacity = grown;
+	}
+
+	return resized;
+}
+
+
+////////////////////////////////// Encoding //////////////////////////////////
+
+// Writes a LEB128 varint (nothing if output is NULL)
+//
+// @returns The varint's length
+static size_t writeVarint(uint8_t *output, uint64_t value) {
+	size_t length = 0;
+	do {
+		uint8_t byte = value & 0x7F;
+		value >>= 7;
+		if (output) {
+			output[length] = value ? (uint8_t) (byte | 0x80) : byte;
+		}
+		length++;
+	} while (value);
+
+	return length;
+}
+
+static bool readVarint(const uint8_t **cursor, const uint8_t *end, uint64_t *value) {
+	uint64_t result = 0;
+	for (unsigned int shift = 0; shift < 64 && *cursor < end; shift += 7) {
+		uint8_t byte = *(*cursor)++;
+		result |= (uint64_t) (byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			*value = result;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool isWordByte(char character) {
+	unsigned char byte = (unsigned char) character;
+
+	// Anything beyond ASCII is treated as a letter, so that UTF-8 encoded words stay in one piece
+	return (byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || byte >= 0x80;
+}
+
+// Splits a text into terms (writing at most maxTokens of them)
+//
+// @returns The amount of terms in the text
+static size_t tokenize(const char *text, size_t length, struct Token *tokens, size_t maxTokens) {
+	size_t count = 0;
+	for (size_t i = 0; i < length;) {
+		if (!isWordByte(text[i])) {
+			i++;
+			continue;
+		}
+
+		struct Token token;
+		token.position = (uint32_t) count;
+		token.length   = 0;
+		for (; i < length && isWordByte(text[i]); i++) {
+			char character = text[i];
+			if (token.length < TEXTINDEX_MAX_TERM) {
+				token.term[token.length++] =
+					character >= 'A' && character <= 'Z' ? (char) (character - 'A' + 'a') : character;
+			}
+		}
+
+		if (count < maxTokens) {
+			tokens[count] = token;
+		}
+		count++;
+	}
+
+	return count;
+}
+
+static int compareTokens(const void *a, const void *b) {
+	const struct Token *first  = a;
+	const struct Token *second = b;
+	int order                  = compareBytes(first->term, first->length, second->term, second->length);
+	if (order != 0) {
+		return order;
+	}
+
+	return first->position < second->position ? -1 : first->position > second->position;
+}
+
+
+////////////////////////////////// Posting lists //////////////////////////////////
+
+static void cursor_start(struct PostingCursor *cursor, const uint8_t *postings, size_t length, uint64_t firstDocument,
+						 uint32_t documentCount) {
+	cursor->next          = postings;
+	cursor->end           = postings + length;
+	cursor->document      = firstDocument;
+	cursor->positioned    = false;
+	cursor->positionCount = 0;
+	cursor->positions     = NULL;
+	cursor->documentCount = documentCount;
+}
+
+// Moves on to the next entry
+//
+// @returns Whether there has been another one (false for the rest of a corrupted list as well)
+static bool cursor_next(struct PostingCursor *cursor) {
+	uint64_t delta;
+	uint64_t count;
+	if (!readVarint(&cursor->next, cursor->end, &delta) || !readVarint(&cursor->next, cursor->end, &count)
+		|| (cursor->positioned && delta == 0)) {
+		cursor->next = cursor->end;
+		return false;
+	}
+
+	cursor->document += delta;
+	cursor->positioned    = true;
+	cursor->positionCount = count;
+	cursor->positions     = cursor->next;
+
+	// Skipping the positions only needs to find the varints' last bytes
+	for (uint64_t i = 0; i < count; i++) {
+		while (cursor->next < cursor->end && (*cursor->next & 0x80)) {
+			cursor->next++;
+		}
+		if (cursor->next == cursor->end) {
+			return false;
+		}
+		cursor->next++;
+	}
+
+	return true;
+}
+
+// Moves on to the first entry of the given document or of the first one after it
+static bool cursor_advance(struct PostingCursor *cursor, uint64_t document) {
+	while (!cursor->positioned || cursor->document < document) {
+		if (!cursor_next(cursor)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static size_t cursor_readPositions(const struct PostingCursor *cursor, uint32_t *positions) {
+	const uint8_t *next = cursor->positions;
+	uint64_t position   = 0;
+	size_t count        = 0;
+	for (uint64_t i = 0; i < cursor->positionCount && count < MAX_DOCUMENT_TERMS; i++) {
+		uint64_t delta;
+		if (!readVarint(&next, cursor->end, &delta)) {
+			break;
+		}
+		position += delta;
+		positions[count++] = (uint32_t) position;
+	}
+
+	return count;
+}
+
+
+////////////////////////////////// Table //////////////////////////////////
+
+static void table_init(struct MemTable *table, uint64_t firstDocument) {
+	memset(table, 0, sizeof(struct MemTable));
+	table->firstDocument  = firstDocument;
+	table->minTimestampMs = UINT64_MAX;
+}
+
+static void table_free(struct MemTable *table) {
+	for (size_t i = 0; i < table->termCapacity; i++) {
+		memory_free(table->terms[i].postings);
+	}
+	memory_free(table->terms);
+	memory_free(table->documents);
+	memory_free(table->texts);
+}
+
+static uint64_t hashTerm(const char *term, size_t length) {
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; i++) {
+		hash = (hash ^ (unsigned char) term[i]) * 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+// Returns the slot the term is in or would have to be inserted at
+static struct MemTerm *table_slot(const struct MemTable *table, const char *term, size_t length) {
+	size_t mask = table->termCapacity - 1;
+	for (size_t i = hashTerm(term, length) & mask;; i = (i + 1) & mask) {
+		struct MemTerm *slot = &table->terms[i];
+		if (slot->length == 0 || (slot->length == length && memcmp(slot->term, term, length) == 0)) {
+			return slot;
+		}
+	}
+}
+
+static const struct MemTerm *table_find(const struct MemTable *table, const char *term, size_t length) {
+	if (table->termCapacity == 0) {
+		return NULL;
+	}
+
+	const struct MemTerm *slot = table_slot(table, term, length);
+
+	return slot->length != 0 ? slot : NULL;
+}
+
+static struct MemTerm *table_insert(struct MemTable *table, const char *term, size_t length) {
+	// The table is kept at most 70% full
+	if ((table->termCount + 1) * 10 > table->termCapacity * 7) {
+		size_t capacity         = table->termCapacity ? table->termCapacity * 2 : 1024;
+		struct MemTerm *resized = memory_calloc(MEMORY_TEXTINDEX, capacity, sizeof(struct MemTerm));
+		if (!resized) {
+			return NULL;
+		}
+
+		struct MemTable grown = *table;
+		grown.terms           = resized;
+		grown.termCapacity    = capacity;
+		for (size_t i = 0; i < table->termCapacity; i++) {
+			if (table->terms[i].length != 0) {
+				*table_slot(&grown, table->terms[i].term, table->terms[i].length) = table->terms[i];
+			}
+		}
+		memory_free(table->terms);
+		table->terms        = resized;
+		table->termCapacity = capacity;
+	}
+
+	struct MemTerm *slot = table_slot(table, term, length);
+	if (slot->length == 0) {
+		slot->length = (uint8_t) length;
+		memcpy(slot->term, term, length);
+		table->termCount++;
+		table->termBlobSize += length;
+	}
+
+	return slot;
+}
+
+// Appends the document's entry to the term's posting list
+//
+// @param tokens The term's occurrences in the document (ordered by position)
+static void table_appendPosting(struct MemTable *table, struct MemTerm *term, uint64_t document,
+								const struct Token *tokens, size_t count) {
+	uint8_t *postings =
+		reserve(term->postings, &term->postingsCapacity, term->postingsLength + (2 + count) * MAX_VARINT_LENGTH, 1);
+	if (!postings) {
+		return;
+	}
+	term->postings = postings;
+
+	size_t length = term->postingsLength;
+	length += writeVarint(postings + length,
+						  document - (term->documentCount ? term->lastDocument : table->firstDocument));
+	length += writeVarint(postings + length, count);
+	for (size_t i = 0; i < count; i++) {
+		length += writeVarint(postings + length, tokens[i].position - (i > 0 ? tokens[i - 1].position : 0));
+	}
+
+	table->postingsSize += length - term->postingsLength;
+	term->postingsLength = length;
+	term->lastDocument   = document;
+	term->documentCount++;
+}
+
+// Adds a document to the table
+//
+// @param tokens The document's terms, ordered by term and position
+// @returns Whether the document has been added. If adding any of its terms fails, it is added without them.
+static bool table_add(struct MemTable *table, const struct DocumentRecord *record, const char *text,
+					  const struct Token *tokens, size_t tokenCount) {
+	// The document itself is stored first, so that the posting lists never refer to a document that doesn't exist
+	struct DocumentRecord *documents =
+		reserve(table->documents, &table->documentCapacity, table->documentCount + 1, sizeof(struct DocumentRecord));
+	if (!documents) {
+		return false;
+	}
+	table->documents = documents;
+
+	char *texts = reserve(table->texts, &table->textsCapacity, table->textsSize + record->textLength, 1);
+	if (!texts) {
+		return false;
+	}
+	table->texts = texts;
+
+	uint64_t document                                 = table->firstDocument + table->documentCount;
+	table->documents[table->documentCount]            = *record;
+	table->documents[table->documentCount].textOffset = table->textsSize;
+	memcpy(table->texts + table->textsSize, text, record->textLength);
+	table->textsSize += record->textLength;
+	if (table->documentCount == 0) {
+		table->createdAt = monotonicMs();
+	}
+	table->documentCount++;
+
+	if (record->timestampMs < table->minTimestampMs) {
+		table->minTimestampMs = record->timestampMs;
+	}
+	if (record->timestampMs > table->maxTimestampMs) {
+		table->maxTimestampMs = record->timestampMs;
+	}
+
+	for (size_t i = 0; i < tokenCount;) {
+		size_t end = i + 1;
+		while (end < tokenCount && tokens[end].length == tokens[i].length
+			   && memcmp(tokens[end].term, tokens[i].term, tokens[i].length) == 0) {
+			end++;
+		}
+
+		struct MemTerm *term = table_insert(table, tokens[i].term, tokens[i].length);
+		if (term) {
+			table_appendPosting(table, term, document, tokens + i, end - i);
+		}
+		i = end;
+	}
+
+	return true;
+}
+
+
+////////////////////////////////// Segments //////////////////////////////////
+
+// Determines where the sections start from the counts and sizes in the header
+//
+// @returns The size of the segment file
+static uint64_t layOut(struct SegmentHeader *header) {
+	header->documentsOffset = sizeof(struct SegmentHeader);
+	header->termsOffset     = header->documentsOffset + header->documentCount * sizeof(struct DocumentRecord);
+	header->termBlobOffset  = header->termsOffset + header->termCount * sizeof(struct TermRecord);
+	header->textsOffset     = header->termBlobOffset + header->termBlobSize;
+	header->postingsOffset  = header->textsOffset + header->textsSize;
+
+	return header->postingsOffset + header->postingsSize;
+}
+
+// Checks the header of a mapped segment file and locates its sections
+//
+// @returns The segment or NULL if the file isn't a valid segment
+static struct Segment *attachSegment(const uint8_t *data, size_t size) {
+	const struct SegmentHeader *header = (const struct SegmentHeader *) data;
+	if (size < sizeof(struct SegmentHeader) || header->magic != SEGMENT_MAGIC || header->version != SEGMENT_VERSION
+		|| header->documentCount == 0 || header->documentCount > size / sizeof(struct DocumentRecord)
+		|| header->termCount > size / sizeof(struct TermRecord) || header->termBlobSize > size
+		|| header->textsSize > size || header->postingsSize > size) {
+		return NULL;
+	}
+
+	struct SegmentHeader expected = *header;
+	if (layOut(&expected) != size || memcmp(&expected, header, sizeof(struct SegmentHeader)) != 0) {
+		return NULL;
+	}
+
+	struct Segment *segment = memory_alloc(MEMORY_TEXTINDEX, sizeof(struct Segment));
+	if (!segment) {
+		return NULL;
+	}
+
+	segment->data      = data;
+	segment->size      = size;
+	segment->header    = header;
+	segment->documents = (const struct DocumentRecord *) (data + header->documentsOffset);
+	segment->terms     = (const struct TermRecord *) (data + header->termsOffset);
+	segment->termBlob  = data + header->termBlobOffset;
+	segment->texts     = (const char *) (data + header->textsOffset);
+	segment->postings  = data + header->postingsOffset;
+
+	return segment;
+}
+
+static uint64_t lastDocument(const struct Segment *segment) {
+	return segment->header->firstDocument + segment->header->documentCount - 1;
+}
+
+// Gets a term of the dictionary
+//
+// @returns Whether the term record is valid
+static bool termAt(const struct Segment *segment, size_t index, const uint8_t **term, size_t *termLength) {
+	const struct SegmentHeader *header = segment->header;
+	const struct TermRecord *record    = &segment->terms[index];
+	if (record->termOffset > header->termBlobSize || record->termLength > header->termBlobSize - record->termOffset
+		|| record->postingsOffset > header->postingsSize
+		|| record->postingsLength > header->postingsSize - record->postingsOffset) {
+		return false;
+	}
+
+	*term       = segment->termBlob + record->termOffset;
+	*termLength = record->termLength;
+
+	return true;
+}
+
+static bool segment_find(const struct Segment *segment, const char *term, size_t length,
+						 struct PostingCursor *cursor) {
+	const uint8_t *candidate;
+	size_t candidateLength;
+	size_t low  = 0;
+	size_t high = segment->header->termCount;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (!termAt(segment, mid, &candidate, &candidateLength)) {
+			return false;
+		}
+		if (compareBytes(candidate, candidateLength, term, length) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	if (low == segment->header->termCount || !termAt(segment, low, &candidate, &candidateLength)
+		|| compareBytes(candidate, candidateLength, term, length) != 0) {
+		return false;
+	}
+
+	const struct TermRecord *record = &segment->terms[low];
+	cursor_start(cursor, segment->postings + record->postingsOffset, record->postingsLength,
+				 segment->header->firstDocument, record->documentCount);
+
+	return true;
+}
+
+// Walks the merged dictionary of the sources, concatenating the posting lists of every term. Without output, only the
+// amount of terms and the sizes of the term blob and the postings are determined (and written into the header).
+//
+// @param header The merged segment's header (whose offsets have been laid out if there's an output)
+// @returns Whether the sources' dictionaries are valid
+static bool mergeTerms(struct Segment *const *sources, struct SegmentHeader *header, uint8_t *output) {
+	size_t positions[TEXTINDEX_MERGE_FACTOR] = { 0 };
+	uint64_t termCount                       = 0;
+	uint64_t termBlobSize                    = 0;
+	uint64_t postingsSize                    = 0;
+
+	while (true) {
+		// Find the smallest term any source is at
+		const uint8_t *term = NULL;
+		size_t termLength   = 0;
+		bool present[TEXTINDEX_MERGE_FACTOR];
+		for (size_t i = 0; i < TEXTINDEX_MERGE_FACTOR; i++) {
+			present[i] = false;
+			if (positions[i] == sources[i]->header->termCount) {
+				continue;
+			}
+
+			const uint8_t *candidate;
+			size_t candidateLength;
+			if (!termAt(sources[i], positions[i], &candidate, &candidateLength)) {
+				return false;
+			}
+			int order = term ? compareBytes(candidate, candidateLength, term, termLength) : -1;
+			if (order < 0) {
+				memset(present, 0, i * sizeof(bool));
+				term       = candidate;
+				termLength = candidateLength;
+			}
+			present[i] = order <= 0;
+		}
+		if (!term) {
+			break;
+		}
+
+		struct TermRecord record;
+		memset(&record, 0, sizeof(struct TermRecord));
+		record.termOffset     = termBlobSize;
+		record.termLength     = (uint32_t) termLength;
+		record.postingsOffset = postingsSize;
+		if (output) {
+			memcpy(output + header->termBlobOffset + termBlobSize, term, termLength);
+		}
+
+		// Only the first entry of every posting list has to be re-encoded, as it is relative to the beginning of its
+		// segment instead of the previous segment's last entry
+		for (size_t i = 0; i < TEXTINDEX_MERGE_FACTOR; i++) {
+			if (!present[i]) {
+				continue;
+			}
+
+			const struct TermRecord *source = &sources[i]->terms[positions[i]++];
+			const uint8_t *postings         = sources[i]->postings + source->postingsOffset;
+			const uint8_t *rest             = postings;
+			uint64_t delta;
+			if (!readVarint(&rest, postings + source->postingsLength, &delta)) {
+				return false;
+			}
+
+			uint64_t document = sources[i]->header->firstDocument + delta;
+			uint64_t previous = record.documentCount ? record.lastDocument : header->firstDocument;
+			if (document < previous || (record.documentCount && document == previous)) {
+				return false;
+			}
+
+			uint8_t *at       = output ? output + header->postingsOffset + postingsSize : NULL;
+			size_t length     = writeVarint(at, document - previous);
+			size_t restLength = source->postingsLength - (size_t) (rest - postings);
+			if (output) {
+				memcpy(at + length, rest, restLength);
+			}
+			postingsSize += length + restLength;
+
+			record.documentCount += source->documentCount;
+			record.lastDocument = source->lastDocument;
+		}
+		record.postingsLength = postingsSize - record.postingsOffset;
+
+		if (output) {
+			memcpy(output + header->termsOffset + termCount * sizeof(struct TermRecord), &record,
+				   sizeof(struct TermRecord));
+		}
+		termCount++;
+		termBlobSize += termLength;
+	}
+
+	if (!output) {
+		header->termCount    = termCount;
+		header->termBlobSize = termBlobSize;
+		header->postingsSize = postingsSize;
+	}
+
+	return true;
+}
+
+
+////////////////////////////////// Files //////////////////////////////////
+
+// A segment file that is being written. It is mapped writable and filled in place.
+struct SegmentWriter {
+	int fd;
+	uint8_t *data;
+	size_t size;
+	char path[MAX_PATH_LENGTH];
+	char temporaryPath[MAX_PATH_LENGTH];
+};
+
+static void segmentPath(const struct TextIndex *index, char *buffer, size_t size, uint64_t firstDocument,
+						uint64_t lastDocument, const char *suffix) {
+	snprintf(buffer, size, "%s/%016llx-%016llx.seg%s", index->directory, (unsigned long long) firstDocument,
+			 (unsigned long long) lastDocument, suffix);
+}
+
+#ifndef _WIN32
+static void closeSegment(struct Segment *segment) {
+	munmap((void *) segment->data, segment->size);
+	memory_free(segment);
+}
+
+static struct Segment *openSegment(const char *path) {
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat status;
+	void *mapping = MAP_FAILED;
+	if (fstat(fd, &status) == 0 && status.st_size > 0) {
+		mapping = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	// The mapping stays valid without the descriptor
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return NULL;
+	}
+
+	struct Segment *segment = attachSegment(mapping, (size_t) status.st_size);
+	if (!segment) {
+		munmap(mapping, (size_t) status.st_size);
+	}
+
+	return segment;
+}
+
+static bool writer_open(struct SegmentWriter *writer, const struct TextIndex *index,
+						const struct SegmentHeader *header, uint64_t size) {
+	uint64_t lastDocument = header->firstDocument + header->documentCount - 1;
+	segmentPath(index, writer->path, sizeof(writer->path), header->firstDocument, lastDocument, "");
+	segmentPath(index, writer->temporaryPath, sizeof(writer->temporaryPath), header->firstDocument, lastDocument,
+				".tmp");
+
+	writer->fd = open(writer->temporaryPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (writer->fd < 0) {
+		return false;
+	}
+
+	// The space is allocated up front, as running out of it while writing through the mapping would be fatal
+	writer->size = (size_t) size;
+	writer->data = MAP_FAILED;
+	if (posix_fallocate(writer->fd, 0, (off_t) size) == 0) {
+		writer->data = mmap(NULL, writer->size, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, 0);
+	}
+	if (writer->data == MAP_FAILED) {
+		close(writer->fd);
+		remove(writer->temporaryPath);
+		return false;
+	}
+
+	memcpy(writer->data, header, sizeof(struct SegmentHeader));
+
+	return true;
+}
+
+static void writer_abort(struct SegmentWriter *writer) {
+	munmap(writer->data, writer->size);
+	close(writer->fd);
+	remove(writer->temporaryPath);
+}
+
+// Makes the file durable, moves it into place and keeps its mapping (read-only) as the new segment
+static struct Segment *writer_finish(struct SegmentWriter *writer) {
+	if (msync(writer->data, writer->size, MS_SYNC) != 0 || fsync(writer->fd) != 0
+		|| rename(writer->temporaryPath, writer->path) != 0) {
+		writer_abort(writer);
+		return NULL;
+	}
+	close(writer->fd);
+
+	mprotect(writer->data, writer->size, PROT_READ);
+	struct Segment *segment = attachSegment(writer->data, writer->size);
+	if (!segment) {
+		munmap(writer->data, writer->size);
+		remove(writer->path);
+	}
+
+	return segment;
+}
+
+struct SegmentName {
+	uint64_t firstDocument;
+	uint64_t lastDocument;
+};
+
+static int compareSegmentNames(const void *a, const void *b) {
+	const struct SegmentName *first  = a;
+	const struct SegmentName *second = b;
+	if (first->firstDocument != second->firstDocument) {
+		return first->firstDocument < second->firstDocument ? -1 : 1;
+	}
+
+	// Covering segments come before the ones they cover
+	return first->lastDocument > second->lastDocument ? -1 : first->lastDocument < second->lastDocument;
+}
+
+// Maps the segments in the directory and deletes files left behind by a crash
+//
+// @param[out] nextDocument The document following the last one that has ever been stored
+static bool loadSegments(struct TextIndex *index, uint64_t *nextDocument) {
+	DIR *directory = opendir(index->directory);
+	if (!directory) {
+		return false;
+	}
+
+	struct SegmentName *names = memory_alloc(MEMORY_TEXTINDEX, MAX_SEGMENT_FILES * sizeof(struct SegmentName));
+	if (!names) {
+		closedir(directory);
+		return false;
+	}
+
+	char path[MAX_PATH_LENGTH];
+	size_t nameCount = 0;
+	*nextDocument    = 0;
+	struct dirent *entry;
+	while ((entry = readdir(directory))) {
+		unsigned long long first;
+		unsigned long long last;
+		int consumed  = 0;
+		size_t length = strlen(entry->d_name);
+		if (length == SEGMENT_NAME_LENGTH && sscanf(entry->d_name, "%16llx-%16llx.seg%n", &first, &last, &consumed) == 2
+			&& (size_t) consumed == length && first <= last) {
+			if (last + 1 > *nextDocument) {
+				*nextDocument = last + 1;
+			}
+			if (nameCount < MAX_SEGMENT_FILES) {
+				names[nameCount].firstDocument = first;
+				names[nameCount].lastDocument  = last;
+				nameCount++;
+			}
+		} else if (length == SEGMENT_NAME_LENGTH + strlen(".tmp")
+				   && strcmp(entry->d_name + SEGMENT_NAME_LENGTH, ".tmp") == 0) {
+			// A segment that hasn't been written completely (a truncated path must not be removed instead)
+			int pathLength = snprintf(path, sizeof(path), "%s/%s", index->directory, entry->d_name);
+			if (pathLength > 0 && (size_t) pathLength < sizeof(path)) {
+				remove(path);
+			}
+		}
+	}
+	closedir(directory);
+
+	qsort(names, nameCount, sizeof(struct SegmentName), &compareSegmentNames);
+	for (size_t i = 0; i < nameCount && index->segmentCount < TEXTINDEX_MAX_SEGMENTS; i++) {
+		const struct Segment *previous = index->segmentCount ? index->segments[index->segmentCount - 1] : NULL;
+		segmentPath(index, path, sizeof(path), names[i].firstDocument, names[i].lastDocument, "");
+		if (previous && names[i].lastDocument <= lastDocument(previous)) {
+			// The source of a merge that has been interrupted after the merged segment had been written
+			remove(path);
+			continue;
+		}
+		if (previous && names[i].firstDocument <= lastDocument(previous)) {
+			continue;
+		}
+
+		struct Segment *segment = openSegment(path);
+		if (segment
+			&& (segment->header->firstDocument != names[i].firstDocument
+				|| lastDocument(segment) != names[i].lastDocument)) {
+			closeSegment(segment);
+			segment = NULL;
+		}
+		if (segment) {
+			index->segments[index->segmentCount++] = segment;
+		}
+	}
+	memory_free(names);
+
+	return true;
+}
+#else
+static void closeSegment(struct Segment *segment) {
+	memory_free(segment);
+}
+
+static bool writer_open(struct SegmentWriter *writer, const struct TextIndex *index,
+						const struct SegmentHeader *header, uint64_t size) {
+	(void) writer;
+	(void) index;
+	(void) header;
+	(void) size;
+
+	return false;
+}
+
+static void writer_abort(struct SegmentWriter *writer) {
+	(void) writer;
+}
+
+static struct Segment *writer_finish(struct SegmentWriter *writer) {
+	(void) writer;
+
+	return NULL;
+}
+
+static bool loadSegments(struct TextIndex *index, uint64_t *nextDocument) {
+	(void) index;
+	(void) nextDocument;
+
+	return false;
+}
+#endif
+
+
+////////////////////////////////// Background //////////////////////////////////
+
+static int compareMemTerms(const void *a, const void *b) {
+	const struct MemTerm *first  = *(const struct MemTerm *const *) a;
+	const struct MemTerm *second = *(const struct MemTerm *const *) b;
+
+	return compareBytes(first->term, first->length, second->term, second->length);
+}
+
+static struct Segment *writeTable(const struct TextIndex *index, const struct MemTable *table) {
+	const struct MemTerm **terms =
+		memory_alloc(MEMORY_TEXTINDEX, (table->termCount ? table->termCount : 1) * sizeof(struct MemTerm *));
+	if (!terms) {
+		return NULL;
+	}
+	size_t termCount = 0;
+	for (size_t i = 0; i < table->termCapacity; i++) {
+		if (table->terms[i].length != 0) {
+			terms[termCount++] = &table->terms[i];
+		}
+	}
+	qsort(terms, termCount, sizeof(struct MemTerm *), &compareMemTerms);
+
+	struct SegmentHeader header;
+	memset(&header, 0, sizeof(struct SegmentHeader));
+	header.magic          = SEGMENT_MAGIC;
+	header.version        = SEGMENT_VERSION;
+	header.firstDocument  = table->firstDocument;
+	header.documentCount  = table->documentCount;
+	header.termCount      = termCount;
+	header.minTimestampMs = table->minTimestampMs;
+	header.maxTimestampMs = table->maxTimestampMs;
+	header.termBlobSize   = table->termBlobSize;
+	header.textsSize      = table->textsSize;
+	header.postingsSize   = table->postingsSize;
+	uint64_t size         = layOut(&header);
+
+	struct SegmentWriter writer;
+	if (!writer_open(&writer, index, &header, size)) {
+		memory_free(terms);
+		return NULL;
+	}
+
+	memcpy(writer.data + header.documentsOffset, table->documents,
+		   table->documentCount * sizeof(struct DocumentRecord));
+	memcpy(writer.data + header.textsOffset, table->texts, table->textsSize);
+
+	uint64_t termOffset     = 0;
+	uint64_t postingsOffset = 0;
+	for (size_t i = 0; i < termCount; i++) {
+		struct TermRecord record;
+		memset(&record, 0, sizeof(struct TermRecord));
+		record.termOffset     = termOffset;
+		record.termLength     = terms[i]->length;
+		record.postingsOffset = postingsOffset;
+		record.postingsLength = terms[i]->postingsLength;
+		record.lastDocument   = terms[i]->lastDocument;
+		record.documentCount  = terms[i]->documentCount;
+		memcpy(writer.data + header.termsOffset + i * sizeof(struct TermRecord), &record, sizeof(struct TermRecord));
+		memcpy(writer.data + header.termBlobOffset + termOffset, terms[i]->term, terms[i]->length);
+		memcpy(writer.data + header.postingsOffset + postingsOffset, terms[i]->postings, terms[i]->postingsLength);
+		termOffset += terms[i]->length;
+		postingsOffset += terms[i]->postingsLength;
+	}
+	memory_free(terms);
+
+	return writer_finish(&writer);
+}
+
+// Writes the frozen table into a segment. Must only be called by the background thread.
+static bool writeFrozen(struct TextIndex *index) {
+	if (index->segmentCount == TEXTINDEX_MAX_SEGMENTS) {
+		return false;
+	}
+
+	// The frozen table isn't modified, so it can be read without the lock
+	struct Segment *segment = writeTable(index, &index->frozen);
+	if (!segment) {
+		return false;
+	}
+
+	pthread_rwlock_wrlock(&index->segmentsLock);
+	pthread_mutex_lock(&index->tableLock);
+	struct MemTable written                = index->frozen;
+	index->segments[index->segmentCount++] = segment;
+	index->hasFrozen                       = false;
+	table_init(&index->frozen, 0);
+	pthread_mutex_unlock(&index->tableLock);
+	pthread_rwlock_unlock(&index->segmentsLock);
+
+	table_free(&written);
+
+	return true;
+}
+
+// Writes all documents into segments. Must only be called by the background thread.
+static bool flush(struct TextIndex *index) {
+	// A table that couldn't be written before goes first
+	if (index->hasFrozen && !writeFrozen(index)) {
+		return false;
+	}
+
+	// Freezing the table only takes a moment, so adding documents is hardly ever held up
+	pthread_rwlock_wrlock(&index->segmentsLock);
+	pthread_mutex_lock(&index->tableLock);
+	bool frozen = index->table.documentCount > 0;
+	if (frozen) {
+		index->frozen    = index->table;
+		index->hasFrozen = true;
+		table_init(&index->table, index->frozen.firstDocument + index->frozen.documentCount);
+	}
+	pthread_mutex_unlock(&index->tableLock);
+	pthread_rwlock_unlock(&index->segmentsLock);
+
+	return !frozen || writeFrozen(index);
+}
+
+// Merges the newest segments into one if TEXTINDEX_MERGE_FACTOR of them are of the same level. Must only be called by
+// the background thread.
+static bool merge(struct TextIndex *index) {
+	// Only this thread replaces segments, so they can be read without the lock
+	if (index->segmentCount < TEXTINDEX_MERGE_FACTOR) {
+		return false;
+	}
+
+	size_t first = index->segmentCount - TEXTINDEX_MERGE_FACTOR;
+	struct Segment *sources[TEXTINDEX_MERGE_FACTOR];
+	for (size_t i = 0; i < TEXTINDEX_MERGE_FACTOR; i++) {
+		sources[i] = index->segments[first + i];
+		if (sources[i]->header->level != sources[0]->header->level) {
+			return false;
+		}
+	}
+
+	struct SegmentHeader header;
+	memset(&header, 0, sizeof(struct SegmentHeader));
+	header.magic          = SEGMENT_MAGIC;
+	header.version        = SEGMENT_VERSION;
+	header.level          = sources[0]->header->level + 1;
+	header.firstDocument  = sources[0]->header->firstDocument;
+	header.documentCount  = lastDocument(sources[TEXTINDEX_MERGE_FACTOR - 1]) - header.firstDocument + 1;
+	header.minTimestampMs = UINT64_MAX;
+	for (size_t i = 0; i < TEXTINDEX_MERGE_FACTOR; i++) {
+		const struct SegmentHeader *source = sources[i]->header;
+		header.textsSize += source->textsSize;
+		header.minTimestampMs = source->minTimestampMs < header.minTimestampMs ? source->minTimestampMs
+																			   : header.minTimestampMs;
+		header.maxTimestampMs = source->maxTimestampMs > header.maxTimestampMs ? source->maxTimestampMs
+																			   : header.maxTimestampMs;
+	}
+	if (!mergeTerms(sources, &header, NULL)) {
+		return false;
+	}
+	uint64_t size = layOut(&header);
+
+	struct SegmentWriter writer;
+	if (!writer_open(&writer, index, &header, size)) {
+		return false;
+	}
+
+	// Documents that are missing between the sources (because a segment couldn't be read) keep their numbers
+	struct DocumentRecord *documents = (struct DocumentRecord *) (writer.data + header.documentsOffset);
+	for (uint64_t i = 0; i < header.documentCount; i++) {
+		documents[i].kind = MISSING_DOCUMENT;
+	}
+	uint64_t textOffset = 0;
+	for (size_t i = 0; i < TEXTINDEX_MERGE_FACTOR; i++) {
+		const struct SegmentHeader *source = sources[i]->header;
+		struct DocumentRecord *target      = documents + (source->firstDocument - header.firstDocument);
+		memcpy(target, sources[i]->documents, source->documentCount * sizeof(struct DocumentRecord));
+		for (uint64_t j = 0; j < source->documentCount; j++) {
+			target[j].textOffset += textOffset;
+		}
+		memcpy(writer.data + header.textsOffset + textOffset, sources[i]->texts, source->textsSize);
+		textOffset += source->textsSize;
+	}
+
+	if (!mergeTerms(sources, &header, writer.data)) {
+		writer_abort(&writer);
+		return false;
+	}
+	struct Segment *merged = writer_finish(&writer);
+	if (!merged) {
+		return false;
+	}
+
+	pthread_rwlock_wrlock(&index->segmentsLock);
+	index->segments[first] = merged;
+	index->segmentCount    = first + 1;
+	pthread_rwlock_unlock(&index->segmentsLock);
+
+	// Queries can't be using the sources anymore
+	char path[MAX_PATH_LENGTH];
+	for (size_t i = 0; i < TEXTINDEX_MERGE_FACTOR; i++) {
+		segmentPath(index, path, sizeof(path), sources[i]->header->firstDocument, lastDocument(sources[i]), "");
+		remove(path);
+		closeSegment(sources[i]);
+	}
+
+	return true;
+}
+
+// Has to be called with the table's lock held
+static void waitFor(struct TextIndex *index, unsigned int milliseconds) {
+	struct timespec deadline;
+	timespec_get(&deadline, TIME_UTC);
+	deadline.tv_sec += milliseconds / 1000;
+	deadline.tv_nsec += (long) (milliseconds % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_cond_timedwait(&index->wake, &index->tableLock, &deadline);
+}
+
+static void *runIndexer(void *arg) {
+	struct TextIndex *index = arg;
+
+	// The segments may have been left in need of merging last time
+	while (merge(index)) {
+	}
+
+	pthread_mutex_lock(&index->tableLock);
+	while (!index->stopping) {
+		size_t count = index->table.documentCount;
+		if (count < TEXTINDEX_FLUSH_DOCUMENTS && !index->hasFrozen
+			&& (count == 0 || monotonicMs() - index->table.createdAt < TEXTINDEX_FLUSH_INTERVAL_MS)) {
+			waitFor(index, WAKE_INTERVAL_MS);
+			continue;
+		}
+		pthread_mutex_unlock(&index->tableLock);
+
+		bool flushed = flush(index);
+		while (merge(index)) {
+		}
+
+		pthread_mutex_lock(&index->tableLock);
+		if (!flushed && !index->stopping) {
+			waitFor(index, RETRY_INTERVAL_MS);
+		}
+	}
+	pthread_mutex_unlock(&index->tableLock);
+
+	flush(index);
+
+	return NULL;
+}
+
+
+////////////////////////////////// Queries //////////////////////////////////
+
+static void tableSource(const struct MemTable *table, struct Source *source) {
+	source->firstDocument  = table->firstDocument;
+	source->documentCount  = table->documentCount;
+	source->documents      = table->documents;
+	source->texts          = table->texts;
+	source->textsSize      = table->textsSize;
+	source->minTimestampMs = table->minTimestampMs;
+	source->maxTimestampMs = table->maxTimestampMs;
+	source->table          = table;
+	source->segment        = NULL;
+}
+
+static void segmentSource(const struct Segment *segment, struct Source *source) {
+	source->firstDocument  = segment->header->firstDocument;
+	source->documentCount  = (size_t) segment->header->documentCount;
+	source->documents      = segment->documents;
+	source->texts          = segment->texts;
+	source->textsSize      = (size_t) segment->header->textsSize;
+	source->minTimestampMs = segment->header->minTimestampMs;
+	source->maxTimestampMs = segment->header->maxTimestampMs;
+	source->table          = NULL;
+	source->segment        = segment;
+}
+
+static bool findPostings(const struct Source *source, const struct Token *term, struct PostingCursor *cursor) {
+	if (source->segment) {
+		return segment_find(source->segment, term->term, term->length, cursor);
+	}
+
+	const struct MemTerm *found = table_find(source->table, term->term, term->length);
+	if (found) {
+		cursor_start(cursor, found->postings, found->postingsLength, source->firstDocument, found->documentCount);
+	}
+
+	return found != NULL;
+}
+
+static bool matchesTime(const struct DocumentRecord *record, const struct Query *query) {
+	return record->kind != MISSING_DOCUMENT && record->timestampMs >= query->fromMs
+		   && record->timestampMs <= query->toMs;
+}
+
+// Checks whether the terms the cursors are at follow each other somewhere in the document
+static bool matchesPhrase(struct Query *query) {
+	for (size_t i = 0; i < query->termCount; i++) {
+		query->positionCounts[i] = cursor_readPositions(&query->cursors[i], query->positions[i]);
+	}
+
+	size_t next[TEXTINDEX_MAX_PHRASE_TERMS] = { 0 };
+	for (size_t i = 0; i < query->positionCounts[0]; i++) {
+		uint64_t start = query->positions[0][i];
+		bool matched   = true;
+		for (size_t j = 1; j < query->termCount && matched; j++) {
+			// The positions only ever increase, so every list is only walked once
+			while (next[j] < query->positionCounts[j] && query->positions[j][next[j]] < start + j) {
+				next[j]++;
+			}
+			if (next[j] == query->positionCounts[j]) {
+				return false;
+			}
+			matched = query->positions[j][next[j]] == start + j;
+		}
+		if (matched) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void reverseDocuments(struct TextIndexHit *hits, size_t count) {
+	for (size_t i = 0; i < count / 2; i++) {
+		uint64_t document            = hits[i].document;
+		hits[i].document             = hits[count - 1 - i].document;
+		hits[count - 1 - i].document = document;
+	}
+}
+
+static void describeHit(const struct Source *source, struct TextIndexHit *hit) {
+	const struct DocumentRecord *record = &source->documents[hit->document - source->firstDocument];
+	hit->timestampMs                    = record->timestampMs;
+	hit->kind                           = (enum TextIndexKind) record->kind;
+	hit->userID                         = record->userID;
+	hit->channelID                      = record->channelID;
+
+	size_t length = 0;
+	if (record->textOffset <= source->textsSize && record->textLength <= source->textsSize - record->textOffset) {
+		length = record->textLength < TEXTINDEX_MAX_TEXT - 1 ? record->textLength : TEXTINDEX_MAX_TEXT - 1;
+	}
+	memcpy(hit->text, source->texts + record->textOffset, length);
+	hit->text[length] = '\0';
+}
+
+// Finds the newest matching documents of a source
+//
+// @returns The amount of hits that have been written (at most capacity)
+static size_t searchSource(const struct Source *source, struct Query *query, struct TextIndexHit *hits,
+						   size_t capacity) {
+	if (source->documentCount == 0 || source->maxTimestampMs < query->fromMs
+		|| source->minTimestampMs > query->toMs) {
+		return 0;
+	}
+
+	size_t matched = 0;
+	if (query->termCount == 0) {
+		// Without a phrase the documents are simply walked newest first
+		for (size_t i = source->documentCount; i-- > 0 && matched < capacity;) {
+			if (matchesTime(&source->documents[i], query)) {
+				hits[matched++].document = source->firstDocument + i;
+			}
+		}
+	} else {
+		for (size_t i = 0; i < query->termCount; i++) {
+			if (!findPostings(source, &query->terms[i], &query->cursors[i])) {
+				return 0;
+			}
+
+			// Insertion sort by the amount of documents
+			size_t j = i;
+			for (; j > 0 && query->cursors[query->order[j - 1]].documentCount > query->cursors[i].documentCount; j--) {
+				query->order[j] = query->order[j - 1];
+			}
+			query->order[j] = i;
+		}
+
+		// The cursors leapfrog each other until they meet. The hits are a ring that ends up holding the newest
+		// matches (oldest first).
+		uint64_t target = source->firstDocument;
+		while (true) {
+			bool aligned = true;
+			for (size_t i = 0; i < query->termCount && aligned; i++) {
+				struct PostingCursor *cursor = &query->cursors[query->order[i]];
+				if (!cursor_advance(cursor, target)) {
+					target = UINT64_MAX;
+					break;
+				}
+				if (cursor->document > target) {
+					target  = cursor->document;
+					aligned = false;
+				}
+			}
+			if (target == UINT64_MAX || target - source->firstDocument >= source->documentCount) {
+				break;
+			}
+			if (!aligned) {
+				continue;
+			}
+
+			if (matchesTime(&source->documents[target - source->firstDocument], query) && matchesPhrase(query)) {
+				hits[matched % capacity].document = target;
+				matched++;
+			}
+			target++;
+		}
+
+		// The newest part of the ring comes before its oldest one
+		size_t split = matched % capacity;
+		reverseDocuments(hits, split);
+		reverseDocuments(hits + split, (matched < capacity ? matched : capacity) - split);
+		matched = matched < capacity ? matched : capacity;
+	}
+
+	for (size_t i = 0; i < matched; i++) {
+		describeHit(source, &hits[i]);
+	}
+
+	return matched;
+}
+
+
+////////////////////////////////// API //////////////////////////////////
+
+struct TextIndex *textindex_create(const char *directory) {
+#ifndef _WIN32
+	if (strlen(directory) + 1 + SEGMENT_NAME_LENGTH + strlen(".tmp") >= MAX_PATH_LENGTH) {
+		return NULL;
+	}
+
+	struct TextIndex *index = memory_calloc(MEMORY_TEXTINDEX, 1, sizeof(struct TextIndex));
+	if (!index) {
+		return NULL;
+	}
+	strcpy(index->directory, directory);
+
+	if (pthread_mutex_init(&index->tableLock, NULL) != 0) {
+		memory_free(index);
+		return NULL;
+	}
+	if (pthread_cond_init(&index->wake, NULL) != 0) {
+		pthread_mutex_destroy(&index->tableLock);
+		memory_free(index);
+		return NULL;
+	}
+	if (pthread_rwlock_init(&index->segmentsLock, NULL) != 0) {
+		pthread_cond_destroy(&index->wake);
+		pthread_mutex_destroy(&index->tableLock);
+		memory_free(index);
+		return NULL;
+	}
+
+	uint64_t nextDocument;
+	bool loaded = loadSegments(index, &nextDocument);
+	table_init(&index->table, nextDocument);
+	table_init(&index->frozen, 0);
+	if (!loaded || pthread_create(&index->thread, NULL, &runIndexer, index) != 0) {
+		for (size_t i = 0; i < index->segmentCount; i++) {
+			closeSegment(index->segments[i]);
+		}
+		pthread_rwlock_destroy(&index->segmentsLock);
+		pthread_cond_destroy(&index->wake);
+		pthread_mutex_destroy(&index->tableLock);
+		memory_free(index);
+		return NULL;
+	}
+
+	return index;
+#else
+	(void) directory;
+
+	return NULL;
+#endif
+}
+
+void textindex_destroy(struct TextIndex *index) {
+	if (!index) {
+		return;
+	}
+
+	pthread_mutex_lock(&index->tableLock);
+	index->stopping = true;
+	pthread_cond_signal(&index->wake);
+	pthread_mutex_unlock(&index->tableLock);
+	pthread_join(index->thread, NULL);
+
+	// Whatever couldn't be written is lost
+	for (size_t i = 0; i < index->segmentCount; i++) {
+		closeSegment(index->segments[i]);
+	}
+	table_free(&index->table);
+	table_free(&index->frozen);
+
+	pthread_rwlock_destroy(&index->segmentsLock);
+	pthread_cond_destroy(&index->wake);
+	pthread_mutex_destroy(&index->tableLock);
+	memory_free(index);
+}
+
+bool textindex_add(struct TextIndex *index, enum TextIndexKind kind, mumble_userid_t userID,
+				   mumble_channelid_t channelID, uint64_t timestampMs, const char *text) {
+	if (!index || !text) {
+		return false;
+	}
+
+	struct DocumentRecord record;
+	memset(&record, 0, sizeof(struct DocumentRecord));
+	record.timestampMs = timestampMs;
+	record.textLength  = (uint32_t) strnlen(text, TEXTINDEX_MAX_TEXT - 1);
+	record.kind        = kind;
+	record.userID      = userID;
+	record.channelID   = channelID;
+
+	// Terms are prepared before taking the lock, grouped the way they are stored
+	struct Token tokens[MAX_DOCUMENT_TERMS];
+	size_t tokenCount = tokenize(text, record.textLength, tokens, MAX_DOCUMENT_TERMS);
+	tokenCount        = tokenCount < MAX_DOCUMENT_TERMS ? tokenCount : MAX_DOCUMENT_TERMS;
+	qsort(tokens, tokenCount, sizeof(struct Token), &compareTokens);
+
+	pthread_mutex_lock(&index->tableLock);
+	size_t pending = index->table.documentCount + (index->hasFrozen ? index->frozen.documentCount : 0);
+	bool added     = pending < TEXTINDEX_MAX_PENDING_DOCUMENTS
+				 && table_add(&index->table, &record, text, tokens, tokenCount);
+	if (added && index->table.documentCount >= TEXTINDEX_FLUSH_DOCUMENTS) {
+		pthread_cond_signal(&index->wake);
+	}
+	pthread_mutex_unlock(&index->tableLock);
+
+	return added;
+}
+
+size_t textindex_search(struct TextIndex *index, const char *phrase, uint64_t fromMs, uint64_t toMs,
+						struct TextIndexHit *hits, size_t maxHits) {
+	if (!index || !phrase || maxHits == 0 || fromMs > toMs) {
+		return 0;
+	}
+
+	struct Query *query = memory_alloc(MEMORY_TEXTINDEX, sizeof(struct Query));
+	if (!query) {
+		return 0;
+	}
+	query->termCount = tokenize(phrase, strlen(phrase), query->terms, TEXTINDEX_MAX_PHRASE_TERMS);
+	query->fromMs    = fromMs;
+	query->toMs      = toMs;
+	if (query->termCount > TEXTINDEX_MAX_PHRASE_TERMS) {
+		memory_free(query);
+		return 0;
+	}
+
+	// The sources are searched from the newest to the oldest, so that the search can stop as soon as enough
+	// documents have been found
+	struct Source source;
+	size_t found = 0;
+	pthread_rwlock_rdlock(&index->segmentsLock);
+
+	pthread_mutex_lock(&index->tableLock);
+	tableSource(&index->table, &source);
+	found += searchSource(&source, query, hits, maxHits);
+	pthread_mutex_unlock(&index->tableLock);
+
+	if (index->hasFrozen && found < maxHits) {
+		tableSource(&index->frozen, &source);
+		found += searchSource(&source, query, hits + found, maxHits - found);
+	}
+	for (size_t i = index->segmentCount; i-- > 0 && found < maxHits;) {
+		segmentSource(index->segments[i], &source);
+		found += searchSource(&source, query, hits + found, maxHits - found);
+	}
+
+	pthread_rwlock_unlock(&index->segmentsLock);
+	memory_free(query);
+
+	return found;
+}
@@ -0,0 +1,106 @@
+/// This header file declares the full-text index over transcripts and channel events.
+///
+/// The plugin indexes two kinds of documents: the channels users enter and the captions of what they said. Captions
+/// only exist if the plugin has been built with a speech recognizer (see PLUGIN_SPEECH_RECOGNIZER in transcription.h)
+/// and transcription has been enabled. Mumble doesn't pass chat messages to plugins, so without a recognizer the index
+/// only holds events.
+///
+/// Every document (a caption or an event) is tagged with the user it is about, the channel they were in and when it
+/// happened. Documents are numbered in the order they are added and never change afterwards, so the index only ever
+/// grows: New documents go into an in-memory table, which a background thread regularly writes into an immutable
+/// segment file (see below) and replaces with an empty one. Segments are memory-mapped read-only, so opening the index
+/// reads next to nothing and only the parts of a segment a query touches are ever paged in.
+///
+/// For every term a segment holds a posting list: the documents containing the term (delta-encoded) and the term's
+/// positions within each of them (delta-encoded as well), all written as LEB128 varints. Posting lists are sorted by
+/// document, so a phrase is found by walking the posting lists of its terms in lockstep and comparing positions only
+/// where all of them meet.
+///
+/// Segments are merged in the background (tiered): Once the newest TEXTINDEX_MERGE_FACTOR segments have been created
+/// by the same amount of merges, they are replaced by a single segment. Merging doesn't decode the posting lists but
+/// concatenates them, re-encoding only their first entry. This keeps the amount of segments logarithmic in the amount
+/// of documents while every document is only ever rewritten a logarithmic amount of times.
+///
+/// Segment files are named after the first and last document they contain and are replaced atomically (written to a
+/// temporary file and renamed). Merged segments are written before their sources are deleted, so sources that are left
+/// behind by a crash are recognized by being covered by another segment and deleted when the index is opened.
+///
+/// NOTE: Segment files are written in the host's byte order. The index is only available on POSIX systems, everywhere
+/// else textindex_create returns NULL.
+
+#ifndef MUMBLE_PLUGIN_TEXTINDEX_H_
+#define MUMBLE_PLUGIN_TEXTINDEX_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The maximum length of a document's text (including the terminating null byte). Longer texts are truncated.
+#define TEXTINDEX_MAX_TEXT 512
+/// Terms are the runs of letters and digits (compared case-insensitively), of which only the first
+/// TEXTINDEX_MAX_TERM bytes are indexed
+#define TEXTINDEX_MAX_TERM 32
+/// The maximum amount of terms in a phrase
+#define TEXTINDEX_MAX_PHRASE_TERMS 32
+/// The amount of documents after which the in-memory table is written into a segment
+#define TEXTINDEX_FLUSH_DOCUMENTS 8192
+/// How long documents may stay in the in-memory table at most
+#define TEXTINDEX_FLUSH_INTERVAL_MS 60000
+/// The amount of documents the in-memory tables may hold while segments can't be written. Further documents are
+/// rejected.
+#define TEXTINDEX_MAX_PENDING_DOCUMENTS (8 * TEXTINDEX_FLUSH_DOCUMENTS)
+/// The amount of segments of the same tier that are merged into one
+#define TEXTINDEX_MERGE_FACTOR 4
+/// The maximum amount of segments (the tiered merging keeps well below this)
+#define TEXTINDEX_MAX_SEGMENTS 64
+
+enum TextIndexKind {
+	/// The text has been spoken by the user
+	TEXTINDEX_TRANSCRIPT,
+	/// The text describes something the user did (e.g. entering a channel)
+	TEXTINDEX_EVENT,
+};
+
+struct TextIndexHit {
+	/// The document's number (documents are numbered in the order they have been added)
+	uint64_t document;
+	/// When it happened (milliseconds since the epoch)
+	uint64_t timestampMs;
+	enum TextIndexKind kind;
+	mumble_userid_t userID;
+	/// The channel the user has been in (-1 if it isn't known)
+	mumble_channelid_t channelID;
+	char text[TEXTINDEX_MAX_TEXT];
+};
+
+struct TextIndex;
+
+/// Opens the index stored in the given directory and starts the background thread
+///
+/// @param directory The directory the segment files are stored in. It has to exist.
+/// @returns The index or NULL if the directory couldn't be read or starting the thread failed
+struct TextIndex *textindex_create(const char *directory);
+
+/// Writes all documents that haven't been written yet, stops the background thread and destroys the index
+void textindex_destroy(struct TextIndex *index);
+
+/// Adds a document to the index. Thread-safe; never waits for segments being searched or written.
+///
+/// @returns Whether the document has been added (it isn't if there's no memory or too many documents are pending)
+bool textindex_add(struct TextIndex *index, enum TextIndexKind kind, mumble_userid_t userID,
+				   mumble_channelid_t channelID, uint64_t timestampMs, const char *text);
+
+/// Finds the newest documents containing the given phrase that happened within the given time range. Thread-safe.
+///
+/// @param phrase The terms that have to appear in this order, one right after the other (an empty phrase matches
+/// every document)
+/// @param fromMs The beginning of the time range (inclusive, milliseconds since the epoch)
+/// @param toMs The end of the time range (inclusive)
+/// @param[out] hits Where to write the documents that have been found, newest first
+/// @returns The amount of documents that have been found (at most maxHits, 0 if the phrase has too many terms)
+size_t textindex_search(struct TextIndex *index, const char *phrase, uint64_t fromMs, uint64_t toMs,
+						struct TextIndexHit *hits, size_t maxHits);
+
+#endif // MUMBLE_PLUGIN_TEXTINDEX_H_
@@ -0,0 +1,520 @@
+#include "transcription.h"
+#include "memory.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#define MAX_SEGMENT_SAMPLES ((size_t) TRANSCRIPTION_MAX_SEGMENT_MS * TRANSCRIPTION_SAMPLE_RATE / 1000)
+#define MIN_SEGMENT_SAMPLES ((size_t) TRANSCRIPTION_MIN_SEGMENT_MS * TRANSCRIPTION_SAMPLE_RATE / 1000)
+#define NO_SEGMENT (-1)
+
+struct Segment {
+	mumble_userid_t userID;
+	uint64_t startMs;
+	bool continued;
+	// CLOCK_MONOTONIC when the segment has been queued
+	uint64_t queuedAt;
+	// The amount of samples written by the audio thread (published with release semantics)
+	atomic_size_t length;
+	int16_t *samples;
+	// The next segment in the free list or the queue
+	int next;
+};
+
+struct Speaker {
+	// The user ID plus one (0 if the slot is unused)
+	atomic_uint owner;
+	// The open segment (NULL if there is none or it is being closed)
+	_Atomic(struct Segment *) segment;
+	// The amount of audio threads that may be writing to the segment
+	atomic_uint writers;
+
+	// Only touched by the audio thread: the segment the decimator belongs to and its state
+	struct Segment *decimated;
+	uint32_t phase;
+	float sum;
+	uint32_t summed;
+
+	// Only touched by the thread ticking: the length at the last tick and since when it hasn't changed
+	size_t tickedLength;
+	uint64_t idleSince;
+};
+
+struct Transcriber {
+	TranscriptionRecognizeFunction recognize;
+	TranscriptionCaptionFunction caption;
+	void *userData;
+	unsigned int latencyBudgetMs;
+
+	const void *model;
+	size_t modelSize;
+
+	struct Speaker speakers[TRANSCRIPTION_MAX_SPEAKERS];
+
+	int16_t *sampleBlock;
+	struct Segment segments[TRANSCRIPTION_MAX_SEGMENTS];
+
+	// Protects everything below
+	pthread_mutex_t lock;
+	pthread_cond_t queued;
+	int freeSegments;
+	int queueHead;
+	int queueTail;
+	bool stopping;
+
+	pthread_t workers[TRANSCRIPTION_MAX_WORKERS];
+	size_t workerCount;
+};
+
+static uint64_t monotonicMs() {
+	struct timespec now;
+#ifndef _WIN32
+	clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+	timespec_get(&now, TIME_UTC);
+#endif
+
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static uint64_t wallClockMs() {
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+
+////////////////////////////////// Model //////////////////////////////////
+
+static bool mapModel(struct Transcriber *transcriber, const char *path) {
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat status;
+	void *mapping = MAP_FAILED;
+	if (fstat(fd, &status) == 0 && status.st_size > 0) {
+		mapping = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	// The mapping stays valid without the descriptor
+	close(fd);
+
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+
+	transcriber->model     = mapping;
+	transcriber->modelSize = (size_t) status.st_size;
+
+	return true;
+#else
+	(void) transcriber;
+	(void) path;
+
+	return false;
+#endif
+}
+
+static void unmapModel(struct Transcriber *transcriber) {
+#ifndef _WIN32
+	if (transcriber->model) {
+		munmap((void *) transcriber->model, transcriber->modelSize);
+	}
+#endif
+}
+
+
+////////////////////////////////// Segments //////////////////////////////////
+
+// Has to be called with the lock held
+static struct Segment *takeSegment(struct Transcriber *transcriber) {
+	if (transcriber->freeSegments == NO_SEGMENT) {
+		return NULL;
+	}
+
+	struct Segment *segment   = &transcriber->segments[transcriber->freeSegments];
+	transcriber->freeSegments = segment->next;
+	atomic_store_explicit(&segment->length, 0, memory_order_relaxed);
+
+	return segment;
+}
+
+// Has to be called with the lock held
+static void releaseSegment(struct Transcriber *transcriber, struct Segment *segment) {
+	int index                 = (int) (segment - transcriber->segments);
+	segment->next             = transcriber->freeSegments;
+	transcriber->freeSegments = index;
+}
+
+// Has to be called with the lock held. Segments that are too short are released right away.
+static void queueSegment(struct Transcriber *transcriber, struct Segment *segment) {
+	if (atomic_load_explicit(&segment->length, memory_order_acquire) < MIN_SEGMENT_SAMPLES) {
+		releaseSegment(transcriber, segment);
+		return;
+	}
+
+	int index         = (int) (segment - transcriber->segments);
+	segment->queuedAt = monotonicMs();
+	segment->next     = NO_SEGMENT;
+	if (transcriber->queueTail == NO_SEGMENT) {
+		transcriber->queueHead = index;
+	} else {
+		transcriber->segments[transcriber->queueTail].next = index;
+	}
+	transcriber->queueTail = index;
+
+	pthread_cond_signal(&transcriber->queued);
+}
+
+static struct Speaker *findSpeaker(struct Transcriber *transcriber, mumble_userid_t userID) {
+	for (size_t i = 0; i < TRANSCRIPTION_MAX_SPEAKERS; i++) {
+		if (atomic_load(&transcriber->speakers[i].owner) == userID + 1) {
+			return &transcriber->speakers[i];
+		}
+	}
+
+	return NULL;
+}
+
+// Replaces the speaker's segment and waits until no audio thread can be writing to the previous one anymore, which is
+// then owned by the caller. Has to be called with the lock held.
+static struct Segment *swapSegment(struct Speaker *speaker, struct Segment *segment) {
+	struct Segment *previous = atomic_exchange(&speaker->segment, segment);
+	// Writers pick the segment up after announcing themselves, so they are only ever briefly in the way
+	while (atomic_load(&speaker->writers) > 0) {
+		sched_yield();
+	}
+
+	return previous;
+}
+
+static struct Segment *openSegment(struct Transcriber *transcriber, mumble_userid_t userID, uint64_t startMs,
+								   bool continued) {
+	struct Segment *segment = takeSegment(transcriber);
+	if (segment) {
+		segment->userID    = userID;
+		segment->startMs   = startMs;
+		segment->continued = continued;
+	}
+
+	return segment;
+}
+
+
+////////////////////////////////// Workers //////////////////////////////////
+
+static void *runWorker(void *arg) {
+	struct Transcriber *transcriber = arg;
+
+	struct Segment *batch[TRANSCRIPTION_MAX_BATCH];
+	struct TranscriptionSegment views[TRANSCRIPTION_MAX_BATCH];
+	char texts[TRANSCRIPTION_MAX_BATCH][TRANSCRIPTION_MAX_TEXT];
+
+	pthread_mutex_lock(&transcriber->lock);
+	for (;;) {
+		while (!transcriber->stopping && transcriber->queueHead == NO_SEGMENT) {
+			pthread_cond_wait(&transcriber->queued, &transcriber->lock);
+		}
+		if (transcriber->stopping) {
+			break;
+		}
+
+		// Everything that has piled up is recognized at once, except for what has waited too long already
+		struct Segment *dropped[TRANSCRIPTION_MAX_SEGMENTS];
+		size_t droppedCount = 0;
+		size_t batchSize    = 0;
+		uint64_t now        = monotonicMs();
+		while (transcriber->queueHead != NO_SEGMENT && batchSize < TRANSCRIPTION_MAX_BATCH) {
+			struct Segment *segment = &transcriber->segments[transcriber->queueHead];
+			transcriber->queueHead  = segment->next;
+			if (transcriber->queueHead == NO_SEGMENT) {
+				transcriber->queueTail = NO_SEGMENT;
+			}
+
+			if (now - segment->queuedAt > transcriber->latencyBudgetMs) {
+				dropped[droppedCount++] = segment;
+			} else {
+				batch[batchSize++] = segment;
+			}
+		}
+		pthread_mutex_unlock(&transcriber->lock);
+
+		for (size_t i = 0; i < batchSize; i++) {
+			views[i].userID      = batch[i]->userID;
+			views[i].startMs     = batch[i]->startMs;
+			views[i].samples     = batch[i]->samples;
+			views[i].sampleCount = atomic_load_explicit(&batch[i]->length, memory_order_acquire);
+			views[i].continued   = batch[i]->continued;
+			texts[i][0]          = '\0';
+		}
+
+		bool recognized = batchSize > 0 && transcriber->recognize
+						  && transcriber->recognize(transcriber->userData, transcriber->model, transcriber->modelSize,
+													views, batchSize, texts);
+		for (size_t i = 0; i < batchSize; i++) {
+			texts[i][TRANSCRIPTION_MAX_TEXT - 1] = '\0';
+			transcriber->caption(transcriber->userData, &views[i],
+								 recognized ? TRANSCRIPTION_CAPTIONED : TRANSCRIPTION_UNRECOGNIZED,
+								 recognized ? texts[i] : NULL);
+		}
+		for (size_t i = 0; i < droppedCount; i++) {
+			struct TranscriptionSegment view;
+			view.userID      = dropped[i]->userID;
+			view.startMs     = dropped[i]->startMs;
+			view.samples     = dropped[i]->samples;
+			view.sampleCount = atomic_load_explicit(&dropped[i]->length, memory_order_acquire);
+			view.continued   = dropped[i]->continued;
+			transcriber->caption(transcriber->userData, &view, TRANSCRIPTION_DROPPED, NULL);
+		}
+
+		pthread_mutex_lock(&transcriber->lock);
+		for (size_t i = 0; i < batchSize; i++) {
+			releaseSegment(transcriber, batch[i]);
+		}
+		for (size_t i = 0; i < droppedCount; i++) {
+			releaseSegment(transcriber, dropped[i]);
+		}
+	}
+	pthread_mutex_unlock(&transcriber->lock);
+
+	return NULL;
+}
+
+
+////////////////////////////////// API //////////////////////////////////
+
+struct Transcriber *transcription_create(const char *modelPath, TranscriptionRecognizeFunction recognize,
+										 TranscriptionCaptionFunction caption, void *userData, size_t workerCount,
+										 unsigned int latencyBudgetMs) {
+	if (workerCount == 0 || workerCount > TRANSCRIPTION_MAX_WORKERS) {
+		return NULL;
+	}
+
+	struct Transcriber *transcriber = memory_calloc(MEMORY_TRANSCRIPTION, 1, sizeof(struct Transcriber));
+	if (!transcriber) {
+		return NULL;
+	}
+
+	transcriber->recognize       = recognize;
+	transcriber->caption         = caption;
+	transcriber->userData        = userData;
+	transcriber->latencyBudgetMs = latencyBudgetMs;
+
+	if (modelPath && !mapModel(transcriber, modelPath)) {
+		memory_free(transcriber);
+		return NULL;
+	}
+
+	transcriber->sampleBlock =
+		memory_allocLarge(MEMORY_TRANSCRIPTION, TRANSCRIPTION_MAX_SEGMENTS * MAX_SEGMENT_SAMPLES * sizeof(int16_t));
+	if (!transcriber->sampleBlock || pthread_mutex_init(&transcriber->lock, NULL) != 0) {
+		memory_freeLarge(transcriber->sampleBlock);
+		unmapModel(transcriber);
+		memory_free(transcriber);
+		return NULL;
+	}
+	if (pthread_cond_init(&transcriber->queued, NULL) != 0) {
+		pthread_mutex_destroy(&transcriber->lock);
+		memory_freeLarge(transcriber->sampleBlock);
+		unmapModel(transcriber);
+		memory_free(transcriber);
+		return NULL;
+	}
+
+	transcriber->freeSegments = NO_SEGMENT;
+	transcriber->queueHead    = NO_SEGMENT;
+	transcriber->queueTail    = NO_SEGMENT;
+	for (size_t i = TRANSCRIPTION_MAX_SEGMENTS; i-- > 0;) {
+		transcriber->segments[i].samples = transcriber->sampleBlock + i * MAX_SEGMENT_SAMPLES;
+		atomic_init(&transcriber->segments[i].length, 0);
+		releaseSegment(transcriber, &transcriber->segments[i]);
+	}
+	for (size_t i = 0; i < TRANSCRIPTION_MAX_SPEAKERS; i++) {
+		atomic_init(&transcriber->speakers[i].owner, 0);
+		atomic_init(&transcriber->speakers[i].segment, NULL);
+		atomic_init(&transcriber->speakers[i].writers, 0);
+	}
+
+	for (; transcriber->workerCount < workerCount; transcriber->workerCount++) {
+		if (pthread_create(&transcriber->workers[transcriber->workerCount], NULL, &runWorker, transcriber) != 0) {
+			transcription_destroy(transcriber);
+			return NULL;
+		}
+	}
+
+	return transcriber;
+}
+
+void transcription_destroy(struct Transcriber *transcriber) {
+	if (!transcriber) {
+		return;
+	}
+
+	pthread_mutex_lock(&transcriber->lock);
+	transcriber->stopping = true;
+	pthread_cond_broadcast(&transcriber->queued);
+	pthread_mutex_unlock(&transcriber->lock);
+
+	for (size_t i = 0; i < transcriber->workerCount; i++) {
+		pthread_join(transcriber->workers[i], NULL);
+	}
+
+	pthread_cond_destroy(&transcriber->queued);
+	pthread_mutex_destroy(&transcriber->lock);
+	memory_freeLarge(transcriber->sampleBlock);
+	unmapModel(transcriber);
+	memory_free(transcriber);
+}
+
+void transcription_process(struct Transcriber *transcriber, mumble_userid_t userID, const float *pcm,
+						   uint32_t sampleCount, uint16_t channelCount, uint32_t sampleRate) {
+	if (!transcriber || channelCount == 0 || sampleRate < TRANSCRIPTION_SAMPLE_RATE) {
+		return;
+	}
+
+	struct Speaker *speaker = findSpeaker(transcriber, userID);
+	if (!speaker) {
+		return;
+	}
+
+	// Announcing the write before loading the segment keeps it from being closed underneath
+	atomic_fetch_add(&speaker->writers, 1);
+	struct Segment *segment = atomic_load(&speaker->segment);
+	if (!segment || atomic_load(&speaker->owner) != userID + 1) {
+		atomic_fetch_sub(&speaker->writers, 1);
+		return;
+	}
+
+	if (speaker->decimated != segment) {
+		speaker->decimated = segment;
+		speaker->phase     = 0;
+		speaker->sum       = 0.0f;
+		speaker->summed    = 0;
+	}
+
+	// Every output sample is the average of the input samples it covers (a box filter, which is enough to keep the
+	// aliasing of speech out of the way)
+	size_t length = atomic_load_explicit(&segment->length, memory_order_relaxed);
+	float scale   = 32767.0f / (float) channelCount;
+	for (uint32_t i = 0; i < sampleCount && length < MAX_SEGMENT_SAMPLES; i++) {
+		float mono = 0.0f;
+		for (uint16_t channel = 0; channel < channelCount; channel++) {
+			mono += pcm[i * channelCount + channel];
+		}
+		speaker->sum += mono;
+		speaker->summed++;
+
+		speaker->phase += TRANSCRIPTION_SAMPLE_RATE;
+		if (speaker->phase >= sampleRate) {
+			speaker->phase -= sampleRate;
+
+			float sample = speaker->sum / (float) speaker->summed * scale;
+			sample       = sample > 32767.0f ? 32767.0f : sample < -32768.0f ? -32768.0f : sample;
+			segment->samples[length++] = (int16_t) sample;
+			speaker->sum               = 0.0f;
+			speaker->summed            = 0;
+		}
+	}
+	atomic_store_explicit(&segment->length, length, memory_order_release);
+
+	atomic_fetch_sub(&speaker->writers, 1);
+}
+
+void transcription_setTalking(struct Transcriber *transcriber, mumble_userid_t userID, bool talking) {
+	if (!transcriber) {
+		return;
+	}
+
+	pthread_mutex_lock(&transcriber->lock);
+
+	struct Speaker *speaker = findSpeaker(transcriber, userID);
+	if (talking) {
+		for (size_t i = 0; i < TRANSCRIPTION_MAX_SPEAKERS && !speaker; i++) {
+			if (atomic_load(&transcriber->speakers[i].owner) == 0) {
+				speaker = &transcriber->speakers[i];
+			}
+		}
+
+		// If all segments are in use, the speaker isn't transcribed (until one is available again, see tick)
+		struct Segment *segment = speaker && !atomic_load(&speaker->segment)
+									  ? openSegment(transcriber, userID, wallClockMs(), false)
+									  : NULL;
+		if (segment) {
+			speaker->tickedLength = 0;
+			speaker->idleSince    = monotonicMs();
+			// The owner is published last, so that audio threads don't find the speaker without their segment
+			atomic_store(&speaker->segment, segment);
+			atomic_store(&speaker->owner, userID + 1);
+		}
+	} else if (speaker) {
+		atomic_store(&speaker->owner, 0);
+		struct Segment *segment = swapSegment(speaker, NULL);
+		if (segment) {
+			queueSegment(transcriber, segment);
+		}
+	}
+
+	pthread_mutex_unlock(&transcriber->lock);
+}
+
+void transcription_tick(struct Transcriber *transcriber) {
+	if (!transcriber) {
+		return;
+	}
+
+	pthread_mutex_lock(&transcriber->lock);
+
+	uint64_t now = monotonicMs();
+	for (size_t i = 0; i < TRANSCRIPTION_MAX_SPEAKERS; i++) {
+		struct Speaker *speaker = &transcriber->speakers[i];
+		unsigned int owner      = atomic_load(&speaker->owner);
+		struct Segment *segment = atomic_load(&speaker->segment);
+		if (owner == 0) {
+			continue;
+		}
+		if (!segment) {
+			// The speaker has been talking while all segments were in use
+			segment = openSegment(transcriber, owner - 1, wallClockMs(), true);
+			if (segment) {
+				speaker->tickedLength = 0;
+				speaker->idleSince    = now;
+				atomic_store(&speaker->segment, segment);
+			}
+			continue;
+		}
+
+		size_t length = atomic_load_explicit(&segment->length, memory_order_acquire);
+		if (length != speaker->tickedLength) {
+			speaker->tickedLength = length;
+			speaker->idleSince    = now;
+		}
+
+		if (now - speaker->idleSince >= TRANSCRIPTION_IDLE_MS) {
+			// Nobody is going to tell that the speaker has stopped
+			atomic_store(&speaker->owner, 0);
+			queueSegment(transcriber, swapSegment(speaker, NULL));
+		} else if (length == MAX_SEGMENT_SAMPLES) {
+			// The speaker carries on in a new segment (or isn't transcribed until a segment is available again)
+			uint64_t startMs             = segment->startMs + TRANSCRIPTION_MAX_SEGMENT_MS;
+			struct Segment *continuation = openSegment(transcriber, owner - 1, startMs, true);
+			queueSegment(transcriber, swapSegment(speaker, continuation));
+			speaker->tickedLength = 0;
+			speaker->idleSince    = now;
+		}
+	}
+
+	pthread_mutex_unlock(&transcriber->lock);
+}
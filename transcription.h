@@ -0,0 +1,121 @@
+/// This header file declares the transcription of the speakers' audio.
+///
+/// transcription_process is meant to be called from mumble_onAudioSourceFetched. It downmixes and decimates every
+/// speaker's audio to TRANSCRIPTION_SAMPLE_RATE and appends it to the speaker's open segment. It never locks or
+/// allocates: segments are taken from a preallocated pool, and the only synchronization with the threads opening and
+/// closing them is an atomic writer count per speaker.
+///
+/// Segments follow the speakers' talking state: One is opened when a user starts talking and closed once they stop.
+/// Segments are also closed once they reach TRANSCRIPTION_MAX_SEGMENT_MS (the speaker carries on in a new one, so long
+/// monologues are captioned while they are still going on) and once no audio has arrived for TRANSCRIPTION_IDLE_MS
+/// (e.g. because the talking state change got lost along with the connection).
+///
+/// Closed segments are queued for a pool of worker threads. A worker takes everything that is queued (up to
+/// TRANSCRIPTION_MAX_BATCH segments) and hands it to the recognizer in a single call, so several speakers talking at
+/// once cost one inference call instead of one each. Batches only form when segments pile up, i.e. exactly when the
+/// throughput matters. Segments that have been queued for longer than the latency budget are dropped unrecognized
+/// instead of delaying everything queued behind them, which bounds how late a caption can be.
+///
+/// The recognizer's model is memory-mapped read-only, so loading it doesn't read the file: Pages are only read in once
+/// the recognizer touches them (and shared with every other process mapping the same file).
+///
+/// NOTE: transcription_setTalking and transcription_tick must not be called concurrently. transcription_process may be
+/// called concurrently with either of them, but only by one thread per speaker.
+
+#ifndef MUMBLE_PLUGIN_TRANSCRIPTION_H_
+#define MUMBLE_PLUGIN_TRANSCRIPTION_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The sample rate of segments (mono)
+#define TRANSCRIPTION_SAMPLE_RATE 16000
+/// The maximum amount of users that may be talking at the same time. Further speakers aren't transcribed.
+#define TRANSCRIPTION_MAX_SPEAKERS 16
+/// The amount of segments that may be open or queued at the same time
+#define TRANSCRIPTION_MAX_SEGMENTS 32
+#define TRANSCRIPTION_MAX_SEGMENT_MS 8000
+/// Shorter segments (e.g. clicks) are discarded without being recognized
+#define TRANSCRIPTION_MIN_SEGMENT_MS 250
+#define TRANSCRIPTION_IDLE_MS 1000
+/// The maximum amount of segments recognized in a single call
+#define TRANSCRIPTION_MAX_BATCH 8
+#define TRANSCRIPTION_MAX_WORKERS 4
+/// The maximum length of a segment's text (including the terminating null byte)
+#define TRANSCRIPTION_MAX_TEXT 512
+
+enum TranscriptionResult {
+	/// The recognizer has transcribed the segment
+	TRANSCRIPTION_CAPTIONED,
+	/// There is no recognizer or it failed
+	TRANSCRIPTION_UNRECOGNIZED,
+	/// The segment has waited longer than the latency budget
+	TRANSCRIPTION_DROPPED,
+};
+
+struct TranscriptionSegment {
+	mumble_userid_t userID;
+	/// When the segment started (milliseconds since the epoch)
+	uint64_t startMs;
+	/// TRANSCRIPTION_SAMPLE_RATE mono samples
+	const int16_t *samples;
+	size_t sampleCount;
+	/// Whether the segment continues the speaker's previous one, which has been closed because of its length
+	bool continued;
+};
+
+/// Recognizes a batch of segments in a single call. Called on a worker thread.
+///
+/// @param model The memory-mapped model (NULL if there is none)
+/// @param[out] texts The segments' texts (one buffer per segment)
+/// @returns Whether recognizing the segments succeeded
+typedef bool (*TranscriptionRecognizeFunction)(void *userData, const void *model, size_t modelSize,
+											   const struct TranscriptionSegment *segments, size_t segmentCount,
+											   char (*texts)[TRANSCRIPTION_MAX_TEXT]);
+
+/// Receives every segment that has been closed (except for those that have been too short). Called on a worker
+/// thread.
+///
+/// @param text The segment's text (NULL unless the result is TRANSCRIPTION_CAPTIONED)
+typedef void (*TranscriptionCaptionFunction)(void *userData, const struct TranscriptionSegment *segment,
+											 enum TranscriptionResult result, const char *text);
+
+/// The speech recognizer the plugin is built with. It isn't part of the plugin: the PLUGIN_SPEECH_RECOGNIZER CMake
+/// option names the C source file or library implementing it (e.g. by wrapping an inference engine). Without one,
+/// PLUGIN_SPEECH_RECOGNIZER is 0 and the plugin doesn't transcribe anything.
+bool transcription_recognizeSpeech(void *userData, const void *model, size_t modelSize,
+								   const struct TranscriptionSegment *segments, size_t segmentCount,
+								   char (*texts)[TRANSCRIPTION_MAX_TEXT]);
+
+struct Transcriber;
+
+/// Maps the model, allocates all segments and starts the workers
+///
+/// @param modelPath The recognizer's model (NULL if it doesn't need one)
+/// @param recognize The recognizer (NULL to only report when users spoke, with every segment unrecognized)
+/// @param workerCount The amount of worker threads (at most TRANSCRIPTION_MAX_WORKERS)
+/// @param latencyBudgetMs How long a closed segment may wait for a worker
+/// @returns The transcriber or NULL if mapping the model, allocating or starting the workers failed
+struct Transcriber *transcription_create(const char *modelPath, TranscriptionRecognizeFunction recognize,
+										 TranscriptionCaptionFunction caption, void *userData, size_t workerCount,
+										 unsigned int latencyBudgetMs);
+
+/// Stops the workers (discarding queued segments) and destroys the transcriber. No thread may process audio anymore.
+void transcription_destroy(struct Transcriber *transcriber);
+
+/// Appends a speaker's audio to their open segment (if they have one)
+///
+/// @param pcm Interleaved samples
+void transcription_process(struct Transcriber *transcriber, mumble_userid_t userID, const float *pcm,
+						   uint32_t sampleCount, uint16_t channelCount, uint32_t sampleRate);
+
+/// Opens or closes a speaker's segment
+void transcription_setTalking(struct Transcriber *transcriber, mumble_userid_t userID, bool talking);
+
+/// Closes segments that have become too long or idle. Meant to be called periodically (at least every 100ms).
+void transcription_tick(struct Transcriber *transcriber);
+
+#endif // MUMBLE_PLUGIN_TRANSCRIPTION_H_
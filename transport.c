@@ -0,0 +1,782 @@
+#include "transport.h"
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Packet layout (all integers little endian):
+// DATA: type (1) | session (2) | sequence number (4) | base (4) | flags (1) | payload
+// ACK:  type (1) | session (2) | next expected sequence number (4) | selective ack mask (4)
+// The base is the oldest sequence number the sender hasn't got acknowledged yet. Everything before it has been received
+// (possibly by a previous instance of the receiver), so a receiver that doesn't know the session yet starts there.
+// Bit i of the selective ack mask tells that the packet with sequence number (next expected + 1 + i) has been received.
+#define PACKET_TYPE_DATA 1
+#define PACKET_TYPE_ACK 2
+#define DATA_HEADER_SIZE 12
+#define ACK_PACKET_SIZE 11
+#define MAX_PAYLOAD_SIZE (TRANSPORT_MTU - DATA_HEADER_SIZE)
+
+#define FLAG_FIRST_FRAGMENT 1
+#define FLAG_LAST_FRAGMENT 2
+
+// Amount of packets that can be in flight (sender) or buffered out of order (receiver) per peer
+#define WINDOW_SIZE 64
+// Amount of later packets that have to be acknowledged before a missing one is retransmitted without waiting for its
+// timer to run out
+#define FAST_RETRANSMIT_THRESHOLD 3
+// After this many unsuccessful retransmissions of a single packet the peer is considered gone
+#define MAX_RETRANSMISSIONS 8
+
+// The amount of sessions a peer has abandoned that are remembered, so that their delayed packets are ignored
+#define RETIRED_SESSIONS 4
+// How long a partially reassembled message may wait for its next fragment. This is longer than a sender keeps
+// retransmitting a fragment before it gives up.
+#define REASSEMBLY_TIMEOUT_MS 30000
+
+#define INITIAL_RTO_MS 1000
+#define MIN_RTO_MS 200
+#define MAX_RTO_MS 4000
+#define INITIAL_SSTHRESH 32.0f
+
+struct OutgoingMessage {
+	struct OutgoingMessage *next;
+	size_t length;
+	size_t offset;
+	bool started;
+	// Whether the message has been taken from the transport's message pool (instead of the heap)
+	bool pooled;
+	uint8_t data[];
+};
+
+struct SendSlot {
+	bool inUse;
+	bool acked;
+	bool retransmitted;
+	uint8_t retransmissions;
+	uint16_t length;
+	uint64_t sentAt;
+	uint8_t packet[TRANSPORT_MTU];
+};
+
+struct ReceiveSlot {
+	bool present;
+	uint8_t flags;
+	uint16_t length;
+	uint8_t payload[MAX_PAYLOAD_SIZE];
+};
+
+struct ReassemblyBuffer {
+	bool inUse;
+	size_t length;
+	uint8_t data[TRANSPORT_MAX_MESSAGE_SIZE];
+};
+
+struct Peer {
+	bool inUse;
+	mumble_connection_t connection;
+	mumble_userid_t userID;
+
+	// Sending side
+	uint16_t localSession;
+	uint32_t sendBase;
+	uint32_t nextSequence;
+	uint32_t recoverSequence;
+	struct SendSlot sendWindow[WINDOW_SIZE];
+	struct OutgoingMessage *queueHead;
+	struct OutgoingMessage *queueTail;
+	float congestionWindow;
+	float slowStartThreshold;
+	bool hasRttSample;
+	uint32_t smoothedRtt;
+	uint32_t rttVariance;
+	uint32_t rto;
+
+	// Receiving side
+	bool remoteSessionKnown;
+	uint16_t remoteSession;
+	uint16_t retiredSessions[RETIRED_SESSIONS];
+	size_t retiredSessionCount;
+	uint32_t receiveBase;
+	bool ackPending;
+	bool discarding;
+	struct ReceiveSlot receiveWindow[WINDOW_SIZE];
+	struct ReassemblyBuffer *reassembly;
+	// When the last fragment has been added to the reassembly buffer
+	uint64_t reassemblyUpdatedMs;
+};
+
+struct Transport {
+	TransportSendFunction send;
+	TransportDeliverFunction deliver;
+	void *userData;
+	uint16_t nextSession;
+	struct Peer peers[TRANSPORT_MAX_PEERS];
+	struct ReassemblyBuffer pool[TRANSPORT_REASSEMBLY_POOL_SIZE];
+	// Messages that fit into a single packet (i.e. most of them) are taken from here
+	struct MemoryPool *messagePool;
+};
+
+
+static void writeU16(uint8_t *buffer, uint16_t value) {
+	buffer[0] = (uint8_t) value;
+	buffer[1] = (uint8_t)(value >> 8);
+}
+
+static void writeU32(uint8_t *buffer, uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		buffer[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static uint16_t readU16(const uint8_t *buffer) {
+	return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+static uint32_t readU32(const uint8_t *buffer) {
+	return (uint32_t) buffer[0] | ((uint32_t) buffer[1] << 8) | ((uint32_t) buffer[2] << 16)
+		   | ((uint32_t) buffer[3] << 24);
+}
+
+// Difference between two sequence numbers that stays correct across wrap-arounds
+static int32_t sequenceDiff(uint32_t a, uint32_t b) {
+	return (int32_t)(a - b);
+}
+
+
+static struct ReassemblyBuffer *acquireBuffer(struct Transport *transport) {
+	for (size_t i = 0; i < TRANSPORT_REASSEMBLY_POOL_SIZE; i++) {
+		if (!transport->pool[i].inUse) {
+			transport->pool[i].inUse  = true;
+			transport->pool[i].length = 0;
+			return &transport->pool[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void releaseBuffer(struct ReassemblyBuffer *buffer) {
+	if (buffer) {
+		buffer->inUse = false;
+	}
+}
+
+static void freeMessage(struct Transport *transport, struct OutgoingMessage *message) {
+	if (message->pooled) {
+		memory_poolFree(transport->messagePool, message);
+	} else {
+		memory_free(message);
+	}
+}
+
+static void freeQueue(struct Transport *transport, struct Peer *peer) {
+	struct OutgoingMessage *message = peer->queueHead;
+	while (message) {
+		struct OutgoingMessage *next = message->next;
+		freeMessage(transport, message);
+		message = next;
+	}
+
+	peer->queueHead = NULL;
+	peer->queueTail = NULL;
+}
+
+// Drops everything that is queued for or in flight to the peer and starts a new session. What has been received from
+// the peer is left alone.
+static void resetSending(struct Transport *transport, struct Peer *peer) {
+	freeQueue(transport, peer);
+	memset(peer->sendWindow, 0, sizeof(peer->sendWindow));
+
+	peer->localSession       = transport->nextSession++;
+	peer->sendBase           = 0;
+	peer->nextSequence       = 0;
+	peer->recoverSequence    = 0;
+	peer->congestionWindow   = 1.0f;
+	peer->slowStartThreshold = INITIAL_SSTHRESH;
+	peer->hasRttSample       = false;
+	peer->smoothedRtt        = 0;
+	peer->rttVariance        = 0;
+	peer->rto                = INITIAL_RTO_MS;
+}
+
+// Drops everything that has been received from the peer but not delivered yet. The peer's session is left alone.
+static void resetReceiving(struct Peer *peer) {
+	for (size_t i = 0; i < WINDOW_SIZE; i++) {
+		peer->receiveWindow[i].present = false;
+	}
+	releaseBuffer(peer->reassembly);
+	peer->reassembly = NULL;
+	peer->discarding = false;
+	peer->ackPending = false;
+}
+
+static void resetPeer(struct Transport *transport, struct Peer *peer) {
+	freeQueue(transport, peer);
+	releaseBuffer(peer->reassembly);
+
+	memset(peer, 0, sizeof(*peer));
+}
+
+static void initPeer(struct Transport *transport, struct Peer *peer, mumble_connection_t connection,
+					 mumble_userid_t userID) {
+	resetPeer(transport, peer);
+
+	peer->inUse      = true;
+	peer->connection = connection;
+	peer->userID     = userID;
+	resetSending(transport, peer);
+}
+
+static struct Peer *findPeer(struct Transport *transport, mumble_connection_t connection, mumble_userid_t userID,
+							 bool create) {
+	struct Peer *freePeer = NULL;
+
+	for (size_t i = 0; i < TRANSPORT_MAX_PEERS; i++) {
+		struct Peer *peer = &transport->peers[i];
+		if (peer->inUse) {
+			if (peer->connection == connection && peer->userID == userID) {
+				return peer;
+			}
+		} else if (!freePeer) {
+			freePeer = peer;
+		}
+	}
+
+	if (!create || !freePeer) {
+		return NULL;
+	}
+
+	initPeer(transport, freePeer, connection, userID);
+
+	return freePeer;
+}
+
+
+static void transmitSlot(struct Transport *transport, struct Peer *peer, struct SendSlot *slot, uint64_t nowMs) {
+	slot->sentAt = nowMs;
+	writeU32(slot->packet + 7, peer->sendBase);
+	// A failed send is treated like a lost packet: the retransmission timer takes care of it
+	transport->send(transport->userData, peer->connection, peer->userID, slot->packet, slot->length);
+}
+
+static void sendAck(struct Transport *transport, struct Peer *peer) {
+	uint32_t mask = 0;
+	for (uint32_t i = 0; i < 32 && i + 1 < WINDOW_SIZE; i++) {
+		uint32_t sequence = peer->receiveBase + 1 + i;
+		if (peer->receiveWindow[sequence % WINDOW_SIZE].present) {
+			mask |= (uint32_t) 1 << i;
+		}
+	}
+
+	uint8_t packet[ACK_PACKET_SIZE];
+	packet[0] = PACKET_TYPE_ACK;
+	writeU16(packet + 1, peer->remoteSession);
+	writeU32(packet + 3, peer->receiveBase);
+	writeU32(packet + 7, mask);
+
+	peer->ackPending = false;
+
+	transport->send(transport->userData, peer->connection, peer->userID, packet, sizeof(packet));
+}
+
+// Moves queued message fragments into the send window as long as the congestion window permits
+static void pump(struct Transport *transport, struct Peer *peer, uint64_t nowMs) {
+	while (peer->queueHead) {
+		uint32_t inFlight = peer->nextSequence - peer->sendBase;
+		if (inFlight >= WINDOW_SIZE || (float) inFlight >= peer->congestionWindow) {
+			break;
+		}
+
+		struct OutgoingMessage *message = peer->queueHead;
+
+		size_t chunkSize = message->length - message->offset;
+		if (chunkSize > MAX_PAYLOAD_SIZE) {
+			chunkSize = MAX_PAYLOAD_SIZE;
+		}
+
+		uint8_t flags = 0;
+		if (!message->started) {
+			flags |= FLAG_FIRST_FRAGMENT;
+		}
+		if (message->offset + chunkSize == message->length) {
+			flags |= FLAG_LAST_FRAGMENT;
+		}
+
+		struct SendSlot *slot = &peer->sendWindow[peer->nextSequence % WINDOW_SIZE];
+		slot->inUse           = true;
+		slot->acked           = false;
+		slot->retransmitted   = false;
+		slot->retransmissions = 0;
+		slot->length          = (uint16_t)(DATA_HEADER_SIZE + chunkSize);
+		slot->packet[0]       = PACKET_TYPE_DATA;
+		writeU16(slot->packet + 1, peer->localSession);
+		writeU32(slot->packet + 3, peer->nextSequence);
+		slot->packet[11] = flags;
+		memcpy(slot->packet + DATA_HEADER_SIZE, message->data + message->offset, chunkSize);
+
+		peer->nextSequence++;
+		message->offset += chunkSize;
+		message->started = true;
+
+		if (flags & FLAG_LAST_FRAGMENT) {
+			peer->queueHead = message->next;
+			if (!peer->queueHead) {
+				peer->queueTail = NULL;
+			}
+			freeMessage(transport, message);
+		}
+
+		transmitSlot(transport, peer, slot, nowMs);
+	}
+}
+
+static void updateRtt(struct Peer *peer, uint32_t sample) {
+	if (!peer->hasRttSample) {
+		peer->smoothedRtt  = sample;
+		peer->rttVariance  = sample / 2;
+		peer->hasRttSample = true;
+	} else {
+		uint32_t deviation = sample > peer->smoothedRtt ? sample - peer->smoothedRtt : peer->smoothedRtt - sample;
+		peer->rttVariance  = (3 * peer->rttVariance + deviation) / 4;
+		peer->smoothedRtt  = (7 * peer->smoothedRtt + sample) / 8;
+	}
+
+	uint32_t rto = peer->smoothedRtt + 4 * peer->rttVariance;
+	if (rto < MIN_RTO_MS) {
+		rto = MIN_RTO_MS;
+	} else if (rto > MAX_RTO_MS) {
+		rto = MAX_RTO_MS;
+	}
+	peer->rto = rto;
+}
+
+static void onSlotAcked(struct Peer *peer, struct SendSlot *slot, uint64_t nowMs) {
+	// Karn's algorithm: retransmitted packets don't yield reliable RTT samples
+	if (!slot->retransmitted) {
+		updateRtt(peer, (uint32_t)(nowMs - slot->sentAt));
+	}
+
+	if (peer->congestionWindow < peer->slowStartThreshold) {
+		peer->congestionWindow += 1.0f;
+	} else {
+		peer->congestionWindow += 1.0f / peer->congestionWindow;
+	}
+	if (peer->congestionWindow > WINDOW_SIZE) {
+		peer->congestionWindow = WINDOW_SIZE;
+	}
+
+	slot->acked = true;
+}
+
+static void onLoss(struct Peer *peer, bool timeout) {
+	// Only react once per window of data
+	if (sequenceDiff(peer->sendBase, peer->recoverSequence) < 0) {
+		return;
+	}
+
+	peer->slowStartThreshold = peer->congestionWindow / 2.0f;
+	if (peer->slowStartThreshold < 2.0f) {
+		peer->slowStartThreshold = 2.0f;
+	}
+	peer->congestionWindow = timeout ? 1.0f : peer->slowStartThreshold;
+	peer->recoverSequence  = peer->nextSequence;
+}
+
+static void retransmit(struct Transport *transport, struct Peer *peer, struct SendSlot *slot, uint64_t nowMs) {
+	slot->retransmitted = true;
+	slot->retransmissions++;
+	transmitSlot(transport, peer, slot, nowMs);
+}
+
+// A receiver that keeps its state acknowledges the oldest outstanding fragment cumulatively. If it has only been
+// acknowledged selectively, the receiver has been restarted since and lost the fragments it had acknowledged that way.
+static bool hasReneged(const struct Peer *peer) {
+	return peer->sendBase != peer->nextSequence && peer->sendWindow[peer->sendBase % WINDOW_SIZE].acked;
+}
+
+static void forgetSelectiveAcks(struct Peer *peer) {
+	for (uint32_t sequence = peer->sendBase; sequence != peer->nextSequence; sequence++) {
+		peer->sendWindow[sequence % WINDOW_SIZE].acked = false;
+	}
+}
+
+static void retransmitAll(struct Transport *transport, struct Peer *peer, uint64_t nowMs) {
+	for (uint32_t sequence = peer->sendBase; sequence != peer->nextSequence; sequence++) {
+		struct SendSlot *slot = &peer->sendWindow[sequence % WINDOW_SIZE];
+		if (slot->inUse && !slot->acked) {
+			retransmit(transport, peer, slot, nowMs);
+		}
+	}
+}
+
+static void handleAck(struct Transport *transport, struct Peer *peer, const uint8_t *data, uint64_t nowMs) {
+	if (readU16(data + 1) != peer->localSession) {
+		// Acknowledgement for a previous session
+		return;
+	}
+
+	uint32_t nextExpected = readU32(data + 3);
+	uint32_t mask         = readU32(data + 7);
+
+	if (sequenceDiff(nextExpected, peer->sendBase) < 0 || sequenceDiff(nextExpected, peer->nextSequence) > 0) {
+		return;
+	}
+
+	for (uint32_t sequence = peer->sendBase; sequence != nextExpected; sequence++) {
+		struct SendSlot *slot = &peer->sendWindow[sequence % WINDOW_SIZE];
+		if (!slot->acked) {
+			onSlotAcked(peer, slot, nowMs);
+		}
+		slot->inUse = false;
+	}
+	peer->sendBase = nextExpected;
+
+	bool reneged = hasReneged(peer);
+	if (reneged) {
+		forgetSelectiveAcks(peer);
+	}
+
+	uint32_t sackedCount = 0;
+	for (uint32_t i = 0; i < 32; i++) {
+		if (!(mask & ((uint32_t) 1 << i))) {
+			continue;
+		}
+
+		uint32_t sequence = nextExpected + 1 + i;
+		if (sequenceDiff(sequence, peer->nextSequence) >= 0) {
+			break;
+		}
+
+		struct SendSlot *slot = &peer->sendWindow[sequence % WINDOW_SIZE];
+		if (!slot->acked) {
+			onSlotAcked(peer, slot, nowMs);
+		}
+		sackedCount++;
+	}
+
+	if (reneged) {
+		// Everything the receiver lacks is sent again right away
+		retransmitAll(transport, peer, nowMs);
+	} else if (sackedCount >= FAST_RETRANSMIT_THRESHOLD && peer->sendBase != peer->nextSequence) {
+		struct SendSlot *missing = &peer->sendWindow[peer->sendBase % WINDOW_SIZE];
+		if (missing->inUse && !missing->acked && !missing->retransmitted) {
+			onLoss(peer, false);
+			retransmit(transport, peer, missing, nowMs);
+		}
+	}
+
+	pump(transport, peer, nowMs);
+}
+
+// Hands all in-order fragments to the reassembly stage
+static void drainReceiveWindow(struct Transport *transport, struct Peer *peer, uint64_t nowMs) {
+	for (;;) {
+		struct ReceiveSlot *slot = &peer->receiveWindow[peer->receiveBase % WINDOW_SIZE];
+		if (!slot->present) {
+			return;
+		}
+
+		if (slot->flags & FLAG_FIRST_FRAGMENT) {
+			releaseBuffer(peer->reassembly);
+			peer->reassembly = NULL;
+			peer->discarding = false;
+
+			if (!(slot->flags & FLAG_LAST_FRAGMENT)) {
+				peer->reassembly = acquireBuffer(transport);
+				if (!peer->reassembly) {
+					// Pool exhausted -> keep the fragment buffered and try again later
+					return;
+				}
+				peer->reassemblyUpdatedMs = nowMs;
+			}
+		}
+
+		if (slot->flags == (FLAG_FIRST_FRAGMENT | FLAG_LAST_FRAGMENT)) {
+			transport->deliver(transport->userData, peer->connection, peer->userID, slot->payload, slot->length);
+		} else if (!peer->discarding) {
+			struct ReassemblyBuffer *buffer = peer->reassembly;
+
+			if (!buffer || buffer->length + slot->length > TRANSPORT_MAX_MESSAGE_SIZE) {
+				// Either we missed the beginning of this message or it is bigger than allowed
+				releaseBuffer(buffer);
+				peer->reassembly = NULL;
+				peer->discarding = true;
+			} else {
+				memcpy(buffer->data + buffer->length, slot->payload, slot->length);
+				buffer->length += slot->length;
+				peer->reassemblyUpdatedMs = nowMs;
+
+				if (slot->flags & FLAG_LAST_FRAGMENT) {
+					transport->deliver(transport->userData, peer->connection, peer->userID, buffer->data,
+									   buffer->length);
+					releaseBuffer(buffer);
+					peer->reassembly = NULL;
+				}
+			}
+		}
+
+		if (slot->flags & FLAG_LAST_FRAGMENT) {
+			peer->discarding = false;
+		}
+
+		slot->present = false;
+		peer->receiveBase++;
+	}
+}
+
+static bool isRetiredSession(const struct Peer *peer, uint16_t session) {
+	size_t count = peer->retiredSessionCount < RETIRED_SESSIONS ? peer->retiredSessionCount : RETIRED_SESSIONS;
+	for (size_t i = 0; i < count; i++) {
+		if (peer->retiredSessions[i] == session) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Skips the fragments before the sender's base, which will never be sent (again)
+static void skipTo(struct Peer *peer, uint32_t base) {
+	int32_t skipped = sequenceDiff(base, peer->receiveBase);
+	if (skipped <= 0) {
+		return;
+	}
+
+	for (int32_t i = 0; i < skipped && i < WINDOW_SIZE; i++) {
+		peer->receiveWindow[(peer->receiveBase + (uint32_t) i) % WINDOW_SIZE].present = false;
+	}
+	peer->receiveBase = base;
+
+	// The message that was being reassembled can't be completed anymore
+	releaseBuffer(peer->reassembly);
+	peer->reassembly = NULL;
+	peer->discarding = true;
+}
+
+static void handleData(struct Transport *transport, struct Peer *peer, const uint8_t *data, size_t dataLength,
+					   uint64_t nowMs) {
+	uint16_t session = readU16(data + 1);
+	uint32_t base    = readU32(data + 7);
+	if (!peer->remoteSessionKnown || peer->remoteSession != session) {
+		if (isRetiredSession(peer, session)) {
+			// A delayed packet of a session that the remote side has abandoned since
+			return;
+		}
+
+		// The remote side (re)started -> start over with its sequence numbers
+		if (peer->remoteSessionKnown) {
+			peer->retiredSessions[peer->retiredSessionCount++ % RETIRED_SESSIONS] = peer->remoteSession;
+		}
+		resetReceiving(peer);
+		peer->receiveBase        = base;
+		peer->remoteSession      = session;
+		peer->remoteSessionKnown = true;
+	}
+
+	skipTo(peer, base);
+
+	uint32_t sequence = readU32(data + 3);
+	int32_t offset    = sequenceDiff(sequence, peer->receiveBase);
+
+	if (offset >= WINDOW_SIZE) {
+		// Outside of our window -> the sender will retransmit it later
+		return;
+	}
+
+	peer->ackPending = true;
+
+	if (offset < 0) {
+		// Duplicate of something we already processed. Acknowledge it again as our previous ack might have been lost.
+		return;
+	}
+
+	struct ReceiveSlot *slot = &peer->receiveWindow[sequence % WINDOW_SIZE];
+	if (!slot->present) {
+		slot->present = true;
+		slot->flags   = data[11];
+		slot->length  = (uint16_t)(dataLength - DATA_HEADER_SIZE);
+		memcpy(slot->payload, data + DATA_HEADER_SIZE, slot->length);
+	}
+
+	drainReceiveWindow(transport, peer, nowMs);
+}
+
+
+struct Transport *transport_create(TransportSendFunction send, TransportDeliverFunction deliver, void *userData) {
+	struct Transport *transport = memory_calloc(MEMORY_TRANSPORT, 1, sizeof(struct Transport));
+	if (!transport) {
+		return NULL;
+	}
+
+	transport->send     = send;
+	transport->deliver  = deliver;
+	transport->userData = userData;
+
+	transport->messagePool = memory_createPool(MEMORY_TRANSPORT, sizeof(struct OutgoingMessage) + MAX_PAYLOAD_SIZE,
+											   TRANSPORT_MESSAGE_POOL_SIZE);
+	if (!transport->messagePool) {
+		memory_free(transport);
+
+		return NULL;
+	}
+
+	// Use a non-constant starting point so that a restarted plugin doesn't reuse its previous session IDs
+	transport->nextSession = (uint16_t)((uintptr_t) transport >> 4) ^ (uint16_t) rand();
+
+	return transport;
+}
+
+void transport_destroy(struct Transport *transport) {
+	if (!transport) {
+		return;
+	}
+
+	for (size_t i = 0; i < TRANSPORT_MAX_PEERS; i++) {
+		resetPeer(transport, &transport->peers[i]);
+	}
+
+	memory_destroyPool(transport->messagePool);
+	memory_free(transport);
+}
+
+mumble_error_t transport_send(struct Transport *transport, mumble_connection_t connection, mumble_userid_t peerID,
+							  const uint8_t *data, size_t dataLength, uint64_t nowMs) {
+	if (dataLength > TRANSPORT_MAX_MESSAGE_SIZE) {
+		return MUMBLE_EC_DATA_TOO_BIG;
+	}
+
+	struct Peer *peer = findPeer(transport, connection, peerID, true);
+	if (!peer) {
+		return MUMBLE_EC_GENERIC_ERROR;
+	}
+
+	// Larger messages, and small ones while the pool is exhausted, are allocated from the heap
+	struct OutgoingMessage *message = dataLength <= MAX_PAYLOAD_SIZE ? memory_poolAlloc(transport->messagePool) : NULL;
+	bool pooled                     = message != NULL;
+	if (!message) {
+		message = memory_alloc(MEMORY_TRANSPORT, sizeof(struct OutgoingMessage) + dataLength);
+		if (!message) {
+			return MUMBLE_EC_GENERIC_ERROR;
+		}
+	}
+
+	message->next    = NULL;
+	message->pooled  = pooled;
+	message->length  = dataLength;
+	message->offset  = 0;
+	message->started = false;
+	memcpy(message->data, data, dataLength);
+
+	if (peer->queueTail) {
+		peer->queueTail->next = message;
+	} else {
+		peer->queueHead = message;
+	}
+	peer->queueTail = message;
+
+	pump(transport, peer, nowMs);
+
+	return MUMBLE_STATUS_OK;
+}
+
+bool transport_receive(struct Transport *transport, mumble_connection_t connection, mumble_userid_t peerID,
+					   const uint8_t *data, size_t dataLength, uint64_t nowMs) {
+	if (dataLength < 1) {
+		return false;
+	}
+
+	if (data[0] == PACKET_TYPE_DATA && dataLength >= DATA_HEADER_SIZE && dataLength <= TRANSPORT_MTU) {
+		struct Peer *peer = findPeer(transport, connection, peerID, true);
+		if (peer) {
+			handleData(transport, peer, data, dataLength, nowMs);
+		}
+
+		return true;
+	}
+
+	if (data[0] == PACKET_TYPE_ACK && dataLength == ACK_PACKET_SIZE) {
+		struct Peer *peer = findPeer(transport, connection, peerID, false);
+		if (peer) {
+			handleAck(transport, peer, data, nowMs);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+void transport_tick(struct Transport *transport, uint64_t nowMs) {
+	for (size_t i = 0; i < TRANSPORT_MAX_PEERS; i++) {
+		struct Peer *peer = &transport->peers[i];
+		if (!peer->inUse) {
+			continue;
+		}
+
+		if (peer->ackPending) {
+			sendAck(transport, peer);
+		}
+
+		// A partial message whose sender has given up would hold on to its buffer forever. The rest of it is discarded.
+		if (peer->reassembly && nowMs - peer->reassemblyUpdatedMs >= REASSEMBLY_TIMEOUT_MS) {
+			releaseBuffer(peer->reassembly);
+			peer->reassembly = NULL;
+			peer->discarding = true;
+		}
+
+		// Reassembly might have stalled because the pool was exhausted
+		drainReceiveWindow(transport, peer, nowMs);
+
+		// A receiver that has been restarted might not send any acknowledgements that would tell
+		struct SendSlot *oldest = &peer->sendWindow[peer->sendBase % WINDOW_SIZE];
+		if (hasReneged(peer) && nowMs - oldest->sentAt >= peer->rto) {
+			forgetSelectiveAcks(peer);
+			retransmitAll(transport, peer, nowMs);
+		}
+
+		// Like TCP only the oldest timed out packet is retransmitted right away. The timers of all other outstanding
+		// packets are restarted so that they go out again as the (collapsed) congestion window permits.
+		struct SendSlot *timedOut = NULL;
+		for (uint32_t sequence = peer->sendBase; sequence != peer->nextSequence; sequence++) {
+			struct SendSlot *slot = &peer->sendWindow[sequence % WINDOW_SIZE];
+			if (!slot->inUse || slot->acked) {
+				continue;
+			}
+
+			if (timedOut) {
+				slot->sentAt = nowMs;
+			} else if (nowMs - slot->sentAt >= peer->rto) {
+				timedOut = slot;
+			}
+		}
+
+		if (timedOut) {
+			if (timedOut->retransmissions >= MAX_RETRANSMISSIONS) {
+				// The peer seems to be gone. What it has sent so far is still delivered.
+				resetSending(transport, peer);
+				continue;
+			}
+
+			onLoss(peer, true);
+			retransmit(transport, peer, timedOut, nowMs);
+			peer->rto = peer->rto * 2 > MAX_RTO_MS ? MAX_RTO_MS : peer->rto * 2;
+		}
+
+		pump(transport, peer, nowMs);
+	}
+}
+
+void transport_removePeer(struct Transport *transport, mumble_connection_t connection, mumble_userid_t peerID) {
+	struct Peer *peer = findPeer(transport, connection, peerID, false);
+	if (peer) {
+		resetPeer(transport, peer);
+	}
+}
+
+void transport_removeConnection(struct Transport *transport, mumble_connection_t connection) {
+	for (size_t i = 0; i < TRANSPORT_MAX_PEERS; i++) {
+		if (transport->peers[i].inUse && transport->peers[i].connection == connection) {
+			resetPeer(transport, &transport->peers[i]);
+		}
+	}
+}
@@ -0,0 +1,90 @@
+/// This header file declares a reliable, ordered message transport on top of Mumble's plugin data messages.
+///
+/// Messages handed to transport_send are split into fragments that fit into a single sendData call, numbered,
+/// acknowledged selectively by the receiver and retransmitted until acknowledged. The receiver reassembles fragments
+/// into buffers taken from a fixed pool and hands complete messages to the deliver callback in the order they were
+/// sent. A congestion window limits the number of unacknowledged fragments per peer.
+///
+/// Every packet carries the sender's session and the oldest fragment it is still sending, so a receiver that (re)starts
+/// in the middle of a stream picks it up from there, and delayed packets of a session the sender has abandoned are
+/// ignored. A sender that gives up on a peer only starts a new session for what it sends; a partial message that is
+/// never completed is dropped after a while so that it doesn't hold on to its reassembly buffer.
+///
+/// The transport never calls into Mumble directly. Instead packets leave through the send callback and enter through
+/// transport_receive, so a lossy and reordering loopback can stand in for Mumble when testing.
+///
+/// NOTE: A transport instance is not thread-safe. All functions have to be called from the same thread (usually
+/// Mumble's main thread, which is where mumble_onReceiveData is called from).
+
+#ifndef MUMBLE_PLUGIN_TRANSPORT_H_
+#define MUMBLE_PLUGIN_TRANSPORT_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// The data ID that is used for all packets of the transport
+#define TRANSPORT_DATA_ID "hello_mumble:transport"
+/// The maximum size of a single packet handed to the send callback. Mumble limits plugin messages to 1KB.
+#define TRANSPORT_MTU 1000
+/// The maximum size of a message that can be sent and reassembled
+#define TRANSPORT_MAX_MESSAGE_SIZE (64 * 1024)
+/// The amount of reassembly buffers shared by all peers
+#define TRANSPORT_REASSEMBLY_POOL_SIZE 8
+/// The maximum amount of peers a transport keeps state for at the same time
+#define TRANSPORT_MAX_PEERS 32
+/// The amount of preallocated queue entries for messages that fit into a single packet. Further messages are
+/// allocated from the heap.
+#define TRANSPORT_MESSAGE_POOL_SIZE 128
+
+/// Sends a single packet to the given peer. Usually this forwards to mumbleAPI.sendData using TRANSPORT_DATA_ID.
+typedef mumble_error_t (*TransportSendFunction)(void *userData, mumble_connection_t connection, mumble_userid_t peer,
+												const uint8_t *data, size_t dataLength);
+
+/// Receives a complete message. The data pointer is only valid for the duration of the call.
+typedef void (*TransportDeliverFunction)(void *userData, mumble_connection_t connection, mumble_userid_t peer,
+										 const uint8_t *data, size_t dataLength);
+
+struct Transport;
+
+/// Creates a new transport. All memory the transport needs (except for queued outgoing messages) is allocated here.
+///
+/// @param send The function used to send packets
+/// @param deliver The function that complete messages are handed to
+/// @param userData An arbitrary pointer that is passed to both callbacks
+/// @returns The new transport or NULL if allocating it failed
+struct Transport *transport_create(TransportSendFunction send, TransportDeliverFunction deliver, void *userData);
+
+/// Destroys the given transport, dropping all queued and partially received messages.
+void transport_destroy(struct Transport *transport);
+
+/// Queues the given message for reliable delivery to the given peer. The data is copied.
+///
+/// @param nowMs The current time in milliseconds (monotonic)
+/// @returns The error code. MUMBLE_EC_DATA_TOO_BIG if the message exceeds TRANSPORT_MAX_MESSAGE_SIZE and
+/// MUMBLE_EC_GENERIC_ERROR if no further peer can be tracked or memory is exhausted.
+mumble_error_t transport_send(struct Transport *transport, mumble_connection_t connection, mumble_userid_t peer,
+							  const uint8_t *data, size_t dataLength, uint64_t nowMs);
+
+/// Processes a packet that has been received with TRANSPORT_DATA_ID.
+///
+/// @param nowMs The current time in milliseconds (monotonic)
+/// @returns Whether the packet was a valid transport packet
+bool transport_receive(struct Transport *transport, mumble_connection_t connection, mumble_userid_t peer,
+					   const uint8_t *data, size_t dataLength, uint64_t nowMs);
+
+/// Sends pending acknowledgements, retransmits timed out fragments and pushes queued fragments as far as the
+/// congestion window allows. This has to be called regularly (e.g. every 50ms).
+///
+/// @param nowMs The current time in milliseconds (monotonic)
+void transport_tick(struct Transport *transport, uint64_t nowMs);
+
+/// Forgets all state (including queued messages) kept for the given peer
+void transport_removePeer(struct Transport *transport, mumble_connection_t connection, mumble_userid_t peer);
+
+/// Forgets all state kept for peers on the given connection
+void transport_removeConnection(struct Transport *transport, mumble_connection_t connection);
+
+#endif // MUMBLE_PLUGIN_TRANSPORT_H_
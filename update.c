@@ -0,0 +1,641 @@
+#include "update.h"
+#include "memory.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// The manifest is only fetched over TLS (OpenSSL)
+#if defined(__linux__) && defined(UPDATE_HTTPS)
+#	define FETCH_SUPPORTED
+#endif
+
+#ifdef FETCH_SUPPORTED
+#	include <arpa/inet.h>
+#	include <errno.h>
+#	include <netdb.h>
+#	include <openssl/ssl.h>
+#	include <openssl/x509v3.h>
+#	include <poll.h>
+#	include <sys/eventfd.h>
+#	include <sys/socket.h>
+#	include <time.h>
+#	include <unistd.h>
+#endif
+
+#define MAX_HOST 128
+#define MAX_PORT 8
+#define MAX_VALIDATOR 128
+#define MAX_REQUEST 1024
+
+// The parts of a response the checker cares about. The cache file is stored in the same format.
+struct Response {
+	int status;
+	char etag[MAX_VALIDATOR];
+	char lastModified[MAX_VALIDATOR];
+	// Points into the parsed buffer
+	char *body;
+	size_t bodyLength;
+};
+
+struct UpdateChecker {
+	char host[MAX_HOST];
+	char port[MAX_PORT];
+	char path[UPDATE_MAX_URL];
+	// Empty if there is no cache
+	char cachePath[512];
+	// Empty to trust the system's certificates
+	char caFile[512];
+	unsigned int timeoutMs;
+	mumble_version_t currentVersion;
+
+	// The validators of the cached manifest (only accessed by the thread fetching it once that has been started)
+	char etag[MAX_VALIDATOR];
+	char lastModified[MAX_VALIDATOR];
+
+	atomic_bool available;
+	pthread_mutex_t lock;
+	char downloadURL[UPDATE_MAX_URL];
+
+#ifdef FETCH_SUPPORTED
+	// Written to in order to abort the fetch
+	int stopFD;
+	bool fetching;
+	pthread_t thread;
+	char response[UPDATE_MAX_RESPONSE + 1];
+#endif
+};
+
+
+////////////////////////////////// Parsing //////////////////////////////////
+
+static char *trim(char *string) {
+	while (*string == ' ' || *string == '\t') {
+		string++;
+	}
+
+	size_t length = strlen(string);
+	while (length > 0 && strchr(" \t\r\n", string[length - 1])) {
+		string[--length] = '\0';
+	}
+
+	return string;
+}
+
+static bool parseURL(struct UpdateChecker *checker, const char *url) {
+	// The manifest decides what users are offered to download, so it has to come from an authenticated server
+	static const char scheme[] = "https://";
+	if (strncmp(url, scheme, strlen(scheme)) != 0) {
+		return false;
+	}
+	const char *host = url + strlen(scheme);
+
+	// IPv6 addresses are enclosed in brackets
+	const char *hostEnd = host[0] == '[' ? strchr(host, ']') : host + strcspn(host, ":/");
+	if (!hostEnd) {
+		return false;
+	}
+	if (host[0] == '[') {
+		host++;
+	}
+
+	size_t hostLength = (size_t) (hostEnd - host);
+	if (hostLength == 0 || hostLength >= sizeof(checker->host)) {
+		return false;
+	}
+	memcpy(checker->host, host, hostLength);
+	checker->host[hostLength] = '\0';
+
+	const char *rest = hostEnd + (*hostEnd == ']');
+	strcpy(checker->port, "443");
+	if (*rest == ':') {
+		size_t portLength = strspn(rest + 1, "0123456789");
+		if (portLength == 0 || portLength >= sizeof(checker->port)) {
+			return false;
+		}
+		memcpy(checker->port, rest + 1, portLength);
+		checker->port[portLength] = '\0';
+		rest += 1 + portLength;
+	}
+
+	if (*rest != '\0' && *rest != '/') {
+		return false;
+	}
+	int length = snprintf(checker->path, sizeof(checker->path), "%s", *rest == '/' ? rest : "/");
+
+	return length > 0 && (size_t) length < sizeof(checker->path) && !strpbrk(checker->path, " \r\n");
+}
+
+static bool parseVersion(const char *string, mumble_version_t *version) {
+	int consumed = 0;
+	if (sscanf(string, "%d.%d.%d%n", &version->major, &version->minor, &version->patch, &consumed) != 3) {
+		return false;
+	}
+
+	return string[consumed] == '\0';
+}
+
+static bool isNewer(mumble_version_t version, mumble_version_t current) {
+	if (version.major != current.major) {
+		return version.major > current.major;
+	}
+	if (version.minor != current.minor) {
+		return version.minor > current.minor;
+	}
+
+	return version.patch > current.patch;
+}
+
+// Publishes what the manifest says
+//
+// @returns Whether the manifest is valid
+static bool applyManifest(struct UpdateChecker *checker, const char *manifest, size_t length) {
+	char buffer[UPDATE_MAX_RESPONSE + 1];
+	if (length >= sizeof(buffer)) {
+		return false;
+	}
+	memcpy(buffer, manifest, length);
+	buffer[length] = '\0';
+
+	bool hasVersion          = false;
+	mumble_version_t version = { 0, 0, 0 };
+	const char *url          = NULL;
+	char *position;
+	for (char *line = strtok_r(buffer, "\n", &position); line; line = strtok_r(NULL, "\n", &position)) {
+		line = trim(line);
+		if (line[0] == '\0' || line[0] == '#') {
+			continue;
+		}
+
+		char *separator = strchr(line, '=');
+		if (!separator) {
+			return false;
+		}
+		*separator  = '\0';
+		char *key   = trim(line);
+		char *value = trim(separator + 1);
+
+		if (strcmp(key, "version") == 0) {
+			hasVersion = parseVersion(value, &version);
+		} else if (strcmp(key, "url") == 0) {
+			url = value;
+		}
+		// Unknown keys are ignored so that newer manifests still work with older versions
+	}
+
+	if (!hasVersion || !url || url[0] == '\0' || strlen(url) >= sizeof(checker->downloadURL)) {
+		return false;
+	}
+
+	bool available = isNewer(version, checker->currentVersion);
+
+	pthread_mutex_lock(&checker->lock);
+	strcpy(checker->downloadURL, available ? url : "");
+	pthread_mutex_unlock(&checker->lock);
+	atomic_store(&checker->available, available);
+
+	return true;
+}
+
+// Decodes a chunked body in place
+static bool decodeChunked(char *body, size_t *length) {
+	size_t read    = 0;
+	size_t written = 0;
+	for (;;) {
+		char *end;
+		unsigned long chunkLength = strtoul(body + read, &end, 16);
+		// Chunk extensions are ignored
+		char *lineEnd = strstr(end, "\r\n");
+		if (end == body + read || !lineEnd || lineEnd >= body + *length) {
+			return false;
+		}
+		read = (size_t) (lineEnd - body) + 2;
+
+		if (chunkLength == 0) {
+			*length = written;
+			return true;
+		}
+		if (chunkLength > *length - read || *length - read - chunkLength < 2) {
+			return false;
+		}
+
+		memmove(body + written, body + read, chunkLength);
+		written += chunkLength;
+		read += chunkLength + 2;
+	}
+}
+
+// Parses a response (which has to be null-terminated) in place
+static bool parseResponse(char *data, size_t length, struct Response *response) {
+	memset(response, 0, sizeof(*response));
+
+	char *headersEnd = strstr(data, "\r\n\r\n");
+	int consumed     = 0;
+	if (!headersEnd || sscanf(data, "HTTP/1.%*d %3d%n", &response->status, &consumed) != 1 || consumed == 0) {
+		return false;
+	}
+	*headersEnd          = '\0';
+	response->body       = headersEnd + 4;
+	response->bodyLength = length - (size_t) (response->body - data);
+
+	bool chunked            = false;
+	long long contentLength = -1;
+	// The headers have been terminated after their last line, so that its line break isn't found anymore
+	for (char *line = strstr(data, "\r\n"); line;) {
+		line += 2;
+		char *lineEnd = strstr(line, "\r\n");
+		if (lineEnd) {
+			*lineEnd = '\0';
+		}
+
+		char *separator = strchr(line, ':');
+		if (separator) {
+			*separator  = '\0';
+			char *name  = trim(line);
+			char *value = trim(separator + 1);
+
+			if (strcasecmp(name, "ETag") == 0) {
+				snprintf(response->etag, sizeof(response->etag), "%s", value);
+			} else if (strcasecmp(name, "Last-Modified") == 0) {
+				snprintf(response->lastModified, sizeof(response->lastModified), "%s", value);
+			} else if (strcasecmp(name, "Content-Length") == 0) {
+				contentLength = strtoll(value, NULL, 10);
+			} else if (strcasecmp(name, "Transfer-Encoding") == 0) {
+				chunked = strcasecmp(value, "chunked") == 0;
+			}
+		}
+
+		line = lineEnd;
+	}
+
+	if (chunked) {
+		return decodeChunked(response->body, &response->bodyLength);
+	}
+	if (contentLength >= 0) {
+		// A truncated body is worthless
+		if ((unsigned long long) contentLength > response->bodyLength) {
+			return false;
+		}
+		response->bodyLength = (size_t) contentLength;
+	}
+
+	return true;
+}
+
+
+////////////////////////////////// Cache //////////////////////////////////
+
+static void loadCache(struct UpdateChecker *checker) {
+	FILE *file = fopen(checker->cachePath, "rb");
+	if (!file) {
+		return;
+	}
+
+	char buffer[UPDATE_MAX_RESPONSE + 1];
+	size_t length = fread(buffer, 1, UPDATE_MAX_RESPONSE, file);
+	bool complete = feof(file) && !ferror(file);
+	fclose(file);
+	buffer[length] = '\0';
+
+	struct Response response;
+	if (complete && parseResponse(buffer, length, &response) && response.status == 200
+		&& applyManifest(checker, response.body, response.bodyLength)) {
+		strcpy(checker->etag, response.etag);
+		strcpy(checker->lastModified, response.lastModified);
+	}
+}
+
+#ifdef FETCH_SUPPORTED
+// The file is replaced atomically, so that a crash never leaves a truncated cache behind
+static void saveCache(const struct UpdateChecker *checker, const struct Response *response) {
+	if (checker->cachePath[0] == '\0') {
+		return;
+	}
+
+	char temporaryPath[sizeof(checker->cachePath) + 8];
+	snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", checker->cachePath);
+
+	FILE *file = fopen(temporaryPath, "wb");
+	if (!file) {
+		return;
+	}
+
+	// The validators are stored as headers, so that the cache is parsed just like a response
+	bool written = fprintf(file, "HTTP/1.1 200 OK\r\nETag: %s\r\nLast-Modified: %s\r\n\r\n", response->etag,
+						   response->lastModified)
+					   > 0
+				   && fwrite(response->body, 1, response->bodyLength, file) == response->bodyLength;
+	written = fclose(file) == 0 && written;
+
+	if (!written || rename(temporaryPath, checker->cachePath) != 0) {
+		remove(temporaryPath);
+	}
+}
+#endif
+
+
+////////////////////////////////// Fetching //////////////////////////////////
+
+#ifdef FETCH_SUPPORTED
+static uint64_t monotonicMs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+// Waits until the socket is ready for the given events
+//
+// @returns Whether it is ready (false if the deadline has passed or the fetch has been aborted)
+static bool waitFor(const struct UpdateChecker *checker, int socketFD, short events, uint64_t deadline) {
+	struct pollfd fds[2] = { { socketFD, events, 0 }, { checker->stopFD, POLLIN, 0 } };
+	for (;;) {
+		uint64_t now = monotonicMs();
+		if (now >= deadline) {
+			return false;
+		}
+
+		int ready = poll(fds, 2, (int) (deadline - now));
+		if (ready < 0 && errno == EINTR) {
+			continue;
+		}
+
+		return ready > 0 && !fds[1].revents && fds[0].revents;
+	}
+}
+
+static int connectToServer(const struct UpdateChecker *checker, uint64_t deadline) {
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo *addresses;
+	if (getaddrinfo(checker->host, checker->port, &hints, &addresses) != 0) {
+		return -1;
+	}
+
+	int socketFD = -1;
+	for (struct addrinfo *address = addresses; address && socketFD < 0; address = address->ai_next) {
+		int type = address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC;
+		socketFD = socket(address->ai_family, type, address->ai_protocol);
+		if (socketFD < 0) {
+			continue;
+		}
+
+		int error           = 0;
+		socklen_t errorSize = sizeof(error);
+		bool connected      = connect(socketFD, address->ai_addr, address->ai_addrlen) == 0
+						 || (errno == EINPROGRESS && waitFor(checker, socketFD, POLLOUT, deadline)
+							 && getsockopt(socketFD, SOL_SOCKET, SO_ERROR, &error, &errorSize) == 0 && error == 0);
+		if (!connected) {
+			close(socketFD);
+			socketFD = -1;
+		}
+	}
+
+	freeaddrinfo(addresses);
+
+	return socketFD;
+}
+
+// Waits until the TLS connection can make progress after an operation returned the given result
+//
+// @returns Whether it can (false if the operation failed for good, the deadline has passed or the fetch has been
+// aborted)
+static bool waitForTLS(const struct UpdateChecker *checker, int socketFD, SSL *tls, int result, uint64_t deadline) {
+	switch (SSL_get_error(tls, result)) {
+		case SSL_ERROR_WANT_READ:
+			return waitFor(checker, socketFD, POLLIN, deadline);
+		case SSL_ERROR_WANT_WRITE:
+			return waitFor(checker, socketFD, POLLOUT, deadline);
+		default:
+			return false;
+	}
+}
+
+// Performs the TLS handshake, which only succeeds if the server presents a certificate for the manifest's host that
+// the system (or the CA file) trusts
+//
+// @returns The connection or NULL if the handshake failed
+static SSL *startTLS(const struct UpdateChecker *checker, SSL_CTX *context, int socketFD, uint64_t deadline) {
+	SSL *tls = SSL_new(context);
+	if (!tls) {
+		return NULL;
+	}
+
+	// Addresses are matched against the certificate's IP addresses and aren't sent as the server name
+	uint8_t address[16];
+	bool isAddress =
+		inet_pton(AF_INET, checker->host, address) == 1 || inet_pton(AF_INET6, checker->host, address) == 1;
+	bool configured =
+		SSL_set_fd(tls, socketFD) == 1
+		&& (isAddress ? X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(tls), checker->host) == 1
+					  : SSL_set1_host(tls, checker->host) == 1 && SSL_set_tlsext_host_name(tls, checker->host) == 1);
+
+	while (configured) {
+		int result = SSL_connect(tls);
+		if (result == 1) {
+			return tls;
+		}
+		if (!waitForTLS(checker, socketFD, tls, result, deadline)) {
+			break;
+		}
+	}
+
+	SSL_free(tls);
+
+	return NULL;
+}
+
+// Appends to a request of MAX_REQUEST bytes
+//
+// @returns Whether it still fits
+static bool append(char *request, size_t *length, const char *format, ...) {
+	va_list arguments;
+	va_start(arguments, format);
+	int written = vsnprintf(request + *length, MAX_REQUEST - *length, format, arguments);
+	va_end(arguments);
+
+	if (written < 0 || (size_t) written >= MAX_REQUEST - *length) {
+		return false;
+	}
+	*length += (size_t) written;
+
+	return true;
+}
+
+// Sends the (conditional) request and reads the whole response into checker->response
+//
+// @returns The length of the response (0 if fetching it failed)
+static size_t fetch(struct UpdateChecker *checker) {
+	uint64_t deadline = monotonicMs() + checker->timeoutMs;
+
+	mumble_version_t version = checker->currentVersion;
+	bool bracketed           = strchr(checker->host, ':') != NULL;
+	bool defaultPort         = strcmp(checker->port, "443") == 0;
+
+	char request[MAX_REQUEST];
+	size_t requestLength = 0;
+	bool valid = append(request, &requestLength, "GET %s HTTP/1.1\r\nHost: %s%s%s%s%s\r\n", checker->path,
+						bracketed ? "[" : "", checker->host, bracketed ? "]" : "", defaultPort ? "" : ":",
+						defaultPort ? "" : checker->port)
+				 && append(request, &requestLength, "User-Agent: hello_mumble/%d.%d.%d\r\nConnection: close\r\n",
+						   version.major, version.minor, version.patch)
+				 && (checker->etag[0] == '\0'
+					 || append(request, &requestLength, "If-None-Match: %s\r\n", checker->etag))
+				 && (checker->lastModified[0] == '\0'
+					 || append(request, &requestLength, "If-Modified-Since: %s\r\n", checker->lastModified))
+				 && append(request, &requestLength, "\r\n");
+	if (!valid) {
+		return 0;
+	}
+
+	SSL_CTX *context = SSL_CTX_new(TLS_client_method());
+	if (!context) {
+		return 0;
+	}
+	SSL_CTX_set_verify(context, SSL_VERIFY_PEER, NULL);
+	SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+#	ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+	// Servers commonly close the connection without a close_notify. Truncated bodies are still caught by their
+	// Content-Length or chunked encoding.
+	SSL_CTX_set_options(context, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#	endif
+
+	bool trusted = checker->caFile[0] != '\0' ? SSL_CTX_load_verify_locations(context, checker->caFile, NULL) == 1
+											   : SSL_CTX_set_default_verify_paths(context) == 1;
+	int socketFD = trusted ? connectToServer(checker, deadline) : -1;
+	SSL *tls     = socketFD >= 0 ? startTLS(checker, context, socketFD, deadline) : NULL;
+
+	size_t sent = 0;
+	while (tls && sent < requestLength) {
+		int result = SSL_write(tls, request + sent, (int) (requestLength - sent));
+		if (result > 0) {
+			sent += (size_t) result;
+		} else if (!waitForTLS(checker, socketFD, tls, result, deadline)) {
+			break;
+		}
+	}
+
+	// The server closes the connection once the response is complete (Connection: close)
+	size_t received = 0;
+	bool complete   = false;
+	while (tls && sent == requestLength && received < UPDATE_MAX_RESPONSE) {
+		int result = SSL_read(tls, checker->response + received, (int) (UPDATE_MAX_RESPONSE - received));
+		if (result > 0) {
+			received += (size_t) result;
+		} else if (SSL_get_error(tls, result) == SSL_ERROR_ZERO_RETURN) {
+			complete = true;
+			break;
+		} else if (!waitForTLS(checker, socketFD, tls, result, deadline)) {
+			break;
+		}
+	}
+
+	SSL_free(tls);
+	SSL_CTX_free(context);
+	if (socketFD >= 0) {
+		close(socketFD);
+	}
+	checker->response[received] = '\0';
+
+	return complete ? received : 0;
+}
+
+static void *runFetch(void *arg) {
+	struct UpdateChecker *checker = arg;
+
+	size_t length = fetch(checker);
+
+	struct Response response;
+	// A 304 (Not Modified) confirms the cached manifest, which has been applied already
+	if (length > 0 && parseResponse(checker->response, length, &response) && response.status == 200
+		&& applyManifest(checker, response.body, response.bodyLength)) {
+		saveCache(checker, &response);
+	}
+
+	return NULL;
+}
+#endif
+
+
+////////////////////////////////// API //////////////////////////////////
+
+struct UpdateChecker *update_create(const char *manifestURL, const char *cacheDirectory,
+									mumble_version_t currentVersion, const char *caFile, unsigned int timeoutMs) {
+	struct UpdateChecker *checker = memory_calloc(MEMORY_UPDATE, 1, sizeof(struct UpdateChecker));
+	if (!checker) {
+		return NULL;
+	}
+
+	int caLength = snprintf(checker->caFile, sizeof(checker->caFile), "%s", caFile ? caFile : "");
+	if (!parseURL(checker, manifestURL) || (size_t) caLength >= sizeof(checker->caFile)
+		|| pthread_mutex_init(&checker->lock, NULL) != 0) {
+		memory_free(checker);
+		return NULL;
+	}
+	checker->timeoutMs      = timeoutMs;
+	checker->currentVersion = currentVersion;
+	atomic_init(&checker->available, false);
+
+	if (cacheDirectory) {
+		int length =
+			snprintf(checker->cachePath, sizeof(checker->cachePath), "%s/" UPDATE_CACHE_FILE_NAME, cacheDirectory);
+		if (length > 0 && (size_t) length < sizeof(checker->cachePath)) {
+			loadCache(checker);
+		} else {
+			checker->cachePath[0] = '\0';
+		}
+	}
+
+#ifdef FETCH_SUPPORTED
+	// Failing to start the fetch leaves the cached manifest in place
+	checker->stopFD   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	checker->fetching = checker->stopFD >= 0 && pthread_create(&checker->thread, NULL, &runFetch, checker) == 0;
+#endif
+
+	return checker;
+}
+
+void update_destroy(struct UpdateChecker *checker) {
+	if (!checker) {
+		return;
+	}
+
+#ifdef FETCH_SUPPORTED
+	if (checker->fetching) {
+		// Should this fail, the fetch still ends once it times out
+		uint64_t value = 1;
+		ssize_t result = write(checker->stopFD, &value, sizeof(value));
+		(void) result;
+		pthread_join(checker->thread, NULL);
+	}
+	if (checker->stopFD >= 0) {
+		close(checker->stopFD);
+	}
+#endif
+
+	pthread_mutex_destroy(&checker->lock);
+	memory_free(checker);
+}
+
+bool update_available(const struct UpdateChecker *checker) {
+	return checker && atomic_load_explicit(&checker->available, memory_order_relaxed);
+}
+
+size_t update_getURL(struct UpdateChecker *checker, char *buffer, size_t size) {
+	if (size == 0) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&checker->lock);
+	snprintf(buffer, size, "%s", checker->downloadURL);
+	pthread_mutex_unlock(&checker->lock);
+
+	return strlen(buffer);
+}
@@ -0,0 +1,66 @@
+/// This header file declares the plugin's update checker.
+///
+/// Mumble asks plugins whether they have an update while it is starting up, so the answer has to be at hand without
+/// waiting for the network. The checker fetches a small manifest once, on a thread of its own, and keeps the result in
+/// memory, where update_available is a single atomic load. The manifest is cached on disk along with the validators
+/// the server sent (ETag and Last-Modified): The cached manifest answers right away, and the fetch is a conditional
+/// request that the server answers with 304 Not Modified (and no body) as long as the manifest hasn't changed.
+///
+/// The manifest consists of "key = value" lines:
+///
+///     version = 1.2.0
+///     url = https://example.com/hello_mumble-1.2.0.zip
+///
+/// The manifest decides what users are offered to download, so it is only fetched over HTTPS from a server whose
+/// certificate the system (or the CA file the checker has been given) trusts, through OpenSSL. Redirects aren't
+/// followed. Fetching is only available on Linux in builds with OpenSSL, elsewhere the cached manifest is all the
+/// checker knows about.
+///
+/// NOTE: Name resolution can't be interrupted, so destroying the checker may have to wait for it to finish.
+
+#ifndef MUMBLE_PLUGIN_UPDATE_H_
+#define MUMBLE_PLUGIN_UPDATE_H_
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define UPDATE_CACHE_FILE_NAME "update.cache"
+/// The maximum length of the manifest's URL and the download URL (including the terminating null byte)
+#define UPDATE_MAX_URL 256
+/// The maximum size of a response (headers included). Larger responses are discarded.
+#define UPDATE_MAX_RESPONSE (8 * 1024)
+/// How long the fetch takes at most by default
+#define UPDATE_TIMEOUT_MS 10000
+
+struct UpdateChecker;
+
+/// Loads the cached manifest and starts fetching the current one
+///
+/// @param manifestURL The manifest's URL (https://host[:port]/path)
+/// @param cacheDirectory The directory the manifest is cached in (NULL disables the cache)
+/// @param currentVersion The version of the running plugin
+/// @param caFile A PEM file with the certificates to trust instead of the system's (NULL to use the system's), e.g. for
+/// a test server
+/// @param timeoutMs How long the fetch may take as a whole
+/// @returns The checker or NULL if the URL is invalid (including any URL that isn't HTTPS) or creating the checker
+/// failed
+struct UpdateChecker *update_create(const char *manifestURL, const char *cacheDirectory,
+									mumble_version_t currentVersion, const char *caFile, unsigned int timeoutMs);
+
+/// Aborts the fetch (if it is still running) and destroys the checker
+void update_destroy(struct UpdateChecker *checker);
+
+/// Safe to call from any thread
+///
+/// @returns Whether the manifest announces a newer version (false if checker is NULL)
+bool update_available(const struct UpdateChecker *checker);
+
+/// Safe to call from any thread
+///
+/// @param[out] buffer The buffer the download URL is written to
+/// @returns The length of the URL (0 if there is no update)
+size_t update_getURL(struct UpdateChecker *checker, char *buffer, size_t size);
+
+#endif // MUMBLE_PLUGIN_UPDATE_H_